@@ -13,8 +13,10 @@ import {
 import { createStyledBreakpointsTheme } from 'styled-breakpoints'
 import styled, { ThemeProvider } from 'styled-components'
 import { create } from 'zustand'
-import { Spinner } from './common'
+import { Spinner, TraceOverlay } from './common'
 import { useDebounce } from './common/hooks/use-debounce'
+import { benchmarkConfig } from './common/utils/benchmark'
+import { getTraceBuffer } from './common/utils/tracing'
 import { Controls } from './controls'
 import { DebugKeyboardControls, useDebug } from './debug'
 import { ScreenshotKeyboardControls, useScreenshot } from './screenshot'
@@ -356,7 +358,7 @@ const SketchModule = memo(({ route }: { route: string }) => {
 })
 
 const useIsFullscreen = () => {
-    const [fullscreen] = useState(() => document.location.search.includes('fullscreen'))
+    const [fullscreen] = useState(() => document.location.search.includes('fullscreen') || benchmarkConfig !== null)
 
     return fullscreen
 }
@@ -503,6 +505,8 @@ const App = () => {
             <ScreenshotKeyboardControls />
             <DebugKeyboardControls />
 
+            {getTraceBuffer() && <TraceOverlay />}
+
             {!debugMode && !screenshotMode && !isFullscreen ? (
                 <GithubLink target="_blank" href={`https://github.com/isaac-mason/sketches/tree/main/src/sketches/${sketchPath}`}>
                     GitHub
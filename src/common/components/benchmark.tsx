@@ -0,0 +1,179 @@
+import { Html } from '@react-three/drei'
+import { useThree } from '@react-three/fiber'
+import { useEffect, useMemo, useState } from 'react'
+import styled from 'styled-components'
+import {
+    BenchmarkConfig,
+    BenchmarkResult,
+    startBenchmarkRecording,
+    stopBenchmarkRecording,
+    summarizeBenchmarkSamples,
+} from '../utils/benchmark'
+
+declare global {
+    interface Window {
+        benchmarkResult?: BenchmarkResult
+    }
+}
+
+const ResultWrapper = styled.div`
+    position: absolute;
+    top: 0;
+    left: 0;
+    z-index: 1000;
+    max-width: 100%;
+    max-height: 100%;
+    overflow: auto;
+    box-sizing: border-box;
+    padding: 1em;
+    color: #fff;
+    background-color: rgba(0, 0, 0, 0.8);
+    font-size: 0.8rem;
+
+    a {
+        color: #fff;
+    }
+`
+
+const readHeap = () => (performance as Performance & { memory?: { usedJSHeapSize: number } }).memory?.usedJSHeapSize
+
+export type BenchmarkRunnerProps = {
+    config: BenchmarkConfig
+}
+
+/**
+ * Drives a canvas with `frameloop="never"` for the warmup and recorded frames of a benchmark.
+ *
+ * Each frame advances the clock by a fixed delta, so fixed time steps step the same amount on every run.
+ * The result is logged as JSON, set on `window.benchmarkResult`, dispatched as a `benchmark-complete` event, and shown over the canvas.
+ */
+export const BenchmarkRunner = ({ config }: BenchmarkRunnerProps) => {
+    const gl = useThree((s) => s.gl)
+    const advance = useThree((s) => s.advance)
+
+    const [result, setResult] = useState<BenchmarkResult | null>(null)
+
+    useEffect(() => {
+        const { frames, warmupFrames, frameDelta } = config
+        const totalFrames = warmupFrames + frames
+
+        // draw calls and triangles are read after each frame
+        gl.info.autoReset = false
+
+        const frameTimes: number[] = []
+        const cpuTimes: number[] = []
+        const drawCalls: number[] = []
+        const triangles: number[] = []
+
+        let heapStart: number | undefined
+        let heapPeak = 0
+
+        let frame = 0
+        let lastFrameTime: number | undefined
+        let animationFrame = 0
+
+        const finish = () => {
+            const timers = stopBenchmarkRecording()
+            const heapEnd = readHeap()
+
+            const benchmarkResult: BenchmarkResult = {
+                route: window.location.pathname,
+                userAgent: navigator.userAgent,
+                config,
+                canvas: { width: gl.domElement.width, height: gl.domElement.height, pixelRatio: gl.getPixelRatio() },
+                frameTime: summarizeBenchmarkSamples(frameTimes),
+                cpuTime: summarizeBenchmarkSamples(cpuTimes),
+                drawCalls: summarizeBenchmarkSamples(drawCalls),
+                triangles: summarizeBenchmarkSamples(triangles),
+                heap:
+                    heapStart !== undefined && heapEnd !== undefined
+                        ? { start: heapStart, end: heapEnd, peak: Math.max(heapPeak, heapEnd) }
+                        : null,
+                timers: Object.fromEntries([...timers].map(([name, samples]) => [name, summarizeBenchmarkSamples(samples)])),
+            }
+
+            console.log(JSON.stringify(benchmarkResult))
+
+            window.benchmarkResult = benchmarkResult
+            window.dispatchEvent(new CustomEvent('benchmark-complete', { detail: benchmarkResult }))
+
+            setResult(benchmarkResult)
+        }
+
+        const loop = (now: number) => {
+            if (frame === warmupFrames) {
+                startBenchmarkRecording()
+                heapStart = readHeap()
+            }
+
+            const recording = frame >= warmupFrames
+
+            if (recording && lastFrameTime !== undefined) {
+                frameTimes.push(now - lastFrameTime)
+            }
+
+            lastFrameTime = now
+
+            /* frame */
+            gl.info.reset()
+
+            const start = performance.now()
+            advance((frame + 1) * frameDelta)
+            const cpuTime = performance.now() - start
+
+            if (recording) {
+                cpuTimes.push(cpuTime)
+                drawCalls.push(gl.info.render.calls)
+                triangles.push(gl.info.render.triangles)
+                heapPeak = Math.max(heapPeak, readHeap() ?? 0)
+            }
+
+            frame++
+
+            if (frame === totalFrames) {
+                finish()
+                return
+            }
+
+            animationFrame = requestAnimationFrame(loop)
+        }
+
+        animationFrame = requestAnimationFrame(loop)
+
+        return () => {
+            cancelAnimationFrame(animationFrame)
+            stopBenchmarkRecording()
+            gl.info.autoReset = true
+        }
+    }, [])
+
+    useEffect(() => {
+        if (!result) return
+
+        // one more frame, so the result overlay is positioned
+        advance((config.warmupFrames + config.frames + 1) * config.frameDelta)
+    }, [result])
+
+    const json = useMemo(() => (result ? JSON.stringify(result, null, 2) : ''), [result])
+
+    const downloadUrl = useMemo(() => (json ? URL.createObjectURL(new Blob([json], { type: 'application/json' })) : ''), [json])
+
+    useEffect(() => {
+        return () => {
+            if (downloadUrl) URL.revokeObjectURL(downloadUrl)
+        }
+    }, [downloadUrl])
+
+    if (!result) return null
+
+    return (
+        <Html fullscreen>
+            <ResultWrapper>
+                <a href={downloadUrl} download="benchmark.json">
+                    Download
+                </a>
+                <pre>{json}</pre>
+            </ResultWrapper>
+        </Html>
+    )
+}
@@ -1,17 +1,22 @@
 import { Canvas as R3FCanvas } from '@react-three/fiber'
 import { Suspense } from 'react'
+import { benchmarkConfig } from '../utils/benchmark'
 import { DebugTunnel } from '../utils/debug-tunnel'
+import { BenchmarkRunner } from './benchmark'
 import { Spinner } from './spinner'
 import { ThreeDebug } from '../../debug'
 
-export const Canvas = ({ children, ...rest }: Parameters<typeof R3FCanvas>[0]) => (
+export const Canvas = ({ children, frameloop, dpr, ...rest }: Parameters<typeof R3FCanvas>[0]) => (
     <Suspense fallback={<Spinner />}>
-        <R3FCanvas id="gl" {...rest}>
+        {/* benchmarks drive frames themselves, at a fixed pixel ratio */}
+        <R3FCanvas id="gl" frameloop={benchmarkConfig ? 'never' : frameloop} dpr={benchmarkConfig ? 1 : dpr} {...rest}>
             {children}
 
             <DebugTunnel.Out />
 
             <ThreeDebug />
+
+            {benchmarkConfig && <BenchmarkRunner config={benchmarkConfig} />}
         </R3FCanvas>
     </Suspense>
 )
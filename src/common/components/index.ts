@@ -1,8 +1,10 @@
+export * from './benchmark'
 export * from './canvas'
 export * from './crosshair'
 export * from './instructions'
 export * from './interaction-barrier'
 export * from './spinner'
 export * from './third-person-controls'
+export * from './trace-overlay'
 export * from './webgpu-canvas'
 
@@ -0,0 +1,122 @@
+import { button, useControls } from 'leva'
+import { useEffect, useMemo, useState } from 'react'
+import styled from 'styled-components'
+import { TraceAggregator, TraceEventKind, TraceStats, getTraceBuffer } from '../utils/tracing'
+
+const OverlayWrapper = styled.div`
+    position: absolute;
+    bottom: 0;
+    left: 0;
+    z-index: 1000;
+    max-height: 50%;
+    overflow: auto;
+    padding: 0.5em;
+    color: #fff;
+    background-color: rgba(0, 0, 0, 0.8);
+    font-family: monospace;
+    font-size: 0.75rem;
+    pointer-events: none;
+
+    td {
+        padding: 0 0.5em;
+    }
+
+    td:not(:first-child) {
+        text-align: right;
+    }
+`
+
+const formatValue = (value: number) => (Math.abs(value) >= 100 ? value.toFixed(0) : value.toFixed(2))
+
+const downloadJson = (data: unknown, filename: string) => {
+    const url = URL.createObjectURL(new Blob([JSON.stringify(data)], { type: 'application/json' }))
+
+    const link = document.createElement('a')
+    link.href = url
+    link.download = filename
+    link.click()
+
+    URL.revokeObjectURL(url)
+}
+
+/**
+ * Shows per second stats of spans and counters traced on any thread, see `tracing.ts`.
+ * Rendered when the page is loaded with `?trace`, the trace can be exported as Chrome trace JSON from the controls.
+ */
+export const TraceOverlay = () => {
+    const traceBuffer = getTraceBuffer()
+
+    const aggregator = useMemo(() => (traceBuffer ? new TraceAggregator(traceBuffer) : null), [traceBuffer])
+
+    const [stats, setStats] = useState<TraceStats[]>([])
+    const [dropped, setDropped] = useState(0)
+
+    const { overlay } = useControls('tracing', {
+        overlay: true,
+        'export chrome trace': button(() => {
+            if (!aggregator) return
+
+            aggregator.update()
+            downloadJson(aggregator.toChromeTrace(), `trace-${Date.now()}.json`)
+        }),
+        clear: button(() => aggregator?.clear()),
+    })
+
+    useEffect(() => {
+        if (!aggregator) return
+
+        let animationFrame = 0
+        let lastDisplayUpdate = 0
+
+        // drain the ring every frame so it doesn't lap, the table only needs to update a few times a second
+        const loop = (time: number) => {
+            aggregator.update()
+
+            if (time - lastDisplayUpdate > 500) {
+                setStats(aggregator.getStats())
+                setDropped(aggregator.dropped)
+                lastDisplayUpdate = time
+            }
+
+            animationFrame = requestAnimationFrame(loop)
+        }
+
+        animationFrame = requestAnimationFrame(loop)
+
+        return () => cancelAnimationFrame(animationFrame)
+    }, [aggregator])
+
+    if (!aggregator || !overlay) return null
+
+    return (
+        <OverlayWrapper>
+            <table>
+                <thead>
+                    <tr>
+                        <td>name</td>
+                        <td>/s</td>
+                        <td>mean</td>
+                        <td>max</td>
+                        <td>last</td>
+                    </tr>
+                </thead>
+                <tbody>
+                    {stats.map(({ kind, name, count, mean, max, last }) => (
+                        <tr key={name}>
+                            <td>
+                                {name}
+                                {kind === TraceEventKind.SPAN ? ' (ms)' : ''}
+                            </td>
+                            <td>{count}</td>
+                            <td>{formatValue(mean)}</td>
+                            <td>{formatValue(max)}</td>
+                            <td>{formatValue(last)}</td>
+                        </tr>
+                    ))}
+                </tbody>
+            </table>
+
+            {dropped > 0 && <div>{dropped} events dropped</div>}
+        </OverlayWrapper>
+    )
+}
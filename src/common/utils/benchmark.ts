@@ -0,0 +1,166 @@
+import { createRandom } from './random'
+import { getQueryParamOrDefault } from './url-query-param'
+
+export type BenchmarkConfig = {
+    /**
+     * Frames to record, after the warmup frames
+     */
+    frames: number
+
+    warmupFrames: number
+
+    /**
+     * Seed for Math.random
+     */
+    seed: number
+
+    /**
+     * Seconds each frame advances the clock by, so fixed time steps see the same inputs on every run
+     */
+    frameDelta: number
+}
+
+export type BenchmarkSummary = {
+    count: number
+    mean: number
+    min: number
+    p50: number
+    p90: number
+    p95: number
+    p99: number
+    max: number
+}
+
+export type BenchmarkResult = {
+    route: string
+    userAgent: string
+    config: BenchmarkConfig
+
+    /**
+     * Drawing buffer size, results are only comparable between runs of the same size
+     */
+    canvas: { width: number; height: number; pixelRatio: number }
+
+    /**
+     * Milliseconds between frames
+     */
+    frameTime: BenchmarkSummary
+
+    /**
+     * Milliseconds spent in the frame loop and render per frame
+     */
+    cpuTime: BenchmarkSummary
+
+    drawCalls: BenchmarkSummary
+    triangles: BenchmarkSummary
+
+    /**
+     * Bytes of JS heap in use, only available in Chromium
+     */
+    heap: { start: number; end: number; peak: number } | null
+
+    /**
+     * Milliseconds per sample of each custom timer
+     */
+    timers: Record<string, BenchmarkSummary>
+}
+
+const isFrameCount = (value: string) => /^\d+$/.test(value)
+
+const readBenchmarkConfig = (): BenchmarkConfig | null => {
+    const frames = Number(getQueryParamOrDefault('benchmark', '0', isFrameCount))
+
+    if (frames === 0) return null
+
+    return {
+        frames,
+        warmupFrames: Number(getQueryParamOrDefault('benchmarkWarmup', '60', isFrameCount)),
+        seed: Number(getQueryParamOrDefault('benchmarkSeed', '1', isFrameCount)),
+        frameDelta: 1 / 60,
+    }
+}
+
+/**
+ * Set when the page is loaded with `?benchmark=<frames>`, and optionally `benchmarkWarmup=<frames>` and `benchmarkSeed=<seed>`.
+ * Read once on load, a benchmark is a fresh page load of one sketch.
+ */
+export const benchmarkConfig = typeof window === 'undefined' ? null : readBenchmarkConfig()
+
+/* custom timers, only recorded while a benchmark is recording */
+let recording = false
+const timers = new Map<string, number[]>()
+
+/**
+ * @returns a start time for `endBenchmarkTimer`, or 0 when no benchmark is recording
+ */
+export const startBenchmarkTimer = () => (recording ? performance.now() : 0)
+
+export const endBenchmarkTimer = (name: string, start: number) => {
+    // started before recording
+    if (!recording || start === 0) return
+
+    recordBenchmarkTime(name, performance.now() - start)
+}
+
+/**
+ * Records a duration measured elsewhere, e.g. in a worker and sent back with its result
+ */
+export const recordBenchmarkTime = (name: string, milliseconds: number) => {
+    if (!recording) return
+
+    let samples = timers.get(name)
+
+    if (!samples) {
+        samples = []
+        timers.set(name, samples)
+    }
+
+    samples.push(milliseconds)
+}
+
+export const startBenchmarkRecording = () => {
+    timers.clear()
+    recording = true
+}
+
+export const stopBenchmarkRecording = () => {
+    recording = false
+
+    return timers
+}
+
+/**
+ * Replaces Math.random with a seeded generator, mulberry32
+ */
+export const seedMathRandom = (seed: number) => {
+    Math.random = createRandom(seed)
+}
+
+const round = (value: number) => Math.round(value * 1000) / 1000
+
+export const summarizeBenchmarkSamples = (samples: number[]): BenchmarkSummary => {
+    if (samples.length === 0) {
+        return { count: 0, mean: 0, min: 0, p50: 0, p90: 0, p95: 0, p99: 0, max: 0 }
+    }
+
+    const sorted = Float64Array.from(samples).sort()
+
+    // nearest rank
+    const percentile = (p: number) => sorted[Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1)]
+
+    let total = 0
+    for (let i = 0; i < sorted.length; i++) {
+        total += sorted[i]
+    }
+
+    return {
+        count: sorted.length,
+        mean: round(total / sorted.length),
+        min: round(sorted[0]),
+        p50: round(percentile(0.5)),
+        p90: round(percentile(0.9)),
+        p95: round(percentile(0.95)),
+        p99: round(percentile(0.99)),
+        max: round(sorted[sorted.length - 1]),
+    }
+}
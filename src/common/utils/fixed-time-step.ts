@@ -1,7 +1,14 @@
+import { endBenchmarkTimer, startBenchmarkTimer } from './benchmark'
+
 export type FixedTimeStepProps = {
     maxSubSteps?: number
     timeStep?: number
     step: () => void
+
+    /**
+     * Benchmark timer name for each step, see `benchmark.ts`
+     */
+    name?: string
 }
 
 export class FixedTimeStep {
@@ -9,6 +16,8 @@ export class FixedTimeStep {
 
     private step: () => void
 
+    private name: string | undefined
+
     private timeStepMs: number
 
     private maxSubSteps: number
@@ -19,8 +28,9 @@ export class FixedTimeStep {
 
     private accumulator = 0
 
-    constructor({ maxSubSteps = 10, timeStep = 1 / 60, step }: FixedTimeStepProps) {
+    constructor({ maxSubSteps = 10, timeStep = 1 / 60, step, name }: FixedTimeStepProps) {
         this.step = step
+        this.name = name
         this.timeStepMs = timeStep * 1000
         this.maxSubSteps = maxSubSteps
     }
@@ -36,7 +46,13 @@ export class FixedTimeStep {
         if (!this.paused) {
             let subSteps = 0
             while (this.accumulator >= this.timeStepMs && subSteps < this.maxSubSteps) {
-                this.step()
+                if (this.name) {
+                    const start = startBenchmarkTimer()
+                    this.step()
+                    endBenchmarkTimer(this.name, start)
+                } else {
+                    this.step()
+                }
 
                 subSteps++
                 this.accumulator -= this.timeStepMs
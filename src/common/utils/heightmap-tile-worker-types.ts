@@ -0,0 +1,46 @@
+export const HeightmapTileWorkerMessageType = {
+    GENERATE: 0,
+    TILE: 1,
+} as const
+
+/**
+ * A tile to generate. Tiles are `width` by `height` samples, and neighbouring tiles should share their edge samples so they meet without seams.
+ */
+export type HeightmapTileRequest<Params> = {
+    seed: number
+    x: number
+    z: number
+    width: number
+    height: number
+    params: Params
+}
+
+export type HeightmapTileGenerateMessage<Params> = {
+    type: typeof HeightmapTileWorkerMessageType.GENERATE
+    id: number
+    tile: HeightmapTileRequest<Params>
+}
+
+export type HeightmapTile = {
+    seed: number
+    x: number
+    z: number
+    width: number
+    height: number
+
+    /**
+     * Row major, `width` samples per row
+     */
+    heights: Float32Array
+
+    minHeight: number
+    maxHeight: number
+}
+
+export type HeightmapTileMessage = {
+    type: typeof HeightmapTileWorkerMessageType.TILE
+    id: number
+    tile: HeightmapTile
+}
+
+export type HeightmapTileWorkerMessage<Params> = HeightmapTileGenerateMessage<Params> | HeightmapTileMessage
@@ -0,0 +1,51 @@
+import {
+    HeightmapTileMessage,
+    HeightmapTileRequest,
+    HeightmapTileWorkerMessage,
+    HeightmapTileWorkerMessageType,
+} from './heightmap-tile-worker-types'
+
+export type HeightmapTileWorkerParams<Params> = {
+    /**
+     * Writes the heights of a tile, row major with `tile.width` samples per row
+     */
+    generate: (tile: HeightmapTileRequest<Params>, heights: Float32Array) => void
+}
+
+/**
+ * Generates tiles requested by a `HeightmapTiles` pool.
+ *
+ * Each tile is generated into a new Float32Array, which is transferred back to the main thread with the tile height range.
+ */
+export const runHeightmapTileWorker = <Params>({ generate }: HeightmapTileWorkerParams<Params>) => {
+    const worker = self as unknown as Worker
+
+    worker.onmessage = (e) => {
+        const data = e.data as HeightmapTileWorkerMessage<Params>
+
+        if (data.type !== HeightmapTileWorkerMessageType.GENERATE) return
+
+        const { tile } = data
+        const heights = new Float32Array(tile.width * tile.height)
+
+        generate(tile, heights)
+
+        let minHeight = Infinity
+        let maxHeight = -Infinity
+
+        for (let i = 0; i < heights.length; i++) {
+            const height = heights[i]
+
+            if (height < minHeight) minHeight = height
+            if (height > maxHeight) maxHeight = height
+        }
+
+        const message: HeightmapTileMessage = {
+            type: HeightmapTileWorkerMessageType.TILE,
+            id: data.id,
+            tile: { seed: tile.seed, x: tile.x, z: tile.z, width: tile.width, height: tile.height, heights, minHeight, maxHeight },
+        }
+
+        worker.postMessage(message, { transfer: [heights.buffer] })
+    }
+}
@@ -0,0 +1,387 @@
+import {
+    HeightmapTile,
+    HeightmapTileGenerateMessage,
+    HeightmapTileWorkerMessage,
+    HeightmapTileWorkerMessageType,
+} from './heightmap-tile-worker-types'
+
+export type HeightmapTilesConfig<Params> = {
+    /**
+     * Samples per tile row
+     */
+    width: number
+
+    /**
+     * Samples per tile column
+     */
+    height: number
+
+    /**
+     * Passed to the worker `generate` function with every tile
+     */
+    params: Params
+}
+
+export type HeightmapTilesParams<Params> = HeightmapTilesConfig<Params> & {
+    /**
+     * Creates a worker that calls `runHeightmapTileWorker`
+     */
+    createWorker: () => Worker
+
+    /**
+     * @default 2
+     */
+    workerPoolSize?: number
+
+    /**
+     * Tiles sent to a worker before it has returned any, more keeps workers busy between messages
+     * @default 2
+     */
+    maxTilesPerWorker?: number
+
+    /**
+     * Least recently used tiles are dropped past this count, should be more than the tiles in a `stream` radius
+     * @default 256
+     */
+    maxCachedTiles?: number
+}
+
+type QueuedTile = {
+    key: string
+    seed: number
+    x: number
+    z: number
+
+    /**
+     * Lower is sent first, requested tiles before streamed tiles
+     */
+    priority: number
+
+    /**
+     * Whether the tile is only wanted by `stream`, and can be dropped when it leaves the stream radius
+     */
+    streamed: boolean
+
+    resolvers: ((tile: HeightmapTile) => void)[]
+}
+
+type InFlightTile = {
+    worker: number
+
+    /**
+     * null if the tile was generated with a previous config
+     */
+    queued: QueuedTile | null
+}
+
+const getConfigKey = ({ width, height, params }: HeightmapTilesConfig<unknown>) => `${width}:${height}:${JSON.stringify(params)}`
+
+/**
+ * Generates heightmap tiles in a pool of workers, and caches them by config, seed and tile coordinate.
+ *
+ * Tiles can be requested one at a time with `requestTile`, or streamed around a focus point with `stream`, nearest first.
+ * Tiles are delivered to `onTile` and to request promises, and can be read later with `getTile` while they are cached.
+ * Cached tiles are shared, so their heights shouldn't be written to.
+ */
+export class HeightmapTiles<Params> {
+    /**
+     * Called for every generated tile
+     */
+    onTile?: (tile: HeightmapTile) => void
+
+    private config: HeightmapTilesConfig<Params>
+    private configKey: string
+
+    private workers: Worker[] = []
+    private workerLoads: number[] = []
+
+    private createWorker: () => Worker
+    private workerPoolSize: number
+    private maxTilesPerWorker: number
+    private maxCachedTiles: number
+
+    private nextId = 0
+
+    private cache = new Map<string, HeightmapTile>()
+    private queued = new Map<string, QueuedTile>()
+    private inFlight = new Map<number, InFlightTile>()
+    private inFlightKeys = new Map<string, QueuedTile>()
+
+    constructor({
+        createWorker,
+        workerPoolSize = 2,
+        maxTilesPerWorker = 2,
+        maxCachedTiles = 256,
+        ...config
+    }: HeightmapTilesParams<Params>) {
+        this.createWorker = createWorker
+        this.workerPoolSize = workerPoolSize
+        this.maxTilesPerWorker = maxTilesPerWorker
+        this.maxCachedTiles = maxCachedTiles
+        this.config = config
+        this.configKey = getConfigKey(config)
+    }
+
+    /**
+     * Number of tiles that are queued or being generated
+     */
+    get size() {
+        return this.queued.size + this.inFlightKeys.size
+    }
+
+    /**
+     * Changes the tile size or generation params. Tiles cached with other configs are kept until they are evicted, so switching
+     * back to a config reuses them. Pending requests are generated again with the new config.
+     */
+    configure(config: HeightmapTilesConfig<Params>) {
+        const configKey = getConfigKey(config)
+
+        if (configKey === this.configKey) return
+
+        this.config = config
+        this.configKey = configKey
+
+        const pending = [...this.queued.values()]
+
+        for (const inFlight of this.inFlight.values()) {
+            const queued = inFlight.queued
+
+            if (!queued) continue
+
+            inFlight.queued = null
+
+            if (queued.resolvers.length > 0 || queued.streamed) {
+                pending.push(queued)
+            }
+        }
+
+        this.queued.clear()
+        this.inFlightKeys.clear()
+
+        /* pending tiles are keyed again for the new config, and resolved right away if it has them cached */
+        for (const queued of pending) {
+            queued.key = this.getTileKey(queued.seed, queued.x, queued.z)
+
+            const cached = this.cache.get(queued.key)
+
+            if (cached) {
+                this.touch(queued.key, cached)
+
+                for (const resolve of queued.resolvers) {
+                    resolve(cached)
+                }
+
+                continue
+            }
+
+            this.queued.set(queued.key, queued)
+        }
+
+        this.dispatch()
+    }
+
+    /**
+     * @returns the cached tile, or undefined if it hasn't been generated
+     */
+    getTile(seed: number, x: number, z: number) {
+        const key = this.getTileKey(seed, x, z)
+        const tile = this.cache.get(key)
+
+        if (tile) this.touch(key, tile)
+
+        return tile
+    }
+
+    /**
+     * Generates a tile, ahead of any streamed tiles
+     */
+    requestTile(seed: number, x: number, z: number): Promise<HeightmapTile> {
+        const cached = this.getTile(seed, x, z)
+
+        if (cached) return Promise.resolve(cached)
+
+        return new Promise((resolve) => {
+            const key = this.getTileKey(seed, x, z)
+            const pending = this.inFlightKeys.get(key) ?? this.queued.get(key)
+
+            if (pending) {
+                pending.priority = -1
+                pending.streamed = false
+                pending.resolvers.push(resolve)
+            } else {
+                this.queued.set(key, { key, seed, x, z, priority: -1, streamed: false, resolvers: [resolve] })
+            }
+
+            this.dispatch()
+        })
+    }
+
+    /**
+     * Generates the tiles within `radius` tiles of a focus point given in tile coordinates, nearest first.
+     * Streamed tiles that are still queued and are now out of the radius are dropped. Call when the focus point moves.
+     */
+    stream(seed: number, focusX: number, focusZ: number, radius: number) {
+        const wanted = new Set<string>()
+
+        const minX = Math.floor(focusX - radius)
+        const maxX = Math.ceil(focusX + radius)
+        const minZ = Math.floor(focusZ - radius)
+        const maxZ = Math.ceil(focusZ + radius)
+
+        for (let z = minZ; z <= maxZ; z++) {
+            for (let x = minX; x <= maxX; x++) {
+                // distance to the tile center
+                const dx = x + 0.5 - focusX
+                const dz = z + 0.5 - focusZ
+                const distance = Math.sqrt(dx * dx + dz * dz)
+
+                if (distance > radius) continue
+
+                const key = this.getTileKey(seed, x, z)
+                wanted.add(key)
+
+                const cached = this.cache.get(key)
+
+                if (cached) {
+                    this.touch(key, cached)
+                    continue
+                }
+
+                if (this.inFlightKeys.has(key)) continue
+
+                const queued = this.queued.get(key)
+
+                if (queued) {
+                    if (queued.streamed) queued.priority = distance
+                } else {
+                    this.queued.set(key, { key, seed, x, z, priority: distance, streamed: true, resolvers: [] })
+                }
+            }
+        }
+
+        /* drop streamed tiles that have left the radius before being sent */
+        for (const [key, queued] of this.queued) {
+            if (queued.streamed && !wanted.has(key)) {
+                this.queued.delete(key)
+            }
+        }
+
+        this.dispatch()
+    }
+
+    connect() {
+        for (let i = 0; i < this.workerPoolSize; i++) {
+            const index = this.workers.length
+            const worker = this.createWorker()
+
+            worker.onmessage = (e) => {
+                const message = e.data as HeightmapTileWorkerMessage<Params>
+
+                if (message.type === HeightmapTileWorkerMessageType.TILE) {
+                    this.onGenerated(index, message.id, message.tile)
+                }
+            }
+
+            this.workers.push(worker)
+            this.workerLoads.push(0)
+        }
+
+        this.dispatch()
+    }
+
+    /**
+     * Terminates the workers. Queued tiles and pending requests are dropped, cached tiles are kept.
+     */
+    disconnect() {
+        for (const worker of this.workers) {
+            worker.terminate()
+        }
+
+        this.workers = []
+        this.workerLoads = []
+        this.queued.clear()
+        this.inFlight.clear()
+        this.inFlightKeys.clear()
+    }
+
+    private dispatch() {
+        while (this.queued.size > 0) {
+            /* least loaded worker with room */
+            let worker = -1
+
+            for (let i = 0; i < this.workers.length; i++) {
+                if (this.workerLoads[i] >= this.maxTilesPerWorker) continue
+
+                if (worker === -1 || this.workerLoads[i] < this.workerLoads[worker]) worker = i
+            }
+
+            if (worker === -1) return
+
+            /* highest priority tile */
+            let next: QueuedTile | undefined
+
+            for (const queued of this.queued.values()) {
+                if (!next || queued.priority < next.priority) next = queued
+            }
+
+            this.queued.delete(next!.key)
+
+            const id = this.nextId++
+            this.inFlight.set(id, { worker, queued: next! })
+            this.inFlightKeys.set(next!.key, next!)
+            this.workerLoads[worker]++
+
+            const { width, height, params } = this.config
+
+            const message: HeightmapTileGenerateMessage<Params> = {
+                type: HeightmapTileWorkerMessageType.GENERATE,
+                id,
+                tile: { seed: next!.seed, x: next!.x, z: next!.z, width, height, params },
+            }
+
+            this.workers[worker].postMessage(message)
+        }
+    }
+
+    private onGenerated(worker: number, id: number, tile: HeightmapTile) {
+        const inFlight = this.inFlight.get(id)
+
+        // disconnected
+        if (!inFlight) return
+
+        this.inFlight.delete(id)
+        this.workerLoads[worker]--
+
+        const queued = inFlight.queued
+
+        if (queued) {
+            this.inFlightKeys.delete(queued.key)
+
+            this.touch(queued.key, tile)
+
+            while (this.cache.size > this.maxCachedTiles) {
+                this.cache.delete(this.cache.keys().next().value!)
+            }
+
+            for (const resolve of queued.resolvers) {
+                resolve(tile)
+            }
+
+            this.onTile?.(tile)
+        }
+
+        this.dispatch()
+    }
+
+    private getTileKey(seed: number, x: number, z: number) {
+        return `${this.configKey}|${seed}:${x}:${z}`
+    }
+
+    /**
+     * Moves a tile to the back of the cache eviction order
+     */
+    private touch(key: string, tile: HeightmapTile) {
+        this.cache.delete(key)
+        this.cache.set(key, tile)
+    }
+}
@@ -1 +1,10 @@
+export * from './benchmark'
 export * from './debug-tunnel'
+export * from './heightmap-tile-worker-types'
+export * from './heightmap-tiles'
+export * from './indexed-binary-heap'
+export * from './path-query-service'
+export * from './path-query-worker-types'
+export * from './random'
+export * from './spatial-hash'
+export * from './tracing'
@@ -0,0 +1,200 @@
+const NOT_IN_HEAP = -1
+
+/**
+ * A binary min heap of integer ids, stored in typed arrays.
+ *
+ * Each id can be in the heap at most once. The heap keeps the position of every id, so `push` on an id that is
+ * already in the heap is a decrease-key rather than a duplicate entry.
+ * Ids must be non-negative integers, and storage grows to fit the largest id pushed.
+ */
+export class IndexedBinaryHeap {
+    private heap: Int32Array
+    private positions: Int32Array
+    private priorities: Float64Array
+
+    private count = 0
+
+    constructor(initialCapacity = 1024) {
+        const capacity = Math.max(1, initialCapacity)
+
+        this.heap = new Int32Array(capacity)
+        this.positions = new Int32Array(capacity).fill(NOT_IN_HEAP)
+        this.priorities = new Float64Array(capacity)
+    }
+
+    get size() {
+        return this.count
+    }
+
+    isEmpty() {
+        return this.count === 0
+    }
+
+    has(id: number) {
+        return id < this.positions.length && this.positions[id] !== NOT_IN_HEAP
+    }
+
+    /**
+     * @returns the priority of an id in the heap, or Infinity if it isn't in the heap
+     */
+    getPriority(id: number) {
+        return this.has(id) ? this.priorities[id] : Infinity
+    }
+
+    /**
+     * Adds an id, or lowers its priority if it is already in the heap.
+     *
+     * @returns false if the id is already in the heap with the same or a lower priority
+     */
+    push(id: number, priority: number) {
+        if (id >= this.positions.length) {
+            this.grow(id + 1)
+        }
+
+        const position = this.positions[id]
+
+        if (position !== NOT_IN_HEAP) {
+            if (this.priorities[id] <= priority) return false
+
+            this.priorities[id] = priority
+            this.siftUp(position)
+
+            return true
+        }
+
+        if (this.count >= this.heap.length) {
+            this.grow(this.count + 1)
+        }
+
+        this.priorities[id] = priority
+        this.heap[this.count] = id
+        this.positions[id] = this.count
+        this.count++
+
+        this.siftUp(this.count - 1)
+
+        return true
+    }
+
+    /**
+     * @returns the id with the lowest priority without removing it, or -1 if the heap is empty
+     */
+    peek() {
+        return this.count === 0 ? -1 : this.heap[0]
+    }
+
+    /**
+     * Removes the id with the lowest priority
+     *
+     * @returns the id, or -1 if the heap is empty
+     */
+    pop() {
+        if (this.count === 0) return -1
+
+        const { heap, positions } = this
+
+        const id = heap[0]
+        positions[id] = NOT_IN_HEAP
+
+        this.count--
+
+        if (this.count > 0) {
+            const last = heap[this.count]
+            heap[0] = last
+            positions[last] = 0
+
+            this.siftDown(0)
+        }
+
+        return id
+    }
+
+    /**
+     * Removes all ids, in O(size)
+     */
+    clear() {
+        for (let i = 0; i < this.count; i++) {
+            this.positions[this.heap[i]] = NOT_IN_HEAP
+        }
+
+        this.count = 0
+    }
+
+    private siftUp(position: number) {
+        const { heap, positions, priorities } = this
+
+        const id = heap[position]
+        const priority = priorities[id]
+
+        while (position > 0) {
+            const parentPosition = (position - 1) >>> 1
+            const parent = heap[parentPosition]
+
+            if (priorities[parent] <= priority) break
+
+            heap[position] = parent
+            positions[parent] = position
+
+            position = parentPosition
+        }
+
+        heap[position] = id
+        positions[id] = position
+    }
+
+    private siftDown(position: number) {
+        const { heap, positions, priorities, count } = this
+
+        const id = heap[position]
+        const priority = priorities[id]
+
+        const half = count >>> 1
+
+        while (position < half) {
+            let childPosition = 2 * position + 1
+            let child = heap[childPosition]
+
+            const rightPosition = childPosition + 1
+
+            if (rightPosition < count && priorities[heap[rightPosition]] < priorities[child]) {
+                childPosition = rightPosition
+                child = heap[rightPosition]
+            }
+
+            if (priorities[child] >= priority) break
+
+            heap[position] = child
+            positions[child] = position
+
+            position = childPosition
+        }
+
+        heap[position] = id
+        positions[id] = position
+    }
+
+    private grow(minCapacity: number) {
+        let capacity = this.positions.length
+
+        while (capacity < minCapacity) capacity *= 2
+
+        if (capacity !== this.positions.length) {
+            const positions = new Int32Array(capacity).fill(NOT_IN_HEAP)
+            positions.set(this.positions)
+            this.positions = positions
+
+            const priorities = new Float64Array(capacity)
+            priorities.set(this.priorities)
+            this.priorities = priorities
+        }
+
+        if (this.heap.length < minCapacity) {
+            let heapCapacity = this.heap.length
+            while (heapCapacity < minCapacity) heapCapacity *= 2
+
+            const heap = new Int32Array(heapCapacity)
+            heap.set(this.heap)
+            this.heap = heap
+        }
+    }
+}
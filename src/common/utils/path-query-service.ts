@@ -0,0 +1,222 @@
+import { endBenchmarkTimer, startBenchmarkTimer } from './benchmark'
+import {
+    PathQueryBatchMessage,
+    PathQueryCancelMessage,
+    PathQueryContextMessage,
+    PathQueryResult,
+    PathQueryWorkerMessage,
+    PathQueryWorkerMessageType,
+} from './path-query-worker-types'
+
+export type PathQueryCallback = (result: PathQueryResult) => void
+
+export type PathQueryServiceParams = {
+    /**
+     * Creates a worker that calls `runPathQueryWorker`
+     */
+    createWorker: () => Worker
+
+    /**
+     * @default 2
+     */
+    workerPoolSize?: number
+}
+
+type PendingQuery<Query> = { id: number; query: Query; callback: PathQueryCallback; transfer?: Transferable[] }
+
+type InFlightQuery = { worker: number; callback: PathQueryCallback; benchmarkStart: number }
+
+/**
+ * Runs path queries in a pool of workers.
+ *
+ * Queries made during a frame are sent in one batch per worker on `flush`, to the workers with the fewest queries in flight.
+ * Results are delivered to the query callback with waypoints in a transferred Float32Array, xyz per waypoint.
+ * Cancelled queries are dropped from the batch if they haven't been sent yet, otherwise the worker stops searching at its next time slice.
+ */
+export class PathQueryService<Query, Context = unknown> {
+    private workers: Worker[] = []
+    private workerLoads: number[] = []
+
+    private createWorker: () => Worker
+    private workerPoolSize: number
+
+    private nextId = 0
+
+    private pending: PendingQuery<Query>[] = []
+    private pendingCancels: number[][] = []
+    private inFlight = new Map<number, InFlightQuery>()
+
+    private contexts: Context[] = []
+
+    constructor({ createWorker, workerPoolSize = 2 }: PathQueryServiceParams) {
+        this.createWorker = createWorker
+        this.workerPoolSize = workerPoolSize
+    }
+
+    /**
+     * Number of queries that have been requested and not yet resolved or cancelled
+     */
+    get size() {
+        return this.pending.length + this.inFlight.size
+    }
+
+    /**
+     * Queues a query to be sent on the next `flush`
+     *
+     * @returns an id that can be passed to `cancel`
+     */
+    request(query: Query, callback: PathQueryCallback, transfer?: Transferable[]) {
+        const id = this.nextId++
+
+        this.pending.push({ id, query, callback, transfer })
+
+        return id
+    }
+
+    cancel(id: number) {
+        const pendingIndex = this.pending.findIndex((pending) => pending.id === id)
+
+        if (pendingIndex !== -1) {
+            this.pending.splice(pendingIndex, 1)
+            return
+        }
+
+        const inFlight = this.inFlight.get(id)
+
+        if (!inFlight) return
+
+        this.inFlight.delete(id)
+        this.workerLoads[inFlight.worker]--
+        this.pendingCancels[inFlight.worker].push(id)
+    }
+
+    /**
+     * Sends data used by queries to all workers, e.g. a navmesh. Workers receive context messages in order, and before later queries.
+     * Context is kept and sent again to workers created by a later `connect`.
+     */
+    setContext(context: Context) {
+        this.contexts.push(context)
+
+        const message: PathQueryContextMessage<Context> = { type: PathQueryWorkerMessageType.CONTEXT, context }
+
+        for (const worker of this.workers) {
+            worker.postMessage(message)
+        }
+    }
+
+    /**
+     * Drops kept context, e.g. when replacing a navmesh. Already connected workers keep what they have received.
+     */
+    clearContext() {
+        this.contexts = []
+    }
+
+    /**
+     * Sends queued queries and cancellations to workers. Call once per frame.
+     */
+    flush() {
+        const workerCount = this.workers.length
+
+        if (workerCount === 0) return
+
+        /* cancellations */
+        for (let worker = 0; worker < workerCount; worker++) {
+            const ids = this.pendingCancels[worker]
+
+            if (ids.length === 0) continue
+
+            const message: PathQueryCancelMessage = { type: PathQueryWorkerMessageType.CANCEL, ids }
+            this.workers[worker].postMessage(message)
+
+            this.pendingCancels[worker] = []
+        }
+
+        if (this.pending.length === 0) return
+
+        /* one batch per worker, to the least loaded workers */
+        const batches: PathQueryBatchMessage<Query>[] = []
+        const transfers: Transferable[][] = []
+
+        for (let worker = 0; worker < workerCount; worker++) {
+            batches.push({ type: PathQueryWorkerMessageType.QUERY_BATCH, ids: [], queries: [] })
+            transfers.push([])
+        }
+
+        const benchmarkStart = startBenchmarkTimer()
+
+        for (const { id, query, callback, transfer } of this.pending) {
+            let worker = 0
+
+            for (let i = 1; i < workerCount; i++) {
+                if (this.workerLoads[i] < this.workerLoads[worker]) worker = i
+            }
+
+            this.workerLoads[worker]++
+            this.inFlight.set(id, { worker, callback, benchmarkStart })
+
+            batches[worker].ids.push(id)
+            batches[worker].queries.push(query)
+
+            if (transfer) transfers[worker].push(...transfer)
+        }
+
+        this.pending = []
+
+        for (let worker = 0; worker < workerCount; worker++) {
+            if (batches[worker].ids.length === 0) continue
+
+            this.workers[worker].postMessage(batches[worker], { transfer: transfers[worker] })
+        }
+    }
+
+    connect() {
+        for (let i = 0; i < this.workerPoolSize; i++) {
+            const index = this.workers.length
+            const worker = this.createWorker()
+
+            worker.onmessage = (e) => {
+                const message = e.data as PathQueryWorkerMessage<Query, Context>
+
+                if (message.type === PathQueryWorkerMessageType.RESULTS) {
+                    this.onResults(index, message.results)
+                }
+            }
+
+            for (const context of this.contexts) {
+                const message: PathQueryContextMessage<Context> = { type: PathQueryWorkerMessageType.CONTEXT, context }
+                worker.postMessage(message)
+            }
+
+            this.workers.push(worker)
+            this.workerLoads.push(0)
+            this.pendingCancels.push([])
+        }
+    }
+
+    disconnect() {
+        for (const worker of this.workers) {
+            worker.terminate()
+        }
+
+        this.workers = []
+        this.workerLoads = []
+        this.pendingCancels = []
+        this.inFlight.clear()
+    }
+
+    private onResults(worker: number, results: PathQueryResult[]) {
+        for (const result of results) {
+            const inFlight = this.inFlight.get(result.id)
+
+            // cancelled after it was sent
+            if (!inFlight) continue
+
+            this.inFlight.delete(result.id)
+            this.workerLoads[worker]--
+
+            endBenchmarkTimer('path-query', inFlight.benchmarkStart)
+
+            inFlight.callback(result)
+        }
+    }
+}
@@ -0,0 +1,46 @@
+export const PathQueryWorkerMessageType = {
+    QUERY_BATCH: 0,
+    CANCEL: 1,
+    RESULTS: 2,
+    CONTEXT: 3,
+} as const
+
+export type PathQueryBatchMessage<Query> = {
+    type: typeof PathQueryWorkerMessageType.QUERY_BATCH
+    ids: number[]
+    queries: Query[]
+}
+
+export type PathQueryCancelMessage = {
+    type: typeof PathQueryWorkerMessageType.CANCEL
+    ids: number[]
+}
+
+/**
+ * Data shared by all queries, e.g. a serialised navmesh or the buffers of a voxel world
+ */
+export type PathQueryContextMessage<Context> = {
+    type: typeof PathQueryWorkerMessageType.CONTEXT
+    context: Context
+}
+
+export type PathQueryResult = {
+    id: number
+    success: boolean
+
+    /**
+     * Path waypoints, xyz per waypoint
+     */
+    waypoints: Float32Array
+}
+
+export type PathQueryResultsMessage = {
+    type: typeof PathQueryWorkerMessageType.RESULTS
+    results: PathQueryResult[]
+}
+
+export type PathQueryWorkerMessage<Query, Context> =
+    | PathQueryBatchMessage<Query>
+    | PathQueryCancelMessage
+    | PathQueryContextMessage<Context>
+    | PathQueryResultsMessage
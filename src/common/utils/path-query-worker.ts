@@ -0,0 +1,122 @@
+import {
+    PathQueryResult,
+    PathQueryResultsMessage,
+    PathQueryWorkerMessage,
+    PathQueryWorkerMessageType,
+} from './path-query-worker-types'
+
+/**
+ * A resumable search. Each `next` call runs a small amount of the search, and the search returns waypoints, xyz per waypoint, or null if there is no path.
+ */
+export type PathQuerySearch = Iterator<unknown, Float32Array | null>
+
+export type PathQueryWorkerParams<Query, Context> = {
+    /**
+     * Creates a search for a query
+     */
+    search: (query: Query) => PathQuerySearch
+
+    /**
+     * Called with context messages from the main thread, before any queries that were sent after them
+     */
+    onContext?: (context: Context) => void
+
+    /**
+     * Milliseconds to run searches for before yielding to receive new queries and cancellations
+     * @default 8
+     */
+    budget?: number
+}
+
+type ActiveSearch = { id: number; search: PathQuerySearch }
+
+const EMPTY_WAYPOINTS = new Float32Array(0)
+
+/**
+ * Runs path queries sent by a `PathQueryService`.
+ *
+ * Searches are run round robin in time slices, so long searches don't hold up short ones, and cancellations
+ * are received between slices. Results from each slice are posted together, with waypoint buffers transferred.
+ */
+export const runPathQueryWorker = <Query, Context = unknown>({ search, onContext, budget = 8 }: PathQueryWorkerParams<Query, Context>) => {
+    const worker = self as unknown as Worker
+
+    let active: ActiveSearch[] = []
+    let scheduled = false
+
+    // yields to the event loop without the clamping of nested setTimeout calls
+    const channel = new MessageChannel()
+
+    const schedule = () => {
+        if (scheduled) return
+
+        scheduled = true
+        channel.port2.postMessage(null)
+    }
+
+    const runSlice = () => {
+        scheduled = false
+
+        const start = performance.now()
+
+        const results: PathQueryResult[] = []
+        const transfer: ArrayBuffer[] = []
+
+        while (active.length > 0 && performance.now() - start < budget) {
+            const current = active.shift()!
+
+            let step: IteratorResult<unknown, Float32Array | null>
+
+            try {
+                step = current.search.next()
+            } catch (e) {
+                step = { done: true, value: null }
+            }
+
+            if (!step.done) {
+                active.push(current)
+                continue
+            }
+
+            const waypoints = step.value ?? EMPTY_WAYPOINTS
+
+            results.push({ id: current.id, success: step.value !== null, waypoints })
+
+            if (waypoints !== EMPTY_WAYPOINTS) transfer.push(waypoints.buffer as ArrayBuffer)
+        }
+
+        if (results.length > 0) {
+            const message: PathQueryResultsMessage = { type: PathQueryWorkerMessageType.RESULTS, results }
+
+            worker.postMessage(message, { transfer })
+        }
+
+        if (active.length > 0) schedule()
+    }
+
+    channel.port1.onmessage = runSlice
+
+    worker.onmessage = (e) => {
+        const data = e.data as PathQueryWorkerMessage<Query, Context>
+
+        if (data.type === PathQueryWorkerMessageType.CONTEXT) {
+            onContext?.(data.context)
+        } else if (data.type === PathQueryWorkerMessageType.QUERY_BATCH) {
+            for (let i = 0; i < data.ids.length; i++) {
+                active.push({ id: data.ids[i], search: search(data.queries[i]) })
+            }
+
+            schedule()
+        } else if (data.type === PathQueryWorkerMessageType.CANCEL) {
+            const cancelled = new Set(data.ids)
+
+            active = active.filter(({ id, search }) => {
+                if (!cancelled.has(id)) return true
+
+                search.return?.(null)
+
+                return false
+            })
+        }
+    }
+}
@@ -0,0 +1,184 @@
+/**
+ * Bits per axis in a packed spatial hash key.
+ * Packed coordinates must be in the range [-512, 511].
+ */
+export const SPATIAL_HASH_KEY_BITS = 10
+
+const AXIS_MASK = (1 << SPATIAL_HASH_KEY_BITS) - 1
+const AXIS_SHIFT = 32 - SPATIAL_HASH_KEY_BITS
+
+/**
+ * Packs integer x, y, z coordinates into a single non-negative 30 bit integer, which stays a small integer in JS engines
+ */
+export const packSpatialHashKey = (x: number, y: number, z: number) => {
+    return ((x & AXIS_MASK) << (SPATIAL_HASH_KEY_BITS * 2)) | ((y & AXIS_MASK) << SPATIAL_HASH_KEY_BITS) | (z & AXIS_MASK)
+}
+
+export const unpackSpatialHashKeyX = (key: number) => (key << (AXIS_SHIFT - SPATIAL_HASH_KEY_BITS * 2)) >> AXIS_SHIFT
+
+export const unpackSpatialHashKeyY = (key: number) => (key << (AXIS_SHIFT - SPATIAL_HASH_KEY_BITS)) >> AXIS_SHIFT
+
+export const unpackSpatialHashKeyZ = (key: number) => (key << AXIS_SHIFT) >> AXIS_SHIFT
+
+const EMPTY = -1
+
+/**
+ * An open addressing hash map from integer keys, e.g. packed spatial hash keys, to values.
+ *
+ * Keys are stored in a typed array table with linear probing, and lookups don't allocate.
+ * Entries are also stored densely, so iterating `keys()` and `values()` is a plain array walk.
+ */
+export class SpatialHashMap<T> {
+    private tableKeys: Int32Array
+    private tableIndices: Int32Array
+    private mask: number
+    private shift: number
+
+    private denseKeys: number[] = []
+    private denseValues: T[] = []
+
+    constructor(initialCapacity = 64) {
+        const capacity = 1 << Math.max(2, Math.ceil(Math.log2(initialCapacity)))
+
+        this.tableKeys = new Int32Array(capacity)
+        this.tableIndices = new Int32Array(capacity).fill(EMPTY)
+        this.mask = capacity - 1
+        this.shift = 32 - Math.log2(capacity)
+    }
+
+    get size() {
+        return this.denseKeys.length
+    }
+
+    get(key: number): T | undefined {
+        const index = this.find(key)
+
+        if (index < 0) return undefined
+
+        return this.denseValues[this.tableIndices[index]]
+    }
+
+    has(key: number) {
+        return this.find(key) >= 0
+    }
+
+    set(key: number, value: T) {
+        const index = this.find(key)
+
+        if (index >= 0) {
+            this.denseValues[this.tableIndices[index]] = value
+            return this
+        }
+
+        const insertIndex = ~index
+
+        this.tableKeys[insertIndex] = key
+        this.tableIndices[insertIndex] = this.denseKeys.length
+
+        this.denseKeys.push(key)
+        this.denseValues.push(value)
+
+        if (this.denseKeys.length * 2 > this.tableKeys.length) {
+            this.resize(this.tableKeys.length * 2)
+        }
+
+        return this
+    }
+
+    delete(key: number) {
+        let index = this.find(key)
+
+        if (index < 0) return false
+
+        /* swap remove the dense entry */
+        const denseIndex = this.tableIndices[index]
+        const lastDenseIndex = this.denseKeys.length - 1
+
+        if (denseIndex !== lastDenseIndex) {
+            const lastKey = this.denseKeys[lastDenseIndex]
+
+            this.denseKeys[denseIndex] = lastKey
+            this.denseValues[denseIndex] = this.denseValues[lastDenseIndex]
+            this.tableIndices[this.find(lastKey)] = denseIndex
+        }
+
+        this.denseKeys.pop()
+        this.denseValues.pop()
+
+        /* backward shift deletion, keeps probe sequences intact without tombstones */
+        let next = index
+
+        while (true) {
+            next = (next + 1) & this.mask
+
+            if (this.tableIndices[next] === EMPTY) break
+
+            const home = this.hash(this.tableKeys[next])
+
+            const between = index <= next ? index < home && home <= next : index < home || home <= next
+
+            if (between) continue
+
+            this.tableKeys[index] = this.tableKeys[next]
+            this.tableIndices[index] = this.tableIndices[next]
+            index = next
+        }
+
+        this.tableIndices[index] = EMPTY
+
+        return true
+    }
+
+    clear() {
+        this.tableIndices.fill(EMPTY)
+        this.denseKeys.length = 0
+        this.denseValues.length = 0
+    }
+
+    keys(): readonly number[] {
+        return this.denseKeys
+    }
+
+    values(): readonly T[] {
+        return this.denseValues
+    }
+
+    *[Symbol.iterator](): IterableIterator<[number, T]> {
+        for (let i = 0; i < this.denseKeys.length; i++) {
+            yield [this.denseKeys[i], this.denseValues[i]]
+        }
+    }
+
+    private hash(key: number) {
+        return Math.imul(key, 0x9e3779b1) >>> this.shift
+    }
+
+    /**
+     * @returns the table index of the key, or the bitwise not of the index to insert it at
+     */
+    private find(key: number) {
+        let index = this.hash(key)
+
+        while (this.tableIndices[index] !== EMPTY) {
+            if (this.tableKeys[index] === key) return index
+
+            index = (index + 1) & this.mask
+        }
+
+        return ~index
+    }
+
+    private resize(capacity: number) {
+        this.tableKeys = new Int32Array(capacity)
+        this.tableIndices = new Int32Array(capacity).fill(EMPTY)
+        this.mask = capacity - 1
+        this.shift = 32 - Math.log2(capacity)
+
+        for (let i = 0; i < this.denseKeys.length; i++) {
+            const insertIndex = ~this.find(this.denseKeys[i])
+
+            this.tableKeys[insertIndex] = this.denseKeys[i]
+            this.tableIndices[insertIndex] = i
+        }
+    }
+}
@@ -0,0 +1,529 @@
+import { getUrlSearchParams } from './url-query-param'
+
+const HEADER_NAMES_LOCK = 0
+const HEADER_WRITE_CURSOR = 1
+const HEADER_CAPACITY = 2
+const HEADER_THREAD_COUNT = 3
+const HEADER_NAME_COUNT = 4
+const HEADER_LENGTH = 8
+
+const MAX_NAMES = 256
+const MAX_NAME_BYTES = 64
+const MAX_THREADS = 64
+
+/* start, duration or value, name id, thread id and kind */
+const EVENT_STRIDE = 4
+
+export const TraceEventKind = {
+    SPAN: 0,
+    COUNTER: 1,
+} as const
+
+export type TraceEventKindType = (typeof TraceEventKind)[keyof typeof TraceEventKind]
+
+export type TraceEvent = {
+    kind: TraceEventKindType
+    name: string
+    thread: number
+
+    /**
+     * Milliseconds since the trace buffer was created
+     */
+    time: number
+
+    /**
+     * Milliseconds for spans, the counter value for counters
+     */
+    value: number
+}
+
+const textEncoder = new TextEncoder()
+const textDecoder = new TextDecoder()
+
+/**
+ * Views of a trace buffer, a ring of span and counter events written from any thread via a SharedArrayBuffer.
+ *
+ * Writers reserve an event with an atomic cursor, mark it in progress, write it, then mark it committed, so any number of
+ * threads can write without locking. One reader, on the main thread, reads committed events in order, and drops an event if a
+ * lapping writer marked its slot in progress while it was being copied. A lapped reader skips ahead and counts the events it
+ * missed.
+ * Span and counter names are interned into a table in the same buffer, guarded by a spin lock that is only taken the first time a
+ * thread uses a name.
+ */
+export class TraceBuffer {
+    buffer: SharedArrayBuffer
+
+    private header: Int32Array
+    private epoch: Float64Array
+    private threadNames: Int32Array
+    private nameLengths: Int32Array
+    private nameBytes: Uint8Array
+    private events: Float64Array
+    private committed: Int32Array
+
+    constructor(buffer: SharedArrayBuffer) {
+        this.buffer = buffer
+
+        this.header = new Int32Array(buffer, 0, HEADER_LENGTH)
+
+        const capacity = this.header[HEADER_CAPACITY]
+        let offset = HEADER_LENGTH * Int32Array.BYTES_PER_ELEMENT
+
+        this.epoch = new Float64Array(buffer, offset, 1)
+        offset += Float64Array.BYTES_PER_ELEMENT
+        this.events = new Float64Array(buffer, offset, capacity * EVENT_STRIDE)
+        offset += capacity * EVENT_STRIDE * Float64Array.BYTES_PER_ELEMENT
+        this.committed = new Int32Array(buffer, offset, capacity)
+        offset += capacity * Int32Array.BYTES_PER_ELEMENT
+        this.threadNames = new Int32Array(buffer, offset, MAX_THREADS)
+        offset += MAX_THREADS * Int32Array.BYTES_PER_ELEMENT
+        this.nameLengths = new Int32Array(buffer, offset, MAX_NAMES)
+        offset += MAX_NAMES * Int32Array.BYTES_PER_ELEMENT
+        this.nameBytes = new Uint8Array(buffer, offset, MAX_NAMES * MAX_NAME_BYTES)
+    }
+
+    static create(capacity: number) {
+        const buffer = new SharedArrayBuffer(
+            HEADER_LENGTH * Int32Array.BYTES_PER_ELEMENT +
+                Float64Array.BYTES_PER_ELEMENT +
+                capacity * (EVENT_STRIDE * Float64Array.BYTES_PER_ELEMENT + Int32Array.BYTES_PER_ELEMENT) +
+                (MAX_THREADS + MAX_NAMES) * Int32Array.BYTES_PER_ELEMENT +
+                MAX_NAMES * MAX_NAME_BYTES,
+        )
+
+        new Int32Array(buffer, 0, HEADER_LENGTH)[HEADER_CAPACITY] = capacity
+
+        const traceBuffer = new TraceBuffer(buffer)
+
+        // times are written relative to this, so events from all threads share a clock
+        traceBuffer.epoch[0] = performance.timeOrigin + performance.now()
+
+        return traceBuffer
+    }
+
+    get capacity() {
+        return this.header[HEADER_CAPACITY]
+    }
+
+    get writeCursor() {
+        return Atomics.load(this.header, HEADER_WRITE_CURSOR)
+    }
+
+    get threadCount() {
+        return Math.min(Atomics.load(this.header, HEADER_THREAD_COUNT), MAX_THREADS)
+    }
+
+    /**
+     * @returns milliseconds since the buffer was created, on this thread's clock
+     */
+    now() {
+        return performance.timeOrigin + performance.now() - this.epoch[0]
+    }
+
+    /**
+     * @returns a thread id for `write`, or -1 if the thread table is full
+     */
+    registerThread(name: string) {
+        const thread = Atomics.add(this.header, HEADER_THREAD_COUNT, 1)
+
+        if (thread >= MAX_THREADS) return -1
+
+        Atomics.store(this.threadNames, thread, this.internName(name))
+
+        return thread
+    }
+
+    getThreadName(thread: number) {
+        const name = Atomics.load(this.threadNames, thread)
+
+        return `${this.getName(name)} ${thread}`
+    }
+
+    /**
+     * @returns the id of a name, or -1 if the name table is full
+     */
+    internName(name: string) {
+        const encoded = textEncoder.encode(name).subarray(0, MAX_NAME_BYTES)
+
+        this.lock()
+
+        const count = this.header[HEADER_NAME_COUNT]
+        let id = -1
+
+        for (let i = 0; i < count; i++) {
+            if (this.nameEquals(i, encoded)) {
+                id = i
+                break
+            }
+        }
+
+        if (id === -1 && count < MAX_NAMES) {
+            id = count
+
+            this.nameBytes.set(encoded, id * MAX_NAME_BYTES)
+            this.nameLengths[id] = encoded.length
+
+            Atomics.store(this.header, HEADER_NAME_COUNT, count + 1)
+        }
+
+        this.unlock()
+
+        return id
+    }
+
+    getName(id: number) {
+        const start = id * MAX_NAME_BYTES
+
+        // decode doesn't accept views of shared memory
+        return textDecoder.decode(this.nameBytes.slice(start, start + this.nameLengths[id]))
+    }
+
+    write(kind: TraceEventKindType, name: number, thread: number, time: number, value: number) {
+        const capacity = this.header[HEADER_CAPACITY]
+        const index = Atomics.add(this.header, HEADER_WRITE_CURSOR, 1)
+        const slot = index % capacity
+        const offset = slot * EVENT_STRIDE
+
+        // in progress, a reader copying the previous event in this slot sees the change and drops it
+        Atomics.store(this.committed, slot, -(index + 1))
+
+        this.events[offset] = time
+        this.events[offset + 1] = value
+        this.events[offset + 2] = name
+        this.events[offset + 3] = thread * 2 + kind
+
+        Atomics.store(this.committed, slot, index + 1)
+    }
+
+    /**
+     * Reads committed events from `cursor` up to the write cursor, stopping at the first event that is still being written.
+     *
+     * @returns the cursor to read from next time, and how many events were overwritten before they could be read
+     */
+    read(
+        cursor: number,
+        callback: (kind: TraceEventKindType, name: number, thread: number, time: number, value: number) => void,
+    ) {
+        const capacity = this.header[HEADER_CAPACITY]
+        const writeCursor = Atomics.load(this.header, HEADER_WRITE_CURSOR)
+
+        let dropped = 0
+
+        if (writeCursor - cursor > capacity) {
+            dropped += writeCursor - capacity - cursor
+            cursor = writeCursor - capacity
+        }
+
+        while (cursor < writeCursor) {
+            const slot = cursor % capacity
+            const committed = Atomics.load(this.committed, slot)
+
+            // a lapping writer is overwriting this event
+            if (committed < 0 && -committed > cursor + 1) {
+                dropped++
+                cursor++
+                continue
+            }
+
+            // not written yet, or still being written
+            if (committed < cursor + 1) break
+
+            if (committed === cursor + 1) {
+                const offset = slot * EVENT_STRIDE
+
+                const time = this.events[offset]
+                const value = this.events[offset + 1]
+                const name = this.events[offset + 2]
+                const threadAndKind = this.events[offset + 3]
+
+                // not marked in progress by a lapping writer while copying
+                if (Atomics.load(this.committed, slot) === committed) {
+                    callback((threadAndKind % 2) as TraceEventKindType, name, Math.floor(threadAndKind / 2), time, value)
+                } else {
+                    dropped++
+                }
+            } else {
+                dropped++
+            }
+
+            cursor++
+        }
+
+        return { cursor, dropped }
+    }
+
+    private nameEquals(id: number, encoded: Uint8Array) {
+        if (this.nameLengths[id] !== encoded.length) return false
+
+        const start = id * MAX_NAME_BYTES
+
+        for (let i = 0; i < encoded.length; i++) {
+            if (this.nameBytes[start + i] !== encoded[i]) return false
+        }
+
+        return true
+    }
+
+    private lock() {
+        while (Atomics.compareExchange(this.header, HEADER_NAMES_LOCK, 0, 1) !== 0) {
+            // spin
+        }
+    }
+
+    private unlock() {
+        Atomics.store(this.header, HEADER_NAMES_LOCK, 0)
+    }
+}
+
+/* the trace buffer this thread writes to, set by `connectTracing` */
+let traceBuffer: TraceBuffer | null = null
+let traceThread = -1
+const traceNames = new Map<string, number>()
+
+const getNameId = (name: string) => {
+    let id = traceNames.get(name)
+
+    if (id === undefined) {
+        id = traceBuffer!.internName(name)
+        traceNames.set(name, id)
+    }
+
+    return id
+}
+
+/**
+ * Writes this thread's spans and counters to a trace buffer. Workers are sent the buffer from `getTraceBuffer`, and may be sent
+ * null when tracing is off, in which case tracing calls do nothing.
+ */
+export const connectTracing = (buffer: SharedArrayBuffer | null | undefined, threadName: string) => {
+    if (!buffer) return
+
+    traceBuffer = new TraceBuffer(buffer)
+    traceThread = traceBuffer.registerThread(threadName)
+    traceNames.clear()
+
+    if (traceThread === -1) traceBuffer = null
+}
+
+/**
+ * @returns a start time for `traceEnd`, or 0 when this thread isn't tracing
+ */
+export const traceStart = () => (traceBuffer ? traceBuffer.now() : 0)
+
+/**
+ * Writes a span from a `traceStart` time to now
+ */
+export const traceEnd = (name: string, start: number) => {
+    // started before connecting
+    if (!traceBuffer || start === 0) return
+
+    const nameId = getNameId(name)
+
+    if (nameId === -1) return
+
+    traceBuffer.write(TraceEventKind.SPAN, nameId, traceThread, start, traceBuffer.now() - start)
+}
+
+/**
+ * Writes a counter value, e.g. a queue depth or a latency measured across threads
+ */
+export const traceCounter = (name: string, value: number) => {
+    if (!traceBuffer) return
+
+    const nameId = getNameId(name)
+
+    if (nameId === -1) return
+
+    traceBuffer.write(TraceEventKind.COUNTER, nameId, traceThread, traceBuffer.now(), value)
+}
+
+/* main thread */
+const TRACE_BUFFER_CAPACITY = 1 << 16
+
+let mainTraceBuffer: TraceBuffer | null | undefined
+
+/**
+ * The trace buffer for this page, created on first use when the page is loaded with `?trace`.
+ * Null when tracing is off, or when SharedArrayBuffer is unavailable because the page isn't cross-origin isolated.
+ */
+export const getTraceBuffer = () => {
+    if (mainTraceBuffer !== undefined) return mainTraceBuffer
+
+    mainTraceBuffer = null
+
+    if (typeof window === 'undefined' || !getUrlSearchParams().has('trace')) return mainTraceBuffer
+
+    if (!window.crossOriginIsolated) {
+        console.warn('tracing requires SharedArrayBuffer, which is only available when the page is cross-origin isolated')
+        return mainTraceBuffer
+    }
+
+    mainTraceBuffer = TraceBuffer.create(TRACE_BUFFER_CAPACITY)
+
+    connectTracing(mainTraceBuffer.buffer, 'main')
+
+    return mainTraceBuffer
+}
+
+export type TraceStats = {
+    kind: TraceEventKindType
+    name: string
+
+    /**
+     * Events in the last second
+     */
+    count: number
+
+    /**
+     * Mean and max span duration or counter value in the last second
+     */
+    mean: number
+    max: number
+
+    /**
+     * Latest span duration or counter value
+     */
+    last: number
+}
+
+type TraceStatsWindow = { kind: TraceEventKindType; count: number; total: number; max: number; last: number }
+
+export type TraceAggregatorParams = {
+    /**
+     * Events kept for `toChromeTrace`, older events are dropped
+     * @default 200000
+     */
+    maxEvents?: number
+}
+
+/**
+ * Reads a trace buffer on the main thread. Keeps per second stats per name, and recent events for export as Chrome trace JSON
+ * that can be loaded in chrome://tracing or https://ui.perfetto.dev.
+ */
+export class TraceAggregator {
+    /**
+     * Events overwritten in the ring before they were read, call `update` more often or use a larger buffer if this grows
+     */
+    dropped = 0
+
+    private traceBuffer: TraceBuffer
+    private cursor: number
+    private maxEvents: number
+
+    private names: string[] = []
+
+    private events: TraceEvent[] = []
+    private eventsStart = 0
+
+    private windowStart = 0
+    private currentWindow = new Map<string, TraceStatsWindow>()
+    private lastWindow = new Map<string, TraceStatsWindow>()
+
+    constructor(traceBuffer: TraceBuffer, { maxEvents = 200000 }: TraceAggregatorParams = {}) {
+        this.traceBuffer = traceBuffer
+        this.cursor = traceBuffer.writeCursor
+        this.maxEvents = maxEvents
+        this.windowStart = traceBuffer.now()
+    }
+
+    /**
+     * Reads new events from the trace buffer. Call once per frame.
+     */
+    update() {
+        const traceBuffer = this.traceBuffer
+
+        const { cursor, dropped } = traceBuffer.read(this.cursor, (kind, nameId, thread, time, value) => {
+            let name = this.names[nameId]
+
+            if (name === undefined) {
+                name = traceBuffer.getName(nameId)
+                this.names[nameId] = name
+            }
+
+            this.addEvent({ kind, name, thread, time, value })
+
+            let stats = this.currentWindow.get(name)
+
+            if (!stats) {
+                stats = { kind, count: 0, total: 0, max: -Infinity, last: 0 }
+                this.currentWindow.set(name, stats)
+            }
+
+            stats.count++
+            stats.total += value
+            stats.max = Math.max(stats.max, value)
+            stats.last = value
+        })
+
+        this.cursor = cursor
+        this.dropped += dropped
+
+        /* roll the stats window */
+        const now = traceBuffer.now()
+
+        if (now - this.windowStart >= 1000) {
+            this.lastWindow = this.currentWindow
+            this.currentWindow = new Map()
+            this.windowStart = now
+        }
+    }
+
+    /**
+     * @returns stats for the last full second, sorted by name
+     */
+    getStats(): TraceStats[] {
+        const stats: TraceStats[] = []
+
+        for (const [name, { kind, count, total, max, last }] of this.lastWindow) {
+            stats.push({ kind, name, count, mean: total / count, max, last })
+        }
+
+        return stats.sort((a, b) => a.name.localeCompare(b.name))
+    }
+
+    clear() {
+        this.events = []
+        this.eventsStart = 0
+        this.dropped = 0
+        this.currentWindow.clear()
+        this.lastWindow.clear()
+    }
+
+    /**
+     * @returns kept events in the Chrome trace event format, spans as complete events and counters as counter events
+     */
+    toChromeTrace() {
+        const traceEvents: object[] = []
+
+        for (let thread = 0; thread < this.traceBuffer.threadCount; thread++) {
+            const name = this.traceBuffer.getThreadName(thread)
+
+            traceEvents.push({ name: 'thread_name', ph: 'M', pid: 1, tid: thread, args: { name } })
+        }
+
+        for (let i = 0; i < this.events.length; i++) {
+            const { kind, name, thread, time, value } = this.events[(this.eventsStart + i) % this.events.length]
+
+            // microseconds
+            const ts = time * 1000
+
+            if (kind === TraceEventKind.SPAN) {
+                traceEvents.push({ name, ph: 'X', pid: 1, tid: thread, ts, dur: value * 1000 })
+            } else {
+                traceEvents.push({ name, ph: 'C', pid: 1, tid: thread, ts, args: { value } })
+            }
+        }
+
+        return { traceEvents, displayTimeUnit: 'ms' }
+    }
+
+    private addEvent(event: TraceEvent) {
+        if (this.events.length < this.maxEvents) {
+            this.events.push(event)
+            return
+        }
+
+        this.events[this.eventsStart] = event
+        this.eventsStart = (this.eventsStart + 1) % this.maxEvents
+    }
+}
@@ -1,8 +1,14 @@
 import React from 'react'
 import ReactDOM from 'react-dom/client'
 import App from './app'
+import { benchmarkConfig, seedMathRandom } from './common/utils/benchmark'
 import './index.css'
 
+// sketches are loaded after this, so their Math.random calls are repeatable between benchmark runs
+if (benchmarkConfig) {
+    seedMathRandom(benchmarkConfig.seed)
+}
+
 ReactDOM.createRoot(document.getElementById('root')!).render(
     <React.StrictMode>
         <App />
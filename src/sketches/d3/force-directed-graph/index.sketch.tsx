@@ -1,5 +1,6 @@
-import { Html, OrbitControls } from '@react-three/drei'
-import { ReactNode } from 'react'
+import { Html, Instance, Instances, OrbitControls, PerspectiveCamera } from '@react-three/drei'
+import { useControls } from 'leva'
+import { ReactNode, useMemo } from 'react'
 import { Canvas } from '@/common'
 
 import { Link, Network, Node } from './network'
@@ -45,11 +46,73 @@ const ForceDirectedGraph = () => (
     </>
 )
 
-export default () => (
-    <>
-        <Canvas camera={{ position: [0, 0, 10] }}>
-            <ForceDirectedGraph />
-            <OrbitControls />
-        </Canvas>
-    </>
-)
+/**
+ * A random tree with some extra links, so layout cost is dominated by the charge forces
+ */
+const createLargeGraph = (nodeCount: number) => {
+    const links: { source: string; target: string }[] = []
+
+    for (let i = 1; i < nodeCount; i++) {
+        links.push({ source: String(i), target: String(Math.floor(Math.random() * i)) })
+
+        if (Math.random() < 0.1) {
+            links.push({ source: String(i), target: String(Math.floor(Math.random() * nodeCount)) })
+        }
+    }
+
+    return { nodeIds: Array.from({ length: nodeCount }, (_, i) => String(i)), links }
+}
+
+type LargeForceDirectedGraphProps = {
+    nodeCount: number
+    theta: number
+    coolingTicks: number
+}
+
+const LargeForceDirectedGraph = ({ nodeCount, theta, coolingTicks }: LargeForceDirectedGraphProps) => {
+    const { nodeIds, links } = useMemo(() => createLargeGraph(nodeCount), [nodeCount])
+
+    return (
+        <Instances limit={nodeCount} key={nodeCount}>
+            <circleGeometry args={[0.15, 8]} />
+            <meshBasicMaterial color="#f0c050" />
+
+            <Network layout={{ theta, coolingTicks, chargeStrength: -300, distanceMax: 2000 }}>
+                {nodeIds.map((id) => (
+                    <Node key={id} id={id}>
+                        <Instance />
+                    </Node>
+                ))}
+
+                {links.map((link, i) => (
+                    <Link key={i} source={link.source} target={link.target} />
+                ))}
+            </Network>
+        </Instances>
+    )
+}
+
+export default () => {
+    const { mode, nodeCount, theta, coolingTicks } = useControls('d3-force-directed-graph', {
+        mode: { value: 'emoji', options: ['emoji', 'large'] },
+        nodeCount: { value: 2000, min: 100, max: 10000, step: 100 },
+        theta: { value: 1.2, min: 0.5, max: 2, step: 0.1 },
+        coolingTicks: { value: 200, min: 50, max: 1000, step: 10 },
+    })
+
+    return (
+        <>
+            <Canvas camera={{ position: [0, 0, 10] }}>
+                {mode === 'emoji' ? (
+                    <ForceDirectedGraph />
+                ) : (
+                    <>
+                        <LargeForceDirectedGraph nodeCount={nodeCount} theta={theta} coolingTicks={coolingTicks} />
+                        <PerspectiveCamera makeDefault position={[0, 0, 150]} far={2000} />
+                    </>
+                )}
+                <OrbitControls makeDefault />
+            </Canvas>
+        </>
+    )
+}
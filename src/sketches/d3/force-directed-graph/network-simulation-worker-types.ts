@@ -0,0 +1,106 @@
+export const NetworkSimulationWorkerMessageType = {
+    SET_GRAPH: 0,
+    SET_LAYOUT: 1,
+    POSITIONS: 2,
+    RETURN_POSITIONS: 3,
+} as const
+
+export type NetworkLayoutOptions = {
+    /**
+     * Barnes–Hut approximation criterion for the charge forces, higher is faster and less accurate. 0.9 is the d3 default, 1.2 to 1.5 holds up for large graphs
+     */
+    theta: number
+
+    /**
+     * Charge is ignored between nodes further apart than this, which stops distant clusters pushing each other
+     */
+    distanceMax: number
+
+    chargeStrength: number
+
+    linkDistance: number
+
+    /**
+     * Ticks for alpha to cool from 1 to `alphaMin`, the alpha decay is derived from this
+     */
+    coolingTicks: number
+
+    /**
+     * The simulation sleeps below this alpha until the graph changes
+     */
+    alphaMin: number
+
+    velocityDecay: number
+
+    /**
+     * Ticks run before the first positions are posted, so new graphs don't start in a tangle
+     */
+    warmupTicks: number
+
+    /**
+     * Ticks run per positions message, one message is in flight per rendered frame
+     */
+    ticksPerFrame: number
+}
+
+export const DEFAULT_NETWORK_LAYOUT_OPTIONS: NetworkLayoutOptions = {
+    theta: 0.9,
+    distanceMax: Infinity,
+    chargeStrength: -10000,
+    linkDistance: 30,
+    coolingTicks: 300,
+    alphaMin: 0.001,
+    velocityDecay: 0.4,
+    warmupTicks: 100,
+    ticksPerFrame: 1,
+}
+
+export type NetworkSetGraphMessage = {
+    type: typeof NetworkSimulationWorkerMessageType.SET_GRAPH
+
+    /**
+     * Increments with every graph, positions messages are tagged with the graph they are for
+     */
+    version: number
+
+    /**
+     * Nodes keep their positions across graphs by id
+     */
+    ids: string[]
+
+    /**
+     * Source and target node indices per link
+     */
+    links: Uint32Array
+    linkStrengths: Float32Array
+}
+
+export type NetworkSetLayoutMessage = {
+    type: typeof NetworkSimulationWorkerMessageType.SET_LAYOUT
+    layout: NetworkLayoutOptions
+}
+
+export type NetworkPositionsMessage = {
+    type: typeof NetworkSimulationWorkerMessageType.POSITIONS
+    version: number
+    alpha: number
+
+    /**
+     * xy per node, in node order
+     */
+    positions: Float32Array
+}
+
+/**
+ * Gives a positions buffer back to the worker once it has been read
+ */
+export type NetworkReturnPositionsMessage = {
+    type: typeof NetworkSimulationWorkerMessageType.RETURN_POSITIONS
+    positions: Float32Array
+}
+
+export type NetworkSimulationWorkerMessage =
+    | NetworkSetGraphMessage
+    | NetworkSetLayoutMessage
+    | NetworkPositionsMessage
+    | NetworkReturnPositionsMessage
@@ -0,0 +1,157 @@
+import * as d3 from 'd3'
+import {
+    DEFAULT_NETWORK_LAYOUT_OPTIONS,
+    NetworkPositionsMessage,
+    NetworkSimulationWorkerMessage,
+    NetworkSimulationWorkerMessageType,
+} from './network-simulation-worker-types'
+
+type SimulationNode = { id: string } & d3.SimulationNodeDatum
+
+type SimulationLink = d3.SimulationLinkDatum<SimulationNode> & { strength: number }
+
+// at most one unread frame, the main thread gives the buffer back once a rendered frame has read it
+const MAX_POSITIONS_IN_FLIGHT = 1
+
+const worker = self as unknown as Worker
+
+let layout = DEFAULT_NETWORK_LAYOUT_OPTIONS
+
+let version = -1
+let nodes: SimulationNode[] = []
+let warm = false
+
+const freePositions: Float32Array[] = []
+let positionsInFlight = 0
+
+/* links are given as node indices, which is the default forceLink id */
+const linkForce = d3.forceLink<SimulationNode, SimulationLink>().strength((link) => link.strength)
+const chargeForce = d3.forceManyBody<SimulationNode>()
+const collideForce = d3.forceManyBody<SimulationNode>()
+
+// ticked here rather than by the d3 timer, so ticks are paced by rendered frames returning positions
+const simulation = d3
+    .forceSimulation<SimulationNode>()
+    .force('link', linkForce)
+    .force('charge', chargeForce)
+    .force('collide', collideForce)
+    .force('center', d3.forceCenter(0, 0))
+    .stop()
+
+const applyLayout = () => {
+    chargeForce.strength(layout.chargeStrength).theta(layout.theta).distanceMax(layout.distanceMax)
+    collideForce.theta(layout.theta).distanceMax(layout.distanceMax)
+    linkForce.distance(layout.linkDistance)
+
+    // alpha decays from 1 to alphaMin over coolingTicks
+    simulation
+        .alphaMin(layout.alphaMin)
+        .alphaDecay(1 - Math.pow(layout.alphaMin, 1 / layout.coolingTicks))
+        .velocityDecay(layout.velocityDecay)
+}
+
+applyLayout()
+
+const takePositions = () => {
+    const length = nodes.length * 2
+
+    while (freePositions.length > 0) {
+        const positions = freePositions.pop()!
+
+        // buffers for a previous graph size are dropped
+        if (positions.length === length) return positions
+    }
+
+    if (positionsInFlight < MAX_POSITIONS_IN_FLIGHT) return new Float32Array(length)
+
+    return null
+}
+
+/* yields to the event loop without the clamping of nested setTimeout calls */
+const channel = new MessageChannel()
+let scheduled = false
+
+const schedule = () => {
+    if (scheduled) return
+
+    scheduled = true
+    channel.port2.postMessage(null)
+}
+
+const run = () => {
+    scheduled = false
+
+    if (nodes.length === 0) return
+
+    // sleeping until the graph or layout changes
+    if (warm && simulation.alpha() < simulation.alphaMin()) return
+
+    // waits for the main thread to give a buffer back
+    const positions = takePositions()
+
+    if (!positions) return
+
+    if (!warm) {
+        simulation.tick(layout.warmupTicks)
+        warm = true
+    } else {
+        simulation.tick(layout.ticksPerFrame)
+    }
+
+    for (let i = 0; i < nodes.length; i++) {
+        positions[i * 2] = nodes[i].x!
+        positions[i * 2 + 1] = nodes[i].y!
+    }
+
+    const message: NetworkPositionsMessage = {
+        type: NetworkSimulationWorkerMessageType.POSITIONS,
+        version,
+        alpha: simulation.alpha(),
+        positions,
+    }
+
+    positionsInFlight++
+    worker.postMessage(message, { transfer: [positions.buffer] })
+
+    schedule()
+}
+
+channel.port1.onmessage = run
+
+worker.onmessage = (e) => {
+    const data = e.data as NetworkSimulationWorkerMessage
+
+    if (data.type === NetworkSimulationWorkerMessageType.SET_GRAPH) {
+        /* keep the positions and velocities of nodes that are still in the graph */
+        const previous = new Map(nodes.map((node) => [node.id, node]))
+
+        nodes = data.ids.map((id) => previous.get(id) ?? { id })
+
+        const links: SimulationLink[] = []
+
+        for (let i = 0; i < data.linkStrengths.length; i++) {
+            links.push({ source: data.links[i * 2], target: data.links[i * 2 + 1], strength: data.linkStrengths[i] })
+        }
+
+        simulation.nodes(nodes)
+        linkForce.links(links)
+        simulation.alpha(1)
+
+        version = data.version
+        warm = false
+
+        schedule()
+    } else if (data.type === NetworkSimulationWorkerMessageType.SET_LAYOUT) {
+        layout = data.layout
+        applyLayout()
+
+        simulation.alpha(Math.max(simulation.alpha(), 0.3))
+
+        schedule()
+    } else if (data.type === NetworkSimulationWorkerMessageType.RETURN_POSITIONS) {
+        positionsInFlight--
+        freePositions.push(data.positions)
+
+        schedule()
+    }
+}
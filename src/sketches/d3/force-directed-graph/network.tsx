@@ -1,17 +1,30 @@
-import { useThree } from '@react-three/fiber'
-import * as d3 from 'd3'
+import { useFrame, useThree } from '@react-three/fiber'
 import { createContext, useContext, useEffect, useMemo, useRef, useState } from 'react'
 import * as THREE from 'three'
-import { Line2, LineGeometry, LineMaterial } from 'three/examples/jsm/Addons.js'
+import { LineMaterial, LineSegments2, LineSegmentsGeometry } from 'three/examples/jsm/Addons.js'
+import {
+    DEFAULT_NETWORK_LAYOUT_OPTIONS,
+    NetworkLayoutOptions,
+    NetworkPositionsMessage,
+    NetworkReturnPositionsMessage,
+    NetworkSetGraphMessage,
+    NetworkSetLayoutMessage,
+    NetworkSimulationWorkerMessage,
+    NetworkSimulationWorkerMessageType,
+} from './network-simulation-worker-types'
+import NetworkSimulationWorker from './network-simulation.worker?worker'
 
 const vec = new THREE.Vector3()
 
 export type NetworkNode = {
     id: string
     group: THREE.Group
-} & d3.SimulationNodeDatum
+}
 
-export type NetworkLink = d3.SimulationLinkDatum<NetworkNode>
+export type NetworkLink = {
+    source: string
+    target: string
+}
 
 export type NetworkContextType = {
     addNode: (node: NetworkNode) => void
@@ -26,138 +39,243 @@ export const useNetwork = () => {
     return useContext(networkContext)
 }
 
-type DedupedLink = {
-    source: NetworkNode
-    target: NetworkNode
-    n: number
+type DedupedLinks = {
+    /**
+     * Source and target node indices per link
+     */
+    links: Uint32Array
+
+    /**
+     * Number of links between the same nodes
+     */
+    strengths: Float32Array
+
+    count: number
+}
+
+const createLinkLines = (capacity: number) => {
+    const geometry = new LineSegmentsGeometry()
+    geometry.setPositions(new Float32Array(capacity * 6))
+    geometry.instanceCount = 0
+
+    const material = new LineMaterial({
+        linewidth: 0.1,
+        worldUnits: true,
+        color: '#fff',
+    })
+
+    const lines = new LineSegments2(geometry, material)
+
+    // segments are written every frame, without updating bounds
+    lines.frustumCulled = false
+
+    return lines
+}
+
+/**
+ * The segment buffer shared by the instanceStart and instanceEnd attributes, xyz xyz per link
+ */
+const getLinkSegments = (lines: LineSegments2) => {
+    return (lines.geometry.attributes.instanceStart as THREE.InterleavedBufferAttribute).data as THREE.InstancedInterleavedBuffer
 }
 
 export type NetworkProps = {
     children?: React.ReactNode
+
+    /**
+     * Layout options for the simulation worker, defaults to `DEFAULT_NETWORK_LAYOUT_OPTIONS`.
+     * Large graphs want a higher theta, a finite distanceMax and fewer cooling ticks.
+     */
+    layout?: Partial<NetworkLayoutOptions>
 } & JSX.IntrinsicElements['group']
 
-export const Network = ({ children, ...groupProps }: NetworkProps) => {
-    const scene = useThree((state) => state.scene)
+/**
+ * A force directed graph of `Node` and `Link` children.
+ *
+ * The d3 simulation runs in a worker, which posts node positions in a transferred Float32Array and waits for the buffer to be
+ * returned by the next rendered frame, so the layout cools over rendered frames. The worker sleeps when the layout has cooled.
+ * Links are drawn as one batch of line segments, written in place every frame.
+ */
+export const Network = ({ children, layout, ...groupProps }: NetworkProps) => {
     const viewport = useThree((state) => state.viewport)
-
-    const simulation = useMemo(() => {
-        const s = d3
-            .forceSimulation()
-            .force(
-                'link',
-                d3
-                    .forceLink()
-                    .id((d) => (d as NetworkNode).id)
-                    .strength((d) => (d as DedupedLink).n),
-            )
-            .force('charge', d3.forceManyBody().strength(-10000))
-            .force('collide', d3.forceManyBody())
-            .force('center', d3.forceCenter(viewport.width / 2, viewport.height / 2))
-
-        return s
-    }, [viewport.width, viewport.height])
+    const size = useThree((state) => state.size)
 
     const [nodes, setNodes] = useState<NetworkNode[]>([])
     const [links, setLinks] = useState<NetworkLink[]>([])
 
-    const lineMeshes = useMemo<Map<string, Line2>>(() => new Map(), [])
+    const graphVersion = useRef(0)
+    const latestPositions = useRef<NetworkPositionsMessage | null>(null)
+    const targets = useRef(new Float32Array(0))
 
-    const dedupedLinks = useMemo(() => {
-        const linkMap = new Map<string, DedupedLink>()
+    const [linkLines, setLinkLines] = useState(() => createLinkLines(64))
 
-        links.forEach((link) => {
-            const key = `${link.source}-${link.target}`
+    const worker = useRef<Worker>(null!)
 
-            if (!linkMap.has(key)) {
-                const source = nodes.find((n) => n.id === link.source)
-                const target = nodes.find((n) => n.id === link.target)
+    const returnPositions = (positions: Float32Array) => {
+        const message: NetworkReturnPositionsMessage = { type: NetworkSimulationWorkerMessageType.RETURN_POSITIONS, positions }
+        worker.current.postMessage(message, { transfer: [positions.buffer] })
+    }
 
-                if (source && target) {
-                    linkMap.set(key, {
-                        n: 1,
-                        source,
-                        target,
-                    })
-                }
-            } else {
-                linkMap.get(key)!.n++
-            }
-        })
+    useEffect(() => {
+        const simulationWorker = new NetworkSimulationWorker()
 
-        return Array.from(linkMap.values())
-    }, [nodes, links])
+        simulationWorker.onmessage = (e) => {
+            const data = e.data as NetworkSimulationWorkerMessage
+
+            if (data.type !== NetworkSimulationWorkerMessageType.POSITIONS) return
+
+            // the worker waits for this buffer to be returned after a frame reads it
+            latestPositions.current = data
+        }
+
+        worker.current = simulationWorker
+
+        return () => {
+            simulationWorker.terminate()
+            latestPositions.current = null
+        }
+    }, [])
+
+    useEffect(() => {
+        return () => {
+            linkLines.geometry.dispose()
+            linkLines.material.dispose()
+        }
+    }, [linkLines])
 
     useEffect(() => {
-        const unseenLineMeshes = new Set(lineMeshes.keys())
+        linkLines.material.resolution.set(size.width, size.height)
+    }, [linkLines, size])
 
-        dedupedLinks.forEach((link) => {
-            const key = `${link.source.id}-${link.target.id}`
+    const dedupedLinks = useMemo<DedupedLinks>(() => {
+        const nodeIndices = new Map<string, number>()
 
-            if (lineMeshes.has(key)) {
-                unseenLineMeshes.delete(key)
-            } else {
-                const geometry = new LineGeometry()
+        for (let i = 0; i < nodes.length; i++) {
+            nodeIndices.set(nodes[i].id, i)
+        }
 
-                const material = new LineMaterial({
-                    resolution: new THREE.Vector2(window.innerWidth, window.innerHeight),
-                    linewidth: 0.1,
-                    worldUnits: true,
-                    color: '#fff',
-                })
+        const linkMap = new Map<string, { source: number; target: number; n: number }>()
 
-                const line = new Line2(geometry, material)
+        for (const link of links) {
+            const key = `${link.source}-${link.target}`
+            const existing = linkMap.get(key)
 
-                scene.add(line)
-                lineMeshes.set(key, line)
+            if (existing) {
+                existing.n++
+                continue
             }
-        })
 
-        for (const key of unseenLineMeshes) {
-            const line = lineMeshes.get(key)
+            const source = nodeIndices.get(link.source)
+            const target = nodeIndices.get(link.target)
 
-            if (line) {
-                scene.remove(line)
-                lineMeshes.delete(key)
+            if (source !== undefined && target !== undefined) {
+                linkMap.set(key, { source, target, n: 1 })
             }
         }
-    }, [dedupedLinks])
+
+        const count = linkMap.size
+        const indices = new Uint32Array(count * 2)
+        const strengths = new Float32Array(count)
+
+        let i = 0
+        for (const { source, target, n } of linkMap.values()) {
+            indices[i * 2] = source
+            indices[i * 2 + 1] = target
+            strengths[i] = n
+            i++
+        }
+
+        return { links: indices, strengths, count }
+    }, [nodes, links])
 
     useEffect(() => {
-        simulation.nodes(nodes.map((node) => node))
+        /* grow the link batch */
+        if (dedupedLinks.count > getLinkSegments(linkLines).count) {
+            setLinkLines(createLinkLines(THREE.MathUtils.ceilPowerOfTwo(dedupedLinks.count)))
+        }
+
+        /* targets start where the nodes are */
+        const nodeTargets = new Float32Array(nodes.length * 2)
+
+        for (let i = 0; i < nodes.length; i++) {
+            nodeTargets[i * 2] = nodes[i].group.position.x
+            nodeTargets[i * 2 + 1] = nodes[i].group.position.y
+        }
 
-        simulation.force<d3.ForceLink<NetworkNode, DedupedLink>>('link')!.links(dedupedLinks)
+        targets.current = nodeTargets
 
-        simulation.tick(100)
+        graphVersion.current++
 
-        simulation.on('tick', () => {
-            nodes.forEach((node) => {
-                vec.set(node.x! / viewport.factor, node.y! / viewport.factor, 0)
-                node.group.position.lerp(vec, 0.1)
-            })
+        const message: NetworkSetGraphMessage = {
+            type: NetworkSimulationWorkerMessageType.SET_GRAPH,
+            version: graphVersion.current,
+            ids: nodes.map((node) => node.id),
+            links: dedupedLinks.links.slice(),
+            linkStrengths: dedupedLinks.strengths.slice(),
+        }
 
-            dedupedLinks.forEach((link) => {
-                const key = `${link.source.id}-${link.target.id}`
-                const line = lineMeshes.get(key)!
+        worker.current.postMessage(message, { transfer: [message.links.buffer, message.linkStrengths.buffer] })
+    }, [nodes, dedupedLinks])
 
-                const geometry = line.geometry
+    useEffect(() => {
+        const message: NetworkSetLayoutMessage = {
+            type: NetworkSimulationWorkerMessageType.SET_LAYOUT,
+            layout: { ...DEFAULT_NETWORK_LAYOUT_OPTIONS, ...layout },
+        }
 
-                const points = [
-                    link.source.group.position.x,
-                    link.source.group.position.y,
-                    0,
-                    link.target.group.position.x,
-                    link.target.group.position.y,
-                    0,
-                ]
+        worker.current.postMessage(message)
+    }, [JSON.stringify(layout)])
 
-                geometry.setPositions(points)
-            })
-        })
+    useFrame(() => {
+        /* read the latest positions and give the buffer back */
+        const latest = latestPositions.current
 
-        return () => {
-            simulation.on('tick', null)
+        if (latest) {
+            latestPositions.current = null
+
+            if (latest.version === graphVersion.current) {
+                const { positions } = latest
+                const nodeTargets = targets.current
+
+                for (let i = 0; i < nodeTargets.length; i++) {
+                    nodeTargets[i] = positions[i] / viewport.factor
+                }
+            }
+
+            returnPositions(latest.positions)
+        }
+
+        /* nodes */
+        const nodeTargets = targets.current
+
+        for (let i = 0; i < nodes.length; i++) {
+            vec.set(nodeTargets[i * 2], nodeTargets[i * 2 + 1], 0)
+            nodes[i].group.position.lerp(vec, 0.1)
         }
-    }, [nodes, dedupedLinks, simulation])
+
+        /* links */
+        const segments = getLinkSegments(linkLines)
+
+        // the batch is replaced after the graph grows past it
+        if (dedupedLinks.count > segments.count) return
+
+        const segmentArray = segments.array as Float32Array
+
+        for (let i = 0; i < dedupedLinks.count; i++) {
+            const source = nodes[dedupedLinks.links[i * 2]].group.position
+            const target = nodes[dedupedLinks.links[i * 2 + 1]].group.position
+
+            segmentArray[i * 6] = source.x
+            segmentArray[i * 6 + 1] = source.y
+            segmentArray[i * 6 + 2] = 0
+            segmentArray[i * 6 + 3] = target.x
+            segmentArray[i * 6 + 4] = target.y
+            segmentArray[i * 6 + 5] = 0
+        }
+
+        segments.needsUpdate = true
+        linkLines.geometry.instanceCount = dedupedLinks.count
+    })
 
     const addNode = (node: NetworkNode) => {
         setNodes((nodes) => [...nodes, node])
@@ -177,7 +295,11 @@ export const Network = ({ children, ...groupProps }: NetworkProps) => {
 
     return (
         <networkContext.Provider value={{ addNode, removeNode, addLink, removeLink }}>
-            <group {...groupProps}>{children}</group>
+            <group {...groupProps}>
+                {children}
+
+                <primitive object={linkLines} />
+            </group>
         </networkContext.Provider>
     )
 }
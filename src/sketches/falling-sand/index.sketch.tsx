@@ -1,324 +1,206 @@
-import { useEffect, useRef } from 'react'
+import { ThreeEvent, useFrame, useThree } from '@react-three/fiber'
+import { useEffect, useMemo, useRef } from 'react'
 import styled from 'styled-components'
+import * as THREE from 'three'
 import { create } from 'zustand'
+import { Canvas } from '@/common'
+import { ELEMENT_COUNT, Element, ElementDetails, SandSimulation } from './sand-simulation'
+import { SandSimulationWorkers } from './sand-simulation-workers'
 
-type Vec2 = [number, number]
-type Particle = { x: number; y: number; element: number }
-
-const Element = {
-    air: 0,
-    sand: 1,
-    stone: 2,
-    water: 3,
-    wall: 4,
-}
-
-const ElementDetails: {
-    [key: number]: {
-        name: string
-        color: string
-        density?: number
-        directions?: Array<Vec2>
-    }
-} = {
-    [Element.air]: {
-        name: 'air',
-        color: 'white',
-        density: 0,
-    },
-    [Element.sand]: {
-        name: 'sand',
-        color: '#FFD700',
-        density: 2,
-        directions: [
-            [0, -1],
-            [-1, -1],
-            [1, -1],
-        ],
-    },
-    [Element.stone]: {
-        name: 'stone',
-        color: '#A9A9A9',
-        density: 3,
-        directions: [[0, -1]],
-    },
-    [Element.water]: {
-        name: 'water',
-        color: '#9999ff',
-        density: 1,
-        directions: [
-            [0, -1],
-            [-1, 0],
-            [1, 0],
-        ],
-    },
-    [Element.wall]: {
-        name: 'wall',
-        color: '#808080',
-    },
-}
-
-const width = 150
-const height = 150
+const width = 1024
+const height = 1024
+const chunkSize = 64
+const brushRadius = 6
 
 const useFallingSand = create<{
-    particles: Set<Particle>
-    map: Array<null | Particle>
     selectedElement: number
     paused: boolean
+    resetRequested: boolean
     togglePause: () => void
     reset: () => void
 }>((_, get) => ({
-    particles: new Set(),
-    map: new Array(width * height).fill(null),
     selectedElement: Element.sand,
     paused: false,
+    resetRequested: false,
     togglePause: () => {
         useFallingSand.setState({ paused: !get().paused })
     },
     reset: () => {
-        const { particles, map } = get()
-        particles.clear()
-        map.fill(null)
+        useFallingSand.setState({ resetRequested: true })
     },
 }))
 
-export default function Sketch() {
-    const canvasRef = useRef<HTMLCanvasElement>(null!)
-
-    const { selectedElement, paused, togglePause, reset } = useFallingSand()
-
-    useEffect(() => {
-        // space to toggle pause
-        const onKeyDown = (e: KeyboardEvent) => {
-            if (e.key === ' ') {
-                togglePause()
-            }
-        }
+const sandVertexShader = /* glsl */ `
+    varying vec2 vUv;
 
-        window.addEventListener('keydown', onKeyDown)
+    void main() {
+        vUv = uv;
+        gl_Position = projectionMatrix * modelViewMatrix * vec4(position, 1.0);
+    }
+`
 
-        return () => {
-            window.removeEventListener('keydown', onKeyDown)
-        }
-    }, [])
+const sandFragmentShader = /* glsl */ `
+    uniform sampler2D uElements;
+    uniform vec3 uColors[${ELEMENT_COUNT}];
 
-    useEffect(() => {
-        const canvas = canvasRef.current
-        canvas.width = width
-        canvas.height = height
+    varying vec2 vUv;
 
-        const ctx = canvas.getContext('2d')!
-        ctx.imageSmoothingEnabled = false
+    void main() {
+        int element = int(texture2D(uElements, vUv).r * 255.0 + 0.5);
 
-        const { map, particles } = useFallingSand.getState()
+        gl_FragColor = vec4(uColors[element], 1.0);
 
-        const get = (x: number, y: number) => {
-            return map[y * width + x]
-        }
+        #include <colorspace_fragment>
+    }
+`
 
-        const set = (x: number, y: number, element: number) => {
-            const current = get(x, y)
+/**
+ * Uploads the cells changed since the last upload, the element buffer is the texture data
+ */
+const uploadChangedCells = (renderer: THREE.WebGLRenderer, texture: THREE.DataTexture, simulation: SandSimulation) => {
+    if (!simulation.hasChanges()) return
 
-            if (current) {
-                particles.delete(current)
-            }
+    const textureProperties = renderer.properties.get(texture) as { __webglTexture?: WebGLTexture }
 
-            if (element === Element.air) {
-                map[y * width + x] = null
-                return
-            }
+    // not uploaded yet
+    if (!textureProperties.__webglTexture) {
+        texture.needsUpdate = true
+        simulation.resetChangedBounds()
+        return
+    }
 
-            const particle = { x, y, element }
+    const [minX, minY, maxX, maxY] = simulation.changedBounds
+    const gl = renderer.getContext() as WebGL2RenderingContext
 
-            particles.add(particle)
-            map[y * width + x] = particle
-        }
+    renderer.state.bindTexture(gl.TEXTURE_2D, textureProperties.__webglTexture)
 
-        const swap = (x1: number, y1: number, x2: number, y2: number) => {
-            const p1 = get(x1, y1)
-            const p2 = get(x2, y2)
+    gl.pixelStorei(gl.UNPACK_FLIP_Y_WEBGL, false)
+    gl.pixelStorei(gl.UNPACK_PREMULTIPLY_ALPHA_WEBGL, false)
+    gl.pixelStorei(gl.UNPACK_ALIGNMENT, 1)
+    gl.pixelStorei(gl.UNPACK_ROW_LENGTH, simulation.width)
+    gl.pixelStorei(gl.UNPACK_SKIP_PIXELS, minX)
+    gl.pixelStorei(gl.UNPACK_SKIP_ROWS, minY)
 
-            if (!p1 && !p2) return
+    gl.texSubImage2D(gl.TEXTURE_2D, 0, minX, minY, maxX - minX + 1, maxY - minY + 1, gl.RED, gl.UNSIGNED_BYTE, simulation.elements)
 
-            if (p1) {
-                p1.x = x2
-                p1.y = y2
-            }
+    gl.pixelStorei(gl.UNPACK_ROW_LENGTH, 0)
+    gl.pixelStorei(gl.UNPACK_SKIP_PIXELS, 0)
+    gl.pixelStorei(gl.UNPACK_SKIP_ROWS, 0)
 
-            if (p2) {
-                p2.x = x1
-                p2.y = y1
-            }
+    simulation.resetChangedBounds()
+}
 
-            map[y1 * width + x1] = p2 ?? null
-            map[y2 * width + x2] = p1 ?? null
-        }
+const FallingSand = () => {
+    const gl = useThree((s) => s.gl)
+    const viewport = useThree((s) => s.viewport)
 
-        const render = () => {
-            // resize
-            const { clientWidth, clientHeight } = canvas.parentElement as HTMLElement
-            const size = Math.min(clientWidth, clientHeight) - 120
-            canvas.style.width = `${size}px`
-            canvas.style.height = `${size}px`
+    const pointer = useRef({ down: false, x: 0, y: 0 })
 
-            // clear
-            ctx.fillStyle = 'white'
-            ctx.fillRect(0, 0, width, height)
+    const { simulation, workers } = useMemo(() => {
+        // step with workers when buffers can be shared
+        const shared = typeof SharedArrayBuffer !== 'undefined' && self.crossOriginIsolated
 
-            // render particles
-            for (const particle of particles.values()) {
-                const { x, y, element: type } = particle
+        const buffers = SandSimulation.createBuffers(width, height, chunkSize, shared)
+        const simulation = new SandSimulation(width, height, chunkSize, buffers)
 
-                const canvasX = x
-                const canvasY = height - y
+        const workerCount = Math.max(1, Math.min(4, (navigator.hardwareConcurrency ?? 4) - 1))
+        const workers = shared ? new SandSimulationWorkers(simulation, buffers, workerCount) : null
 
-                ctx.fillStyle = ElementDetails[type].color
+        return { simulation, workers }
+    }, [])
 
-                ctx.fillRect(canvasX, canvasY, 1, 1)
-            }
+    useEffect(() => {
+        return () => {
+            workers?.terminate()
         }
+    }, [])
 
-        let pointerDown = false
-        const pointerPosition = { x: 0, y: 0 }
-
-        const updatePointerPosition = (e: PointerEvent) => {
-            const x = Math.floor((e.offsetX / canvas.clientWidth) * width)
-            const y = Math.floor((e.offsetY / canvas.clientHeight) * height)
-
-            pointerPosition.x = x
-            pointerPosition.y = y
-        }
+    const texture = useMemo(() => {
+        const dataTexture = new THREE.DataTexture(simulation.elements, width, height, THREE.RedFormat, THREE.UnsignedByteType)
+        dataTexture.minFilter = THREE.NearestFilter
+        dataTexture.magFilter = THREE.NearestFilter
+        dataTexture.needsUpdate = true
 
-        canvas.addEventListener('pointerdown', (e) => {
-            pointerDown = true
-            updatePointerPosition(e)
-        })
+        return dataTexture
+    }, [])
 
-        canvas.addEventListener('pointermove', (e) => {
-            updatePointerPosition(e)
-        })
+    const uniforms = useMemo(
+        () => ({
+            uElements: { value: texture },
+            uColors: { value: Array.from({ length: ELEMENT_COUNT }, (_, element) => new THREE.Color(ElementDetails[element].color)) },
+        }),
+        [],
+    )
 
-        canvas.addEventListener('pointerup', () => {
-            pointerDown = false
-        })
+    useFrame(() => {
+        // the simulation is owned by workers while a step is in flight
+        if (workers?.busy) return
 
-        const validPosition = (x: number, y: number) => {
-            if (x < 0 || x >= width || y < 0 || y >= height) return false
+        const { selectedElement, paused, resetRequested } = useFallingSand.getState()
 
-            return true
+        if (resetRequested) {
+            simulation.clear()
+            useFallingSand.setState({ resetRequested: false })
         }
 
-        const update = () => {
-            // draw
-            if (pointerDown) {
-                const selectedType = useFallingSand.getState().selectedElement
-
-                const x = pointerPosition.x
-                const y = height - pointerPosition.y
-
-                const brush = 2
-
-                for (let i = -brush; i <= brush; i++) {
-                    for (let j = -brush; j <= brush; j++) {
-                        const nx = x + i
-                        const ny = y + j
-
-                        set(nx, ny, selectedType)
-                    }
-                }
-            }
-
-            // only update if not paused
-            if (useFallingSand.getState().paused) return
-
-            // update particles
-            const shuffledParticles = Array.from(particles.values())
-                .map((particle) => [particle, Math.random() - 0.5] as [Particle, number])
-                .sort((a, b) => a[1] - b[1])
-                .map(([particle]) => particle)
-
-            for (const particle of shuffledParticles) {
-                const { x, y, element: type } = particle
-
-                const details = ElementDetails[type]
-
-                if (!details.directions) continue
-
-                for (const direction of details.directions) {
-                    const nx = x + direction[0]
-                    const ny = y + direction[1]
-
-                    if (!validPosition(nx, ny)) continue
-
-                    if (!get(nx, ny)) {
-                        if (Math.abs(direction[0]) > 0 && Math.abs(direction[1]) > 0) {
-                            if (!get(nx, y) && !get(x, ny)) {
-                                continue
-                            }
-                        }
-
-                        swap(x, y, nx, ny)
-
-                        break
-                    } else if (details.density) {
-                        /* particle should sink through less dense types */
-
-                        // check if particle at desired position is less dense
-                        const particleBelow = get(nx, ny)
-                        if (
-                            !particleBelow ||
-                            !ElementDetails[particleBelow.element].density ||
-                            ElementDetails[particleBelow.element].density! >= details.density
-                        ) {
-                            continue
-                        }
+        if (pointer.current.down) {
+            simulation.paint(pointer.current.x, pointer.current.y, brushRadius, selectedElement)
+        }
 
-                        // switch places with particle below
-                        swap(x, y, nx, ny)
+        uploadChangedCells(gl, texture, simulation)
 
-                        // prevent rising columns
-                        for (let i = 0; i < 3; i++) {
-                            const directions = ElementDetails[particleBelow.element].directions
+        if (paused) return
 
-                            if (!directions) continue
+        if (workers) {
+            workers.step()
+        } else {
+            simulation.step()
+        }
+    })
 
-                            for (const direction of directions) {
-                                const sx = nx + direction[0]
-                                const sy = ny + direction[1]
+    const updatePointer = (e: ThreeEvent<PointerEvent>) => {
+        if (!e.uv) return
 
-                                if (!validPosition(sx, sy)) continue
+        pointer.current.x = Math.floor(e.uv.x * width)
+        pointer.current.y = Math.floor(e.uv.y * height)
+    }
 
-                                if (get(sx, sy)) continue
+    return (
+        <mesh
+            scale={[viewport.width, viewport.height, 1]}
+            onPointerDown={(e) => {
+                pointer.current.down = true
+                updatePointer(e)
+            }}
+            onPointerMove={updatePointer}
+            onPointerUp={() => {
+                pointer.current.down = false
+            }}
+            onPointerLeave={() => {
+                pointer.current.down = false
+            }}
+        >
+            <planeGeometry />
+            <shaderMaterial uniforms={uniforms} vertexShader={sandVertexShader} fragmentShader={sandFragmentShader} />
+        </mesh>
+    )
+}
 
-                                swap(x, y, sx, sy)
-                            }
-                        }
+export default function Sketch() {
+    const { selectedElement, paused, togglePause, reset } = useFallingSand()
 
-                        break
-                    }
-                }
+    useEffect(() => {
+        // space to toggle pause
+        const onKeyDown = (e: KeyboardEvent) => {
+            if (e.key === ' ') {
+                togglePause()
             }
         }
 
-        let stop = false
-        let animationFrameId: number
-
-        const loop = () => {
-            if (stop) return
-
-            update()
-            render()
-            animationFrameId = requestAnimationFrame(loop)
-        }
-
-        loop()
+        window.addEventListener('keydown', onKeyDown)
 
         return () => {
-            ctx.clearRect(0, 0, width, height)
-
-            stop = true
-            cancelAnimationFrame(animationFrameId)
+            window.removeEventListener('keydown', onKeyDown)
         }
     }, [])
 
@@ -376,12 +258,16 @@ export default function Sketch() {
                 </Button>
             </div>
 
-            <canvas
-                ref={canvasRef}
+            <div
                 style={{
-                    imageRendering: 'pixelated',
+                    height: 'calc(100% - 120px)',
+                    aspectRatio: '1 / 1',
                 }}
-            ></canvas>
+            >
+                <Canvas orthographic camera={{ position: [0, 0, 5], zoom: 1 }} flat>
+                    <FallingSand />
+                </Canvas>
+            </div>
         </div>
     )
 }
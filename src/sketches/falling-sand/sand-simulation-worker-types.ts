@@ -0,0 +1,38 @@
+import { SandSimulationBuffers } from './sand-simulation'
+
+export const SandSimulationWorkerMessageType = {
+    INIT: 0,
+    STEP: 1,
+    STEPPED: 2,
+} as const
+
+/**
+ * Offsets into the shared control buffer, for the barrier between checkerboard passes
+ */
+export const SandSimulationControl = {
+    BARRIER_COUNT: 0,
+    BARRIER_GENERATION: 1,
+    LENGTH: 2,
+} as const
+
+export type InitMessage = {
+    type: typeof SandSimulationWorkerMessageType.INIT
+    width: number
+    height: number
+    chunkSize: number
+    buffers: SandSimulationBuffers
+    control: SharedArrayBuffer
+    workerIndex: number
+    workerCount: number
+}
+
+export type StepMessage = {
+    type: typeof SandSimulationWorkerMessageType.STEP
+    stepCount: number
+}
+
+export type SteppedMessage = {
+    type: typeof SandSimulationWorkerMessageType.STEPPED
+}
+
+export type WorkerMessage = InitMessage | StepMessage | SteppedMessage
@@ -0,0 +1,82 @@
+import { SandSimulation, SandSimulationBuffers } from './sand-simulation'
+import { SandSimulationControl, SandSimulationWorkerMessageType, WorkerMessage } from './sand-simulation-worker-types'
+import SandSimulationWorker from './sand-simulation.worker?worker'
+
+/**
+ * Steps a `SandSimulation` on shared buffers with a pool of workers, one step in flight at a time.
+ *
+ * The simulation must only be changed on the main thread while no step is in flight.
+ */
+export class SandSimulationWorkers {
+    simulation: SandSimulation
+
+    workers: InstanceType<typeof SandSimulationWorker>[] = []
+
+    busy = false
+
+    private pending = 0
+
+    constructor(simulation: SandSimulation, buffers: SandSimulationBuffers, workerCount: number) {
+        this.simulation = simulation
+
+        const control = new SharedArrayBuffer(Int32Array.BYTES_PER_ELEMENT * SandSimulationControl.LENGTH)
+
+        for (let workerIndex = 0; workerIndex < workerCount; workerIndex++) {
+            const worker = new SandSimulationWorker()
+
+            worker.onmessage = (e: MessageEvent<WorkerMessage>) => {
+                if (e.data.type === SandSimulationWorkerMessageType.STEPPED) {
+                    this.onStepped()
+                }
+            }
+
+            worker.postMessage({
+                type: SandSimulationWorkerMessageType.INIT,
+                width: simulation.width,
+                height: simulation.height,
+                chunkSize: simulation.chunkSize,
+                buffers,
+                control,
+                workerIndex,
+                workerCount,
+            })
+
+            this.workers.push(worker)
+        }
+    }
+
+    /**
+     * Starts a step if none is in flight
+     */
+    step() {
+        if (this.busy) return false
+
+        this.busy = true
+        this.pending = this.workers.length
+
+        this.simulation.beginStep()
+
+        for (const worker of this.workers) {
+            worker.postMessage({ type: SandSimulationWorkerMessageType.STEP, stepCount: this.simulation.stepCount })
+        }
+
+        return true
+    }
+
+    terminate() {
+        for (const worker of this.workers) {
+            worker.terminate()
+        }
+
+        this.workers = []
+    }
+
+    private onStepped() {
+        this.pending--
+
+        if (this.pending > 0) return
+
+        this.simulation.endStep()
+        this.busy = false
+    }
+}
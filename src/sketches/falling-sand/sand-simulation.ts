@@ -0,0 +1,495 @@
+export const Element = {
+    air: 0,
+    sand: 1,
+    stone: 2,
+    water: 3,
+    wall: 4,
+}
+
+export const ELEMENT_COUNT = 5
+
+export const ElementDetails: {
+    [key: number]: {
+        name: string
+        color: string
+        density?: number
+        directions?: Array<[number, number]>
+    }
+} = {
+    [Element.air]: {
+        name: 'air',
+        color: 'white',
+        density: 0,
+    },
+    [Element.sand]: {
+        name: 'sand',
+        color: '#FFD700',
+        density: 2,
+        directions: [
+            [0, -1],
+            [-1, -1],
+            [1, -1],
+        ],
+    },
+    [Element.stone]: {
+        name: 'stone',
+        color: '#A9A9A9',
+        density: 3,
+        directions: [[0, -1]],
+    },
+    [Element.water]: {
+        name: 'water',
+        color: '#9999ff',
+        density: 1,
+        directions: [
+            [0, -1],
+            [-1, 0],
+            [1, 0],
+        ],
+    },
+    [Element.wall]: {
+        name: 'wall',
+        color: '#808080',
+    },
+}
+
+/* element details flattened for the update loop */
+const MAX_DIRECTIONS = 3
+
+const ELEMENT_DENSITY = new Uint8Array(ELEMENT_COUNT)
+const ELEMENT_DIRECTION_COUNT = new Uint8Array(ELEMENT_COUNT)
+const ELEMENT_DIRECTIONS = new Int8Array(ELEMENT_COUNT * MAX_DIRECTIONS * 2)
+
+for (let element = 0; element < ELEMENT_COUNT; element++) {
+    const { density, directions = [] } = ElementDetails[element]
+
+    ELEMENT_DENSITY[element] = density ?? 0
+    ELEMENT_DIRECTION_COUNT[element] = directions.length
+
+    for (let d = 0; d < directions.length; d++) {
+        ELEMENT_DIRECTIONS[(element * MAX_DIRECTIONS + d) * 2] = directions[d][0]
+        ELEMENT_DIRECTIONS[(element * MAX_DIRECTIONS + d) * 2 + 1] = directions[d][1]
+    }
+}
+
+/* dirty rects, min x, min y, max x, max y per chunk, inclusive */
+const RECT_STRIDE = 4
+const EMPTY_MIN = 0x7fffffff
+const EMPTY_MAX = -1
+
+const atomicMin = (array: Int32Array, index: number, value: number) => {
+    let current = Atomics.load(array, index)
+
+    while (value < current) {
+        const previous = Atomics.compareExchange(array, index, current, value)
+        if (previous === current) return
+        current = previous
+    }
+}
+
+const atomicMax = (array: Int32Array, index: number, value: number) => {
+    let current = Atomics.load(array, index)
+
+    while (value > current) {
+        const previous = Atomics.compareExchange(array, index, current, value)
+        if (previous === current) return
+        current = previous
+    }
+}
+
+export type SandSimulationBuffers = {
+    elements: ArrayBufferLike
+    flags: ArrayBufferLike
+    dirtyRects: ArrayBufferLike
+}
+
+/**
+ * Falling sand on flat Uint8 element and flag buffers.
+ *
+ * The grid is split into chunks that each keep a dirty rect, and a step only visits cells inside dirty rects, so regions that
+ * have settled cost nothing. A cell that changes marks its 3x3 neighbourhood dirty for the next step.
+ *
+ * A step runs four checkerboard passes over the chunks. Chunks in a pass are never adjacent, and cells move at most one cell,
+ * so chunks in a pass can be updated in parallel by workers sharing the buffers, see `stepPass`.
+ */
+export class SandSimulation {
+    width: number
+    height: number
+
+    chunkSize: number
+    chunksX: number
+    chunksY: number
+
+    elements: Uint8Array
+
+    /**
+     * The clock of the step that last moved each cell, so cells move once per step
+     */
+    flags: Uint8Array
+
+    /**
+     * Dirty rects for even and odd steps. Step k updates cells in the rects for k and marks changes in the rects for k + 1
+     */
+    dirtyRects: Int32Array
+
+    stepCount = 0
+
+    /**
+     * Bounds of changed cells since `resetChangedBounds`, for uploading only what changed, min x, min y, max x, max y
+     */
+    changedBounds = new Int32Array([EMPTY_MIN, EMPTY_MIN, EMPTY_MAX, EMPTY_MAX])
+
+    private random: number
+
+    /* rect of the chunk being updated, and dirty cells inside it */
+    private chunkMinX = 0
+    private chunkMinY = 0
+    private chunkMaxX = 0
+    private chunkMaxY = 0
+    private localMinX = EMPTY_MIN
+    private localMinY = EMPTY_MIN
+    private localMaxX = EMPTY_MAX
+    private localMaxY = EMPTY_MAX
+
+    static createBuffers(width: number, height: number, chunkSize: number, shared: boolean): SandSimulationBuffers {
+        const Buffer = shared ? SharedArrayBuffer : ArrayBuffer
+        const chunkCount = Math.ceil(width / chunkSize) * Math.ceil(height / chunkSize)
+
+        return {
+            elements: new Buffer(width * height),
+            flags: new Buffer(width * height),
+            dirtyRects: new Buffer(Int32Array.BYTES_PER_ELEMENT * chunkCount * RECT_STRIDE * 2),
+        }
+    }
+
+    constructor(width: number, height: number, chunkSize: number, buffers: SandSimulationBuffers, seed = 1) {
+        this.width = width
+        this.height = height
+        this.chunkSize = chunkSize
+        this.chunksX = Math.ceil(width / chunkSize)
+        this.chunksY = Math.ceil(height / chunkSize)
+
+        this.elements = new Uint8Array(buffers.elements)
+        this.flags = new Uint8Array(buffers.flags)
+        this.dirtyRects = new Int32Array(buffers.dirtyRects)
+
+        this.random = seed | 0 || 1
+    }
+
+    get chunkCount() {
+        return this.chunksX * this.chunksY
+    }
+
+    get(x: number, y: number) {
+        return this.elements[y * this.width + x]
+    }
+
+    set(x: number, y: number, element: number) {
+        if (x < 0 || x >= this.width || y < 0 || y >= this.height) return
+
+        const index = y * this.width + x
+
+        if (this.elements[index] === element) return
+
+        this.elements[index] = element
+
+        this.markDirty(x - 1, y - 1, x + 1, y + 1, this.stepCount)
+        this.expandChangedBounds(x, y, x, y)
+    }
+
+    paint(x: number, y: number, radius: number, element: number) {
+        for (let dy = -radius; dy <= radius; dy++) {
+            for (let dx = -radius; dx <= radius; dx++) {
+                this.set(x + dx, y + dy, element)
+            }
+        }
+    }
+
+    clear() {
+        this.elements.fill(0)
+        this.flags.fill(0)
+
+        this.clearRects(this.stepCount)
+        this.clearRects(this.stepCount + 1)
+
+        this.expandChangedBounds(0, 0, this.width - 1, this.height - 1)
+    }
+
+    /**
+     * Prepares the dirty rects for the next step, call before `stepPass`
+     */
+    beginStep() {
+        this.clearRects(this.stepCount + 1)
+    }
+
+    /**
+     * Updates the chunks of a checkerboard pass, 0 to 3, that belong to a worker
+     */
+    stepPass(pass: number, workerIndex = 0, workerCount = 1) {
+        const parityX = pass & 1
+        const parityY = pass >> 1
+
+        let chunkIndex = 0
+
+        for (let cy = parityY; cy < this.chunksY; cy += 2) {
+            for (let cx = parityX; cx < this.chunksX; cx += 2) {
+                if (chunkIndex++ % workerCount !== workerIndex) continue
+
+                this.stepChunk(cx, cy)
+            }
+        }
+    }
+
+    /**
+     * Adds the cells changed by the step to the changed bounds, call after all passes
+     */
+    endStep() {
+        this.stepCount++
+
+        const rects = this.dirtyRects
+        const offset = this.getRectsOffset(this.stepCount)
+
+        for (let chunk = 0; chunk < this.chunkCount; chunk++) {
+            const rect = offset + chunk * RECT_STRIDE
+
+            if (rects[rect + 2] === EMPTY_MAX) continue
+
+            this.expandChangedBounds(rects[rect], rects[rect + 1], rects[rect + 2], rects[rect + 3])
+        }
+    }
+
+    step() {
+        this.beginStep()
+
+        for (let pass = 0; pass < 4; pass++) {
+            this.stepPass(pass)
+        }
+
+        this.endStep()
+    }
+
+    resetChangedBounds() {
+        const bounds = this.changedBounds
+        bounds[0] = bounds[1] = EMPTY_MIN
+        bounds[2] = bounds[3] = EMPTY_MAX
+    }
+
+    hasChanges() {
+        return this.changedBounds[2] !== EMPTY_MAX
+    }
+
+    private stepChunk(cx: number, cy: number) {
+        const rects = this.dirtyRects
+        const rect = this.getRectsOffset(this.stepCount) + (cy * this.chunksX + cx) * RECT_STRIDE
+
+        const maxX = rects[rect + 2]
+
+        if (maxX === EMPTY_MAX) return
+
+        const minX = rects[rect]
+        const minY = rects[rect + 1]
+        const maxY = rects[rect + 3]
+
+        this.chunkMinX = cx * this.chunkSize
+        this.chunkMinY = cy * this.chunkSize
+        this.chunkMaxX = Math.min(this.chunkMinX + this.chunkSize, this.width) - 1
+        this.chunkMaxY = Math.min(this.chunkMinY + this.chunkSize, this.height) - 1
+
+        this.localMinX = this.localMinY = EMPTY_MIN
+        this.localMaxX = this.localMaxY = EMPTY_MAX
+
+        // 1 to 255, flags of cells that were never moved are 0
+        const clock = (this.stepCount % 255) + 1
+
+        /* bottom up, alternating row direction */
+        for (let y = minY; y <= maxY; y++) {
+            if ((y + this.stepCount) & 1) {
+                for (let x = minX; x <= maxX; x++) this.updateCell(x, y, clock)
+            } else {
+                for (let x = maxX; x >= minX; x--) this.updateCell(x, y, clock)
+            }
+        }
+
+        /* dirty cells inside the chunk, for the next step */
+        if (this.localMaxX !== EMPTY_MAX) {
+            const next = this.getRectsOffset(this.stepCount + 1) + (cy * this.chunksX + cx) * RECT_STRIDE
+
+            atomicMin(rects, next, this.localMinX)
+            atomicMin(rects, next + 1, this.localMinY)
+            atomicMax(rects, next + 2, this.localMaxX)
+            atomicMax(rects, next + 3, this.localMaxY)
+        }
+    }
+
+    private updateCell(x: number, y: number, clock: number) {
+        const { elements, flags, width, height } = this
+
+        const index = y * width + x
+        const element = elements[index]
+
+        const directionCount = ELEMENT_DIRECTION_COUNT[element]
+
+        if (directionCount === 0) return
+
+        // moved here this step, or a stale flag from 255 steps ago, look again next step
+        if (flags[index] === clock) {
+            this.markCellDirty(x, y)
+            return
+        }
+
+        const density = ELEMENT_DENSITY[element]
+
+        // mirror horizontal directions for half of the cells, so nothing drifts to one side
+        const flip = this.nextRandom() & 1 ? -1 : 1
+
+        for (let d = 0; d < directionCount; d++) {
+            const direction = (element * MAX_DIRECTIONS + d) * 2
+            const dx = ELEMENT_DIRECTIONS[direction] * flip
+            const dy = ELEMENT_DIRECTIONS[direction + 1]
+
+            const nx = x + dx
+            const ny = y + dy
+
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue
+
+            const target = ny * width + nx
+            const targetElement = elements[target]
+
+            if (targetElement === Element.air) {
+                // no diagonal moves into open space
+                if (dx !== 0 && dy !== 0 && elements[y * width + nx] === Element.air && elements[ny * width + x] === Element.air) {
+                    continue
+                }
+
+                this.swap(index, x, y, target, nx, ny, clock)
+
+                return
+            }
+
+            /* sink through less dense elements */
+            const targetDensity = ELEMENT_DENSITY[targetElement]
+
+            if (!density || !targetDensity || targetDensity >= density) continue
+
+            this.swap(index, x, y, target, nx, ny, clock)
+
+            // move the displaced element aside, to prevent rising columns
+            this.displace(x, y, targetElement, clock)
+
+            return
+        }
+    }
+
+    private displace(x: number, y: number, element: number, clock: number) {
+        const { elements, width, height } = this
+        const directionCount = ELEMENT_DIRECTION_COUNT[element]
+
+        for (let d = 0; d < directionCount; d++) {
+            const direction = (element * MAX_DIRECTIONS + d) * 2
+            const nx = x + ELEMENT_DIRECTIONS[direction]
+            const ny = y + ELEMENT_DIRECTIONS[direction + 1]
+
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue
+
+            const target = ny * width + nx
+
+            if (elements[target] !== Element.air) continue
+
+            this.swap(y * width + x, x, y, target, nx, ny, clock)
+
+            return
+        }
+    }
+
+    private swap(a: number, ax: number, ay: number, b: number, bx: number, by: number, clock: number) {
+        const elements = this.elements
+
+        const element = elements[a]
+        elements[a] = elements[b]
+        elements[b] = element
+
+        this.flags[a] = clock
+        this.flags[b] = clock
+
+        this.markCellDirty(ax, ay)
+        this.markCellDirty(bx, by)
+    }
+
+    private markCellDirty(x: number, y: number) {
+        const minX = Math.max(x - 1, 0)
+        const minY = Math.max(y - 1, 0)
+        const maxX = Math.min(x + 1, this.width - 1)
+        const maxY = Math.min(y + 1, this.height - 1)
+
+        /* inside the chunk being updated, no other worker writes its rect */
+        if (minX >= this.chunkMinX && maxX <= this.chunkMaxX && minY >= this.chunkMinY && maxY <= this.chunkMaxY) {
+            if (minX < this.localMinX) this.localMinX = minX
+            if (minY < this.localMinY) this.localMinY = minY
+            if (maxX > this.localMaxX) this.localMaxX = maxX
+            if (maxY > this.localMaxY) this.localMaxY = maxY
+
+            return
+        }
+
+        this.markDirty(minX, minY, maxX, maxY, this.stepCount + 1)
+    }
+
+    /**
+     * Adds a rect to the dirty rects of the chunks it overlaps, for the given step
+     */
+    private markDirty(minX: number, minY: number, maxX: number, maxY: number, step: number) {
+        minX = Math.max(minX, 0)
+        minY = Math.max(minY, 0)
+        maxX = Math.min(maxX, this.width - 1)
+        maxY = Math.min(maxY, this.height - 1)
+
+        const rects = this.dirtyRects
+        const offset = this.getRectsOffset(step)
+        const chunkSize = this.chunkSize
+
+        for (let cy = Math.floor(minY / chunkSize); cy <= Math.floor(maxY / chunkSize); cy++) {
+            for (let cx = Math.floor(minX / chunkSize); cx <= Math.floor(maxX / chunkSize); cx++) {
+                const rect = offset + (cy * this.chunksX + cx) * RECT_STRIDE
+
+                atomicMin(rects, rect, Math.max(minX, cx * chunkSize))
+                atomicMin(rects, rect + 1, Math.max(minY, cy * chunkSize))
+                atomicMax(rects, rect + 2, Math.min(maxX, (cx + 1) * chunkSize - 1))
+                atomicMax(rects, rect + 3, Math.min(maxY, (cy + 1) * chunkSize - 1))
+            }
+        }
+    }
+
+    private clearRects(step: number) {
+        const rects = this.dirtyRects
+        const offset = this.getRectsOffset(step)
+
+        for (let chunk = 0; chunk < this.chunkCount; chunk++) {
+            const rect = offset + chunk * RECT_STRIDE
+            rects[rect] = rects[rect + 1] = EMPTY_MIN
+            rects[rect + 2] = rects[rect + 3] = EMPTY_MAX
+        }
+    }
+
+    private getRectsOffset(step: number) {
+        return (step & 1) * this.chunkCount * RECT_STRIDE
+    }
+
+    private expandChangedBounds(minX: number, minY: number, maxX: number, maxY: number) {
+        const bounds = this.changedBounds
+        bounds[0] = Math.max(0, Math.min(bounds[0], minX))
+        bounds[1] = Math.max(0, Math.min(bounds[1], minY))
+        bounds[2] = Math.min(this.width - 1, Math.max(bounds[2], maxX))
+        bounds[3] = Math.min(this.height - 1, Math.max(bounds[3], maxY))
+    }
+
+    /* xorshift32, each worker has its own state */
+    private nextRandom() {
+        let x = this.random
+        x ^= x << 13
+        x ^= x >>> 17
+        x ^= x << 5
+        this.random = x
+
+        return x >>> 0
+    }
+}
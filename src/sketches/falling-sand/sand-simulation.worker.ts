@@ -0,0 +1,59 @@
+import { SandSimulation } from './sand-simulation'
+import { InitMessage, SandSimulationControl, SandSimulationWorkerMessageType, WorkerMessage } from './sand-simulation-worker-types'
+
+const state = {
+    simulation: null as SandSimulation | null,
+    control: null as Int32Array | null,
+    workerIndex: 0,
+    workerCount: 1,
+}
+
+const worker = self as unknown as Worker
+
+/**
+ * Waits until every worker has finished the current pass
+ */
+const barrier = (control: Int32Array, workerCount: number) => {
+    const generation = Atomics.load(control, SandSimulationControl.BARRIER_GENERATION)
+
+    if (Atomics.add(control, SandSimulationControl.BARRIER_COUNT, 1) === workerCount - 1) {
+        Atomics.store(control, SandSimulationControl.BARRIER_COUNT, 0)
+        Atomics.add(control, SandSimulationControl.BARRIER_GENERATION, 1)
+        Atomics.notify(control, SandSimulationControl.BARRIER_GENERATION)
+    } else {
+        Atomics.wait(control, SandSimulationControl.BARRIER_GENERATION, generation)
+    }
+}
+
+const init = ({ width, height, chunkSize, buffers, control, workerIndex, workerCount }: InitMessage) => {
+    // different random streams per worker
+    state.simulation = new SandSimulation(width, height, chunkSize, buffers, workerIndex + 1)
+    state.control = new Int32Array(control)
+    state.workerIndex = workerIndex
+    state.workerCount = workerCount
+}
+
+const step = (stepCount: number) => {
+    const { simulation, control, workerIndex, workerCount } = state
+
+    if (!simulation || !control) return
+
+    simulation.stepCount = stepCount
+
+    for (let pass = 0; pass < 4; pass++) {
+        simulation.stepPass(pass, workerIndex, workerCount)
+        barrier(control, workerCount)
+    }
+
+    worker.postMessage({ type: SandSimulationWorkerMessageType.STEPPED })
+}
+
+worker.onmessage = (e: MessageEvent<WorkerMessage>) => {
+    const message = e.data
+
+    if (message.type === SandSimulationWorkerMessageType.INIT) {
+        init(message)
+    } else if (message.type === SandSimulationWorkerMessageType.STEP) {
+        step(message.stepCount)
+    }
+}
@@ -0,0 +1,142 @@
+/**
+ * Game of life on a board packed 32 cells per word, bit b of word i in a row is cell x = i * 32 + b.
+ * Cells outside the board are dead.
+ */
+export class BitPackedGameOfLife {
+    width: number
+    height: number
+    wordsPerRow: number
+
+    state: Uint32Array
+
+    private nextState: Uint32Array
+
+    constructor(width: number, height: number) {
+        if (width % 32 !== 0) {
+            throw new Error('BitPackedGameOfLife width must be a multiple of 32')
+        }
+
+        this.width = width
+        this.height = height
+        this.wordsPerRow = width / 32
+
+        this.state = new Uint32Array(this.wordsPerRow * height)
+        this.nextState = new Uint32Array(this.wordsPerRow * height)
+    }
+
+    get(x: number, y: number) {
+        return (this.state[y * this.wordsPerRow + (x >> 5)] >>> (x & 31)) & 1
+    }
+
+    set(x: number, y: number, alive: boolean) {
+        const index = y * this.wordsPerRow + (x >> 5)
+        const bit = 1 << (x & 31)
+
+        if (alive) {
+            this.state[index] |= bit
+        } else {
+            this.state[index] &= ~bit
+        }
+    }
+
+    randomize(density: number) {
+        for (let y = 0; y < this.height; y++) {
+            for (let x = 0; x < this.width; x++) {
+                this.set(x, y, Math.random() < density)
+            }
+        }
+    }
+
+    /**
+     * Counts the neighbours of 32 cells at a time with bit-sliced adders, one bit plane per bit of the count
+     */
+    step() {
+        const { state, nextState, wordsPerRow, height } = this
+
+        for (let y = 0; y < height; y++) {
+            const above = y + 1 < height ? (y + 1) * wordsPerRow : -1
+            const row = y * wordsPerRow
+            const below = y > 0 ? (y - 1) * wordsPerRow : -1
+
+            for (let i = 0; i < wordsPerRow; i++) {
+                const hasPrevious = i > 0
+                const hasNext = i + 1 < wordsPerRow
+
+                /* rows, with the words either side for the bits shifted in at the edges */
+                const a = above === -1 ? 0 : state[above + i]
+                const aPrevious = above === -1 || !hasPrevious ? 0 : state[above + i - 1]
+                const aNext = above === -1 || !hasNext ? 0 : state[above + i + 1]
+
+                const r = state[row + i]
+                const rPrevious = hasPrevious ? state[row + i - 1] : 0
+                const rNext = hasNext ? state[row + i + 1] : 0
+
+                const b = below === -1 ? 0 : state[below + i]
+                const bPrevious = below === -1 || !hasPrevious ? 0 : state[below + i - 1]
+                const bNext = below === -1 || !hasNext ? 0 : state[below + i + 1]
+
+                /* neighbour counts, saturating at 4 */
+                let s0 = 0
+                let s1 = 0
+                let s2 = 0
+                let carry0 = 0
+
+                // west, bit b sees cell x - 1
+                let n = (a << 1) | (aPrevious >>> 31)
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                n = a
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                // east, bit b sees cell x + 1
+                n = (a >>> 1) | (aNext << 31)
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                n = (r << 1) | (rPrevious >>> 31)
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                n = (r >>> 1) | (rNext << 31)
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                n = (b << 1) | (bPrevious >>> 31)
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                n = b
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                n = (b >>> 1) | (bNext << 31)
+                carry0 = s0 & n
+                s0 ^= n
+                s2 |= s1 & carry0
+                s1 ^= carry0
+
+                // alive with 3 neighbours, or 2 neighbours and alive
+                nextState[row + i] = s1 & ~s2 & (s0 | r)
+            }
+        }
+
+        this.nextState = state
+        this.state = nextState
+    }
+}
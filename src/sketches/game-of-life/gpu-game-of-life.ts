@@ -0,0 +1,161 @@
+import * as THREE from 'three'
+import { FullScreenQuad } from 'three-stdlib'
+
+const simulationVertexShader = /* glsl */ `
+    void main() {
+        gl_Position = vec4(position.xy, 0.0, 1.0);
+    }
+`
+
+const simulationFragmentShader = /* glsl */ `
+    uniform sampler2D uState;
+    uniform bool uStep;
+    uniform bool uBrush;
+    uniform vec2 uBrushCell;
+    uniform float uBrushRadius;
+
+    float getCell(ivec2 position, ivec2 size) {
+        if (position.x < 0 || position.y < 0 || position.x >= size.x || position.y >= size.y) return 0.0;
+
+        return step(0.5, texelFetch(uState, position, 0).r);
+    }
+
+    void main() {
+        ivec2 size = textureSize(uState, 0);
+        ivec2 position = ivec2(gl_FragCoord.xy);
+
+        float alive = getCell(position, size);
+
+        if (uStep) {
+            float neighbors = 0.0;
+
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (dx == 0 && dy == 0) continue;
+                    neighbors += getCell(position + ivec2(dx, dy), size);
+                }
+            }
+
+            alive = neighbors == 3.0 || (alive == 1.0 && neighbors == 2.0) ? 1.0 : 0.0;
+        }
+
+        if (uBrush && all(lessThanEqual(abs(vec2(position) - uBrushCell), vec2(uBrushRadius)))) {
+            alive = 1.0;
+        }
+
+        gl_FragColor = vec4(alive, 0.0, 0.0, 1.0);
+    }
+`
+
+/**
+ * Game of life in ping-pong render targets, the state never leaves the GPU after the initial upload
+ */
+export class GPUGameOfLife {
+    width: number
+    height: number
+
+    private targets: [THREE.WebGLRenderTarget, THREE.WebGLRenderTarget]
+    private current = 0
+
+    // initial state, read by the first pass
+    private seed: THREE.DataTexture | null
+
+    private material: THREE.ShaderMaterial
+    private quad: FullScreenQuad
+
+    constructor(width: number, height: number, initialState: Uint8Array) {
+        this.width = width
+        this.height = height
+
+        const createTarget = () =>
+            new THREE.WebGLRenderTarget(width, height, {
+                format: THREE.RedFormat,
+                type: THREE.UnsignedByteType,
+                minFilter: THREE.NearestFilter,
+                magFilter: THREE.NearestFilter,
+                generateMipmaps: false,
+                depthBuffer: false,
+            })
+
+        this.targets = [createTarget(), createTarget()]
+
+        const seedData = new Uint8Array(width * height)
+        for (let i = 0; i < seedData.length; i++) {
+            seedData[i] = initialState[i] ? 255 : 0
+        }
+
+        this.seed = new THREE.DataTexture(seedData, width, height, THREE.RedFormat, THREE.UnsignedByteType)
+        this.seed.needsUpdate = true
+
+        this.material = new THREE.ShaderMaterial({
+            uniforms: {
+                uState: { value: this.seed },
+                uStep: { value: false },
+                uBrush: { value: false },
+                uBrushCell: { value: new THREE.Vector2() },
+                uBrushRadius: { value: 1 },
+            },
+            vertexShader: simulationVertexShader,
+            fragmentShader: simulationFragmentShader,
+            depthTest: false,
+            depthWrite: false,
+        })
+
+        this.quad = new FullScreenQuad(this.material)
+    }
+
+    /**
+     * The current state, alive cells have a red value of 1
+     */
+    get texture(): THREE.Texture {
+        return this.seed ?? this.targets[this.current].texture
+    }
+
+    step(renderer: THREE.WebGLRenderer) {
+        this.material.uniforms.uStep.value = true
+        this.material.uniforms.uBrush.value = false
+
+        this.pass(renderer)
+    }
+
+    /**
+     * Brings cells within a square around a cell to life, without stepping
+     */
+    draw(renderer: THREE.WebGLRenderer, x: number, y: number, radius: number) {
+        this.material.uniforms.uStep.value = false
+        this.material.uniforms.uBrush.value = true
+        this.material.uniforms.uBrushCell.value.set(x, y)
+        this.material.uniforms.uBrushRadius.value = radius
+
+        this.pass(renderer)
+    }
+
+    dispose() {
+        this.targets[0].dispose()
+        this.targets[1].dispose()
+        this.seed?.dispose()
+        this.material.dispose()
+        this.quad.dispose()
+    }
+
+    private pass(renderer: THREE.WebGLRenderer) {
+        const read = this.texture
+        const next = this.seed ? 0 : 1 - this.current
+        const write = this.targets[next]
+
+        this.material.uniforms.uState.value = read
+
+        const previousRenderTarget = renderer.getRenderTarget()
+
+        renderer.setRenderTarget(write)
+        this.quad.render(renderer)
+        renderer.setRenderTarget(previousRenderTarget)
+
+        this.current = next
+
+        if (this.seed) {
+            this.seed.dispose()
+            this.seed = null
+        }
+    }
+}
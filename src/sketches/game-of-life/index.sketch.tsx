@@ -2,35 +2,26 @@ import bunny from '@pmndrs/assets/models/bunny.glb'
 import { Instance, Instances, MeshReflectorMaterial, PerspectiveCamera, useGLTF } from '@react-three/drei'
 import { ThreeElements, ThreeEvent, useFrame } from '@react-three/fiber'
 import { Bloom, EffectComposer } from '@react-three/postprocessing'
+import { useControls } from 'leva'
 import { easing } from 'maath'
 import { useEffect, useMemo, useRef } from 'react'
 import * as THREE from 'three'
 import { Canvas, useMutableCallback, usePageVisible } from '@/common'
 import { FixedTimeStep } from '@/common/utils/fixed-time-step'
+import { BitPackedGameOfLife } from './bit-packed-game-of-life'
+import { GPUGameOfLife } from './gpu-game-of-life'
 
-const gameOfLifeStep = (current: Uint8Array, next: Uint8Array, width: number, height: number) => {
-    for (let y = 1; y < height - 1; y++) {
-        for (let x = 1; x < width - 1; x++) {
-            let neighbors = 0
+const LEVA_KEY = 'game-of-life'
 
-            for (let dy = -1; dy <= 1; dy++) {
-                for (let dx = -1; dx <= 1; dx++) {
-                    if (dx === 0 && dy === 0) continue
-                    if (current[(y + dy) * width + (x + dx)]) neighbors++
-                }
-            }
-
-            const i = y * width + x
-
-            if (current[i]) {
-                if (neighbors === 2 || neighbors === 3) next[i] = 1
-            } else {
-                if (neighbors === 3) next[i] = 1
-            }
-        }
-    }
+const GAME_SIZES: Record<string, [number, number]> = {
+    '256x192': [256, 192],
+    '1024x768': [1024, 768],
+    '2048x1536': [2048, 1536],
+    '4096x3072': [4096, 3072],
 }
 
+const BRUSH_RADIUS = 1
+
 const gameOfLifeVertexShader = /* glsl */ `
     varying vec2 vUv;
 
@@ -64,73 +55,166 @@ const gameOfLifeFragmentShader = /* glsl */ `
     }
 `
 
+const bitPackedGameOfLifeFragmentShader = /* glsl */ `
+    precision highp usampler2D;
+
+    uniform usampler2D uState;
+    uniform float uGameWidth;
+    uniform float uGameHeight;
+
+    varying vec2 vUv;
+
+    void main() {
+        vec2 gameSize = vec2(uGameWidth, uGameHeight);
+        ivec2 cell = ivec2(min(floor(vUv * gameSize), gameSize - 1.0));
+
+        uint word = texelFetch(uState, ivec2(cell.x >> 5, cell.y), 0).r;
+
+        bool isAlive = ((word >> uint(cell.x & 31)) & 1u) == 1u;
+
+        vec4 color = isAlive ? vec4(1.0, 1.0, 1.0, 1.0) : vec4(0.0, 0.0, 0.0, 0.5);
+
+        gl_FragColor = color;
+    }
+`
+
+export type GameOfLifeMode = 'gpu' | 'cpu'
+
+/**
+ * A simulation and the texture the screen samples, either ping-pong render targets or a bit-packed board uploaded after each step
+ */
+type GameOfLifeSimulation = {
+    texture: THREE.Texture
+    fragmentShader: string
+    step: (renderer: THREE.WebGLRenderer) => void
+    draw: (renderer: THREE.WebGLRenderer, x: number, y: number, radius: number) => void
+    dispose: () => void
+}
+
+const createGPUSimulation = (width: number, height: number, initialState: Uint8Array): GameOfLifeSimulation => {
+    const gameOfLife = new GPUGameOfLife(width, height, initialState)
+
+    return {
+        get texture() {
+            return gameOfLife.texture
+        },
+        fragmentShader: gameOfLifeFragmentShader,
+        step: (renderer) => gameOfLife.step(renderer),
+        draw: (renderer, x, y, radius) => gameOfLife.draw(renderer, x, y, radius),
+        dispose: () => gameOfLife.dispose(),
+    }
+}
+
+const createCPUSimulation = (width: number, height: number, initialState: Uint8Array): GameOfLifeSimulation => {
+    const gameOfLife = new BitPackedGameOfLife(width, height)
+
+    for (let y = 0; y < height; y++) {
+        for (let x = 0; x < width; x++) {
+            gameOfLife.set(x, y, initialState[y * width + x] === 1)
+        }
+    }
+
+    // the packed words are the texture, 32 cells per texel
+    const texture = new THREE.DataTexture(gameOfLife.state, gameOfLife.wordsPerRow, height, THREE.RedIntegerFormat, THREE.UnsignedIntType)
+    texture.internalFormat = 'R32UI'
+    texture.needsUpdate = true
+
+    const upload = () => {
+        texture.image.data = gameOfLife.state
+        texture.needsUpdate = true
+    }
+
+    return {
+        texture,
+        fragmentShader: bitPackedGameOfLifeFragmentShader,
+        step: () => {
+            gameOfLife.step()
+            upload()
+        },
+        draw: (_, cellX, cellY, radius) => {
+            for (let dy = -radius; dy <= radius; dy++) {
+                for (let dx = -radius; dx <= radius; dx++) {
+                    const x = cellX + dx
+                    const y = cellY + dy
+
+                    if (x < 0 || x >= width || y < 0 || y >= height) continue
+
+                    gameOfLife.set(x, y, true)
+                }
+            }
+
+            upload()
+        },
+        dispose: () => texture.dispose(),
+    }
+}
+
 type GameOfLifeProps = {
+    mode: GameOfLifeMode
     gameSize: [number, number]
     planeSize: [number, number]
+    stepsPerSecond: number
 } & ThreeElements['mesh']
 
 const GameOfLife = ({
+    mode,
     gameSize: [gameWidth, gameHeight],
     planeSize: [planeWidth, planeHeight],
+    stepsPerSecond,
     ...meshProps
 }: GameOfLifeProps) => {
     const meshRef = useRef<THREE.Mesh>(null!)
+    const materialRef = useRef<THREE.ShaderMaterial>(null!)
     const drawing = useRef(false)
-    const dirty = useRef(false)
-
-    const state = useMemo(() => new Uint8Array(gameWidth * gameHeight), [])
-    const nextState = useMemo(() => new Uint8Array(gameWidth * gameHeight), [])
-    const dataTexture = useMemo(() => {
-        const data = new Uint8Array(gameWidth * gameHeight * 4)
-        const texture = new THREE.DataTexture(data, gameWidth, gameHeight, THREE.RGBAFormat)
-        return { data, texture }
-    }, [])
 
-    const pageVisibile = usePageVisible()
+    // cells drawn since the last frame, applied before stepping
+    const brushCells = useRef<number[]>([])
 
-    const updateTexture = () => {
-        for (let i = 0; i < gameWidth * gameHeight; i++) {
-            dataTexture.data[i * 4] = state[i] * 255
-            dataTexture.data[i * 4 + 1] = 0
-            dataTexture.data[i * 4 + 2] = 0
-            dataTexture.data[i * 4 + 3] = 255
+    const simulation = useMemo(() => {
+        const initialState = new Uint8Array(gameWidth * gameHeight)
 
-            dataTexture.texture.needsUpdate = true
+        for (let i = 0; i < gameWidth * gameHeight; i++) {
+            initialState[i] = Math.random() > 0.4 ? 1 : 0
         }
-    }
 
-    const step = useMutableCallback(() => {
-        gameOfLifeStep(state, nextState, gameWidth, gameHeight)
-        state.set(nextState)
-        nextState.fill(0)
-
-        dirty.current = true
-    })
+        return mode === 'gpu'
+            ? createGPUSimulation(gameWidth, gameHeight, initialState)
+            : createCPUSimulation(gameWidth, gameHeight, initialState)
+    }, [])
 
     useEffect(() => {
-        state.fill(0)
-        nextState.fill(0)
+        return () => simulation.dispose()
+    }, [])
 
-        for (let i = 0; i < gameWidth * gameHeight; i++) {
-            state[i] = Math.random() > 0.4 ? 1 : 0
-        }
+    const pageVisibile = usePageVisible()
 
-        step.current()
-    }, [])
+    const renderer = useRef<THREE.WebGLRenderer>(null!)
+
+    const step = useMutableCallback(() => {
+        simulation.step(renderer.current)
+    })
 
     const fixedTimeStep = useMemo(() => {
-        return new FixedTimeStep({ timeStep: 1 / 5, maxSubSteps: 5, step: () => step.current() })
+        return new FixedTimeStep({ timeStep: 1 / stepsPerSecond, maxSubSteps: 5, step: () => step.current(), name: 'game-of-life-step' })
     }, [])
 
-    useFrame((_, delta) => {
-        if (!pageVisibile) return
+    useFrame(({ gl }, delta) => {
+        renderer.current = gl
 
-        fixedTimeStep.update(delta)
+        const cells = brushCells.current
 
-        if (dirty.current) {
-            dirty.current = false
-            updateTexture()
+        for (let i = 0; i < cells.length; i += 2) {
+            simulation.draw(gl, cells[i], cells[i + 1], BRUSH_RADIUS)
         }
+
+        cells.length = 0
+
+        if (pageVisibile) {
+            fixedTimeStep.update(delta)
+        }
+
+        // the gpu simulation writes to a different target each step
+        materialRef.current.uniforms.uState.value = simulation.texture
     })
 
     const draw = (world: THREE.Vector3) => {
@@ -144,21 +228,7 @@ const GameOfLife = ({
 
         if (cellX < 0 || cellX >= gameWidth || cellY < 0 || cellY >= gameHeight) return
 
-        const radius = 1
-        for (let dy = -radius; dy <= radius; dy++) {
-            for (let dx = -radius; dx <= radius; dx++) {
-                const x = cellX + dx
-                const y = cellY + dy
-
-                if (x < 0 || x >= gameWidth || y < 0 || y >= gameHeight) continue
-
-                const index = y * gameWidth + x
-
-                state[index] = 1
-            }
-        }
-
-        dirty.current = true
+        brushCells.current.push(cellX, cellY)
     }
 
     const onPointerDown = (event: ThreeEvent<PointerEvent>) => {
@@ -181,13 +251,14 @@ const GameOfLife = ({
         <mesh {...meshProps} ref={meshRef} onPointerDown={onPointerDown} onPointerMove={onPointerMove} onPointerUp={onPointerUp}>
             <planeGeometry args={[planeWidth, planeHeight]} />
             <shaderMaterial
+                ref={materialRef}
                 uniforms={{
-                    uState: { value: dataTexture.texture },
+                    uState: { value: simulation.texture },
                     uGameWidth: { value: gameWidth },
                     uGameHeight: { value: gameHeight },
                 }}
                 vertexShader={gameOfLifeVertexShader}
-                fragmentShader={gameOfLifeFragmentShader}
+                fragmentShader={simulation.fragmentShader}
             />
         </mesh>
     )
@@ -256,6 +327,12 @@ const CameraRig = () => {
 }
 
 export default function Sketch() {
+    const { mode, gameSize, stepsPerSecond } = useControls(LEVA_KEY, {
+        mode: { value: 'gpu' as GameOfLifeMode, options: { 'GPU ping-pong': 'gpu', 'CPU bit-packed': 'cpu' } },
+        gameSize: { value: '2048x1536', options: Object.keys(GAME_SIZES) },
+        stepsPerSecond: { value: 5, min: 1, max: 60, step: 1 },
+    })
+
     return (
         <Canvas shadows dpr={[1, 1.5]}>
             {/* bunnies */}
@@ -284,7 +361,14 @@ export default function Sketch() {
             </mesh>
 
             {/* screen */}
-            <GameOfLife gameSize={[200, 150]} planeSize={[225, 150]} position={[0, 74.5, -25]} />
+            <GameOfLife
+                key={`${mode}-${gameSize}-${stepsPerSecond}`}
+                mode={mode}
+                gameSize={GAME_SIZES[gameSize]}
+                stepsPerSecond={stepsPerSecond}
+                planeSize={[225, 150]}
+                position={[0, 74.5, -25]}
+            />
 
             {/* lights */}
             <hemisphereLight intensity={0.15} groundColor="black" />
@@ -1,15 +1,15 @@
 import { Node, ProblemDefinition } from './search'
 import { Vec2, vec2 } from './vec2'
 
-export type PositionState = Vec2 & { dedupe: string }
+export type PositionState = Vec2 & { id: number }
 
 export type MovementAction = Vec2
 
-const createPositionState = (position: Vec2): PositionState => {
-    return {
-        ...position,
-        dedupe: vec2.hash(position),
-    }
+export type GridPathQuery = {
+    start: Vec2
+    goal: Vec2
+    levelSize: number
+    obstacles: Vec2[]
 }
 
 export class GridPathfindingProblemDefinition implements ProblemDefinition<PositionState, MovementAction> {
@@ -20,7 +20,8 @@ export class GridPathfindingProblemDefinition implements ProblemDefinition<Posit
         { x: 0, y: 1 },
     ]
 
-    private obstaclePositionHashes = new Set<string>()
+    // 1 for each grid cell with an obstacle, indexed by state id
+    private obstacleGrid: Uint8Array
 
     constructor(
         public start: Vec2,
@@ -28,27 +29,29 @@ export class GridPathfindingProblemDefinition implements ProblemDefinition<Posit
         public levelSize: number,
         public obstacles: Vec2[],
     ) {
+        this.obstacleGrid = new Uint8Array(levelSize * levelSize)
+
         for (const obstacle of obstacles) {
-            this.obstaclePositionHashes.add(vec2.hash(obstacle))
+            if (this.isOutOfBounds(obstacle.x, obstacle.y)) continue
+
+            this.obstacleGrid[this.stateId(obstacle.x, obstacle.y)] = 1
         }
     }
 
     initial() {
-        return createPositionState(this.start)
+        return this.createPositionState(this.start.x, this.start.y)
     }
 
     actions(state: PositionState): MovementAction[] {
         const actions: MovementAction[] = []
 
         for (const direction of this.movementDirections) {
-            const newPosition = vec2.add(state, direction)
+            const x = state.x + direction.x
+            const y = state.y + direction.y
 
-            const outOfBounds =
-                newPosition.x < 0 || newPosition.x >= this.levelSize || newPosition.y < 0 || newPosition.y >= this.levelSize
+            if (this.isOutOfBounds(x, y)) continue
 
-            if (outOfBounds) continue
-
-            const obstacleAtPosition = this.obstaclePositionHashes.has(vec2.hash(newPosition))
+            const obstacleAtPosition = this.obstacleGrid[this.stateId(x, y)] === 1
 
             if (obstacleAtPosition) continue
 
@@ -59,7 +62,7 @@ export class GridPathfindingProblemDefinition implements ProblemDefinition<Posit
     }
 
     apply(state: PositionState, action: Vec2): PositionState {
-        return createPositionState(vec2.add(state, action))
+        return this.createPositionState(state.x + action.x, state.y + action.y)
     }
 
     goalTest(state: PositionState) {
@@ -74,6 +77,22 @@ export class GridPathfindingProblemDefinition implements ProblemDefinition<Posit
     ) {
         return cost + 1
     }
+
+    stateCount() {
+        return this.levelSize * this.levelSize
+    }
+
+    private stateId(x: number, y: number) {
+        return x + y * this.levelSize
+    }
+
+    private isOutOfBounds(x: number, y: number) {
+        return x < 0 || x >= this.levelSize || y < 0 || y >= this.levelSize
+    }
+
+    private createPositionState(x: number, y: number): PositionState {
+        return { x, y, id: this.stateId(x, y) }
+    }
 }
 
 const cartesianDistanceHeuristic = (state: PositionState, goal: Vec2) => {
@@ -1,6 +1,8 @@
-import { Canvas } from '@/common'
+import { Canvas, useConst } from '@/common'
+import { PathQueryService } from '@/common/utils/path-query-service'
 import sunsetEnvironment from '@pmndrs/assets/hdri/sunset.exr'
 import { Environment, Html, OrbitControls } from '@react-three/drei'
+import { useFrame } from '@react-three/fiber'
 import { useControls } from 'leva'
 import { useCallback, useEffect, useMemo } from 'react'
 import styled from 'styled-components'
@@ -9,8 +11,8 @@ import { create } from 'zustand'
 import { Flag } from './components/flag'
 import { Floor } from './components/floor'
 import { Rocks } from './components/rocks'
-import { GridPathfindingProblemDefinition, MovementAction, PositionState, fScore } from './grid-pathfinding-problem'
-import { Node, bestFirstGraphSearch, getPath } from './search'
+import { GridPathQuery } from './grid-pathfinding-problem'
+import PathQueryWorker from './path-query.worker?worker'
 import { Vec2 } from './vec2'
 
 type PathfindingState = {
@@ -26,8 +28,8 @@ type PathfindingState = {
     obstacles: Vec2[]
     setObstacles: (obstacles: Vec2[]) => void
 
-    path?: Node<PositionState, MovementAction>[]
-    setPath: (path?: Node<PositionState, MovementAction>[]) => void
+    path?: Vec2[]
+    setPath: (path?: Vec2[]) => void
 }
 
 const usePathfindingState = create<PathfindingState>((set) => ({
@@ -163,8 +165,8 @@ const Path = () => {
 
             meshes.push(
                 <mesh
-                    key={`${part.state.x},${part.state.y}`}
-                    position={[part.state.x - levelSize / 2, 0, part.state.y - levelSize / 2]}
+                    key={`${part.x},${part.y}`}
+                    position={[part.x - levelSize / 2, 0, part.y - levelSize / 2]}
                 >
                     <sphereGeometry args={[0.3, 16, 16]} />
                     <meshStandardMaterial color={color} />
@@ -233,25 +235,49 @@ const Info = styled.div`
     color: white;
 `
 
-export default () => {
+const PathQueries = () => {
     const { start, goal, levelSize, obstacles, setPath } = usePathfindingState()
 
+    const pathQueryService = useConst(
+        () => new PathQueryService<GridPathQuery>({ createWorker: () => new PathQueryWorker(), workerPoolSize: 1 }),
+    )
+
     useEffect(() => {
-        const problem = new GridPathfindingProblemDefinition(start, goal, levelSize, obstacles)
+        pathQueryService.connect()
+
+        return () => pathQueryService.disconnect()
+    }, [])
 
-        const node = bestFirstGraphSearch(problem, fScore)
+    useEffect(() => {
+        const id = pathQueryService.request({ start, goal, levelSize, obstacles }, ({ success, waypoints }) => {
+            const path: Vec2[] = []
+
+            for (let i = 0; success && i < waypoints.length; i += 3) {
+                path.push({ x: waypoints[i], y: waypoints[i + 1] })
+            }
 
-        const path = node ? getPath(node) : []
+            setPath(path)
+        })
 
-        setPath(path)
+        // retargeted before the result arrived
+        return () => pathQueryService.cancel(id)
     }, [start, goal, levelSize, obstacles])
 
+    useFrame(() => {
+        pathQueryService.flush()
+    })
+
+    return null
+}
+
+export default () => {
     return (
         <>
             <Canvas camera={{ position: [0, 5, 3] }}>
                 <Level />
 
                 <Path />
+                <PathQueries />
 
                 <Configuration />
 
@@ -0,0 +1,25 @@
+import { PathQuerySearch, runPathQueryWorker } from '@/common/utils/path-query-worker'
+import { GridPathQuery, GridPathfindingProblemDefinition, fScore } from './grid-pathfinding-problem'
+import { bestFirstGraphSearchSteps, getPath } from './search'
+
+function* searchGridPath({ start, goal, levelSize, obstacles }: GridPathQuery): PathQuerySearch {
+    const problem = new GridPathfindingProblemDefinition(start, goal, levelSize, obstacles)
+
+    const node = yield* bestFirstGraphSearchSteps(problem, fScore)
+
+    if (!node) return null
+
+    const path = getPath(node)
+
+    // grid x and y per waypoint, z is unused
+    const waypoints = new Float32Array(path.length * 3)
+
+    for (let i = 0; i < path.length; i++) {
+        waypoints[i * 3] = path[i].state.x
+        waypoints[i * 3 + 1] = path[i].state.y
+    }
+
+    return waypoints
+}
+
+runPathQueryWorker<GridPathQuery>({ search: searchGridPath })
@@ -1,4 +1,9 @@
-type BaseState = { dedupe: string }
+import { IndexedBinaryHeap } from '@/common/utils/indexed-binary-heap'
+
+/**
+ * States are identified by a non-negative integer id, unique per state and less than `ProblemDefinition.stateCount()`
+ */
+type BaseState = { id: number }
 
 export type Node<State extends BaseState, Action> = {
     state: State
@@ -19,100 +24,78 @@ export function getPath<State extends BaseState, Action>(node: Node<State, Actio
     return path.reverse()
 }
 
-class PriorityQueue<T> {
-    private values: Array<{ key: string; value: T; priority: number }> = []
-    private keyToPriority = new Map<string, number>()
-
-    add(key: string, value: T, priority: number): boolean {
-        const existingPriority = this.keyToPriority.get(key)
-
-        if (existingPriority) {
-            // exit if the existing item takes priority
-            if (existingPriority <= priority) {
-                return false
-            }
-
-            // otherwise remove the existing item
-            this.remove(key)
-        }
-
-        const item = { key, value, priority }
-        let low = 0
-        let high = this.values.length
-
-        while (low < high) {
-            const mid = (low + high) >>> 1
-            if (this.values[mid].priority < priority) {
-                low = mid + 1
-            } else {
-                high = mid
-            }
-        }
-
-        this.values.splice(low, 0, item)
-        this.keyToPriority.set(key, priority)
-
-        return true
-    }
-
-    remove(key: string): void {
-        const index = this.values.findIndex((item) => item.key === key)
-        if (index !== -1) {
-            this.values.splice(index, 1)
-            this.keyToPriority.delete(key)
-        }
-    }
-
-    next(): T | undefined {
-        const value = this.values.shift()
-        if (value) {
-            this.keyToPriority.delete(value.key)
-            return value.value
-        }
-        return undefined
-    }
-
-    isEmpty(): boolean {
-        return this.values.length === 0
-    }
-}
-
 export interface ProblemDefinition<State extends BaseState, Action> {
     initial(): State
     actions(state: State): Action[]
     apply(state: State, action: Action): State
     goalTest(state: State): boolean
     pathCost(cost: number, start: State, action: Action, end: State): number
+
+    /**
+     * Upper bound for state ids, used to size the explored set and open set
+     */
+    stateCount(): number
 }
 
 export function bestFirstGraphSearch<State extends BaseState, Action, ProblemDef extends ProblemDefinition<State, Action>>(
     problem: ProblemDef,
     f: (problemDefinition: ProblemDef, node: Node<State, Action>) => number,
 ): Node<State, Action> | undefined {
+    const search = bestFirstGraphSearchSteps(problem, f, Infinity)
+
+    let step = search.next()
+
+    while (!step.done) {
+        step = search.next()
+    }
+
+    return step.value
+}
+
+/**
+ * Resumable `bestFirstGraphSearch`, yields every `stepIterations` expanded nodes so the search can be time sliced
+ */
+export function* bestFirstGraphSearchSteps<State extends BaseState, Action, ProblemDef extends ProblemDefinition<State, Action>>(
+    problem: ProblemDef,
+    f: (problemDefinition: ProblemDef, node: Node<State, Action>) => number,
+    stepIterations = 1024,
+): Generator<void, Node<State, Action> | undefined> {
     const initialNode = { state: problem.initial(), pathCost: 0 }
 
     if (problem.goalTest(initialNode.state)) {
         return initialNode
     }
 
-    const explored = new Set<string>()
+    const stateCount = problem.stateCount()
+
+    const explored = new Uint8Array(stateCount)
 
-    const frontier = new PriorityQueue<Node<State, Action>>()
-    frontier.add(initialNode.state.dedupe, initialNode, 0)
+    // best node found so far for each state in the frontier
+    const frontierNodes: (Node<State, Action> | undefined)[] = new Array(stateCount)
+
+    const frontier = new IndexedBinaryHeap(Math.min(stateCount, 1024))
+    frontier.push(initialNode.state.id, 0)
+    frontierNodes[initialNode.state.id] = initialNode
+
+    let iterations = 0
 
     while (!frontier.isEmpty()) {
-        const node = frontier.next()!
+        if (++iterations % stepIterations === 0) yield
+
+        const id = frontier.pop()
+        const node = frontierNodes[id]!
+        frontierNodes[id] = undefined
 
         if (problem.goalTest(node.state)) {
             return node
         }
 
-        explored.add(node.state.dedupe)
+        explored[id] = 1
 
         for (const action of problem.actions(node.state)) {
             const state = problem.apply(node.state, action)
 
-            if (explored.has(state.dedupe)) {
+            if (explored[state.id]) {
                 continue
             }
 
@@ -123,7 +106,9 @@ export function bestFirstGraphSearch<State extends BaseState, Action, ProblemDef
                 pathCost: problem.pathCost(node.pathCost, node.state, action, state),
             }
 
-            frontier.add(state.dedupe, child, f(problem, child))
+            if (frontier.push(state.id, f(problem, child))) {
+                frontierNodes[state.id] = child
+            }
         }
     }
 
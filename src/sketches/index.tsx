@@ -281,6 +281,11 @@ const sketchList = [
         path: 'procedural-generation/pixelated-planet',
         tags: ['procedural-generation', 'simplex-noise', 'space', 'planet'],
     },
+    {
+        title: 'Procedural Generation - Streamed Terrain',
+        path: 'procedural-generation/streamed-terrain',
+        tags: ['procedural-generation', 'simplex-noise', 'heightmap', 'workers'],
+    },
     /* d3.js */
     {
         title: 'D3 - Force Directed Graph',
@@ -3,9 +3,11 @@ import { Environment, OrbitControls } from '@react-three/drei'
 import { World } from 'arancini'
 import { createReactAPI } from 'arancini/react'
 import Jolt from 'jolt-physics'
-import { useRef } from 'react'
+import { monitor, useControls } from 'leva'
+import { useCallback, useEffect, useLayoutEffect, useMemo, useRef } from 'react'
+import * as THREE from 'three'
 import { Canvas, useInterval } from '@/common'
-import { Physics, RigidBody, useJolt } from '../jolt-react-api'
+import { ContactBuffer, InstancedRigidBodies, Physics, RigidBody, useJolt } from '../jolt-react-api'
 
 const world = new World<{
     body: Jolt.Body
@@ -18,17 +20,86 @@ const { Entity, Component } = createReactAPI(world)
 
 const COLORS = ['orange', 'white', 'pink', 'skyblue']
 
+const InstancedBoxes = ({ count, bodies }: { count: number; bodies: React.MutableRefObject<Jolt.Body[]> }) => {
+    const instancedMesh = useRef<THREE.InstancedMesh>(null!)
+
+    const instances = useMemo(
+        () => Array.from({ length: count }).map((_, idx) => ({ position: [0, -100 - idx * 3, 0] as [number, number, number] })),
+        [count],
+    )
+
+    useLayoutEffect(() => {
+        const color = new THREE.Color()
+
+        for (let i = 0; i < count; i++) {
+            instancedMesh.current.setColorAt(i, color.set(COLORS[i % COLORS.length]))
+        }
+
+        instancedMesh.current.instanceColor!.needsUpdate = true
+    }, [count])
+
+    return (
+        <InstancedRigidBodies ref={bodies} instances={instances} shape="box">
+            <instancedMesh ref={instancedMesh} args={[undefined, undefined, count]} receiveShadow castShadow frustumCulled={false}>
+                <meshStandardMaterial />
+                <boxGeometry args={[2, 2, 2]} />
+            </instancedMesh>
+        </InstancedRigidBodies>
+    )
+}
+
 const Scene = () => {
+    const groundContactCount = useRef(0)
+
+    // off by default, so turning it on checks that a contact listener attached after the body was added is called
+    const { instanced, count, groundContacts } = useControls('jolt-cube-heap', {
+        instanced: false,
+        count: { value: 500, min: 100, max: 5000, step: 100 },
+        groundContacts: false,
+        groundContactsPerStep: monitor(() => groundContactCount.current, { graph: true, interval: 100 }),
+    })
+
+    const onGroundContacts = useCallback((contacts: ContactBuffer) => {
+        groundContactCount.current = contacts.count
+    }, [])
+
+    useEffect(() => {
+        if (!groundContacts) groundContactCount.current = 0
+    }, [groundContacts])
+
     const nextToTeleport = useRef(0)
+    const instancedBodies = useRef<Jolt.Body[]>([])
 
-    const { jolt, bodyInterface } = useJolt()
+    const { jolt, bodyInterface, physicsSystem, worker } = useJolt()
 
     useInterval(() => {
-        if (teleportingBodies.entities.length <= 0) return
+        if (worker) {
+            const bodies = physicsSystem.workerBodyQuery.entities.filter((e) => e.bodyDescription.motionType === 'dynamic')
+
+            if (bodies.length <= 0) return
+
+            const handle = bodies[nextToTeleport.current % bodies.length].bodyHandle
+
+            if (handle === undefined) return
+
+            const x = (0.5 - Math.random()) * 10
+            const z = (0.5 - Math.random()) * 10
 
-        const index = nextToTeleport.current % teleportingBodies.entities.length
+            worker.setPosition(handle, [x, 40, z])
+            worker.setLinearVelocity(handle, [0, 0, 0])
 
-        const body = teleportingBodies.entities[index].body
+            nextToTeleport.current++
+
+            return
+        }
+
+        const bodies = instanced ? instancedBodies.current : teleportingBodies.entities.map((e) => e.body)
+
+        if (bodies.length <= 0) return
+
+        const index = nextToTeleport.current % bodies.length
+
+        const body = bodies[index]
         const bodyId = body.GetID()
 
         const x = (0.5 - Math.random()) * 10
@@ -49,21 +120,25 @@ const Scene = () => {
     return (
         <>
             {/* falling boxes */}
-            {Array.from({ length: 500 }).map((_, idx) => (
-                <Entity teleport key={idx}>
-                    <Component name="body">
-                        <RigidBody shape="box" position={[0, -100 - idx * 3, 0]}>
-                            <mesh receiveShadow castShadow>
-                                <meshStandardMaterial color={COLORS[idx % COLORS.length]} />
-                                <boxGeometry args={[2, 2, 2]} />
-                            </mesh>
-                        </RigidBody>
-                    </Component>
-                </Entity>
-            ))}
+            {instanced ? (
+                <InstancedBoxes key={count} count={count} bodies={instancedBodies} />
+            ) : (
+                Array.from({ length: count }).map((_, idx) => (
+                    <Entity teleport key={idx}>
+                        <Component name="body">
+                            <RigidBody shape="box" position={[0, -100 - idx * 3, 0]}>
+                                <mesh receiveShadow castShadow>
+                                    <meshStandardMaterial color={COLORS[idx % COLORS.length]} />
+                                    <boxGeometry args={[2, 2, 2]} />
+                                </mesh>
+                            </RigidBody>
+                        </Component>
+                    </Entity>
+                ))
+            )}
 
             {/* ground */}
-            <RigidBody shape="box" type="static">
+            <RigidBody shape="box" type="static" onContacts={groundContacts ? onGroundContacts : undefined}>
                 <mesh receiveShadow castShadow>
                     <meshStandardMaterial color="#333" />
                     <boxGeometry args={[100, 1, 100]} />
@@ -78,10 +153,14 @@ const Scene = () => {
 }
 
 export default function Sketch() {
+    const { worker } = useControls('jolt-cube-heap', {
+        worker: false,
+    })
+
     return (
         <>
             <Canvas shadows camera={{ position: [-10, 30, 40] }}>
-                <Physics gravity={[0, -9.81, 0]}>
+                <Physics key={String(worker)} gravity={[0, -9.81, 0]} worker={worker}>
                     <Scene />
                 </Physics>
 
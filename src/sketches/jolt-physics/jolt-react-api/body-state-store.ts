@@ -0,0 +1,471 @@
+import Jolt from 'jolt-physics'
+import * as THREE from 'three'
+
+export type BodyInstance = {
+    mesh: THREE.InstancedMesh
+    index: number
+}
+
+/**
+ * A Jolt body, or the handle of a body simulated in a physics worker
+ */
+export type BodyStateKey = Jolt.Body | number
+
+const _local = new Float32Array(16)
+const _matrix4 = new THREE.Matrix4()
+const _scale = new THREE.Vector3()
+const _position = new THREE.Vector3()
+const _quaternion = new THREE.Quaternion()
+
+/**
+ * Struct of arrays transform state for bodies, indexed by body slot.
+ *
+ * Holds the previous and current simulated world transforms of each body, and writes interpolated transforms
+ * to meshes or straight into the instance matrices of instanced meshes in one pass.
+ */
+export class BodyStateStore {
+    capacity: number
+
+    count = 0
+
+    bodies: (BodyStateKey | undefined)[] = []
+    objects: (THREE.Object3D | undefined)[] = []
+    instancedMeshes: (THREE.InstancedMesh | undefined)[] = []
+
+    instanceIndices: Int32Array
+
+    previousPositions: Float32Array
+    previousQuaternions: Float32Array
+    currentPositions: Float32Array
+    currentQuaternions: Float32Array
+    scales: Float32Array
+
+    /**
+     * Inverse of the world matrix of the space transforms are written in, the parent for meshes, the instanced mesh for instances
+     */
+    inverseMatrices: Float32Array
+    identityInverses: Uint8Array
+
+    /**
+     * 1 if the body was active when last read
+     */
+    active: Uint8Array
+
+    /**
+     * 1 once a sleeping body has been written at rest, so it is skipped until it wakes
+     */
+    sleeping: Uint8Array
+
+    /**
+     * 1 for worker bodies until a snapshot has them awake, so rest transforms left by a removed body with the same handle are ignored
+     */
+    awaitingSnapshot: Uint8Array
+
+    private slots = new Map<BodyStateKey, number>()
+    private freeSlots: number[] = []
+    private dirtyInstancedMeshes = new Set<THREE.InstancedMesh>()
+
+    constructor(initialCapacity = 256) {
+        this.capacity = initialCapacity
+
+        this.instanceIndices = new Int32Array(initialCapacity)
+        this.previousPositions = new Float32Array(initialCapacity * 3)
+        this.previousQuaternions = new Float32Array(initialCapacity * 4)
+        this.currentPositions = new Float32Array(initialCapacity * 3)
+        this.currentQuaternions = new Float32Array(initialCapacity * 4)
+        this.scales = new Float32Array(initialCapacity * 3)
+        this.inverseMatrices = new Float32Array(initialCapacity * 16)
+        this.identityInverses = new Uint8Array(initialCapacity)
+        this.active = new Uint8Array(initialCapacity)
+        this.sleeping = new Uint8Array(initialCapacity)
+        this.awaitingSnapshot = new Uint8Array(initialCapacity)
+    }
+
+    /**
+     * Number of slots in use or freed, slots below this may be empty
+     */
+    get size() {
+        return this.bodies.length
+    }
+
+    getSlot(body: BodyStateKey) {
+        return this.slots.get(body)
+    }
+
+    /**
+     * Adds a body, and returns its slot. Worker bodies start at `initialTransform`, or the world transform of `object`,
+     * until read from a snapshot.
+     */
+    add(
+        body: BodyStateKey,
+        object: THREE.Object3D,
+        instance?: BodyInstance,
+        initialTransform?: { position: THREE.Vector3Tuple; quaternion: THREE.Vector4Tuple },
+    ) {
+        let slot = this.freeSlots.pop()
+
+        if (slot === undefined) {
+            slot = this.bodies.length
+
+            if (slot >= this.capacity) this.grow()
+
+            this.bodies.push(undefined)
+            this.objects.push(undefined)
+            this.instancedMeshes.push(undefined)
+        }
+
+        this.slots.set(body, slot)
+        this.count++
+
+        this.bodies[slot] = body
+        this.objects[slot] = object
+        this.instancedMeshes[slot] = instance?.mesh
+        this.instanceIndices[slot] = instance?.index ?? -1
+        this.sleeping[slot] = 0
+        this.awaitingSnapshot[slot] = 0
+
+        /* space to write transforms in */
+        const space = instance ? instance.mesh : object.parent
+
+        let inverse: THREE.Matrix4 | undefined
+
+        if (space) {
+            space.updateWorldMatrix(true, false)
+
+            if (!space.matrixWorld.equals(_matrix4.identity())) {
+                inverse = space.matrixWorld.clone().invert()
+            }
+        }
+
+        this.identityInverses[slot] = inverse ? 0 : 1
+
+        if (inverse) {
+            this.inverseMatrices.set(inverse.elements, slot * 16)
+        }
+
+        /* instances use the instanced mesh scale, meshes keep their world scale */
+        if (instance) {
+            this.scales.fill(1, slot * 3, slot * 3 + 3)
+        } else {
+            object.getWorldScale(_scale).toArray(this.scales, slot * 3)
+        }
+
+        if (typeof body === 'number') {
+            if (initialTransform) {
+                this.currentPositions.set(initialTransform.position, slot * 3)
+                this.currentQuaternions.set(initialTransform.quaternion, slot * 4)
+            } else {
+                object.getWorldPosition(_position).toArray(this.currentPositions, slot * 3)
+                object.getWorldQuaternion(_quaternion).toArray(this.currentQuaternions, slot * 4)
+            }
+
+            // written once at the initial transform, then read when the worker publishes it awake
+            this.active[slot] = 0
+            this.awaitingSnapshot[slot] = 1
+        } else {
+            this.read(slot)
+            this.active[slot] = body.IsActive() ? 1 : 0
+        }
+
+        this.copyCurrentToPrevious(slot)
+
+        return slot
+    }
+
+    remove(body: BodyStateKey) {
+        const slot = this.slots.get(body)
+
+        if (slot === undefined) return
+
+        this.slots.delete(body)
+        this.count--
+
+        this.bodies[slot] = undefined
+        this.objects[slot] = undefined
+        this.instancedMeshes[slot] = undefined
+        this.freeSlots.push(slot)
+    }
+
+    /**
+     * Copies current transforms to previous transforms for all bodies, before a fixed step
+     */
+    storePrevious() {
+        const size = this.bodies.length
+
+        this.previousPositions.set(this.currentPositions.subarray(0, size * 3))
+        this.previousQuaternions.set(this.currentQuaternions.subarray(0, size * 4))
+    }
+
+    /**
+     * Reads simulated transforms from awake bodies
+     */
+    readAwake() {
+        const { bodies, active, sleeping } = this
+
+        for (let slot = 0; slot < bodies.length; slot++) {
+            const body = bodies[slot]
+
+            if (body === undefined || typeof body === 'number') continue
+
+            if (!body.IsActive()) {
+                // read once more when going to sleep, following reads are skipped until it wakes
+                if (sleeping[slot] === 0) this.read(slot)
+
+                active[slot] = 0
+
+                continue
+            }
+
+            active[slot] = 1
+            sleeping[slot] = 0
+            this.read(slot)
+        }
+    }
+
+    /**
+     * Reads transforms of worker bodies from a snapshot, laid out by body handle with `stride` floats per body after `offset`:
+     * position xyz, quaternion xyzw, 1 if active
+     */
+    readSnapshot(snapshot: Float32Array, offset: number, stride: number) {
+        const { bodies, active, sleeping, awaitingSnapshot, currentPositions, currentQuaternions } = this
+
+        for (let slot = 0; slot < bodies.length; slot++) {
+            const handle = bodies[slot]
+
+            if (typeof handle !== 'number') continue
+
+            const s = offset + handle * stride
+
+            if (snapshot[s + 7] === 0) {
+                // the worker keeps writing the rest transform of sleeping bodies
+                if (sleeping[slot] === 1 || awaitingSnapshot[slot] === 1) continue
+
+                active[slot] = 0
+            } else {
+                active[slot] = 1
+                sleeping[slot] = 0
+                awaitingSnapshot[slot] = 0
+            }
+
+            const p = slot * 3
+            currentPositions[p] = snapshot[s]
+            currentPositions[p + 1] = snapshot[s + 1]
+            currentPositions[p + 2] = snapshot[s + 2]
+
+            const q = slot * 4
+            currentQuaternions[q] = snapshot[s + 3]
+            currentQuaternions[q + 1] = snapshot[s + 4]
+            currentQuaternions[q + 2] = snapshot[s + 5]
+            currentQuaternions[q + 3] = snapshot[s + 6]
+        }
+    }
+
+    /**
+     * Writes transforms interpolated by `alpha` between previous and current, skipping bodies already written at rest
+     */
+    write(alpha: number) {
+        const {
+            bodies,
+            objects,
+            instancedMeshes,
+            instanceIndices,
+            previousPositions: pp,
+            previousQuaternions: pq,
+            currentPositions: cp,
+            currentQuaternions: cq,
+            scales,
+            inverseMatrices,
+            identityInverses,
+            active,
+            sleeping,
+        } = this
+
+        for (let slot = 0; slot < bodies.length; slot++) {
+            if (bodies[slot] === undefined || sleeping[slot] === 1) continue
+
+            const asleep = active[slot] === 0
+
+            // snap to the rest transform, so it is correct while skipped
+            const t = asleep ? 1 : alpha
+
+            if (asleep) sleeping[slot] = 1
+
+            /* interpolate */
+            const p = slot * 3
+            const px = pp[p] + (cp[p] - pp[p]) * t
+            const py = pp[p + 1] + (cp[p + 1] - pp[p + 1]) * t
+            const pz = pp[p + 2] + (cp[p + 2] - pp[p + 2]) * t
+
+            // normalised lerp along the shortest arc, close to slerp for the small rotations between steps
+            const q = slot * 4
+            const sign = pq[q] * cq[q] + pq[q + 1] * cq[q + 1] + pq[q + 2] * cq[q + 2] + pq[q + 3] * cq[q + 3] < 0 ? -1 : 1
+            let qx = pq[q] + (cq[q] * sign - pq[q]) * t
+            let qy = pq[q + 1] + (cq[q + 1] * sign - pq[q + 1]) * t
+            let qz = pq[q + 2] + (cq[q + 2] * sign - pq[q + 2]) * t
+            let qw = pq[q + 3] + (cq[q + 3] * sign - pq[q + 3]) * t
+            const length = Math.sqrt(qx * qx + qy * qy + qz * qz + qw * qw) || 1
+            qx /= length
+            qy /= length
+            qz /= length
+            qw /= length
+
+            const instancedMesh = instancedMeshes[slot]
+            const object = objects[slot]!
+
+            if (!instancedMesh && identityInverses[slot] === 1) {
+                object.position.set(px, py, pz)
+                object.quaternion.set(qx, qy, qz, qw)
+                continue
+            }
+
+            /* compose world matrix, column major */
+            const sx = scales[p]
+            const sy = scales[p + 1]
+            const sz = scales[p + 2]
+
+            const x2 = qx + qx
+            const y2 = qy + qy
+            const z2 = qz + qz
+            const xx = qx * x2
+            const xy = qx * y2
+            const xz = qx * z2
+            const yy = qy * y2
+            const yz = qy * z2
+            const zz = qz * z2
+            const wx = qw * x2
+            const wy = qw * y2
+            const wz = qw * z2
+
+            const m0 = (1 - (yy + zz)) * sx
+            const m1 = (xy + wz) * sx
+            const m2 = (xz - wy) * sx
+            const m4 = (xy - wz) * sy
+            const m5 = (1 - (xx + zz)) * sy
+            const m6 = (yz + wx) * sy
+            const m8 = (xz + wy) * sz
+            const m9 = (yz - wx) * sz
+            const m10 = (1 - (xx + yy)) * sz
+
+            const out = instancedMesh ? (instancedMesh.instanceMatrix.array as Float32Array) : _local
+            const o = instancedMesh ? instanceIndices[slot] * 16 : 0
+
+            if (identityInverses[slot] === 1) {
+                out[o] = m0
+                out[o + 1] = m1
+                out[o + 2] = m2
+                out[o + 3] = 0
+                out[o + 4] = m4
+                out[o + 5] = m5
+                out[o + 6] = m6
+                out[o + 7] = 0
+                out[o + 8] = m8
+                out[o + 9] = m9
+                out[o + 10] = m10
+                out[o + 11] = 0
+                out[o + 12] = px
+                out[o + 13] = py
+                out[o + 14] = pz
+                out[o + 15] = 1
+            } else {
+                /* local = inverse * world, the bottom row of both is 0 0 0 1 */
+                const i = slot * 16
+                const a0 = inverseMatrices[i]
+                const a1 = inverseMatrices[i + 1]
+                const a2 = inverseMatrices[i + 2]
+                const a4 = inverseMatrices[i + 4]
+                const a5 = inverseMatrices[i + 5]
+                const a6 = inverseMatrices[i + 6]
+                const a8 = inverseMatrices[i + 8]
+                const a9 = inverseMatrices[i + 9]
+                const a10 = inverseMatrices[i + 10]
+                const a12 = inverseMatrices[i + 12]
+                const a13 = inverseMatrices[i + 13]
+                const a14 = inverseMatrices[i + 14]
+
+                out[o] = a0 * m0 + a4 * m1 + a8 * m2
+                out[o + 1] = a1 * m0 + a5 * m1 + a9 * m2
+                out[o + 2] = a2 * m0 + a6 * m1 + a10 * m2
+                out[o + 3] = 0
+                out[o + 4] = a0 * m4 + a4 * m5 + a8 * m6
+                out[o + 5] = a1 * m4 + a5 * m5 + a9 * m6
+                out[o + 6] = a2 * m4 + a6 * m5 + a10 * m6
+                out[o + 7] = 0
+                out[o + 8] = a0 * m8 + a4 * m9 + a8 * m10
+                out[o + 9] = a1 * m8 + a5 * m9 + a9 * m10
+                out[o + 10] = a2 * m8 + a6 * m9 + a10 * m10
+                out[o + 11] = 0
+                out[o + 12] = a0 * px + a4 * py + a8 * pz + a12
+                out[o + 13] = a1 * px + a5 * py + a9 * pz + a13
+                out[o + 14] = a2 * px + a6 * py + a10 * pz + a14
+                out[o + 15] = 1
+            }
+
+            if (instancedMesh) {
+                this.dirtyInstancedMeshes.add(instancedMesh)
+            } else {
+                _matrix4.fromArray(_local).decompose(object.position, object.quaternion, _scale)
+            }
+        }
+
+        for (const mesh of this.dirtyInstancedMeshes) {
+            mesh.instanceMatrix.needsUpdate = true
+        }
+
+        this.dirtyInstancedMeshes.clear()
+    }
+
+    clear() {
+        this.slots.clear()
+        this.freeSlots = []
+        this.bodies = []
+        this.objects = []
+        this.instancedMeshes = []
+        this.count = 0
+    }
+
+    private read(slot: number) {
+        const body = this.bodies[slot] as Jolt.Body
+
+        const position = body.GetPosition()
+        const p = slot * 3
+        this.currentPositions[p] = position.GetX()
+        this.currentPositions[p + 1] = position.GetY()
+        this.currentPositions[p + 2] = position.GetZ()
+
+        const rotation = body.GetRotation()
+        const q = slot * 4
+        this.currentQuaternions[q] = rotation.GetX()
+        this.currentQuaternions[q + 1] = rotation.GetY()
+        this.currentQuaternions[q + 2] = rotation.GetZ()
+        this.currentQuaternions[q + 3] = rotation.GetW()
+    }
+
+    private copyCurrentToPrevious(slot: number) {
+        this.previousPositions.set(this.currentPositions.subarray(slot * 3, slot * 3 + 3), slot * 3)
+        this.previousQuaternions.set(this.currentQuaternions.subarray(slot * 4, slot * 4 + 4), slot * 4)
+    }
+
+    private grow() {
+        const capacity = this.capacity * 2
+
+        const grow = <T extends Float32Array | Int32Array | Uint8Array>(array: T, stride: number): T => {
+            const grown = new (array.constructor as new (length: number) => T)(capacity * stride)
+            grown.set(array)
+            return grown
+        }
+
+        this.instanceIndices = grow(this.instanceIndices, 1)
+        this.previousPositions = grow(this.previousPositions, 3)
+        this.previousQuaternions = grow(this.previousQuaternions, 4)
+        this.currentPositions = grow(this.currentPositions, 3)
+        this.currentQuaternions = grow(this.currentQuaternions, 4)
+        this.scales = grow(this.scales, 3)
+        this.inverseMatrices = grow(this.inverseMatrices, 16)
+        this.identityInverses = grow(this.identityInverses, 1)
+        this.active = grow(this.active, 1)
+        this.sleeping = grow(this.sleeping, 1)
+        this.awaitingSnapshot = grow(this.awaitingSnapshot, 1)
+
+        this.capacity = capacity
+    }
+}
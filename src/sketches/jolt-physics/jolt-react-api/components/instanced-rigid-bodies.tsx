@@ -0,0 +1,161 @@
+import Jolt from 'jolt-physics'
+import { forwardRef, useEffect, useImperativeHandle, useRef, useState } from 'react'
+import * as THREE from 'three'
+import { useECS, useJolt } from '../context'
+import { JoltEntity } from '../ecs'
+import { Raw } from '../raw'
+import { AutoRigidBodyShape, getShapeDescriptionFromGeometry, getShapeSettingsFromGeometry } from '../three-to-jolt'
+import { _euler, _quaternion } from '../tmp'
+import { Vector3Tuple, Vector4Tuple } from '../types'
+import { getBodyMotionType, vec3 } from '../utils'
+import { BodyDescription } from '../worker/physics-worker-types'
+import { RigidBodyProps } from './rigid-body'
+
+export type InstancedRigidBodyProps = {
+    position?: Vector3Tuple
+    rotation?: Vector3Tuple
+    quaternion?: Vector4Tuple
+}
+
+export type InstancedRigidBodiesProps = {
+    instances: InstancedRigidBodyProps[]
+    type?: RigidBodyProps['type']
+    shape?: Exclude<AutoRigidBodyShape, false>
+
+    /**
+     * Must contain an InstancedMesh with at least `instances.length` instances
+     */
+    children: React.ReactNode
+}
+
+/**
+ * Creates a body for each instance of a child InstancedMesh, sharing one shape from the instanced geometry.
+ * Body transforms are written straight into the instance matrix. The ref is empty when bodies are simulated in a physics worker.
+ */
+export const InstancedRigidBodies = forwardRef<Jolt.Body[], InstancedRigidBodiesProps>(
+    ({ instances, type: motionType, shape: shapeType = 'box', children }, ref) => {
+        const objectRef = useRef<THREE.Object3D>(null!)
+
+        const [bodies, setBodies] = useState<Jolt.Body[]>([])
+        useImperativeHandle(ref, () => bodies, [bodies])
+
+        const { world, worker } = useECS()
+        const { bodyInterface } = useJolt()
+
+        useEffect(() => {
+            const jolt = Raw.module
+
+            let instancedMesh: THREE.InstancedMesh | undefined
+
+            objectRef.current.traverse((child) => {
+                if (!instancedMesh && child instanceof THREE.InstancedMesh) {
+                    instancedMesh = child
+                }
+            })
+
+            if (!instancedMesh) {
+                console.info('Could not find an <instancedMesh> in <InstancedRigidBodies>')
+                return
+            }
+
+            if (worker) {
+                const shapeDescription = getShapeDescriptionFromGeometry(instancedMesh.geometry, shapeType)
+
+                if (!shapeDescription) return
+
+                /* describe the bodies, they are created in the physics worker */
+                const entities: JoltEntity[] = []
+
+                for (let index = 0; index < instances.length; index++) {
+                    const { position, rotation, quaternion } = instances[index]
+
+                    const bodyQuaternion: Vector4Tuple = rotation
+                        ? (_quaternion.setFromEuler(_euler.set(...rotation)).toArray() as Vector4Tuple)
+                        : (quaternion ?? [0, 0, 0, 1])
+
+                    const bodyDescription: BodyDescription = {
+                        shapes: [shapeDescription],
+                        position: position ?? [0, 0, 0],
+                        quaternion: bodyQuaternion,
+                        motionType: motionType ?? 'dynamic',
+                    }
+
+                    entities.push(world.create({ bodyDescription, three: instancedMesh, instance: { mesh: instancedMesh, index } }))
+                }
+
+                return () => {
+                    for (const entity of entities) {
+                        world.destroy(entity)
+                    }
+                }
+            }
+
+            const shapeFromGeometry = getShapeSettingsFromGeometry(instancedMesh.geometry, shapeType)
+
+            if (!shapeFromGeometry) return
+
+            /* one shape shared by all bodies */
+            const compoundShapeSettings = new jolt.StaticCompoundShapeSettings()
+            const offset = vec3.threeToJolt(shapeFromGeometry.offset)
+            const shapeQuaternion = new jolt.Quat(0, 0, 0, 1)
+            compoundShapeSettings.AddShape(offset, shapeQuaternion, shapeFromGeometry.shapeSettings, 0)
+            jolt.destroy(offset)
+            jolt.destroy(shapeQuaternion)
+
+            const shape = compoundShapeSettings.Create().Get()
+
+            const { motionType: bodyMotionType, layer: bodyLayer } = getBodyMotionType(motionType)
+
+            const entities: JoltEntity[] = []
+            const bodies: Jolt.Body[] = []
+
+            for (let index = 0; index < instances.length; index++) {
+                const { position, rotation, quaternion } = instances[index]
+
+                const bodyPosition = vec3.tupleToJolt(position ?? [0, 0, 0])
+
+                let bodyQuaternion: Jolt.Quat
+                if (rotation) {
+                    const quat = _quaternion.setFromEuler(_euler.set(...rotation))
+
+                    bodyQuaternion = new jolt.Quat(quat.x, quat.y, quat.z, quat.w)
+                } else if (quaternion) {
+                    bodyQuaternion = new jolt.Quat(...quaternion)
+                } else {
+                    bodyQuaternion = new jolt.Quat(0, 0, 0, 1)
+                }
+
+                const bodyCreationSettings = new jolt.BodyCreationSettings(
+                    shape,
+                    bodyPosition,
+                    bodyQuaternion,
+                    bodyMotionType,
+                    bodyLayer,
+                )
+
+                const body = bodyInterface.CreateBody(bodyCreationSettings)
+
+                jolt.destroy(bodyPosition)
+                jolt.destroy(bodyQuaternion)
+                jolt.destroy(bodyCreationSettings)
+
+                bodies.push(body)
+                entities.push(world.create({ body, three: instancedMesh, instance: { mesh: instancedMesh, index } }))
+            }
+
+            jolt.destroy(compoundShapeSettings)
+
+            setBodies(bodies)
+
+            return () => {
+                setBodies([])
+
+                for (const entity of entities) {
+                    world.destroy(entity)
+                }
+            }
+        }, [instances.length])
+
+        return <object3D ref={objectRef}>{children}</object3D>
+    },
+)
@@ -6,7 +6,7 @@ import { suspend } from 'suspend-react'
 import { useConst } from '@/common'
 import { physicsContext } from '../context'
 import { JoltEntity } from '../ecs'
-import { Raw, initJolt } from '../raw'
+import { initJolt } from '../raw'
 import { BodyContactSystem, ConstraintSystem, PhysicsSystem } from '../systems'
 import { PhysicsConfig, Vector3Tuple } from '../types'
 
@@ -47,6 +47,21 @@ export type PhysicsProps = {
      * @defaultValue false
      */
     paused?: boolean
+
+    /**
+     * Simulate bodies in a worker, reading their transforms from shared memory each frame.
+     * Body refs are undefined, and contact events are not supported.
+     *
+     * @defaultValue false
+     */
+    worker?: boolean
+
+    /**
+     * Maximum number of worker bodies, sizes the shared transform snapshots
+     *
+     * @defaultValue 16384
+     */
+    maxBodies?: number
 }
 
 export const Physics = ({
@@ -56,6 +71,8 @@ export const Physics = ({
     gravity = [0, -9.81, 0],
     paused = false,
     interpolate = true,
+    worker = false,
+    maxBodies = 16384,
 }: React.PropsWithChildren<PhysicsProps>) => {
     suspend(() => initJolt(), [])
 
@@ -82,6 +99,8 @@ export const Physics = ({
 
         const physicsSystem = executor.get(PhysicsSystem)!
 
+        if (worker) physicsSystem.startWorker(maxBodies)
+
         return { executor, physicsSystem }
     })
 
@@ -97,9 +116,7 @@ export const Physics = ({
     }, [])
 
     useEffect(() => {
-        const gravityVec = new Raw.module.Vec3(...gravity)
-        physicsSystem.physicsSystem.SetGravity(gravityVec)
-        Raw.module.destroy(gravityVec)
+        physicsSystem.setGravity(gravity)
     }, [gravity.join(',')])
 
     useEffect(() => {
@@ -112,7 +129,7 @@ export const Physics = ({
         executor.update(delta)
     }, updatePriority)
 
-    const context = useMemo(() => ({ executor, world, physicsSystem }), [executor, world, physicsSystem])
+    const context = useMemo(() => ({ executor, world, physicsSystem, worker }), [executor, world, physicsSystem])
 
     return <physicsContext.Provider value={context}>{children}</physicsContext.Provider>
 }
@@ -1,13 +1,15 @@
 import Jolt from 'jolt-physics'
 import { createContext, forwardRef, useContext, useEffect, useImperativeHandle, useRef, useState } from 'react'
 import * as THREE from 'three'
-import { Layer } from '../constants'
 import { useECS, useJolt } from '../context'
+import { JoltEntity } from '../ecs'
 import { Raw } from '../raw'
-import { AutoRigidBodyShape, getShapeSettingsFromObject } from '../three-to-jolt'
+import { AutoRigidBodyShape, getShapeDescriptionsFromObject, getShapeSettingsFromObject } from '../three-to-jolt'
+import { BodyContactSystem } from '../systems'
 import { BodyEvents, Vector3Tuple, Vector4Tuple } from '../types'
-import { vec3 } from '../utils'
+import { getBodyMotionType, vec3 } from '../utils'
 import { _euler, _quaternion } from '../tmp'
+import { BodyDescription, ShapeDescription } from '../worker/physics-worker-types'
 
 export type RigidBodyProps = {
     position?: Vector3Tuple
@@ -18,14 +20,19 @@ export type RigidBodyProps = {
     shape?: AutoRigidBodyShape
 } & BodyEvents
 
-type ShapeSettings = {
+export type RigidBodyShapeSettings = {
     shape: Jolt.ShapeSettings
     offset?: THREE.Vector3
+
+    /**
+     * Used instead of `shape` when bodies are simulated in a physics worker
+     */
+    description?: ShapeDescription
 }
 
 const rigidBodyContext = createContext<{
-    addShapeSettings: (shape: ShapeSettings) => void
-    removeShapeSettings: (shape: ShapeSettings) => void
+    addShapeSettings: (shape: RigidBodyShapeSettings) => void
+    removeShapeSettings: (shape: RigidBodyShapeSettings) => void
 }>(null!)
 
 export const useRigidBody = () => {
@@ -44,6 +51,8 @@ export const RigidBody = forwardRef<Jolt.Body, RigidBodyProps>(
             onContactAdded,
             onContactPersisted,
             onContactRemoved,
+            onContacts,
+            contactFilter,
         },
         ref,
     ) => {
@@ -52,16 +61,16 @@ export const RigidBody = forwardRef<Jolt.Body, RigidBodyProps>(
         const [body, setBody] = useState<Jolt.Body>()
         useImperativeHandle(ref, () => body!, [body])
 
-        const { world } = useECS()
+        const { world, executor, worker } = useECS()
         const { bodyInterface } = useJolt()
 
-        const childShapeSettings = useRef<ShapeSettings[]>([])
+        const childShapeSettings = useRef<RigidBodyShapeSettings[]>([])
 
-        const addShapeSettings = (shapeSettings: ShapeSettings) => {
+        const addShapeSettings = (shapeSettings: RigidBodyShapeSettings) => {
             childShapeSettings.current.push(shapeSettings)
         }
 
-        const removeShapeSettings = (shapeSettings: ShapeSettings) => {
+        const removeShapeSettings = (shapeSettings: RigidBodyShapeSettings) => {
             const index = childShapeSettings.current.indexOf(shapeSettings)
 
             if (index !== -1) {
@@ -70,14 +79,65 @@ export const RigidBody = forwardRef<Jolt.Body, RigidBodyProps>(
         }
 
         const bodyEvents = useRef<BodyEvents>({})
+        const entityRef = useRef<JoltEntity>()
 
         useEffect(() => {
             bodyEvents.current.onContactAdded = onContactAdded
             bodyEvents.current.onContactPersisted = onContactPersisted
             bodyEvents.current.onContactRemoved = onContactRemoved
-        }, [onContactAdded, onContactPersisted, onContactRemoved])
+            bodyEvents.current.onContacts = onContacts
+            bodyEvents.current.contactFilter = contactFilter
+
+            // the contact system reads which events to collect when the body is added, tell it about listeners set later
+            if (entityRef.current) executor.get(BodyContactSystem)?.updateSubscription(entityRef.current)
+        }, [onContactAdded, onContactPersisted, onContactRemoved, onContacts, contactFilter])
 
         useEffect(() => {
+            if (!worker) return
+
+            /* describe the body, it is created in the physics worker */
+            let shapes: ShapeDescription[]
+
+            if (shapeType && childShapeSettings.current.length === 0) {
+                shapes = getShapeDescriptionsFromObject(objectRef.current, shapeType)
+            } else {
+                shapes = []
+
+                for (const shapeSettings of childShapeSettings.current) {
+                    if (!shapeSettings.description) continue
+
+                    shapes.push({ ...shapeSettings.description, offset: shapeSettings.offset?.toArray() })
+                }
+            }
+
+            if (shapes.length === 0) {
+                console.info('Could not find any shapes in the <RigidBody>')
+                return
+            }
+
+            const bodyQuaternion: Vector4Tuple = rotation
+                ? (_quaternion.setFromEuler(_euler.set(...rotation)).toArray() as Vector4Tuple)
+                : (quaternion ?? [0, 0, 0, 1])
+
+            const bodyDescription: BodyDescription = {
+                shapes,
+                position: position ?? [0, 0, 0],
+                quaternion: bodyQuaternion,
+                motionType: motionType ?? 'dynamic',
+            }
+
+            const entity = world.create({ bodyDescription, bodyEvents: bodyEvents.current, three: objectRef.current })
+            entityRef.current = entity
+
+            return () => {
+                entityRef.current = undefined
+                world.destroy(entity)
+            }
+        }, [])
+
+        useEffect(() => {
+            if (worker) return
+
             const jolt = Raw.module
 
             /* get shape settings */
@@ -125,22 +185,7 @@ export const RigidBody = forwardRef<Jolt.Body, RigidBodyProps>(
                 bodyQuaternion = new jolt.Quat(0, 0, 0, 1)
             }
 
-            let bodyMotionType: number
-            switch (motionType) {
-                case 'dynamic':
-                    bodyMotionType = jolt.EMotionType_Dynamic
-                    break
-                case 'kinematic':
-                    bodyMotionType = jolt.EMotionType_Kinematic
-                    break
-                case 'static':
-                    bodyMotionType = jolt.EMotionType_Static
-                    break
-                default:
-                    bodyMotionType = jolt.EMotionType_Dynamic
-            }
-
-            const bodyLayer = motionType === 'static' ? Layer.NON_MOVING : Layer.MOVING
+            const { motionType: bodyMotionType, layer: bodyLayer } = getBodyMotionType(motionType)
 
             /* create body */
             const bodyCreationSettings = new jolt.BodyCreationSettings(
@@ -160,10 +205,12 @@ export const RigidBody = forwardRef<Jolt.Body, RigidBodyProps>(
             jolt.destroy(bodyCreationSettings)
 
             const entity = world.create({ body, bodyEvents: bodyEvents.current, three: objectRef.current })
+            entityRef.current = entity
 
             setBody(body)
 
             return () => {
+                entityRef.current = undefined
                 setBody(undefined!)
 
                 world.destroy(entity)
@@ -1,5 +1,5 @@
 import { useEffect } from 'react'
-import { useRigidBody } from './rigid-body'
+import { RigidBodyShapeSettings, useRigidBody } from './rigid-body'
 import { Raw } from '../raw'
 
 export type BoxShapeProps = {
@@ -14,7 +14,7 @@ export const BoxShape = ({ args }: BoxShapeProps) => {
 
         const shape = new jolt.BoxShapeSettings(new jolt.Vec3(...args))
 
-        const shapeSettings = { shape }
+        const shapeSettings: RigidBodyShapeSettings = { shape, description: { type: 'box', halfExtents: args } }
 
         rigidBody.addShapeSettings(shapeSettings)
 
@@ -37,7 +37,7 @@ export const SphereShape = ({ args }: SphereShapeProps) => {
         const jolt = Raw.module
 
         const shape = new jolt.SphereShapeSettings(args[0])
-        const shapeSettings = { shape }
+        const shapeSettings: RigidBodyShapeSettings = { shape, description: { type: 'sphere', radius: args[0] } }
 
         rigidBody.addShapeSettings(shapeSettings)
 
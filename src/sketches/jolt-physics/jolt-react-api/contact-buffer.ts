@@ -0,0 +1,108 @@
+import type { JoltEntity } from './ecs'
+
+export const ContactEventType = {
+    ADDED: 0,
+    PERSISTED: 1,
+    REMOVED: 2,
+} as const
+
+/**
+ * Offsets of contact fields, `CONTACT_STRIDE` floats per contact
+ */
+export const ContactField = {
+    TYPE: 0,
+    /* world space contact point xyz */
+    POINT: 1,
+    /* normal xyz, from the listening body towards the other body */
+    NORMAL: 4,
+    /* impulse estimated from the approach speed along the normal and the reduced mass, before solving */
+    IMPULSE: 7,
+    PENETRATION_DEPTH: 8,
+} as const
+
+export const CONTACT_STRIDE = 9
+
+/**
+ * Contacts of one body collected over a physics step, in a flat buffer.
+ *
+ * Removed contacts only have a type and the other body, Jolt doesn't report points for them.
+ * The buffer is reused after listeners are called, copy values that are needed later.
+ */
+export class ContactBuffer {
+    count = 0
+
+    data: Float32Array
+
+    /**
+     * Index and sequence number of the other body of each contact
+     */
+    otherBodyIds: Uint32Array
+
+    otherEntities: (JoltEntity | undefined)[] = []
+
+    private capacity: number
+
+    constructor(initialCapacity = 16) {
+        this.capacity = initialCapacity
+        this.data = new Float32Array(initialCapacity * CONTACT_STRIDE)
+        this.otherBodyIds = new Uint32Array(initialCapacity)
+    }
+
+    getType(index: number) {
+        return this.data[index * CONTACT_STRIDE + ContactField.TYPE]
+    }
+
+    getImpulse(index: number) {
+        return this.data[index * CONTACT_STRIDE + ContactField.IMPULSE]
+    }
+
+    push(
+        type: number,
+        px: number,
+        py: number,
+        pz: number,
+        nx: number,
+        ny: number,
+        nz: number,
+        impulse: number,
+        penetrationDepth: number,
+        otherBodyId: number,
+        otherEntity: JoltEntity | undefined,
+    ) {
+        if (this.count >= this.capacity) this.grow()
+
+        const index = this.count++
+        const offset = index * CONTACT_STRIDE
+
+        const data = this.data
+        data[offset] = type
+        data[offset + 1] = px
+        data[offset + 2] = py
+        data[offset + 3] = pz
+        data[offset + 4] = nx
+        data[offset + 5] = ny
+        data[offset + 6] = nz
+        data[offset + 7] = impulse
+        data[offset + 8] = penetrationDepth
+
+        this.otherBodyIds[index] = otherBodyId
+        this.otherEntities[index] = otherEntity
+    }
+
+    clear() {
+        this.otherEntities.fill(undefined, 0, this.count)
+        this.count = 0
+    }
+
+    private grow() {
+        this.capacity *= 2
+
+        const data = new Float32Array(this.capacity * CONTACT_STRIDE)
+        data.set(this.data)
+        this.data = data
+
+        const otherBodyIds = new Uint32Array(this.capacity)
+        otherBodyIds.set(this.otherBodyIds)
+        this.otherBodyIds = otherBodyIds
+    }
+}
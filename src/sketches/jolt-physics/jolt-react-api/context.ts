@@ -9,6 +9,11 @@ type ContextType = {
     executor: Executor<JoltEntity>
     world: World<JoltEntity>
     physicsSystem: PhysicsSystem
+
+    /**
+     * Whether bodies are simulated in a physics worker
+     */
+    worker: boolean
 }
 
 export const physicsContext = createContext<ContextType>(null!)
@@ -25,6 +30,7 @@ export const useJolt = () => {
         joltInterface: context.physicsSystem.joltInterface,
         bodyInterface: context.physicsSystem.bodyInterface,
         physicsSystem: context.physicsSystem,
+        worker: context.physicsSystem.worker,
     }
 
     return publicApi
@@ -1,6 +1,8 @@
 import Jolt from 'jolt-physics'
 import * as THREE from 'three'
+import type { BodyInstance } from './body-state-store'
 import { BodyEvents, PhysicsConfig, WorldEvents } from './types'
+import type { BodyDescription, ConstraintDescription } from './worker/physics-worker-types'
 
 export type JoltEntity = {
     physicsConfig?: PhysicsConfig
@@ -8,5 +10,22 @@ export type JoltEntity = {
     bodyEvents?: BodyEvents
     constraint?: Jolt.Constraint
     three?: THREE.Object3D
+
+    /**
+     * Instance of an InstancedMesh the body transform is written to, instead of `three`
+     */
+    instance?: BodyInstance
     worldEvents?: WorldEvents
+
+    /**
+     * A body created in the physics worker, and its handle once created
+     */
+    bodyDescription?: BodyDescription
+    bodyHandle?: number
+
+    /**
+     * A constraint created in the physics worker, between bodies by handle
+     */
+    constraintDescription?: ConstraintDescription
+    constraintHandle?: number
 }
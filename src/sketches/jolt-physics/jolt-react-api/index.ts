@@ -1,5 +1,12 @@
+export {
+    InstancedRigidBodies,
+    type InstancedRigidBodiesProps,
+    type InstancedRigidBodyProps,
+} from './components/instanced-rigid-bodies'
 export { Physics, type PhysicsProps } from './components/physics'
 export { RigidBody, type RigidBodyProps } from './components/rigid-body'
 export * from './components/shape'
+export { CONTACT_STRIDE, ContactBuffer, ContactEventType, ContactField } from './contact-buffer'
 export { useJolt } from './context'
+export type { ContactFilter } from './types'
 export * from './hooks'
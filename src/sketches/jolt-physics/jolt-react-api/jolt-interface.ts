@@ -0,0 +1,41 @@
+import type Jolt from 'jolt-physics'
+import { Layer, NUM_OBJECT_LAYERS } from './constants'
+
+/**
+ * Creates a JoltInterface with the object and broadphase layers used by the react api
+ */
+export const createJoltInterface = (jolt: typeof Jolt) => {
+    /* setup collisions and broadphase */
+    const objectFilter = new jolt.ObjectLayerPairFilterTable(NUM_OBJECT_LAYERS)
+    objectFilter.EnableCollision(Layer.NON_MOVING, Layer.MOVING)
+    objectFilter.EnableCollision(Layer.MOVING, Layer.MOVING)
+
+    const BP_LAYER_NON_MOVING = new jolt.BroadPhaseLayer(0)
+    const BP_LAYER_MOVING = new jolt.BroadPhaseLayer(1)
+    const NUM_BROAD_PHASE_LAYERS = 2
+    const bpInterface = new jolt.BroadPhaseLayerInterfaceTable(NUM_OBJECT_LAYERS, NUM_BROAD_PHASE_LAYERS)
+    bpInterface.MapObjectToBroadPhaseLayer(Layer.NON_MOVING, BP_LAYER_NON_MOVING)
+    bpInterface.MapObjectToBroadPhaseLayer(Layer.MOVING, BP_LAYER_MOVING)
+
+    const settings = new jolt.JoltSettings()
+    settings.mObjectLayerPairFilter = objectFilter
+    settings.mBroadPhaseLayerInterface = bpInterface
+    settings.mObjectVsBroadPhaseLayerFilter = new jolt.ObjectVsBroadPhaseLayerFilterTable(
+        settings.mBroadPhaseLayerInterface,
+        NUM_BROAD_PHASE_LAYERS,
+        settings.mObjectLayerPairFilter,
+        NUM_OBJECT_LAYERS,
+    )
+
+    /* get interfaces */
+    const joltInterface = new jolt.JoltInterface(settings)
+    const physicsSystem = joltInterface.GetPhysicsSystem()
+    const bodyInterface = physicsSystem.GetBodyInterface()
+
+    /* cleanup */
+    jolt.destroy(settings)
+    jolt.destroy(BP_LAYER_NON_MOVING)
+    jolt.destroy(BP_LAYER_MOVING)
+
+    return { joltInterface, physicsSystem, bodyInterface }
+}
@@ -1,66 +1,69 @@
+import { traceEnd, traceStart } from '@/common/utils/tracing'
 import { System } from 'arancini/systems'
+import Jolt from 'jolt-physics'
+import { ContactBuffer, ContactEventType } from '../contact-buffer'
 import { JoltEntity } from '../ecs'
 import { Raw } from '../raw'
+import { BodyEvents } from '../types'
 import { PhysicsSystem } from './physics-system'
 
+type ContactSubscription = {
+    entity: JoltEntity
+    bodyEvents: BodyEvents
+    bodyId: number
+
+    /* batched contacts, if the body has an onContacts listener */
+    contacts: ContactBuffer | undefined
+    minImpulse: number
+    persisted: boolean
+    removed: boolean
+}
+
+const hasContactListeners = ({ onContacts, onContactAdded, onContactPersisted, onContactRemoved }: BodyEvents) =>
+    !!(onContacts || onContactAdded || onContactPersisted || onContactRemoved)
+
+/**
+ * Collects contacts for bodies with contact listeners.
+ *
+ * Contacts are filtered per body and written to a flat buffer per body, and `onContacts` listeners receive the buffer once per step.
+ * The contact listener is only set while a body has listeners, and contacts between bodies without listeners return before reading
+ * anything from Jolt.
+ */
 export class BodyContactSystem extends System<JoltEntity> {
     physics = this.attach(PhysicsSystem)!
 
+    contactEventsQuery = this.query((e) => e.has('body', 'bodyEvents'))
+
+    private subscriptionsByPointer = new Map<number, ContactSubscription>()
+    private subscriptionsById = new Map<number, ContactSubscription>()
+    private removedListenerCount = 0
+
+    private pendingDispatch: ContactSubscription[] = []
+
+    private contactListener!: Jolt.ContactListenerJS
+    private contactListenerSet = false
+
+    private unsubscribeAfterStep: (() => void) | undefined
+
     onInit(): void {
         const jolt = Raw.module
 
         /* contact events */
         const contactListener = new jolt.ContactListenerJS()
+        this.contactListener = contactListener
 
         contactListener.OnContactAdded = ((body1Ptr: number, body2Ptr: number, manifoldPtr: number, settingsPtr: number) => {
-            const body1 = jolt.wrapPointer(body1Ptr, jolt.Body)
-            const body2 = jolt.wrapPointer(body2Ptr, jolt.Body)
-            const manifold = jolt.wrapPointer(manifoldPtr, jolt.ContactManifold)
-            const settings = jolt.wrapPointer(settingsPtr, jolt.ContactSettings)
-
-            const body1Entity = this.physics.getBodyEntity(body1)
-            if (body1Entity?.bodyEvents?.onContactAdded) {
-                body1Entity.bodyEvents.onContactAdded(body1, body2, manifold, settings)
-            }
-
-            const body2Entity = this.physics.getBodyEntity(body2)
-            if (body2Entity?.bodyEvents?.onContactAdded) {
-                body2Entity.bodyEvents.onContactAdded(body1, body2, manifold, settings)
-            }
+            this.onContact(ContactEventType.ADDED, body1Ptr, body2Ptr, manifoldPtr, settingsPtr)
         }) as never
 
         contactListener.OnContactPersisted = ((body1Ptr: number, body2Ptr: number, manifoldPtr: number, settingsPtr: number) => {
-            const body1 = jolt.wrapPointer(body1Ptr, jolt.Body)
-            const body2 = jolt.wrapPointer(body2Ptr, jolt.Body)
-            const manifold = jolt.wrapPointer(manifoldPtr, jolt.ContactManifold)
-            const settings = jolt.wrapPointer(settingsPtr, jolt.ContactSettings)
-
-            const body1Entity = this.physics.getBodyEntity(body1)
-            if (body1Entity?.bodyEvents?.onContactPersisted) {
-                body1Entity.bodyEvents.onContactPersisted(body1, body2, manifold, settings)
-            }
-
-            const body2Entity = this.physics.getBodyEntity(body2)
-            if (body2Entity?.bodyEvents?.onContactPersisted) {
-                body2Entity.bodyEvents.onContactPersisted(body1, body2, manifold, settings)
-            }
+            this.onContact(ContactEventType.PERSISTED, body1Ptr, body2Ptr, manifoldPtr, settingsPtr)
         }) as never
 
         contactListener.OnContactRemoved = ((subShapePairPtr: number) => {
-            const subShapePair = jolt.wrapPointer(subShapePairPtr, jolt.SubShapeIDPair)
-
-            const body1 = this.physics.physicsSystem.GetBodyLockInterfaceNoLock().TryGetBody(subShapePair.GetBody1ID())
-            const body2 = this.physics.physicsSystem.GetBodyLockInterfaceNoLock().TryGetBody(subShapePair.GetBody2ID())
+            if (this.removedListenerCount === 0) return
 
-            const body1Entity = this.physics.getBodyEntity(body1)
-            if (body1Entity?.bodyEvents?.onContactRemoved) {
-                body1Entity.bodyEvents.onContactRemoved(subShapePair)
-            }
-
-            const body2Entity = this.physics.getBodyEntity(body2)
-            if (body2Entity?.bodyEvents?.onContactRemoved) {
-                body2Entity.bodyEvents.onContactRemoved(subShapePair)
-            }
+            this.onContactRemoved(subShapePairPtr)
         }) as never
 
         contactListener.OnContactValidate = ((
@@ -73,6 +76,270 @@ export class BodyContactSystem extends System<JoltEntity> {
             return jolt.ValidateResult_AcceptAllContactsForThisBodyPair
         }) as never
 
-        this.physics.physicsSystem.SetContactListener(contactListener)
+        /* subscriptions */
+        this.contactEventsQuery.onEntityAdded.add((entity) => {
+            if (!hasContactListeners(entity.bodyEvents)) return
+
+            this.subscribe(entity)
+        })
+
+        this.contactEventsQuery.onEntityRemoved.add((entity) => {
+            if (!entity.body) return
+
+            this.unsubscribe(entity.body)
+        })
+
+        this.unsubscribeAfterStep = this.physics.onAfterStep.add(() => this.dispatch())
+    }
+
+    onDestroy(): void {
+        this.unsubscribeAfterStep?.()
+        this.unsubscribeAfterStep = undefined
+
+        this.subscriptionsByPointer.clear()
+        this.subscriptionsById.clear()
+        this.removedListenerCount = 0
+        this.pendingDispatch.length = 0
+        this.contactListenerSet = false
+    }
+
+    /**
+     * Call after changing an entity's `bodyEvents` listeners or `contactFilter`, subscribes, updates or unsubscribes the body
+     */
+    updateSubscription(entity: JoltEntity) {
+        if (!entity.body || !entity.bodyEvents) return
+
+        const subscription = this.subscriptionsByPointer.get(Raw.module.getPointer(entity.body))
+
+        if (!hasContactListeners(entity.bodyEvents)) {
+            this.unsubscribe(entity.body)
+        } else if (subscription) {
+            this.configure(subscription)
+        } else {
+            this.subscribe(entity)
+        }
+    }
+
+    private subscribe(entity: JoltEntity) {
+        const body = entity.body!
+
+        const subscription: ContactSubscription = {
+            entity,
+            bodyEvents: entity.bodyEvents!,
+            bodyId: body.GetID().GetIndexAndSequenceNumber(),
+            contacts: undefined,
+            minImpulse: 0,
+            persisted: false,
+            removed: false,
+        }
+
+        this.subscriptionsByPointer.set(Raw.module.getPointer(body), subscription)
+        this.subscriptionsById.set(subscription.bodyId, subscription)
+
+        this.configure(subscription)
+
+        if (!this.contactListenerSet) {
+            this.physics.physicsSystem.SetContactListener(this.contactListener)
+            this.contactListenerSet = true
+        }
+    }
+
+    /**
+     * Reads the flags and filter of a subscription from its body events
+     */
+    private configure(subscription: ContactSubscription) {
+        const bodyEvents = subscription.bodyEvents
+        const filter = bodyEvents.contactFilter ?? {}
+
+        const removed = !!bodyEvents.onContactRemoved || (!!bodyEvents.onContacts && filter.removed !== false)
+
+        if (removed !== subscription.removed) this.removedListenerCount += removed ? 1 : -1
+
+        subscription.removed = removed
+        subscription.persisted = !!bodyEvents.onContactPersisted || (!!bodyEvents.onContacts && !!filter.persisted)
+        subscription.minImpulse = filter.minImpulse ?? 0
+
+        if (bodyEvents.onContacts && !subscription.contacts) {
+            subscription.contacts = new ContactBuffer()
+        } else if (!bodyEvents.onContacts && subscription.contacts) {
+            subscription.contacts = undefined
+
+            const pending = this.pendingDispatch.indexOf(subscription)
+            if (pending !== -1) this.pendingDispatch.splice(pending, 1)
+        }
+    }
+
+    private unsubscribe(body: Jolt.Body) {
+        const pointer = Raw.module.getPointer(body)
+        const subscription = this.subscriptionsByPointer.get(pointer)
+
+        if (!subscription) return
+
+        this.subscriptionsByPointer.delete(pointer)
+        this.subscriptionsById.delete(subscription.bodyId)
+
+        if (subscription.removed) this.removedListenerCount--
+
+        const pending = this.pendingDispatch.indexOf(subscription)
+        if (pending !== -1) this.pendingDispatch.splice(pending, 1)
+
+        // nobody is listening, stop calling into js for every contact
+        if (this.subscriptionsByPointer.size === 0 && this.contactListenerSet) {
+            this.physics.physicsSystem.SetContactListener(null as never)
+            this.contactListenerSet = false
+        }
+    }
+
+    private onContact(type: number, body1Ptr: number, body2Ptr: number, manifoldPtr: number, settingsPtr: number) {
+        let subscription1 = this.subscriptionsByPointer.get(body1Ptr)
+        let subscription2 = this.subscriptionsByPointer.get(body2Ptr)
+
+        if (type === ContactEventType.PERSISTED) {
+            if (subscription1 && !subscription1.persisted) subscription1 = undefined
+            if (subscription2 && !subscription2.persisted) subscription2 = undefined
+        }
+
+        if (!subscription1 && !subscription2) return
+
+        const jolt = Raw.module
+
+        const body1 = jolt.wrapPointer(body1Ptr, jolt.Body)
+        const body2 = jolt.wrapPointer(body2Ptr, jolt.Body)
+        const manifold = jolt.wrapPointer(manifoldPtr, jolt.ContactManifold)
+
+        /* immediate listeners */
+        const added = type === ContactEventType.ADDED
+        const handler1 = added ? subscription1?.bodyEvents.onContactAdded : subscription1?.bodyEvents.onContactPersisted
+        const handler2 = added ? subscription2?.bodyEvents.onContactAdded : subscription2?.bodyEvents.onContactPersisted
+
+        if (handler1 || handler2) {
+            const settings = jolt.wrapPointer(settingsPtr, jolt.ContactSettings)
+
+            handler1?.(body1, body2, manifold, settings)
+            handler2?.(body1, body2, manifold, settings)
+        }
+
+        if (!subscription1?.contacts && !subscription2?.contacts) return
+
+        /* contact */
+        const normal = manifold.mWorldSpaceNormal
+        const nx = normal.GetX()
+        const ny = normal.GetY()
+        const nz = normal.GetZ()
+
+        const point = manifold.GetWorldSpaceContactPointOn1(0)
+        const px = point.GetX()
+        const py = point.GetY()
+        const pz = point.GetZ()
+
+        const penetrationDepth = manifold.mPenetrationDepth
+
+        /* estimated impulse, callbacks run before the contact is solved */
+        // read each velocity before the next call, values are returned in a shared temporary
+        const velocity1 = body1.GetLinearVelocity()
+        const approach1 = velocity1.GetX() * nx + velocity1.GetY() * ny + velocity1.GetZ() * nz
+        const velocity2 = body2.GetLinearVelocity()
+        const approach2 = velocity2.GetX() * nx + velocity2.GetY() * ny + velocity2.GetZ() * nz
+
+        const inverseMass = getInverseMass(body1) + getInverseMass(body2)
+        const reducedMass = inverseMass > 0 ? 1 / inverseMass : 0
+        const impulse = Math.max(0, approach1 - approach2) * reducedMass
+
+        /* collect, with the normal pointing away from the listening body */
+        if (subscription1?.contacts && impulse >= subscription1.minImpulse) {
+            this.collect(subscription1, type, px, py, pz, nx, ny, nz, impulse, penetrationDepth, body2)
+        }
+
+        if (subscription2?.contacts && impulse >= subscription2.minImpulse) {
+            this.collect(subscription2, type, px, py, pz, -nx, -ny, -nz, impulse, penetrationDepth, body1)
+        }
+    }
+
+    private onContactRemoved(subShapePairPtr: number) {
+        const jolt = Raw.module
+
+        const subShapePair = jolt.wrapPointer(subShapePairPtr, jolt.SubShapeIDPair)
+
+        const body1Id = subShapePair.GetBody1ID().GetIndexAndSequenceNumber()
+        const body2Id = subShapePair.GetBody2ID().GetIndexAndSequenceNumber()
+
+        const subscription1 = this.subscriptionsById.get(body1Id)
+        const subscription2 = this.subscriptionsById.get(body2Id)
+
+        if (!subscription1?.removed && !subscription2?.removed) return
+
+        subscription1?.bodyEvents.onContactRemoved?.(subShapePair)
+        subscription2?.bodyEvents.onContactRemoved?.(subShapePair)
+
+        const bodyLockInterface = this.physics.physicsSystem.GetBodyLockInterfaceNoLock()
+
+        if (subscription1?.contacts && subscription1.removed) {
+            const other = bodyLockInterface.TryGetBody(subShapePair.GetBody2ID())
+            this.collectRemoved(subscription1, body2Id, this.physics.getBodyEntity(other))
+        }
+
+        if (subscription2?.contacts && subscription2.removed) {
+            const other = bodyLockInterface.TryGetBody(subShapePair.GetBody1ID())
+            this.collectRemoved(subscription2, body1Id, this.physics.getBodyEntity(other))
+        }
+    }
+
+    private collect(
+        subscription: ContactSubscription,
+        type: number,
+        px: number,
+        py: number,
+        pz: number,
+        nx: number,
+        ny: number,
+        nz: number,
+        impulse: number,
+        penetrationDepth: number,
+        other: Jolt.Body,
+    ) {
+        const contacts = subscription.contacts!
+
+        if (contacts.count === 0) this.pendingDispatch.push(subscription)
+
+        const otherId = other.GetID().GetIndexAndSequenceNumber()
+        const otherEntity = this.physics.getBodyEntity(other)
+
+        contacts.push(type, px, py, pz, nx, ny, nz, impulse, penetrationDepth, otherId, otherEntity)
+    }
+
+    private collectRemoved(subscription: ContactSubscription, otherId: number, otherEntity: JoltEntity | undefined) {
+        const contacts = subscription.contacts!
+
+        if (contacts.count === 0) this.pendingDispatch.push(subscription)
+
+        contacts.push(ContactEventType.REMOVED, 0, 0, 0, 0, 0, 0, 0, 0, otherId, otherEntity)
+    }
+
+    private dispatch() {
+        const pending = this.pendingDispatch
+
+        if (pending.length === 0) return
+
+        const start = traceStart()
+
+        this.pendingDispatch = []
+
+        for (const subscription of pending) {
+            // an earlier listener in this dispatch can remove onContacts
+            if (!subscription.contacts) continue
+
+            subscription.bodyEvents.onContacts?.(subscription.contacts)
+            subscription.contacts.clear()
+        }
+
+        // reuse the array if listeners didn't cause more contacts to be collected
+        if (this.pendingDispatch.length === 0) {
+            pending.length = 0
+            this.pendingDispatch = pending
+        }
+
+        traceEnd('jolt-contact-dispatch', start)
     }
 }
+
+const getInverseMass = (body: Jolt.Body) => (body.IsDynamic() ? body.GetMotionProperties().GetInverseMass() : 0)
@@ -8,6 +8,8 @@ export class ConstraintSystem extends System<JoltEntity> {
 
     constraintQuery = this.query((e) => e.has('constraint'))
 
+    workerConstraintQuery = this.query((e) => e.has('constraintDescription'))
+
     onInit(): void {
         this.constraintQuery.onEntityAdded.add((entity) => {
             const { constraint } = entity
@@ -21,5 +23,23 @@ export class ConstraintSystem extends System<JoltEntity> {
             this.physics.physicsSystem.RemoveConstraint(constraint)
             Jolt.destroy(constraint)
         })
+
+        /* constraints between worker bodies */
+        this.workerConstraintQuery.onEntityAdded.add((entity) => {
+            const { worker } = this.physics
+
+            if (!worker) return
+
+            entity.constraintHandle = worker.addConstraint(entity.constraintDescription)
+        })
+
+        this.workerConstraintQuery.onEntityRemoved.add((entity) => {
+            const { worker } = this.physics
+
+            if (!worker || entity.constraintHandle === undefined) return
+
+            worker.removeConstraint(entity.constraintHandle)
+            entity.constraintHandle = undefined
+        })
     }
 }
@@ -1,63 +1,18 @@
+import { traceEnd, traceStart } from '@/common/utils/tracing'
 import { invalidate } from '@react-three/fiber'
+import { Topic } from 'arancini/events'
 import { System } from 'arancini/systems'
 import Jolt from 'jolt-physics'
 import * as THREE from 'three'
-import { Layer, NUM_OBJECT_LAYERS } from '../constants'
+import { BodyStateStore } from '../body-state-store'
 import { JoltEntity } from '../ecs'
+import { createJoltInterface } from '../jolt-interface'
 import { Raw } from '../raw'
-import { _matrix4, _position, _quaternion, _rotation, _scale, _vector3 } from '../tmp'
-import { quat, vec3 } from '../utils'
+import { Vector3Tuple } from '../types'
+import { PhysicsWorkerClient } from '../worker/physics-worker-client'
+import { SNAPSHOT_BODY_STRIDE, SnapshotHeader } from '../worker/physics-worker-types'
 
-type BodyState = {
-    meshType: 'instancedMesh' | 'mesh'
-    body: Jolt.Body
-    object: THREE.Object3D
-    invertedWorldMatrix: THREE.Matrix4
-    setMatrix: (matrix: THREE.Matrix4) => void
-    getMatrix: (matrix: THREE.Matrix4) => THREE.Matrix4
-
-    /**
-     * Required for instanced bodies.
-     */
-    scale: THREE.Vector3
-    isSleeping: boolean
-}
-
-interface CreateBodyStateOptions {
-    object: THREE.Object3D
-    body: Jolt.Body
-    setMatrix?: (matrix: THREE.Matrix4) => void
-    getMatrix?: (matrix: THREE.Matrix4) => THREE.Matrix4
-    worldScale?: THREE.Vector3
-    meshType?: BodyState['meshType']
-}
-
-const createBodyState = ({
-    body,
-    object,
-    setMatrix,
-    getMatrix,
-    worldScale,
-    meshType = 'mesh',
-}: CreateBodyStateOptions): BodyState => {
-    object.updateWorldMatrix(true, false)
-    const invertedWorldMatrix = object.parent!.matrixWorld.clone().invert()
-
-    return {
-        object,
-        body,
-        invertedWorldMatrix,
-        setMatrix: setMatrix
-            ? setMatrix
-            : (matrix: THREE.Matrix4) => {
-                  object.matrix.copy(matrix)
-              },
-        getMatrix: getMatrix ? getMatrix : (matrix: THREE.Matrix4) => matrix.copy(object.matrix),
-        scale: worldScale || object.getWorldScale(_scale).clone(),
-        isSleeping: false,
-        meshType,
-    }
-}
+const WORKER_DEFAULT_TIME_STEP = 1 / 60
 
 export class PhysicsSystem extends System<JoltEntity> {
     joltInterface!: Jolt.JoltInterface
@@ -70,60 +25,47 @@ export class PhysicsSystem extends System<JoltEntity> {
 
     bodyWithThreeQuery = this.query((e) => e.has('body', 'three'))
 
+    workerBodyQuery = this.query((e) => e.has('bodyDescription', 'three'))
+
     worldEvents = this.query((e) => e.has('worldEvents'))
 
     physicsConfig = this.singleton('physicsConfig', { required: true })!
 
-    private steppingState: {
-        accumulator: number
-        previousState: Map<
-            Jolt.Body,
-            {
-                position: THREE.Vector3
-                quaternion: THREE.Quaternion
-            }
-        >
-    } = {
+    /**
+     * Emitted after each local step, before `afterStep` world events
+     */
+    onAfterStep = new Topic<[]>()
+
+    private steppingState = {
         accumulator: 0,
-        previousState: new Map(),
     }
 
-    private bodyStates = new Map<Jolt.Body, BodyState>()
+    /**
+     * Previous and current body transforms by body slot
+     */
+    bodyStates = new BodyStateStore()
+
+    /**
+     * Set by `startWorker`, bodies with a `bodyDescription` are simulated in the worker
+     */
+    worker: PhysicsWorkerClient | undefined
+
+    private workerMaxBodies: number | undefined
+
+    private lastSnapshotTime = 0
 
     onInit(): void {
         const jolt = Raw.module
 
-        /* setup collisions and broadphase */
-        const objectFilter = new jolt.ObjectLayerPairFilterTable(NUM_OBJECT_LAYERS)
-        objectFilter.EnableCollision(Layer.NON_MOVING, Layer.MOVING)
-        objectFilter.EnableCollision(Layer.MOVING, Layer.MOVING)
-
-        const BP_LAYER_NON_MOVING = new jolt.BroadPhaseLayer(0)
-        const BP_LAYER_MOVING = new jolt.BroadPhaseLayer(1)
-        const NUM_BROAD_PHASE_LAYERS = 2
-        const bpInterface = new jolt.BroadPhaseLayerInterfaceTable(NUM_OBJECT_LAYERS, NUM_BROAD_PHASE_LAYERS)
-        bpInterface.MapObjectToBroadPhaseLayer(Layer.NON_MOVING, BP_LAYER_NON_MOVING)
-        bpInterface.MapObjectToBroadPhaseLayer(Layer.MOVING, BP_LAYER_MOVING)
-
-        const settings = new jolt.JoltSettings()
-        settings.mObjectLayerPairFilter = objectFilter
-        settings.mBroadPhaseLayerInterface = bpInterface
-        settings.mObjectVsBroadPhaseLayerFilter = new jolt.ObjectVsBroadPhaseLayerFilterTable(
-            settings.mBroadPhaseLayerInterface,
-            NUM_BROAD_PHASE_LAYERS,
-            settings.mObjectLayerPairFilter,
-            NUM_OBJECT_LAYERS,
-        )
-
-        /* get interfaces */
-        this.joltInterface = new jolt.JoltInterface(settings)
-        this.physicsSystem = this.joltInterface.GetPhysicsSystem()
-        this.bodyInterface = this.physicsSystem.GetBodyInterface()
-
-        /* cleanup */
-        jolt.destroy(settings)
-        jolt.destroy(BP_LAYER_NON_MOVING)
-        jolt.destroy(BP_LAYER_MOVING)
+        const { joltInterface, physicsSystem, bodyInterface } = createJoltInterface(jolt)
+        this.joltInterface = joltInterface
+        this.physicsSystem = physicsSystem
+        this.bodyInterface = bodyInterface
+
+        // restart the worker if the system is re-initialised
+        if (this.workerMaxBodies !== undefined && !this.worker) {
+            this.worker = new PhysicsWorkerClient(this.workerMaxBodies)
+        }
 
         /* body entity events */
         this.bodyQuery.onEntityAdded.add((entity) => {
@@ -133,23 +75,79 @@ export class PhysicsSystem extends System<JoltEntity> {
 
             // store entity on body for easy lookup
             ;(body as any)._arancini_entity = entity
+
+            if (entity.three) {
+                this.bodyStates.add(body, entity.three, entity.instance)
+            }
         })
 
         this.bodyQuery.onEntityRemoved.add(({ body }) => {
             if (!body) return
 
-            this.bodyStates.delete(body)
+            this.bodyStates.remove(body)
             this.bodyInterface.RemoveBody(body.GetID())
             // todo: calling DestroyBody throws `Uncaught RuntimeError: memory access out of bounds`
             // this.bodyInterface.DestroyBody(body.GetID())
         })
+
+        /* worker body entity events */
+        this.workerBodyQuery.onEntityAdded.add((entity) => {
+            if (!this.worker) {
+                console.warn('PhysicsSystem: entity has a bodyDescription, but the physics worker has not been started')
+                return
+            }
+
+            const { bodyDescription, three, instance } = entity
+
+            const handle = this.worker.createBody(bodyDescription)
+            entity.bodyHandle = handle
+
+            this.bodyStates.add(handle, three, instance, bodyDescription)
+        })
+
+        this.workerBodyQuery.onEntityRemoved.add((entity) => {
+            if (!this.worker || entity.bodyHandle === undefined) return
+
+            this.bodyStates.remove(entity.bodyHandle)
+            this.worker.removeBody(entity.bodyHandle)
+
+            entity.bodyHandle = undefined
+        })
     }
 
     onDestroy(): void {
+        this.worker?.terminate()
+        this.worker = undefined
+
         Raw.module.destroy(this.joltInterface)
     }
 
+    /**
+     * Simulates bodies with a `bodyDescription` in a worker. Must be called before they are added.
+     */
+    startWorker(maxBodies: number) {
+        if (this.worker) return this.worker
+
+        this.workerMaxBodies = maxBodies
+        this.worker = new PhysicsWorkerClient(maxBodies)
+
+        return this.worker
+    }
+
+    setGravity(gravity: Vector3Tuple) {
+        const gravityVec = new Raw.module.Vec3(...gravity)
+        this.physicsSystem.SetGravity(gravityVec)
+        Raw.module.destroy(gravityVec)
+
+        this.worker?.setGravity(gravity)
+    }
+
     onUpdate(delta: number): void {
+        if (this.worker) {
+            this.workerUpdate()
+            return
+        }
+
         if (this.physicsConfig.paused) return
 
         const timeStep = this.physicsConfig.timeStep
@@ -164,66 +162,36 @@ export class PhysicsSystem extends System<JoltEntity> {
 
         const interpolationAlpha = timeStepVariable || !interpolate ? 1 : this.steppingState.accumulator / timeStep
 
-        for (const entity of this.bodyQuery) {
-            const body = entity.body
+        // one pass over all bodies, sleeping bodies are skipped once written at rest
+        this.bodyStates.write(interpolationAlpha)
 
-            let state = this.bodyStates.get(body)
+        // todo: consider sleeping
+        invalidate()
+    }
 
-            if (!state) {
-                state = createBodyState({
-                    body: body,
-                    object: entity.three!,
-                })
-                this.bodyStates.set(body, state)
-            }
+    private workerUpdate(): void {
+        const worker = this.worker!
+        const { paused, interpolate } = this.physicsConfig
 
-            // todo: sleep / wake events
+        const timeStep = this.physicsConfig.timeStep === 'vary' ? WORKER_DEFAULT_TIME_STEP : this.physicsConfig.timeStep
 
-            // todo: early exit if sleeping
+        worker.flush(timeStep, paused)
 
-            // Get new position and rotation
-            const pos = body.GetPosition()
-            const rot = body.GetRotation()
+        const now = performance.now()
 
-            if (interpolate) {
-                const previousState = this.steppingState.previousState.get(body)
-
-                if (previousState) {
-                    // Get previous simulated world position
-                    _matrix4
-                        .compose(previousState.position, previousState.quaternion, state.scale)
-                        .premultiply(state.invertedWorldMatrix)
-                        .decompose(_position, _rotation, _scale)
-
-                    // Apply previous tick position
-                    if (state.meshType == 'mesh') {
-                        state.object.position.copy(_position)
-                        state.object.quaternion.copy(_rotation)
-                    }
-                }
-            }
+        if (worker.acquireSnapshot()) {
+            this.bodyStates.storePrevious()
+            this.bodyStates.readSnapshot(worker.snapshot.current, SnapshotHeader.LENGTH, SNAPSHOT_BODY_STRIDE)
 
-            // Get new position
-            _matrix4
-                .compose(vec3.joltToThree(pos, _vector3), quat.joltToThree(rot, _quaternion), state.scale)
-                .premultiply(state.invertedWorldMatrix)
-                .decompose(_position, _rotation, _scale)
-
-            if (state.meshType == 'instancedMesh') {
-                state.setMatrix(_matrix4)
-            } else {
-                if (interpolate) {
-                    state.object.position.lerp(_position, interpolationAlpha)
-                    state.object.quaternion.slerp(_rotation, interpolationAlpha)
-                } else {
-                    state.object.position.copy(_position)
-                    state.object.quaternion.copy(_rotation)
-                }
-            }
+            this.lastSnapshotTime = now
         }
 
-        // todo: consider sleeping
-        invalidate()
+        // snapshots arrive on the worker's clock, interpolate by the time since the latest one arrived
+        const interpolationAlpha = interpolate ? Math.min((now - this.lastSnapshotTime) / (timeStep * 1000), 1) : 1
+
+        this.bodyStates.write(interpolationAlpha)
+
+        if (!paused) invalidate()
     }
 
     private variableStep(delta: number): void {
@@ -244,7 +212,13 @@ export class PhysicsSystem extends System<JoltEntity> {
             }
         }
 
+        const start = traceStart()
         this.joltInterface.Step(delta, steps)
+        traceEnd('jolt-step', start)
+
+        this.bodyStates.readAwake()
+
+        this.onAfterStep.emit()
 
         for (const entity of this.worldEvents) {
             if (entity.worldEvents.afterStep) {
@@ -262,22 +236,7 @@ export class PhysicsSystem extends System<JoltEntity> {
             // Set up previous state
             // needed for accurate interpolations if the world steps more than once
             if (interpolate) {
-                this.steppingState.previousState = new Map()
-
-                for (const { body } of this.bodyQuery) {
-                    let previousState = this.steppingState.previousState.get(body)
-
-                    if (!previousState) {
-                        previousState = {
-                            position: new THREE.Vector3(),
-                            quaternion: new THREE.Quaternion(),
-                        }
-                        this.steppingState.previousState.set(body, previousState)
-                    }
-
-                    vec3.joltToThree(body.GetPosition(), previousState.position)
-                    quat.joltToThree(body.GetRotation(), previousState.quaternion)
-                }
+                this.bodyStates.storePrevious()
             }
 
             this.stepWorld(timeStep, 1)
@@ -2,6 +2,7 @@ import Jolt from 'jolt-physics'
 import { BufferGeometry, Mesh, Object3D, Vector3 } from 'three'
 import { Raw } from './raw'
 import { vec3 } from './utils'
+import type { ShapeDescription } from './worker/physics-worker-types'
 
 export type AutoRigidBodyShape = 'box' | 'sphere' | false
 
@@ -83,3 +84,50 @@ export const getShapeSettingsFromGeometry = (
 
     return undefined
 }
+
+/**
+ * Describes shapes for an object without creating them, e.g. for bodies created in a physics worker
+ */
+export const getShapeDescriptionsFromObject = (object: Object3D, colliders: AutoRigidBodyShape) => {
+    const shapes: ShapeDescription[] = []
+
+    object.traverse((child) => {
+        const geometry = (child as Mesh)?.geometry
+
+        if (geometry) {
+            const shape = getShapeDescriptionFromGeometry(geometry, colliders)
+
+            if (shape) {
+                shapes.push(shape)
+            }
+        }
+    })
+
+    return shapes
+}
+
+export const getShapeDescriptionFromGeometry = (
+    geometry: BufferGeometry,
+    shape: AutoRigidBodyShape,
+): ShapeDescription | undefined => {
+    switch (shape) {
+        case 'box': {
+            geometry.computeBoundingBox()
+            const { boundingBox } = geometry
+
+            const size = boundingBox!.getSize(new Vector3())
+            const center = boundingBox!.getCenter(new Vector3())
+
+            return { type: 'box', halfExtents: [size.x / 2, size.y / 2, size.z / 2], offset: center.toArray() }
+        }
+
+        case 'sphere': {
+            geometry.computeBoundingSphere()
+            const { boundingSphere } = geometry
+
+            return { type: 'sphere', radius: boundingSphere!.radius, offset: boundingSphere!.center.toArray() }
+        }
+    }
+
+    return undefined
+}
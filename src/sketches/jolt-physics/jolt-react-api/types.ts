@@ -1,4 +1,5 @@
 import Jolt from 'jolt-physics'
+import type { ContactBuffer } from './contact-buffer'
 
 export type Vector3Tuple = [number, number, number]
 export type Vector4Tuple = [number, number, number, number]
@@ -23,6 +24,31 @@ export type BodyEvents = {
         contactSettings: Jolt.ContactSettings,
     ) => void
     onContactRemoved?: (subShapePair: Jolt.SubShapeIDPair) => void
+
+    /**
+     * Called once per physics step with the body's contacts from that step, if it had any that pass `contactFilter`
+     */
+    onContacts?: (contacts: ContactBuffer) => void
+    contactFilter?: ContactFilter
+}
+
+export type ContactFilter = {
+    /**
+     * Contacts with a lower estimated impulse are not collected
+     * @defaultValue 0
+     */
+    minImpulse?: number
+
+    /**
+     * Collect contacts that persist from the previous step, there can be many in resting stacks
+     * @defaultValue false
+     */
+    persisted?: boolean
+
+    /**
+     * @defaultValue true
+     */
+    removed?: boolean
 }
 
 export type WorldEvents = {
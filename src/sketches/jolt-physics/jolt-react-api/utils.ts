@@ -1,5 +1,6 @@
 import Jolt from 'jolt-physics'
 import * as THREE from 'three'
+import { Layer } from './constants'
 import { Raw } from './raw'
 import { Vector3Tuple } from './types'
 
@@ -16,3 +17,26 @@ export const quat = {
     joltToThree: (quat: Jolt.Quat, out = new THREE.Quaternion()) => out.set(quat.GetX(), quat.GetY(), quat.GetZ(), quat.GetW()),
     joltToTuple: (quat: Jolt.Quat) => [quat.GetX(), quat.GetY(), quat.GetZ(), quat.GetW()]
 }
+
+export const getBodyMotionType = (type: 'dynamic' | 'kinematic' | 'static' | undefined) => {
+    const jolt = Raw.module
+
+    let motionType: number
+    switch (type) {
+        case 'dynamic':
+            motionType = jolt.EMotionType_Dynamic
+            break
+        case 'kinematic':
+            motionType = jolt.EMotionType_Kinematic
+            break
+        case 'static':
+            motionType = jolt.EMotionType_Static
+            break
+        default:
+            motionType = jolt.EMotionType_Dynamic
+    }
+
+    const layer = type === 'static' ? Layer.NON_MOVING : Layer.MOVING
+
+    return { motionType, layer }
+}
@@ -0,0 +1,141 @@
+import { getTraceBuffer } from '@/common/utils/tracing'
+import { Vector3Tuple, Vector4Tuple } from '../types'
+import PhysicsWorker from './physics.worker?worker'
+import {
+    BodyDescription,
+    ConstraintDescription,
+    PhysicsCommand,
+    PhysicsCommandType,
+    PhysicsWorkerCommandsMessage,
+    PhysicsWorkerInitMessage,
+    PhysicsWorkerMessageType,
+    getSnapshotLength,
+} from './physics-worker-types'
+import { TripleBuffer } from './triple-buffer'
+
+/**
+ * Main thread side of a physics world stepped in a worker.
+ *
+ * Commands are queued and posted in one message per frame on `flush`. The worker steps on its own fixed timestep
+ * and publishes body transforms to a shared triple buffer, read with `acquireSnapshot` without waiting on the worker.
+ */
+export class PhysicsWorkerClient {
+    snapshot: TripleBuffer
+
+    maxBodies: number
+
+    private worker: InstanceType<typeof PhysicsWorker>
+
+    private commands: PhysicsCommand[] = []
+
+    private freeBodyHandles: number[] = []
+    private nextBodyHandle = 0
+    private nextConstraintHandle = 0
+
+    constructor(maxBodies: number) {
+        this.maxBodies = maxBodies
+
+        const { data, control } = TripleBuffer.create(getSnapshotLength(maxBodies))
+        this.snapshot = new TripleBuffer(data, control, 'reader')
+
+        this.worker = new PhysicsWorker()
+
+        const message: PhysicsWorkerInitMessage = {
+            type: PhysicsWorkerMessageType.INIT,
+            maxBodies,
+            snapshot: data,
+            snapshotControl: control,
+            traceBuffer: getTraceBuffer()?.buffer ?? null,
+        }
+
+        this.worker.postMessage(message)
+    }
+
+    /**
+     * @returns a handle for the body, its index in snapshots
+     */
+    createBody(body: BodyDescription) {
+        const handle = this.freeBodyHandles.pop() ?? this.nextBodyHandle++
+
+        if (handle >= this.maxBodies) {
+            throw new Error(`PhysicsWorkerClient: more than ${this.maxBodies} bodies`)
+        }
+
+        this.commands.push({ type: PhysicsCommandType.CREATE_BODY, handle, body })
+
+        return handle
+    }
+
+    removeBody(handle: number) {
+        this.commands.push({ type: PhysicsCommandType.REMOVE_BODY, handle })
+        this.freeBodyHandles.push(handle)
+    }
+
+    setPosition(handle: number, position: Vector3Tuple, activate = true) {
+        this.commands.push({ type: PhysicsCommandType.SET_POSITION, handle, position, activate })
+    }
+
+    setRotation(handle: number, quaternion: Vector4Tuple, activate = true) {
+        this.commands.push({ type: PhysicsCommandType.SET_ROTATION, handle, quaternion, activate })
+    }
+
+    setLinearVelocity(handle: number, velocity: Vector3Tuple) {
+        this.commands.push({ type: PhysicsCommandType.SET_LINEAR_VELOCITY, handle, velocity })
+    }
+
+    setAngularVelocity(handle: number, velocity: Vector3Tuple) {
+        this.commands.push({ type: PhysicsCommandType.SET_ANGULAR_VELOCITY, handle, velocity })
+    }
+
+    addImpulse(handle: number, impulse: Vector3Tuple) {
+        this.commands.push({ type: PhysicsCommandType.ADD_IMPULSE, handle, impulse })
+    }
+
+    /**
+     * @returns a handle for the constraint
+     */
+    addConstraint(constraint: ConstraintDescription) {
+        const handle = this.nextConstraintHandle++
+
+        this.commands.push({ type: PhysicsCommandType.ADD_CONSTRAINT, handle, constraint })
+
+        return handle
+    }
+
+    removeConstraint(handle: number) {
+        this.commands.push({ type: PhysicsCommandType.REMOVE_CONSTRAINT, handle })
+    }
+
+    setGravity(gravity: Vector3Tuple) {
+        this.commands.push({ type: PhysicsCommandType.SET_GRAVITY, gravity })
+    }
+
+    /**
+     * Posts commands queued since the last flush. Call once per frame.
+     */
+    flush(timeStep: number, paused: boolean) {
+        const message: PhysicsWorkerCommandsMessage = {
+            type: PhysicsWorkerMessageType.COMMANDS,
+            commands: this.commands,
+            timeStep,
+            paused,
+        }
+
+        this.worker.postMessage(message)
+
+        this.commands = []
+    }
+
+    /**
+     * Takes the latest snapshot if the worker has published one since the last call
+     *
+     * @returns whether `snapshot.current` changed
+     */
+    acquireSnapshot() {
+        return this.snapshot.acquire()
+    }
+
+    terminate() {
+        this.worker.terminate()
+    }
+}
@@ -0,0 +1,104 @@
+import { Vector3Tuple, Vector4Tuple } from '../types'
+
+export const PhysicsWorkerMessageType = {
+    INIT: 0,
+    COMMANDS: 1,
+} as const
+
+export const PhysicsCommandType = {
+    CREATE_BODY: 0,
+    REMOVE_BODY: 1,
+    SET_POSITION: 2,
+    SET_ROTATION: 3,
+    SET_LINEAR_VELOCITY: 4,
+    SET_ANGULAR_VELOCITY: 5,
+    ADD_IMPULSE: 6,
+    ADD_CONSTRAINT: 7,
+    REMOVE_CONSTRAINT: 8,
+    SET_GRAVITY: 9,
+} as const
+
+export type ShapeDescription =
+    | { type: 'box'; halfExtents: Vector3Tuple; offset?: Vector3Tuple }
+    | { type: 'sphere'; radius: number; offset?: Vector3Tuple }
+
+export type BodyDescription = {
+    shapes: ShapeDescription[]
+    position: Vector3Tuple
+    quaternion: Vector4Tuple
+    motionType: 'dynamic' | 'kinematic' | 'static'
+}
+
+/**
+ * Constraints between two bodies, with points in world space
+ */
+export type ConstraintDescription =
+    | { type: 'fixed'; body1: number; body2: number }
+    | { type: 'point'; body1: number; body2: number; point1: Vector3Tuple; point2: Vector3Tuple }
+    | {
+          type: 'distance'
+          body1: number
+          body2: number
+          point1: Vector3Tuple
+          point2: Vector3Tuple
+          minDistance?: number
+          maxDistance?: number
+      }
+
+export type PhysicsCommand =
+    | { type: typeof PhysicsCommandType.CREATE_BODY; handle: number; body: BodyDescription }
+    | { type: typeof PhysicsCommandType.REMOVE_BODY; handle: number }
+    | { type: typeof PhysicsCommandType.SET_POSITION; handle: number; position: Vector3Tuple; activate: boolean }
+    | { type: typeof PhysicsCommandType.SET_ROTATION; handle: number; quaternion: Vector4Tuple; activate: boolean }
+    | { type: typeof PhysicsCommandType.SET_LINEAR_VELOCITY; handle: number; velocity: Vector3Tuple }
+    | { type: typeof PhysicsCommandType.SET_ANGULAR_VELOCITY; handle: number; velocity: Vector3Tuple }
+    | { type: typeof PhysicsCommandType.ADD_IMPULSE; handle: number; impulse: Vector3Tuple }
+    | { type: typeof PhysicsCommandType.ADD_CONSTRAINT; handle: number; constraint: ConstraintDescription }
+    | { type: typeof PhysicsCommandType.REMOVE_CONSTRAINT; handle: number }
+    | { type: typeof PhysicsCommandType.SET_GRAVITY; gravity: Vector3Tuple }
+
+export type PhysicsWorkerInitMessage = {
+    type: typeof PhysicsWorkerMessageType.INIT
+    maxBodies: number
+
+    /**
+     * Triple buffered transform snapshots, see `TripleBuffer`
+     */
+    snapshot: SharedArrayBuffer
+    snapshotControl: SharedArrayBuffer
+
+    /**
+     * See `getTraceBuffer`, null when tracing is off
+     */
+    traceBuffer: SharedArrayBuffer | null
+}
+
+/**
+ * Commands queued during a frame, applied in order before the next step
+ */
+export type PhysicsWorkerCommandsMessage = {
+    type: typeof PhysicsWorkerMessageType.COMMANDS
+    commands: PhysicsCommand[]
+    timeStep: number
+    paused: boolean
+}
+
+export type PhysicsWorkerMessage = PhysicsWorkerInitMessage | PhysicsWorkerCommandsMessage
+
+/**
+ * Floats per body in a snapshot: position xyz, quaternion xyzw, 1 if active
+ */
+export const SNAPSHOT_BODY_STRIDE = 8
+
+/**
+ * Floats at the start of each snapshot buffer
+ */
+export const SnapshotHeader = {
+    /* simulated seconds */
+    TIME: 0,
+    /* milliseconds spent stepping for this snapshot */
+    STEP_MS: 1,
+    LENGTH: 2,
+} as const
+
+export const getSnapshotLength = (maxBodies: number) => SnapshotHeader.LENGTH + maxBodies * SNAPSHOT_BODY_STRIDE
@@ -0,0 +1,355 @@
+import { connectTracing, traceEnd, traceStart } from '@/common/utils/tracing'
+import type Jolt from 'jolt-physics'
+import { createJoltInterface } from '../jolt-interface'
+import { Raw, initJolt } from '../raw'
+import { getBodyMotionType } from '../utils'
+import {
+    BodyDescription,
+    ConstraintDescription,
+    PhysicsCommand,
+    PhysicsCommandType,
+    PhysicsWorkerInitMessage,
+    PhysicsWorkerMessage,
+    PhysicsWorkerMessageType,
+    SNAPSHOT_BODY_STRIDE,
+    SnapshotHeader,
+} from './physics-worker-types'
+import { TripleBuffer } from './triple-buffer'
+
+const DEFAULT_TIME_STEP = 1 / 60
+const MAX_DELTA = 0.25
+const MAX_STEPS_PER_TICK = 4
+
+let joltInterface: Jolt.JoltInterface
+let physicsSystem: Jolt.PhysicsSystem
+let bodyInterface: Jolt.BodyInterface
+
+let snapshot: TripleBuffer
+
+const bodies: (Jolt.Body | undefined)[] = []
+const constraints = new Map<number, Jolt.Constraint>()
+
+// a bit per snapshot buffer index that already holds the body's transform at rest, sleeping bodies skip those buffers
+let restBuffers: Uint8Array
+
+let timeStep = DEFAULT_TIME_STEP
+let paused = false
+
+let accumulator = 0
+let simulatedTime = 0
+let lastTick = 0
+
+let ready = false
+const inbox: PhysicsWorkerMessage[] = []
+
+const init = async ({ maxBodies, snapshot: data, snapshotControl, traceBuffer }: PhysicsWorkerInitMessage) => {
+    connectTracing(traceBuffer, 'jolt-physics-worker')
+
+    await initJolt()
+
+    const jolt = Raw.module
+
+    const physics = createJoltInterface(jolt)
+    joltInterface = physics.joltInterface
+    physicsSystem = physics.physicsSystem
+    bodyInterface = physics.bodyInterface
+
+    const gravity = new jolt.Vec3(0, -9.81, 0)
+    physicsSystem.SetGravity(gravity)
+    jolt.destroy(gravity)
+
+    snapshot = new TripleBuffer(data, snapshotControl, 'writer')
+    restBuffers = new Uint8Array(maxBodies)
+
+    ready = true
+
+    for (const message of inbox) {
+        onMessage(message)
+    }
+
+    inbox.length = 0
+
+    lastTick = performance.now()
+    tick()
+}
+
+const createBody = (handle: number, { shapes, position, quaternion, motionType }: BodyDescription) => {
+    const jolt = Raw.module
+
+    const compoundShapeSettings = new jolt.StaticCompoundShapeSettings()
+    const shapeQuaternion = new jolt.Quat(0, 0, 0, 1)
+
+    for (const shape of shapes) {
+        let shapeSettings: Jolt.ShapeSettings
+
+        if (shape.type === 'box') {
+            const halfExtents = new jolt.Vec3(...shape.halfExtents)
+            shapeSettings = new jolt.BoxShapeSettings(halfExtents)
+            jolt.destroy(halfExtents)
+        } else {
+            shapeSettings = new jolt.SphereShapeSettings(shape.radius)
+        }
+
+        const offset = new jolt.Vec3(...(shape.offset ?? [0, 0, 0]))
+        compoundShapeSettings.AddShape(offset, shapeQuaternion, shapeSettings, 0)
+        jolt.destroy(offset)
+    }
+
+    const { motionType: bodyMotionType, layer: bodyLayer } = getBodyMotionType(motionType)
+
+    const bodyPosition = new jolt.RVec3(...position)
+    const bodyQuaternion = new jolt.Quat(...quaternion)
+
+    const bodyCreationSettings = new jolt.BodyCreationSettings(
+        compoundShapeSettings.Create().Get(),
+        bodyPosition,
+        bodyQuaternion,
+        bodyMotionType,
+        bodyLayer,
+    )
+
+    const body = bodyInterface.CreateBody(bodyCreationSettings)
+    bodyInterface.AddBody(body.GetID(), jolt.EActivation_Activate)
+
+    jolt.destroy(compoundShapeSettings)
+    jolt.destroy(shapeQuaternion)
+    jolt.destroy(bodyPosition)
+    jolt.destroy(bodyQuaternion)
+    jolt.destroy(bodyCreationSettings)
+
+    bodies[handle] = body
+    restBuffers[handle] = 0
+}
+
+const createConstraint = (description: ConstraintDescription) => {
+    const jolt = Raw.module
+
+    const body1 = bodies[description.body1]
+    const body2 = bodies[description.body2]
+
+    if (!body1 || !body2) return undefined
+
+    let settings: Jolt.TwoBodyConstraintSettings
+
+    if (description.type === 'fixed') {
+        const fixed = new jolt.FixedConstraintSettings()
+        fixed.mAutoDetectPoint = true
+        settings = fixed
+    } else if (description.type === 'point') {
+        const point = new jolt.PointConstraintSettings()
+        point.mPoint1 = new jolt.RVec3(...description.point1)
+        point.mPoint2 = new jolt.RVec3(...description.point2)
+        settings = point
+    } else {
+        const distance = new jolt.DistanceConstraintSettings()
+        distance.mPoint1 = new jolt.RVec3(...description.point1)
+        distance.mPoint2 = new jolt.RVec3(...description.point2)
+        if (description.minDistance !== undefined) distance.mMinDistance = description.minDistance
+        if (description.maxDistance !== undefined) distance.mMaxDistance = description.maxDistance
+        settings = distance
+    }
+
+    const constraint = settings.Create(body1, body2)
+
+    jolt.destroy(settings)
+
+    return constraint
+}
+
+const applyCommand = (command: PhysicsCommand) => {
+    const jolt = Raw.module
+
+    if (command.type === PhysicsCommandType.CREATE_BODY) {
+        createBody(command.handle, command.body)
+        return
+    }
+
+    if (command.type === PhysicsCommandType.ADD_CONSTRAINT) {
+        const constraint = createConstraint(command.constraint)
+
+        if (!constraint) return
+
+        physicsSystem.AddConstraint(constraint)
+        constraints.set(command.handle, constraint)
+        return
+    }
+
+    if (command.type === PhysicsCommandType.REMOVE_CONSTRAINT) {
+        const constraint = constraints.get(command.handle)
+
+        if (!constraint) return
+
+        physicsSystem.RemoveConstraint(constraint)
+        jolt.destroy(constraint)
+        constraints.delete(command.handle)
+        return
+    }
+
+    if (command.type === PhysicsCommandType.SET_GRAVITY) {
+        const gravity = new jolt.Vec3(...command.gravity)
+        physicsSystem.SetGravity(gravity)
+        jolt.destroy(gravity)
+        return
+    }
+
+    const body = bodies[command.handle]
+
+    if (!body) return
+
+    const id = body.GetID()
+
+    switch (command.type) {
+        case PhysicsCommandType.REMOVE_BODY: {
+            bodyInterface.RemoveBody(id)
+            // todo: calling DestroyBody throws `Uncaught RuntimeError: memory access out of bounds`
+            bodies[command.handle] = undefined
+
+            // clear the rest bits, so every buffer is written with the handle missing before it is skipped again
+            restBuffers[command.handle] = 0
+            break
+        }
+
+        case PhysicsCommandType.SET_POSITION: {
+            const position = new jolt.RVec3(...command.position)
+            bodyInterface.SetPosition(id, position, command.activate ? jolt.EActivation_Activate : jolt.EActivation_DontActivate)
+            jolt.destroy(position)
+            restBuffers[command.handle] = 0
+            break
+        }
+
+        case PhysicsCommandType.SET_ROTATION: {
+            const quaternion = new jolt.Quat(...command.quaternion)
+            bodyInterface.SetRotation(id, quaternion, command.activate ? jolt.EActivation_Activate : jolt.EActivation_DontActivate)
+            jolt.destroy(quaternion)
+            restBuffers[command.handle] = 0
+            break
+        }
+
+        case PhysicsCommandType.SET_LINEAR_VELOCITY: {
+            const velocity = new jolt.Vec3(...command.velocity)
+            bodyInterface.SetLinearVelocity(id, velocity)
+            jolt.destroy(velocity)
+            break
+        }
+
+        case PhysicsCommandType.SET_ANGULAR_VELOCITY: {
+            const velocity = new jolt.Vec3(...command.velocity)
+            bodyInterface.SetAngularVelocity(id, velocity)
+            jolt.destroy(velocity)
+            break
+        }
+
+        case PhysicsCommandType.ADD_IMPULSE: {
+            const impulse = new jolt.Vec3(...command.impulse)
+            bodyInterface.AddImpulse(id, impulse)
+            jolt.destroy(impulse)
+            break
+        }
+    }
+}
+
+const writeSnapshot = (stepMs: number) => {
+    const buffer = snapshot.current
+
+    // the reader can hold a buffer across several publishes, so rest state is tracked per buffer rather than counted
+    const bufferBit = 1 << snapshot.currentIndex
+
+    buffer[SnapshotHeader.TIME] = simulatedTime
+    buffer[SnapshotHeader.STEP_MS] = stepMs
+
+    for (let handle = 0; handle < bodies.length; handle++) {
+        const body = bodies[handle]
+        const offset = SnapshotHeader.LENGTH + handle * SNAPSHOT_BODY_STRIDE
+
+        if (!body) {
+            if ((restBuffers[handle] & bufferBit) === 0) {
+                buffer[offset + 7] = 0
+                restBuffers[handle] |= bufferBit
+            }
+
+            continue
+        }
+
+        const active = body.IsActive()
+
+        if (active) {
+            restBuffers[handle] = 0
+        } else if ((restBuffers[handle] & bufferBit) !== 0) {
+            continue
+        } else {
+            restBuffers[handle] |= bufferBit
+        }
+
+        const position = body.GetPosition()
+        const quaternion = body.GetRotation()
+
+        buffer[offset] = position.GetX()
+        buffer[offset + 1] = position.GetY()
+        buffer[offset + 2] = position.GetZ()
+        buffer[offset + 3] = quaternion.GetX()
+        buffer[offset + 4] = quaternion.GetY()
+        buffer[offset + 5] = quaternion.GetZ()
+        buffer[offset + 6] = quaternion.GetW()
+        buffer[offset + 7] = active ? 1 : 0
+    }
+
+    snapshot.publish()
+}
+
+const tick = () => {
+    const now = performance.now()
+    const delta = Math.min((now - lastTick) / 1000, MAX_DELTA)
+    lastTick = now
+
+    if (!paused) {
+        accumulator += delta
+
+        let steps = 0
+
+        while (accumulator >= timeStep && steps < MAX_STEPS_PER_TICK) {
+            const start = traceStart()
+            joltInterface.Step(timeStep, 1)
+            traceEnd('jolt-worker-step', start)
+
+            accumulator -= timeStep
+            simulatedTime += timeStep
+            steps++
+        }
+
+        // drop time that couldn't be simulated instead of spiralling
+        if (steps === MAX_STEPS_PER_TICK) accumulator = 0
+
+        if (steps > 0) writeSnapshot(performance.now() - now)
+    }
+
+    const elapsed = performance.now() - now
+
+    setTimeout(tick, Math.max(0, (timeStep - accumulator) * 1000 - elapsed))
+}
+
+const onMessage = (message: PhysicsWorkerMessage) => {
+    if (message.type === PhysicsWorkerMessageType.COMMANDS) {
+        timeStep = message.timeStep
+        paused = message.paused
+
+        for (const command of message.commands) {
+            applyCommand(command)
+        }
+    }
+}
+
+self.onmessage = (e: MessageEvent<PhysicsWorkerMessage>) => {
+    const message = e.data
+
+    if (message.type === PhysicsWorkerMessageType.INIT) {
+        init(message)
+        return
+    }
+
+    if (!ready) {
+        inbox.push(message)
+        return
+    }
+
+    onMessage(message)
+}
@@ -0,0 +1,73 @@
+const INDEX_MASK = 0b11
+const FRESH = 0b100
+
+/**
+ * Lock free single writer, single reader triple buffer over shared memory.
+ *
+ * The writer always has a buffer to write to, and the reader always has a complete buffer to read, so neither waits.
+ * The middle buffer is swapped with the writer's buffer on publish, and with the reader's buffer when it is fresh.
+ */
+export class TripleBuffer {
+    buffers: [Float32Array, Float32Array, Float32Array]
+
+    private control: Int32Array
+    private index: number
+
+    constructor(data: SharedArrayBuffer, control: SharedArrayBuffer, role: 'writer' | 'reader') {
+        const length = data.byteLength / Float32Array.BYTES_PER_ELEMENT / 3
+
+        this.buffers = [
+            new Float32Array(data, 0, length),
+            new Float32Array(data, length * 4, length),
+            new Float32Array(data, length * 8, length),
+        ]
+
+        this.control = new Int32Array(control)
+
+        // the writer starts with buffer 0, the reader with 1, and the middle buffer is 2
+        this.index = role === 'writer' ? 0 : 1
+    }
+
+    static create(length: number) {
+        const data = new SharedArrayBuffer(length * 3 * Float32Array.BYTES_PER_ELEMENT)
+        const control = new SharedArrayBuffer(Int32Array.BYTES_PER_ELEMENT)
+
+        new Int32Array(control)[0] = 2
+
+        return { data, control }
+    }
+
+    /**
+     * The buffer owned by this side
+     */
+    get current() {
+        return this.buffers[this.index]
+    }
+
+    /**
+     * Index of the buffer owned by this side, so per buffer state can be kept by the owner
+     */
+    get currentIndex() {
+        return this.index
+    }
+
+    /**
+     * Writer: makes the current buffer the latest, and takes the previous middle buffer to write next
+     */
+    publish() {
+        this.index = Atomics.exchange(this.control, 0, this.index | FRESH) & INDEX_MASK
+    }
+
+    /**
+     * Reader: takes the latest buffer if one was published since the last call
+     *
+     * @returns whether `current` changed
+     */
+    acquire() {
+        if ((Atomics.load(this.control, 0) & FRESH) === 0) return false
+
+        this.index = Atomics.exchange(this.control, 0, this.index) & INDEX_MASK
+
+        return true
+    }
+}
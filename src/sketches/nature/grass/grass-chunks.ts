@@ -0,0 +1,196 @@
+import * as THREE from 'three'
+
+export type GrassLod = {
+    /**
+     * Chunks closer than this to the camera use this lod
+     */
+    distance: number
+
+    bladesPerChunk: number
+}
+
+/**
+ * Blades are stretched by up to this many times their height in the vertex shader, so a blade can be `1 + MAX_BLADE_STRETCH` tall
+ */
+export const MAX_BLADE_STRETCH = 1.8
+
+/* chunk texels, chunk x, chunk z, fade and unused */
+const CHUNK_TEXTURE_WIDTH = 64
+const CHUNK_STRIDE = 4
+
+const _frustum = new THREE.Frustum()
+const _projectionScreenMatrix = new THREE.Matrix4()
+const _box3 = new THREE.Box3()
+
+/**
+ * Picks the grass chunks to draw each frame.
+ *
+ * Chunks outside the frustum are skipped, and visible chunks are sorted into lods by distance. Each lod writes its chunk
+ * coordinates to a small data texture, and a single instanced draw per lod generates blades for all of its chunks, instance
+ * `i` draws blade `i % bladesPerChunk` of chunk `floor(i / bladesPerChunk)`.
+ *
+ * Blades a chunk loses in the next lod shrink as the chunk nears the lod distance, written as the chunk fade.
+ */
+export class GrassChunks {
+    chunkSize: number
+    chunksPerSide: number
+    terrainSize: number
+
+    /**
+     * Terrain height range per chunk, for culling
+     */
+    minHeights: Float32Array
+    maxHeights: Float32Array
+
+    bladeHeight: number
+
+    lods: GrassLod[]
+
+    /**
+     * Chunks per lod, the instance count of each lod draw is `chunkCounts[lod] * bladesPerChunk`
+     */
+    chunkCounts: number[]
+
+    textures: THREE.DataTexture[]
+
+    private data: Float32Array[]
+
+    constructor({
+        terrainSize,
+        chunkSize,
+        lods,
+        bladeHeight,
+        getHeight,
+    }: {
+        terrainSize: number
+        chunkSize: number
+        lods: GrassLod[]
+        bladeHeight: number
+        getHeight: (x: number, z: number) => number
+    }) {
+        this.terrainSize = terrainSize
+        this.chunkSize = chunkSize
+        this.chunksPerSide = Math.floor(terrainSize / chunkSize)
+        this.lods = lods
+        this.bladeHeight = bladeHeight
+
+        const chunkCount = this.chunksPerSide * this.chunksPerSide
+
+        /* height bounds, sampled on a coarse grid per chunk */
+        this.minHeights = new Float32Array(chunkCount)
+        this.maxHeights = new Float32Array(chunkCount)
+
+        const samples = 4
+
+        for (let cz = 0; cz < this.chunksPerSide; cz++) {
+            for (let cx = 0; cx < this.chunksPerSide; cx++) {
+                let min = Infinity
+                let max = -Infinity
+
+                for (let sz = 0; sz <= samples; sz++) {
+                    for (let sx = 0; sx <= samples; sx++) {
+                        const x = this.getChunkMinX(cx) + (sx / samples) * chunkSize
+                        const z = this.getChunkMinZ(cz) + (sz / samples) * chunkSize
+                        const y = getHeight(x, z)
+
+                        min = Math.min(min, y)
+                        max = Math.max(max, y)
+                    }
+                }
+
+                // the terrain can bulge between samples
+                this.minHeights[cz * this.chunksPerSide + cx] = min - 1
+                this.maxHeights[cz * this.chunksPerSide + cx] = max + 1
+            }
+        }
+
+        /* chunk textures */
+        const textureHeight = Math.ceil(chunkCount / CHUNK_TEXTURE_WIDTH)
+
+        this.chunkCounts = lods.map(() => 0)
+        this.data = lods.map(() => new Float32Array(CHUNK_TEXTURE_WIDTH * textureHeight * CHUNK_STRIDE))
+        this.textures = this.data.map((data) => {
+            const texture = new THREE.DataTexture(data, CHUNK_TEXTURE_WIDTH, textureHeight, THREE.RGBAFormat, THREE.FloatType)
+            texture.needsUpdate = true
+
+            return texture
+        })
+    }
+
+    get maxDistance() {
+        return this.lods[this.lods.length - 1].distance
+    }
+
+    update(camera: THREE.Camera) {
+        _projectionScreenMatrix.multiplyMatrices(camera.projectionMatrix, camera.matrixWorldInverse)
+        _frustum.setFromProjectionMatrix(_projectionScreenMatrix)
+
+        const { chunkSize, chunksPerSide, lods, chunkCounts, data } = this
+        const cameraX = camera.position.x
+        const cameraZ = camera.position.z
+        const maxDistance = this.maxDistance
+        const maxBladeHeight = this.bladeHeight * (1 + MAX_BLADE_STRETCH)
+
+        for (let lod = 0; lod < lods.length; lod++) {
+            chunkCounts[lod] = 0
+        }
+
+        /* only chunks within the draw distance of the camera */
+        const minChunkX = Math.max(0, Math.floor((cameraX - maxDistance + this.terrainSize / 2) / chunkSize))
+        const maxChunkX = Math.min(chunksPerSide - 1, Math.floor((cameraX + maxDistance + this.terrainSize / 2) / chunkSize))
+        const minChunkZ = Math.max(0, Math.floor((cameraZ - maxDistance + this.terrainSize / 2) / chunkSize))
+        const maxChunkZ = Math.min(chunksPerSide - 1, Math.floor((cameraZ + maxDistance + this.terrainSize / 2) / chunkSize))
+
+        for (let cz = minChunkZ; cz <= maxChunkZ; cz++) {
+            for (let cx = minChunkX; cx <= maxChunkX; cx++) {
+                const minX = this.getChunkMinX(cx)
+                const minZ = this.getChunkMinZ(cz)
+
+                const dx = minX + chunkSize / 2 - cameraX
+                const dz = minZ + chunkSize / 2 - cameraZ
+                const distance = Math.sqrt(dx * dx + dz * dz)
+
+                if (distance > maxDistance) continue
+
+                const chunk = cz * chunksPerSide + cx
+
+                _box3.min.set(minX, this.minHeights[chunk], minZ)
+                _box3.max.set(minX + chunkSize, this.maxHeights[chunk] + maxBladeHeight, minZ + chunkSize)
+
+                if (!_frustum.intersectsBox(_box3)) continue
+
+                let lod = 0
+                while (distance > lods[lod].distance) lod++
+
+                // shrink the blades the next lod drops over the last fifth of this lod
+                const lodStart = lod > 0 ? lods[lod - 1].distance : 0
+                const fadeRange = (lods[lod].distance - lodStart) * 0.2
+                const fade = THREE.MathUtils.clamp((distance - (lods[lod].distance - fadeRange)) / fadeRange, 0, 1)
+
+                const offset = chunkCounts[lod]++ * CHUNK_STRIDE
+                const lodData = data[lod]
+                lodData[offset] = cx
+                lodData[offset + 1] = cz
+                lodData[offset + 2] = fade
+            }
+        }
+
+        for (let lod = 0; lod < lods.length; lod++) {
+            this.textures[lod].needsUpdate = true
+        }
+    }
+
+    dispose() {
+        for (const texture of this.textures) {
+            texture.dispose()
+        }
+    }
+
+    private getChunkMinX(cx: number) {
+        return cx * this.chunkSize - this.terrainSize / 2
+    }
+
+    private getChunkMinZ(cz: number) {
+        return cz * this.chunkSize - this.terrainSize / 2
+    }
+}
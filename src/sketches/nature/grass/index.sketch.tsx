@@ -2,15 +2,20 @@ import forestEnvironment from '@pmndrs/assets/hdri/forest.exr'
 import { CameraShake, Environment, OrbitControls, PerspectiveCamera, Sky, useTexture } from '@react-three/drei'
 import { useFrame } from '@react-three/fiber'
 import { useControls } from 'leva'
-import { useMemo, useRef } from 'react'
+import { useEffect, useMemo, useRef } from 'react'
 import { createNoise2D } from 'simplex-noise'
 import * as THREE from 'three'
 import { Canvas } from '@/common'
 import cloudUrl from './cloud.jpg?url'
+import { GrassChunks, GrassLod, MAX_BLADE_STRETCH } from './grass-chunks'
 import grassBladeAlphaUrl from './grass-blade-alpha.jpg?url'
 
 const GROUND_COLOR = '#001700'
 
+const TERRAIN_SIZE = 512
+const HEIGHTMAP_RESOLUTION = 257
+const CHUNK_SIZE = 8
+
 const GRASS_BLADE_COLORS = [
     {
         base: new THREE.Color('#138510'),
@@ -34,104 +39,23 @@ const getHeight = (x: number, z: number): number => {
     return y
 }
 
-const computeGrassAttributes = (instances: number, width: number) => {
-    const tipColor: number[] = []
-    const middleColor: number[] = []
-    const baseColor: number[] = []
-
-    const offsets: number[] = []
-    const orientations: number[] = []
-    const stretches: number[] = []
-    const halfRootAngleSin: number[] = []
-    const halfRootAngleCos: number[] = []
-
-    const tmpColor = new THREE.Color()
+/**
+ * Terrain heights on a grid, texel (i, j) is the height at x = i * spacing - size / 2, z = j * spacing - size / 2
+ */
+const createHeightmap = () => {
+    const data = new Float32Array(HEIGHTMAP_RESOLUTION * HEIGHTMAP_RESOLUTION)
+    const spacing = TERRAIN_SIZE / (HEIGHTMAP_RESOLUTION - 1)
 
-    const tmpQuaternion_0 = new THREE.Quaternion()
-    const tmpQuaternion_1 = new THREE.Quaternion()
-
-    // The min and max angle for the growth direction (in radians)
-    const min = -0.25
-    const max = 0.25
-
-    // For each instance of the grass blade
-    for (let i = 0; i < instances; i++) {
-        /* Position */
-        // Offset
-        const offsetX = Math.random() * width - width / 2
-        const offsetZ = Math.random() * width - width / 2
-        const offsetY = getHeight(offsetX, offsetZ)
-        offsets.push(offsetX, offsetY, offsetZ)
-
-        // Growth direction
-        // Rotate around Y
-        let angle = Math.PI - Math.random() * (2 * Math.PI)
-        halfRootAngleSin.push(Math.sin(0.5 * angle))
-        halfRootAngleCos.push(Math.cos(0.5 * angle))
-
-        let rotationAxis = new THREE.Vector3(0, 1, 0)
-        let x = rotationAxis.x * Math.sin(angle / 2.0)
-        let y = rotationAxis.y * Math.sin(angle / 2.0)
-        let z = rotationAxis.z * Math.sin(angle / 2.0)
-        let w = Math.cos(angle / 2.0)
-        tmpQuaternion_0.set(x, y, z, w).normalize()
-
-        // Rotate around X
-        angle = Math.random() * (max - min) + min
-        rotationAxis = new THREE.Vector3(1, 0, 0)
-        x = rotationAxis.x * Math.sin(angle / 2.0)
-        y = rotationAxis.y * Math.sin(angle / 2.0)
-        z = rotationAxis.z * Math.sin(angle / 2.0)
-        w = Math.cos(angle / 2.0)
-        tmpQuaternion_1.set(x, y, z, w).normalize()
-
-        // Combine rotations to a single quaternion
-        tmpQuaternion_0.multiplyQuaternions(tmpQuaternion_0, tmpQuaternion_1)
-
-        // Rotate around Z
-        angle = Math.random() * (max - min) + min
-        rotationAxis = new THREE.Vector3(0, 0, 1)
-        x = rotationAxis.x * Math.sin(angle / 2.0)
-        y = rotationAxis.y * Math.sin(angle / 2.0)
-        z = rotationAxis.z * Math.sin(angle / 2.0)
-        w = Math.cos(angle / 2.0)
-        tmpQuaternion_1.set(x, y, z, w).normalize()
-
-        // Combine rotations to a single quaternion
-        tmpQuaternion_0.multiplyQuaternions(tmpQuaternion_0, tmpQuaternion_1)
-
-        orientations.push(tmpQuaternion_0.x, tmpQuaternion_0.y, tmpQuaternion_0.z, tmpQuaternion_0.w)
-
-        /* Height */
-        if (i < instances / 3) {
-            stretches.push(Math.random() * 1.8)
-        } else {
-            stretches.push(Math.random())
+    for (let j = 0; j < HEIGHTMAP_RESOLUTION; j++) {
+        for (let i = 0; i < HEIGHTMAP_RESOLUTION; i++) {
+            data[j * HEIGHTMAP_RESOLUTION + i] = getHeight(i * spacing - TERRAIN_SIZE / 2, j * spacing - TERRAIN_SIZE / 2)
         }
-
-        /* Color */
-        const bladeColor = GRASS_BLADE_COLORS[Math.floor(Math.random() * GRASS_BLADE_COLORS.length)]
-
-        const base = tmpColor.copy(bladeColor.base)
-        baseColor.push(base.r, base.g, base.b)
-
-        const middle = tmpColor.copy(bladeColor.middle)
-        middleColor.push(middle.r, middle.g, middle.b)
-
-        const tip = tmpColor.copy(bladeColor.tip)
-        tipColor.push(tip.r, tip.g, tip.b)
     }
 
-    return {
-        offsets: new Float32Array(offsets),
-        orientations: new Float32Array(orientations),
-        stretches: new Float32Array(stretches),
-        halfRootAngleCos: new Float32Array(halfRootAngleCos),
-        halfRootAngleSin: new Float32Array(halfRootAngleSin),
-        baseColor: new Float32Array(baseColor),
-        middleColor: new Float32Array(middleColor),
-        tipColor: new Float32Array(tipColor),
-    }
+    const texture = new THREE.DataTexture(data, HEIGHTMAP_RESOLUTION, HEIGHTMAP_RESOLUTION, THREE.RedFormat, THREE.FloatType)
+    texture.needsUpdate = true
+
+    return texture
 }
 
 const slerp = /* glsl */ `
@@ -219,18 +143,27 @@ const rotateVectorByQuaternion = /* glsl */ `
 
 const grassVertexShader = /* glsl */ `
     precision highp float;
+    precision highp int;
 
-    attribute vec3 baseColor;
-    attribute vec3 middleColor;
-    attribute vec3 tipColor;
-    attribute vec3 offset;
-    attribute vec4 orientation;
-    attribute float halfRootAngleSin;
-    attribute float halfRootAngleCos;
-    attribute float stretch;
+    #ifndef PI
+    #define PI 3.141592653589793
+    #endif
 
     uniform float uTime;
     uniform float uBladeHeight;
+    uniform int uSeed;
+
+    uniform sampler2D uHeightmap;
+    uniform float uTerrainSize;
+
+    uniform sampler2D uChunks;
+    uniform float uChunkSize;
+    uniform int uBladesPerChunk;
+    uniform int uNextLodBladesPerChunk;
+
+    uniform vec3 uBaseColors[${GRASS_BLADE_COLORS.length}];
+    uniform vec3 uMiddleColors[${GRASS_BLADE_COLORS.length}];
+    uniform vec3 uTipColors[${GRASS_BLADE_COLORS.length}];
 
     varying vec2 vUv;
     varying vec3 vPosition;
@@ -238,44 +171,114 @@ const grassVertexShader = /* glsl */ `
     varying vec3 vBaseColor;
     varying vec3 vMiddleColor;
     varying vec3 vTipColor;
-    
+
     ${snoise}
-    
+
     ${rotateVectorByQuaternion}
-    
+
     ${slerp}
-    
+
+    uint hash(uint x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float random(inout uint state) {
+        state = hash(state);
+        return float(state) / 4294967295.0;
+    }
+
+    vec4 quaternionFromAxisAngle(vec3 axis, float angle) {
+        return vec4(axis * sin(angle * 0.5), cos(angle * 0.5));
+    }
+
+    vec4 multiplyQuaternions(vec4 a, vec4 b) {
+        return vec4(a.w * b.xyz + b.w * a.xyz + cross(a.xyz, b.xyz), a.w * b.w - dot(a.xyz, b.xyz));
+    }
+
+    // bilinear, float textures aren't always filterable
+    float getTerrainHeight(vec2 xz) {
+        ivec2 maxTexel = textureSize(uHeightmap, 0) - 1;
+        vec2 texel = (xz / uTerrainSize + 0.5) * vec2(maxTexel);
+        ivec2 i = ivec2(floor(texel));
+        vec2 f = fract(texel);
+
+        float h00 = texelFetch(uHeightmap, clamp(i, ivec2(0), maxTexel), 0).r;
+        float h10 = texelFetch(uHeightmap, clamp(i + ivec2(1, 0), ivec2(0), maxTexel), 0).r;
+        float h01 = texelFetch(uHeightmap, clamp(i + ivec2(0, 1), ivec2(0), maxTexel), 0).r;
+        float h11 = texelFetch(uHeightmap, clamp(i + ivec2(1, 1), ivec2(0), maxTexel), 0).r;
+
+        return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+    }
+
     void main() {
+        // instance i is blade i % bladesPerChunk of the chunk in slot i / bladesPerChunk
+        int slot = gl_InstanceID / uBladesPerChunk;
+        int bladeIndex = gl_InstanceID - slot * uBladesPerChunk;
+
+        int chunksWidth = textureSize(uChunks, 0).x;
+        vec4 chunk = texelFetch(uChunks, ivec2(slot % chunksWidth, slot / chunksWidth), 0);
+
+        // the same blade in every lod, lower lods draw a prefix of the blades
+        uint state = hash(uint(chunk.x) * 73856093u ^ uint(chunk.y) * 19349663u ^ uint(bladeIndex) * 83492791u ^ uint(uSeed));
+
+        /* Position */
+        vec2 chunkMin = chunk.xy * uChunkSize - uTerrainSize * 0.5;
+        vec2 offsetXZ = chunkMin + vec2(random(state), random(state)) * uChunkSize;
+        vec3 offset = vec3(offsetXZ.x, getTerrainHeight(offsetXZ), offsetXZ.y);
+
+        /* Growth direction */
+        float rootAngle = PI - random(state) * (2.0 * PI);
+        float halfRootAngleSin = sin(0.5 * rootAngle);
+        float halfRootAngleCos = cos(0.5 * rootAngle);
+
+        vec4 orientation = quaternionFromAxisAngle(vec3(0.0, 1.0, 0.0), rootAngle);
+        orientation = multiplyQuaternions(orientation, quaternionFromAxisAngle(vec3(1.0, 0.0, 0.0), random(state) * 0.5 - 0.25));
+        orientation = multiplyQuaternions(orientation, quaternionFromAxisAngle(vec3(0.0, 0.0, 1.0), random(state) * 0.5 - 0.25));
+
+        /* Height */
+        float stretch = random(state) < 1.0 / 3.0 ? random(state) * ${MAX_BLADE_STRETCH.toFixed(1)} : random(state);
+
+        // blades the next lod drops shrink as the chunk nears it
+        float shrink = bladeIndex >= uNextLodBladesPerChunk ? 1.0 - chunk.z : 1.0;
+
+        /* Color */
+        int palette = int(random(state) * float(${GRASS_BLADE_COLORS.length})) % ${GRASS_BLADE_COLORS.length};
+
         // Relative position of vertex along the mesh Y direction
         vRelativeY = position.y / float(uBladeHeight);
-        
-        // Get wind data from simplex noise 
+
+        // Get wind data from simplex noise
         float adjustedTime = uTime * 0.1;
         float noise = 1.0 - (snoise(vec2((adjustedTime - offset.x / 50.0), (adjustedTime - offset.z / 50.0))));
-        
+
         // Define the direction of an unbent blade of grass rotated around the Y axis
         vec4 direction = vec4(0.0, halfRootAngleSin, 0.0, halfRootAngleCos);
-        
-        // Interpolate between the unbent direction and the direction of growth calculated on the CPU. 
+
+        // Interpolate between the unbent direction and the direction of growth.
         // Using the relative location of the vertex along the Y axis as the weight, we get a smooth bend
         direction = slerp(direction, orientation, vRelativeY);
         vec3 localBentPosition = vec3(position.x, position.y + position.y * stretch, position.z);
         localBentPosition = rotateVectorByQuaternion(localBentPosition, direction);
-        
+
         // Apply wind
         float halfAngle = noise * 0.15;
         localBentPosition = rotateVectorByQuaternion(localBentPosition, normalize(vec4(sin(halfAngle), 0.0, -sin(halfAngle), cos(halfAngle))));
-        
-        // Calculate final position of the vertex from the world offset and the above shenanigans 
-        vec3 offsetPosition = offset + localBentPosition;
+
+        // Calculate final position of the vertex from the world offset and the above shenanigans
+        vec3 offsetPosition = offset + localBentPosition * shrink;
         gl_Position = projectionMatrix * modelViewMatrix * vec4(offsetPosition, 1.0);
 
         // Varyings
         vUv = uv;
         vPosition = offsetPosition;
-        vBaseColor = baseColor;
-        vMiddleColor = middleColor;
-        vTipColor = tipColor;
+        vBaseColor = uBaseColors[palette];
+        vMiddleColor = uMiddleColors[palette];
+        vTipColor = uTipColors[palette];
     }
 `
 
@@ -319,6 +322,57 @@ const grassFragmentShader = /* glsl */ `
     }
 `
 
+type GrassLodMeshProps = {
+    grassChunks: GrassChunks
+    lod: number
+    geometry: THREE.BufferGeometry
+    uniforms: Record<string, THREE.IUniform>
+    wireframe: boolean
+}
+
+const GrassLodMesh = ({ grassChunks, lod, geometry, uniforms, wireframe }: GrassLodMeshProps) => {
+    const instancedGeometry = useRef<THREE.InstancedBufferGeometry>(null!)
+
+    const { bladesPerChunk } = grassChunks.lods[lod]
+    const nextLod = grassChunks.lods[lod + 1]
+
+    const lodUniforms = useMemo(
+        () => ({
+            ...uniforms,
+            uChunks: { value: grassChunks.textures[lod] },
+            uBladesPerChunk: { value: bladesPerChunk },
+            uNextLodBladesPerChunk: { value: nextLod ? nextLod.bladesPerChunk : 0 },
+        }),
+        [uniforms, grassChunks, lod],
+    )
+
+    // after the chunks for this frame are picked
+    const onBeforeRender = () => {
+        instancedGeometry.current.instanceCount = grassChunks.chunkCounts[lod] * bladesPerChunk
+    }
+
+    return (
+        // chunks are culled on the cpu
+        <mesh frustumCulled={false} onBeforeRender={onBeforeRender}>
+            <instancedBufferGeometry
+                ref={instancedGeometry}
+                key={geometry.uuid}
+                index={geometry.index}
+                attributes-position={geometry.attributes.position}
+                attributes-uv={geometry.attributes.uv}
+            />
+            <shaderMaterial
+                uniforms={lodUniforms}
+                vertexShader={grassVertexShader}
+                fragmentShader={grassFragmentShader}
+                side={THREE.DoubleSide}
+                wireframe={wireframe}
+                toneMapped={false}
+            />
+        </mesh>
+    )
+}
+
 const Grass = () => {
     const cloudMap = useTexture(cloudUrl)
     cloudMap.wrapS = cloudMap.wrapT = THREE.RepeatWrapping
@@ -327,26 +381,75 @@ const Grass = () => {
 
     const uTime = useRef({ value: 0 })
 
-    const { bladeWidth, bladeHeight, bladeJoints, wireframe, width, instances } = useControls('nature-grass', {
+    const { bladeWidth, bladeHeight, bladeJoints, wireframe, bladesPerChunk, drawDistance, seed } = useControls('nature-grass', {
         bladeWidth: 0.12,
         bladeHeight: 1,
         bladeJoints: 5,
-        width: 100,
-        instances: 50000,
+        bladesPerChunk: { value: 512, min: 16, max: 4096, step: 16 },
+        drawDistance: { value: 150, min: 20, max: 250 },
+        seed: { value: 1, step: 1 },
         wireframe: false,
     })
 
-    const attributes = useMemo(() => computeGrassAttributes(instances, width), [instances, width])
+    const heightmap = useMemo(() => createHeightmap(), [])
+
+    /* lods, blade count falls off with distance and far blades have fewer joints and are wider */
+    const lods = useMemo<(GrassLod & { joints: number; widthScale: number })[]>(
+        () => [
+            { distance: drawDistance * 0.2, bladesPerChunk, joints: bladeJoints, widthScale: 1 },
+            { distance: drawDistance * 0.5, bladesPerChunk: Math.max(1, bladesPerChunk >> 2), joints: Math.ceil(bladeJoints / 2), widthScale: 1.5 },
+            { distance: drawDistance, bladesPerChunk: Math.max(1, bladesPerChunk >> 4), joints: 1, widthScale: 2.5 },
+        ],
+        [drawDistance, bladesPerChunk, bladeJoints],
+    )
+
+    const grassChunks = useMemo(
+        () => new GrassChunks({ terrainSize: TERRAIN_SIZE, chunkSize: CHUNK_SIZE, lods, bladeHeight, getHeight }),
+        [lods, bladeHeight],
+    )
+
+    useEffect(() => {
+        return () => grassChunks.dispose()
+    }, [grassChunks])
+
+    const lodGeometries = useMemo(
+        () =>
+            lods.map(({ joints, widthScale }) =>
+                new THREE.PlaneGeometry(bladeWidth * widthScale, bladeHeight, 1, joints).translate(0, bladeHeight / 2, 0),
+            ),
+        [lods, bladeWidth, bladeHeight],
+    )
 
-    const baseGeometry = useMemo(
-        () => new THREE.PlaneGeometry(bladeWidth, bladeHeight, 1, bladeJoints).translate(0, bladeHeight / 2, 0),
-        [bladeWidth, bladeHeight, bladeJoints],
+    useEffect(() => {
+        return () => {
+            for (const geometry of lodGeometries) {
+                geometry.dispose()
+            }
+        }
+    }, [lodGeometries])
+
+    const uniforms = useMemo(
+        () => ({
+            uTime: uTime.current,
+            uBladeHeight: { value: bladeHeight },
+            uSeed: { value: seed },
+            uHeightmap: { value: heightmap },
+            uTerrainSize: { value: TERRAIN_SIZE },
+            uChunkSize: { value: CHUNK_SIZE },
+            uBaseColors: { value: GRASS_BLADE_COLORS.map(({ base }) => base) },
+            uMiddleColors: { value: GRASS_BLADE_COLORS.map(({ middle }) => middle) },
+            uTipColors: { value: GRASS_BLADE_COLORS.map(({ tip }) => tip) },
+            uCloud: { value: cloudMap },
+            alphaMap: { value: grassBladeAlphaMap },
+        }),
+        [bladeHeight, seed],
     )
 
     const { groundGeometry, maxHeight } = useMemo(() => {
         let maxY = -Infinity
 
-        const geometry = new THREE.PlaneGeometry(width, width, 32, 32)
+        // vertices on the heightmap grid
+        const geometry = new THREE.PlaneGeometry(TERRAIN_SIZE, TERRAIN_SIZE, HEIGHTMAP_RESOLUTION - 1, HEIGHTMAP_RESOLUTION - 1)
 
         geometry.lookAt(new THREE.Vector3(0, 1, 0))
 
@@ -363,45 +466,27 @@ const Grass = () => {
         geometry.computeVertexNormals()
 
         return { groundGeometry: geometry, maxHeight: maxY }
-    }, [width])
+    }, [])
 
-    useFrame(({ clock: { elapsedTime } }) => {
+    useFrame(({ camera, clock: { elapsedTime } }) => {
         uTime.current.value = elapsedTime
+
+        grassChunks.update(camera)
     })
 
     return (
         <>
             <group>
-                <mesh>
-                    <instancedBufferGeometry
-                        index={baseGeometry.index}
-                        key={[bladeWidth, bladeHeight, bladeJoints, width, instances].join('-')}
-                        attributes-position={baseGeometry.attributes.position}
-                        attributes-uv={baseGeometry.attributes.uv}
-                    >
-                        <instancedBufferAttribute attach="attributes-offset" args={[attributes.offsets, 3]} />
-                        <instancedBufferAttribute attach="attributes-orientation" args={[attributes.orientations, 4]} />
-                        <instancedBufferAttribute attach="attributes-stretch" args={[attributes.stretches, 1]} />
-                        <instancedBufferAttribute attach="attributes-halfRootAngleSin" args={[attributes.halfRootAngleSin, 1]} />
-                        <instancedBufferAttribute attach="attributes-halfRootAngleCos" args={[attributes.halfRootAngleCos, 1]} />
-                        <instancedBufferAttribute attach="attributes-baseColor" args={[attributes.baseColor, 3]} />
-                        <instancedBufferAttribute attach="attributes-middleColor" args={[attributes.middleColor, 3]} />
-                        <instancedBufferAttribute attach="attributes-tipColor" args={[attributes.tipColor, 3]} />
-                    </instancedBufferGeometry>
-                    <shaderMaterial
-                        uniforms={{
-                            uTime: uTime.current,
-                            uBladeHeight: { value: bladeHeight },
-                            uCloud: { value: cloudMap },
-                            alphaMap: { value: grassBladeAlphaMap },
-                        }}
-                        vertexShader={grassVertexShader}
-                        fragmentShader={grassFragmentShader}
-                        side={THREE.DoubleSide}
+                {lods.map((_, lod) => (
+                    <GrassLodMesh
+                        key={lod}
+                        grassChunks={grassChunks}
+                        lod={lod}
+                        geometry={lodGeometries[lod]}
+                        uniforms={uniforms}
                         wireframe={wireframe}
-                        toneMapped={false}
                     />
-                </mesh>
+                ))}
                 <mesh>
                     <primitive object={groundGeometry} />
                     <meshStandardMaterial color={GROUND_COLOR} />
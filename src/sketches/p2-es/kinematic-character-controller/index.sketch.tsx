@@ -3,15 +3,19 @@ import { useFrame, useThree } from '@react-three/fiber'
 import { World } from 'arancini'
 import { createReactAPI } from 'arancini/react'
 import { Executor, System } from 'arancini/systems'
+import { useControls } from 'leva'
 import * as p2 from 'p2-es'
 import { useMemo } from 'react'
 import * as THREE from 'three'
 import { Canvas } from '@/common'
 import { Duck } from './duck'
-import { KinematicCharacterController } from './kinematic-character-controller'
+import { KinematicCharacterController, KinematicCharacterControllerGroup } from './kinematic-character-controller'
+
+const LEVA_KEY = 'p2-kinematic-character-controller'
 
 type EntityType = {
     isPlayer?: boolean
+    isNpc?: boolean
     camera?: THREE.Camera
     object3D?: THREE.Object3D
     physicsBody?: p2.Body
@@ -21,6 +25,7 @@ type EntityType = {
 
 const SCENERY_GROUP = 0x01
 const PLAYER_GROUP = 0x02
+const NPC_GROUP = 0x04
 
 class PhysicsSystem extends System<EntityType> {
     physicsWorld = new p2.World({ gravity: [0, -9.81] })
@@ -67,7 +72,11 @@ class KinematicCharacterControllerSystem extends System<EntityType> {
 
     physicsSystem = this.attach(PhysicsSystem)!
 
+    controllerGroup!: KinematicCharacterControllerGroup
+
     onInit(): void {
+        this.controllerGroup = new KinematicCharacterControllerGroup(this.physicsSystem.physicsWorld)
+
         this.playerQuery.onEntityAdded.add((entity) => {
             const { physicsBody } = entity
 
@@ -81,8 +90,16 @@ class KinematicCharacterControllerSystem extends System<EntityType> {
                 wallJumpClimb: [15, 15],
             })
 
+            this.controllerGroup.add(controller)
+
             world.add(entity, 'kinematicCharacterController', controller)
         })
+
+        this.playerQuery.onEntityRemoved.add(({ kinematicCharacterController }) => {
+            if (kinematicCharacterController) {
+                this.controllerGroup.remove(kinematicCharacterController)
+            }
+        })
     }
 
     onUpdate(delta: number): void {
@@ -106,8 +123,31 @@ class KinematicCharacterControllerSystem extends System<EntityType> {
             } else {
                 kinematicCharacterController.setJumpKeyState(false)
             }
+        }
+
+        // all controllers share one pass over the world bodies
+        this.controllerGroup.update(delta)
+    }
+}
+
+class NpcInputSystem extends System<EntityType> {
+    npcs = this.query((e) => e.has('isNpc', 'playerInput', 'kinematicCharacterController'))
+
+    onUpdate(): void {
+        for (const { playerInput, kinematicCharacterController } of this.npcs) {
+            const { collisions } = kinematicCharacterController
+
+            /* walk until a wall, then turn around */
+            if (collisions.left) {
+                playerInput.left = false
+                playerInput.right = true
+            } else if (collisions.right) {
+                playerInput.left = true
+                playerInput.right = false
+            }
 
-            kinematicCharacterController.update(delta)
+            /* jump now and then */
+            playerInput.up = collisions.below ? Math.random() < 0.01 : playerInput.up && Math.random() < 0.95
         }
     }
 }
@@ -171,6 +211,7 @@ const world = new World<EntityType>()
 
 const executor = new Executor(world)
 
+executor.add(NpcInputSystem)
 executor.add(KinematicCharacterControllerSystem)
 executor.add(PhysicsSystem)
 executor.add(CameraSystem)
@@ -242,6 +283,59 @@ const Player = () => {
     )
 }
 
+const Npc = () => {
+    const input = useMemo(() => {
+        const right = Math.random() > 0.5
+
+        return { left: !right, right, up: false }
+    }, [])
+
+    const npc = useMemo(() => {
+        const body = new p2.Body({
+            type: p2.Body.KINEMATIC,
+            mass: 0,
+            fixedRotation: true,
+            damping: 0,
+            position: [THREE.MathUtils.randFloat(-6, 6), THREE.MathUtils.randFloat(2, 18)],
+        })
+
+        body.addShape(
+            new p2.Box({
+                width: 0.6,
+                height: 1.2,
+                collisionGroup: NPC_GROUP,
+            }),
+        )
+
+        return body
+    }, [])
+
+    return (
+        <Entity isNpc physicsBody={npc} playerInput={input}>
+            <Component name="object3D">
+                <mesh>
+                    <boxGeometry args={[0.6, 1.2, 0.6]} />
+                    <meshStandardMaterial color="orange" />
+                </mesh>
+            </Component>
+        </Entity>
+    )
+}
+
+const Npcs = () => {
+    const { npcs } = useControls(LEVA_KEY, {
+        npcs: { value: 20, min: 0, max: 500, step: 1 },
+    })
+
+    return (
+        <>
+            {Array.from({ length: npcs }, (_, i) => (
+                <Npc key={i} />
+            ))}
+        </>
+    )
+}
+
 const Box = (props: {
     position: [number, number]
     width: number
@@ -291,6 +385,7 @@ export default () => (
     >
         <Canvas>
             <Player />
+            <Npcs />
             <Camera />
             <Loop />
 
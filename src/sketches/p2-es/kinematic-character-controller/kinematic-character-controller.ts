@@ -35,6 +35,31 @@ function expandAABB(aabb: p2.AABB, amount: number) {
     aabb.upperBound[1] += halfAmount
 }
 
+function aabbContainsRay(aabb: p2.AABB, ray: p2.Ray) {
+    const { lowerBound, upperBound } = aabb
+    const { from, to } = ray
+
+    return (
+        Math.min(from[0], to[0]) >= lowerBound[0] &&
+        Math.max(from[0], to[0]) <= upperBound[0] &&
+        Math.min(from[1], to[1]) >= lowerBound[1] &&
+        Math.max(from[1], to[1]) <= upperBound[1]
+    )
+}
+
+function bodyInCollisionMask(body: p2.Body, collisionMask: number) {
+    for (let i = 0; i < body.shapes.length; i++) {
+        if ((body.shapes[i].collisionGroup & collisionMask) !== 0) {
+            return true
+        }
+    }
+
+    return false
+}
+
+// longest descend ray, used when maxDescendAngle doesn't bound the ray length
+const MAX_DESCEND_RAY_LENGTH = 1e6
+
 type RaycastControllerEvents = {
     raycast: {
         type: 'raycast'
@@ -42,6 +67,133 @@ type RaycastControllerEvents = {
     }
 }
 
+type RaycastControllerOptions = {
+    world: p2.World
+    body: p2.Body
+    collisionMask?: number
+    skinWidth?: number
+    horizontalRayCount?: number
+    verticalRayCount?: number
+    horizontalRaySpacing?: number | null
+    verticalRaySpacing?: number | null
+    batchRaycasts?: boolean
+}
+
+/**
+ * Shares one pass over the world bodies between many controllers.
+ *
+ * Body bounds are copied to a flat array once per step, and each controller finds its raycast candidates in that array instead of
+ * querying the broadphase. Bounds of controller bodies are refreshed as each controller moves, so a controller whose
+ * `collisionMask` includes the group of other controllers sees where they are after this step's earlier moves.
+ */
+export class KinematicCharacterControllerGroup {
+    world: p2.World
+
+    controllers: KinematicCharacterController[] = []
+
+    private bodies: p2.Body[] = []
+    private bodyIndices = new Map<p2.Body, number>()
+
+    /* lower x, lower y, upper x, upper y per body */
+    private bounds = new Float32Array(0)
+    private collisionGroups = new Int32Array(0)
+
+    constructor(world: p2.World) {
+        this.world = world
+    }
+
+    add(controller: KinematicCharacterController) {
+        controller.group = this
+        this.controllers.push(controller)
+    }
+
+    remove(controller: KinematicCharacterController) {
+        const index = this.controllers.indexOf(controller)
+
+        if (index === -1) return
+
+        controller.group = null
+        this.controllers.splice(index, 1)
+    }
+
+    update(deltaTime: number) {
+        this.updateBounds()
+
+        for (const controller of this.controllers) {
+            controller.update(deltaTime)
+
+            const index = this.bodyIndices.get(controller.body)
+
+            if (index !== undefined) {
+                this.writeBounds(index, controller.body)
+            }
+        }
+    }
+
+    queryCandidates(aabb: p2.AABB, collisionMask: number, result: p2.Body[]) {
+        const bodies = this.bodies
+        const bounds = this.bounds
+        const collisionGroups = this.collisionGroups
+        const { lowerBound, upperBound } = aabb
+
+        for (let i = 0; i < bodies.length; i++) {
+            if ((collisionGroups[i] & collisionMask) === 0) continue
+
+            const offset = i * 4
+
+            if (
+                bounds[offset] <= upperBound[0] &&
+                bounds[offset + 1] <= upperBound[1] &&
+                bounds[offset + 2] >= lowerBound[0] &&
+                bounds[offset + 3] >= lowerBound[1]
+            ) {
+                result.push(bodies[i])
+            }
+        }
+
+        return result
+    }
+
+    private updateBounds() {
+        const worldBodies = this.world.bodies
+        const count = worldBodies.length
+
+        if (this.collisionGroups.length < count) {
+            const capacity = Math.max(count, this.collisionGroups.length * 2)
+            this.bounds = new Float32Array(capacity * 4)
+            this.collisionGroups = new Int32Array(capacity)
+        }
+
+        this.bodies.length = count
+        this.bodyIndices.clear()
+
+        for (let i = 0; i < count; i++) {
+            const body = worldBodies[i]
+
+            let collisionGroup = 0
+            for (let j = 0; j < body.shapes.length; j++) {
+                collisionGroup |= body.shapes[j].collisionGroup
+            }
+
+            this.bodies[i] = body
+            this.bodyIndices.set(body, i)
+            this.collisionGroups[i] = collisionGroup
+            this.writeBounds(i, body)
+        }
+    }
+
+    private writeBounds(index: number, body: p2.Body) {
+        body.aabbNeedsUpdate = true
+        const { lowerBound, upperBound } = body.getAABB()
+
+        const offset = index * 4
+        this.bounds[offset] = lowerBound[0]
+        this.bounds[offset + 1] = lowerBound[1]
+        this.bounds[offset + 2] = upperBound[0]
+        this.bounds[offset + 3] = upperBound[1]
+    }
+}
+
 /**
  * Original code from: https://github.com/SebLague/2DPlatformer-Tutorial
  */
@@ -67,16 +219,17 @@ export class RaycastController extends EventEmitter<RaycastControllerEvents> {
         bottomRight: p2.Vec2
     }
 
-    constructor(options: {
-        world: p2.World
-        body: p2.Body
-        collisionMask?: number
-        skinWidth?: number
-        horizontalRayCount?: number
-        verticalRayCount?: number
-        horizontalRaySpacing?: number | null
-        verticalRaySpacing?: number | null
-    }) {
+    /**
+     * Whether rays are tested against bodies in the AABB swept by all rays of a move, instead of querying the world per ray
+     */
+    batchRaycasts: boolean
+
+    group: KinematicCharacterControllerGroup | null = null
+
+    raycastBounds: p2.AABB
+    raycastCandidates: p2.Body[] = []
+
+    constructor(options: RaycastControllerOptions) {
         super()
 
         this.updateRaycastOriginsBounds = new AABB()
@@ -93,6 +246,9 @@ export class RaycastController extends EventEmitter<RaycastControllerEvents> {
         this.horizontalRaySpacing = 0
         this.verticalRaySpacing = 0
 
+        this.batchRaycasts = options.batchRaycasts !== undefined ? options.batchRaycasts : true
+        this.raycastBounds = new AABB()
+
         this.raycastOrigins = {
             topLeft: vec2.create(),
             topRight: vec2.create(),
@@ -133,6 +289,49 @@ export class RaycastController extends EventEmitter<RaycastControllerEvents> {
         this.horizontalRaySpacing = sizeY / (this.horizontalRayCount - 1)
         this.verticalRaySpacing = sizeX / (this.verticalRayCount - 1)
     }
+
+    /**
+     * Finds the bodies that rays within the current origins expanded by the given extents can hit
+     */
+    updateRaycastCandidates(extentX: number, extentY: number, extentBelow: number) {
+        const bounds = this.raycastBounds
+        const { bottomLeft, topRight } = this.raycastOrigins
+        const candidates = this.raycastCandidates
+
+        candidates.length = 0
+
+        if (!this.batchRaycasts) return
+
+        vec2.set(bounds.lowerBound, bottomLeft[0] - extentX, bottomLeft[1] - extentY - extentBelow)
+        vec2.set(bounds.upperBound, topRight[0] + extentX, topRight[1] + extentY)
+
+        if (this.group) {
+            this.group.queryCandidates(bounds, this.collisionMask, candidates)
+            return
+        }
+
+        this.world.broadphase.aabbQuery(this.world, bounds, candidates)
+
+        /* drop bodies no ray can hit */
+        let count = 0
+        for (let i = 0; i < candidates.length; i++) {
+            if (bodyInCollisionMask(candidates[i], this.collisionMask)) {
+                candidates[count++] = candidates[i]
+            }
+        }
+        candidates.length = count
+    }
+
+    /**
+     * Casts a ray against the candidates when it lies within the candidate bounds, otherwise against the world
+     */
+    raycast(result: p2.RaycastResult, ray: p2.Ray) {
+        if (this.batchRaycasts && aabbContainsRay(this.raycastBounds, ray)) {
+            ray.intersectBodies(result, this.raycastCandidates)
+        } else {
+            this.world.raycast(result, ray)
+        }
+    }
 }
 
 export class Controller extends RaycastController {
@@ -155,6 +354,7 @@ export class Controller extends RaycastController {
 
     ray: p2.Ray
     raycastResult: p2.RaycastResult
+    raycastEvent: RaycastControllerEvents['raycast']
 
     constructor(options: {
         maxClimbAngle?: number
@@ -167,6 +367,7 @@ export class Controller extends RaycastController {
         verticalRayCount?: number
         horizontalRaySpacing?: number | null
         verticalRaySpacing?: number | null
+        batchRaycasts?: boolean
     }) {
         super(options)
 
@@ -194,6 +395,7 @@ export class Controller extends RaycastController {
             mode: Ray.CLOSEST,
         })
         this.raycastResult = new RaycastResult()
+        this.raycastEvent = { type: 'raycast', ray: this.ray }
     }
 
     resetCollisions(velocity: p2.Vec2) {
@@ -218,6 +420,10 @@ export class Controller extends RaycastController {
         this.updateRaycastOrigins()
         this.resetCollisions(velocity)
 
+        /* candidates for every ray of this move, see descendSlope, horizontalCollisions and verticalCollisions */
+        const extent = Math.abs(velocity[0]) + Math.abs(velocity[1]) + this.skinWidth
+        this.updateRaycastCandidates(extent, extent, velocity[1] < 0 ? this.getDescendRayLength(velocity) : 0)
+
         if (velocity[0] !== 0) {
             collisions.faceDir = sign(velocity[0])
         }
@@ -239,10 +445,7 @@ export class Controller extends RaycastController {
     }
 
     emitRayCastEvent() {
-        this.emit({
-            type: 'raycast',
-            ray: this.ray,
-        })
+        this.emit(this.raycastEvent)
     }
 
     horizontalCollisions(velocity: p2.Vec2) {
@@ -260,7 +463,7 @@ export class Controller extends RaycastController {
             ray.from[1] += this.horizontalRaySpacing * i
             vec2.set(ray.to, ray.from[0] + directionX * rayLength, ray.from[1])
             ray.update()
-            this.world.raycast(this.raycastResult, ray)
+            this.raycast(this.raycastResult, ray)
             this.emitRayCastEvent()
 
             if (this.raycastResult.body) {
@@ -316,7 +519,7 @@ export class Controller extends RaycastController {
             ray.from[0] += this.verticalRaySpacing * i + velocity[0]
             vec2.set(ray.to, ray.from[0], ray.from[1] + directionY * rayLength)
             ray.update()
-            this.world.raycast(this.raycastResult, ray)
+            this.raycast(this.raycastResult, ray)
             this.emitRayCastEvent()
 
             if (this.raycastResult.body) {
@@ -344,7 +547,7 @@ export class Controller extends RaycastController {
             ray.from[1] += velocity[1]
             vec2.set(ray.to, ray.from[0] + directionX * rayLength, ray.from[1])
             ray.update()
-            this.world.raycast(this.raycastResult, ray)
+            this.raycast(this.raycastResult, ray)
             this.emitRayCastEvent()
 
             if (this.raycastResult.body) {
@@ -378,9 +581,9 @@ export class Controller extends RaycastController {
         const ray = this.ray
         ray.collisionMask = this.collisionMask
         vec2.copy(ray.from, directionX === -1 ? raycastOrigins.bottomRight : raycastOrigins.bottomLeft)
-        vec2.set(ray.to, ray.from[0], ray.from[1] - 1e6)
+        vec2.set(ray.to, ray.from[0], ray.from[1] - this.getDescendRayLength(velocity))
         ray.update()
-        this.world.raycast(this.raycastResult, ray)
+        this.raycast(this.raycastResult, ray)
         this.emitRayCastEvent()
 
         if (this.raycastResult.body) {
@@ -404,6 +607,18 @@ export class Controller extends RaycastController {
         this.raycastResult.reset()
     }
 
+    /**
+     * Hits further than this can't start a descent, slopes are at most maxDescendAngle steep
+     */
+    getDescendRayLength(velocity: p2.Vec2) {
+        if (this.maxDescendAngle >= Math.PI / 2) {
+            return MAX_DESCEND_RAY_LENGTH
+        }
+
+        // one skin width for the check in descendSlope, one as margin
+        return Math.tan(this.maxDescendAngle) * Math.abs(velocity[0]) + this.skinWidth * 2
+    }
+
     resetFallingThroughPlatform() {
         this.collisions.fallingThroughPlatform = false
     }
@@ -456,6 +671,7 @@ export class KinematicCharacterController extends Controller {
         verticalRayCount?: number
         horizontalRaySpacing?: number | null
         verticalRaySpacing?: number | null
+        batchRaycasts?: boolean
     }) {
         super(options)
 
@@ -1,12 +1,16 @@
-import { Bounds, MarchingCube, MarchingCubes, OrbitControls } from '@react-three/drei'
+import { Bounds, OrbitControls } from '@react-three/drei'
 import { useFrame } from '@react-three/fiber'
 import { World } from 'arancini'
 import { createReactAPI } from 'arancini/react'
 import { Executor, System } from 'arancini/systems'
+import { useControls } from 'leva'
 import * as p2 from 'p2-es'
-import { useMemo } from 'react'
+import { useEffect, useMemo, useRef } from 'react'
 import * as THREE from 'three'
 import { Canvas } from '@/common'
+import { endBenchmarkTimer, startBenchmarkTimer } from '@/common/utils/benchmark'
+import { BALL_STRIDE, IncrementalMarchingCubes, VERTEX_STRIDE } from './marching-cubes'
+import { MarchingCubesWorkers } from './marching-cubes-workers'
 
 const defaultMaterial = new p2.Material()
 
@@ -26,9 +30,21 @@ const containerParts: {
     { width: 1.8, height: 0.15, position: [0, 0.75] },
 ]
 
-const gooColors = [0xff0000, 0x00ff00, 0x0000ff]
+const gooColors = [0xff0000, 0x00ff00, 0x0000ff].map((color) => new THREE.Color(color))
+
+const MAX_BALLS = 1000
+
+// the goo of 150 balls at resolution 64 fits, the geometry grows for more
+const INITIAL_VERTEX_CAPACITY = 60000
+
+type GooBall = {
+    strength: number
+    subtract: number
+    color: THREE.Color
+}
 
 type EntityType = {
+    gooBall?: GooBall
     isRotating?: boolean
     object3D?: THREE.Object3D
     physicsBody?: p2.Body
@@ -68,7 +84,9 @@ class PhysicsSystem extends System<EntityType> {
     }
 
     onUpdate(delta: number): void {
+        const start = startBenchmarkTimer()
         this.physicsWorld.step(PhysicsSystem.TIME_STEP, delta, PhysicsSystem.MAX_SUB_STEPS)
+        endBenchmarkTimer('p2-physics-step', start)
 
         for (const { physicsBody, object3D } of this.physicsBodies) {
             object3D.position.set(physicsBody.interpolatedPosition[0], physicsBody.interpolatedPosition[1], 0)
@@ -86,6 +104,8 @@ executor.add(PhysicsSystem)
 
 executor.init()
 
+const gooBallQuery = world.query((e) => e.has('gooBall', 'object3D'))
+
 const { Entity, Component } = createReactAPI(world)
 
 type BallProps = { index: number }
@@ -107,30 +127,147 @@ const Ball = ({ index }: BallProps) => {
         return body
     }, [])
 
+    const gooBall = useMemo(() => ({ strength: 0.08, subtract: 6, color: gooColors[index % gooColors.length] }), [index])
+
     return (
-        <Entity physicsBody={circleBody}>
+        <Entity physicsBody={circleBody} gooBall={gooBall}>
             <Component name="object3D">
-                <MarchingCube
-                    strength={0.08}
-                    subtract={6}
-                    // @ts-expect-error type incorrect
-                    color={gooColors[index % gooColors.length]}
-                />
+                <group />
             </Component>
         </Entity>
     )
 }
 
-const Balls = () => (
-    <MarchingCubes resolution={64} maxPolyCount={20000} enableUvs={false} enableColors>
-        <meshStandardMaterial vertexColors roughness={0.4} />
+const createGooGeometry = (vertexCapacity: number) => {
+    const buffer = new THREE.InterleavedBuffer(new Float32Array(vertexCapacity * VERTEX_STRIDE), VERTEX_STRIDE)
+    buffer.setUsage(THREE.DynamicDrawUsage)
+
+    const geometry = new THREE.BufferGeometry()
+    geometry.setAttribute('position', new THREE.InterleavedBufferAttribute(buffer, 3, 0))
+    geometry.setAttribute('normal', new THREE.InterleavedBufferAttribute(buffer, 3, 3))
+    geometry.setAttribute('color', new THREE.InterleavedBufferAttribute(buffer, 3, 6))
+    geometry.setDrawRange(0, 0)
+
+    // the field spans -1 to 1
+    geometry.boundingSphere = new THREE.Sphere(new THREE.Vector3(), Math.sqrt(3))
+
+    return geometry
+}
+
+type GooProps = {
+    resolution: number
+    workerCount: number
+}
+
+/**
+ * Draws the goo balls as a marching cubes surface, written into one reused geometry
+ */
+const Goo = ({ resolution, workerCount }: GooProps) => {
+    const mesh = useRef<THREE.Mesh>(null!)
+
+    const balls = useMemo(() => new Float32Array(MAX_BALLS * BALL_STRIDE), [])
+
+    const geometry = useRef(createGooGeometry(INITIAL_VERTEX_CAPACITY))
+
+    const marchingCubes = useMemo(() => {
+        if (workerCount > 0) {
+            return new MarchingCubesWorkers({ resolution, maxBalls: MAX_BALLS, workerCount })
+        }
+
+        return new IncrementalMarchingCubes({ resolution, maxBalls: MAX_BALLS })
+    }, [resolution, workerCount])
+
+    useEffect(() => {
+        return () => {
+            if (marchingCubes instanceof MarchingCubesWorkers) {
+                marchingCubes.terminate()
+            }
+        }
+    }, [marchingCubes])
+
+    useEffect(() => {
+        return () => geometry.current.dispose()
+    }, [])
+
+    const writeGeometry = (surface: IncrementalMarchingCubes | MarchingCubesWorkers) => {
+        let interleavedBuffer = (geometry.current.attributes.position as THREE.InterleavedBufferAttribute).data
+
+        /* replace the geometry when the surface outgrows it */
+        if (surface.vertexCount > interleavedBuffer.count) {
+            geometry.current.dispose()
+            geometry.current = createGooGeometry(THREE.MathUtils.ceilPowerOfTwo(surface.vertexCount))
+            mesh.current.geometry = geometry.current
+
+            interleavedBuffer = (geometry.current.attributes.position as THREE.InterleavedBufferAttribute).data
+        }
+
+        const vertexCount = surface.writeVertices(interleavedBuffer.array as Float32Array)
+
+        interleavedBuffer.clearUpdateRanges()
+        interleavedBuffer.addUpdateRange(0, vertexCount * VERTEX_STRIDE)
+        interleavedBuffer.needsUpdate = true
+
+        geometry.current.setDrawRange(0, vertexCount)
+    }
+
+    useFrame(() => {
+        /* balls, positioned by the physics system */
+        let ballCount = 0
+
+        for (const { gooBall, object3D } of gooBallQuery) {
+            if (ballCount >= MAX_BALLS) break
+
+            const offset = ballCount * BALL_STRIDE
+
+            balls[offset] = 0.5 + object3D.position.x * 0.5
+            balls[offset + 1] = 0.5 + object3D.position.y * 0.5
+            balls[offset + 2] = 0.5 + object3D.position.z * 0.5
+            balls[offset + 3] = gooBall.strength
+            balls[offset + 4] = gooBall.subtract
+            balls[offset + 5] = gooBall.color.r
+            balls[offset + 6] = gooBall.color.g
+            balls[offset + 7] = gooBall.color.b
+
+            ballCount++
+        }
+
+        /* surface */
+        if (marchingCubes instanceof MarchingCubesWorkers) {
+            if (marchingCubes.busy) return
+
+            if (marchingCubes.changed) writeGeometry(marchingCubes)
+
+            marchingCubes.update(balls, ballCount)
+        } else {
+            marchingCubes.setBalls(balls, ballCount)
+
+            const start = startBenchmarkTimer()
+            const changed = marchingCubes.update()
+            endBenchmarkTimer('marching-cubes-update', start)
+
+            if (changed) writeGeometry(marchingCubes)
+        }
+    })
+
+    return (
+        <mesh ref={mesh} geometry={geometry.current}>
+            <meshStandardMaterial vertexColors roughness={0.4} />
+        </mesh>
+    )
+}
+
+type BallsProps = {
+    count: number
+}
 
-        {Array.from({ length: 150 })
+const Balls = ({ count }: BallsProps) => (
+    <>
+        {Array.from({ length: count })
             .fill(null)
             .map((_, i) => (
                 <Ball key={i} index={i} />
             ))}
-    </MarchingCubes>
+    </>
 )
 
 const Container = () => {
@@ -179,10 +316,20 @@ const Loop = () => {
     return null
 }
 
-export default () => (
-    <>
+export default () => {
+    const { balls, resolution, workers } = useControls('p2-marching-cubes-goo', {
+        balls: { value: 150, min: 1, max: MAX_BALLS, step: 1 },
+        resolution: { value: 64, min: 16, max: 160, step: 8 },
+        workers: { value: Math.max(0, Math.min(4, (navigator.hardwareConcurrency ?? 4) - 1)), min: 0, max: 8, step: 1 },
+    })
+
+    return (
         <Canvas camera={{ position: [-0.5, 0, 5], fov: 25 }}>
-            <Balls />
+            {/* physics first, so the goo is marched from this frame's ball positions */}
+            <Loop />
+
+            <Balls count={balls} />
+            <Goo resolution={resolution} workerCount={workers} />
             <Container />
 
             <ambientLight intensity={3} />
@@ -196,8 +343,6 @@ export default () => (
             </Bounds>
 
             <OrbitControls />
-
-            <Loop />
         </Canvas>
-    </>
-)
+    )
+}
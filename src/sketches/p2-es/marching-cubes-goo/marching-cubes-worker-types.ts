@@ -0,0 +1,35 @@
+export const MarchingCubesWorkerMessageType = {
+    INIT: 0,
+    UPDATE: 1,
+    UPDATED: 2,
+} as const
+
+export type InitMessage = {
+    type: typeof MarchingCubesWorkerMessageType.INIT
+    resolution: number
+    maxBalls: number
+    isolation: number
+    minBlockZ: number
+    maxBlockZ: number
+}
+
+export type UpdateMessage = {
+    type: typeof MarchingCubesWorkerMessageType.UPDATE
+
+    /**
+     * `BALL_STRIDE` values per ball
+     */
+    balls: Float32Array
+    ballCount: number
+}
+
+export type UpdatedMessage = {
+    type: typeof MarchingCubesWorkerMessageType.UPDATED
+
+    /**
+     * The surface of the worker's blocks, `VERTEX_STRIDE` values per vertex, or null if it hasn't changed
+     */
+    vertices: Float32Array | null
+}
+
+export type WorkerMessage = InitMessage | UpdateMessage | UpdatedMessage
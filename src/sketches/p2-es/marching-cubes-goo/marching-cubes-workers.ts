@@ -0,0 +1,123 @@
+import { BLOCK_SIZE, VERTEX_STRIDE } from './marching-cubes'
+import { MarchingCubesWorkerMessageType, WorkerMessage } from './marching-cubes-worker-types'
+import MarchingCubesWorker from './marching-cubes.worker?worker'
+
+export type MarchingCubesWorkersParams = {
+    resolution: number
+    maxBalls: number
+    workerCount: number
+
+    /**
+     * @default 80
+     */
+    isolation?: number
+}
+
+/**
+ * Splits an `IncrementalMarchingCubes` surface across a pool of workers, by ranges of blocks along z, one update in flight at a time.
+ *
+ * Each worker keeps its own field, evaluated where its cubes read it, and only returns vertices when its part of the surface changes.
+ */
+export class MarchingCubesWorkers {
+    workers: InstanceType<typeof MarchingCubesWorker>[] = []
+
+    busy = false
+
+    /**
+     * Whether a surface has arrived since the last `writeVertices`
+     */
+    changed = false
+
+    vertexCount = 0
+
+    private vertices: Float32Array[] = []
+
+    private pending = 0
+
+    constructor({ resolution, maxBalls, workerCount, isolation = 80 }: MarchingCubesWorkersParams) {
+        const blocksPerSide = Math.ceil(resolution / BLOCK_SIZE)
+        workerCount = Math.min(workerCount, blocksPerSide)
+
+        for (let workerIndex = 0; workerIndex < workerCount; workerIndex++) {
+            const worker = new MarchingCubesWorker()
+
+            worker.onmessage = (e: MessageEvent<WorkerMessage>) => {
+                if (e.data.type === MarchingCubesWorkerMessageType.UPDATED) {
+                    this.onUpdated(workerIndex, e.data.vertices)
+                }
+            }
+
+            worker.postMessage({
+                type: MarchingCubesWorkerMessageType.INIT,
+                resolution,
+                maxBalls,
+                isolation,
+                minBlockZ: Math.floor((workerIndex * blocksPerSide) / workerCount),
+                maxBlockZ: Math.floor(((workerIndex + 1) * blocksPerSide) / workerCount),
+            })
+
+            this.workers.push(worker)
+            this.vertices.push(new Float32Array(0))
+        }
+    }
+
+    /**
+     * Sends balls to the workers if no update is in flight, `BALL_STRIDE` values per ball
+     */
+    update(balls: Float32Array, ballCount: number) {
+        if (this.busy) return false
+
+        this.busy = true
+        this.pending = this.workers.length
+
+        for (const worker of this.workers) {
+            worker.postMessage({ type: MarchingCubesWorkerMessageType.UPDATE, balls, ballCount })
+        }
+
+        return true
+    }
+
+    /**
+     * Copies the latest surface to `target`, `VERTEX_STRIDE` values per vertex, starting at vertex `offset`
+     *
+     * @returns the number of vertices written
+     */
+    writeVertices(target: Float32Array, offset = 0) {
+        let written = 0
+
+        for (const vertices of this.vertices) {
+            const count = Math.min(vertices.length / VERTEX_STRIDE, Math.floor(target.length / VERTEX_STRIDE) - offset - written)
+
+            if (count <= 0) continue
+
+            target.set(vertices.subarray(0, count * VERTEX_STRIDE), (offset + written) * VERTEX_STRIDE)
+            written += count
+        }
+
+        this.changed = false
+
+        return written
+    }
+
+    terminate() {
+        for (const worker of this.workers) {
+            worker.terminate()
+        }
+
+        this.workers = []
+    }
+
+    private onUpdated(workerIndex: number, vertices: Float32Array | null) {
+        if (vertices) {
+            this.vertexCount += (vertices.length - this.vertices[workerIndex].length) / VERTEX_STRIDE
+            this.vertices[workerIndex] = vertices
+            this.changed = true
+        }
+
+        this.pending--
+
+        if (this.pending > 0) return
+
+        this.busy = false
+    }
+}
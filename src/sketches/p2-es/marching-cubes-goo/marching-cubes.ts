@@ -0,0 +1,565 @@
+import { edgeTable, triTable } from 'three/examples/jsm/objects/MarchingCubes.js'
+
+/* x, y and z from 0 to 1, strength, subtract, r, g and b */
+export const BALL_STRIDE = 8
+
+/* position, normal and color */
+export const VERTEX_STRIDE = 9
+
+/* field points and cubes per block side, blocks are the unit of re-evaluation */
+export const BLOCK_SIZE = 8
+
+// balls that moved less than this fraction of a cell keep their field
+const MOVE_EPSILON = 0.05
+
+const _vlist = new Float32Array(12 * 3)
+const _nlist = new Float32Array(12 * 3)
+const _clist = new Float32Array(12 * 3)
+
+export type IncrementalMarchingCubesParams = {
+    /**
+     * Field points per side
+     */
+    resolution: number
+
+    maxBalls: number
+
+    /**
+     * @default 80
+     */
+    isolation?: number
+
+    /**
+     * The range of blocks along z to polygonize, for splitting the surface between workers
+     */
+    minBlockZ?: number
+    maxBlockZ?: number
+}
+
+/**
+ * Metaball marching cubes that only re-evaluates the parts of the field that balls have moved through.
+ *
+ * The field is divided into blocks. When a ball moves, the blocks covering its old and new influence bounds have their field
+ * re-evaluated from the balls overlapping them, and the blocks with cubes that read those points are polygonized again.
+ * Each block keeps its own triangles, which `writeVertices` copies out end to end.
+ *
+ * The field and surface match three's MarchingCubes, positions are from -1 to 1 and ball positions from 0 to 1.
+ */
+export class IncrementalMarchingCubes {
+    resolution: number
+    isolation: number
+    maxBalls: number
+
+    blocksPerSide: number
+    minBlockZ: number
+    maxBlockZ: number
+
+    field: Float32Array
+
+    /**
+     * Ball colors per field point, weighted by ball influence
+     */
+    palette: Float32Array
+    paletteWeights: Float32Array
+
+    vertexCount = 0
+
+    private balls: Float32Array
+    private ballCount = 0
+
+    /**
+     * Inclusive field point bounds per ball, min xyz then max xyz, empty when min is greater than max
+     */
+    private ballBounds: Int32Array
+
+    private fieldDirty: Uint8Array
+    private meshDirty: Uint8Array
+    private dirty = false
+
+    private blockVertices: Float32Array[]
+    private blockVertexCounts: Uint32Array
+
+    constructor({ resolution, maxBalls, isolation = 80, minBlockZ, maxBlockZ }: IncrementalMarchingCubesParams) {
+        this.resolution = resolution
+        this.isolation = isolation
+        this.maxBalls = maxBalls
+
+        this.blocksPerSide = Math.ceil(resolution / BLOCK_SIZE)
+        this.minBlockZ = minBlockZ ?? 0
+        this.maxBlockZ = maxBlockZ ?? this.blocksPerSide
+
+        const points = resolution * resolution * resolution
+        this.field = new Float32Array(points)
+        this.palette = new Float32Array(points * 3)
+        this.paletteWeights = new Float32Array(points)
+
+        this.balls = new Float32Array(maxBalls * BALL_STRIDE).fill(NaN)
+        this.ballBounds = new Int32Array(maxBalls * 6)
+
+        for (let i = 0; i < maxBalls; i++) {
+            this.ballBounds[i * 6] = 1
+            this.ballBounds[i * 6 + 3] = 0
+        }
+
+        const blocks = this.blocksPerSide * this.blocksPerSide * this.blocksPerSide
+        this.fieldDirty = new Uint8Array(blocks)
+        this.meshDirty = new Uint8Array(blocks)
+
+        this.blockVertices = Array.from({ length: blocks }, () => new Float32Array(0))
+        this.blockVertexCounts = new Uint32Array(blocks)
+    }
+
+    /**
+     * Sets the balls, `BALL_STRIDE` values per ball. Blocks balls have moved through, or been added to or removed from, are marked for `update`.
+     */
+    setBalls(balls: Float32Array, count: number) {
+        const { resolution, ballBounds } = this
+        const moveEpsilon = MOVE_EPSILON / resolution
+
+        count = Math.min(count, this.maxBalls)
+
+        for (let i = 0; i < Math.max(count, this.ballCount); i++) {
+            const offset = i * BALL_STRIDE
+            const boundsOffset = i * 6
+
+            if (i < count) {
+                /* unchanged balls keep their field */
+                if (
+                    Math.abs(balls[offset] - this.balls[offset]) < moveEpsilon &&
+                    Math.abs(balls[offset + 1] - this.balls[offset + 1]) < moveEpsilon &&
+                    Math.abs(balls[offset + 2] - this.balls[offset + 2]) < moveEpsilon &&
+                    balls[offset + 3] === this.balls[offset + 3] &&
+                    balls[offset + 4] === this.balls[offset + 4] &&
+                    balls[offset + 5] === this.balls[offset + 5] &&
+                    balls[offset + 6] === this.balls[offset + 6] &&
+                    balls[offset + 7] === this.balls[offset + 7]
+                ) {
+                    continue
+                }
+            }
+
+            /* the old bounds */
+            this.markDirty(
+                ballBounds[boundsOffset],
+                ballBounds[boundsOffset + 1],
+                ballBounds[boundsOffset + 2],
+                ballBounds[boundsOffset + 3],
+                ballBounds[boundsOffset + 4],
+                ballBounds[boundsOffset + 5],
+            )
+
+            if (i >= count) {
+                // removed
+                ballBounds[boundsOffset] = 1
+                ballBounds[boundsOffset + 3] = 0
+                this.balls.fill(NaN, offset, offset + BALL_STRIDE)
+
+                continue
+            }
+
+            this.balls.set(balls.subarray(offset, offset + BALL_STRIDE), offset)
+
+            /* the new bounds */
+            const radius = resolution * Math.sqrt(Math.abs(balls[offset + 3]) / balls[offset + 4])
+
+            for (let axis = 0; axis < 3; axis++) {
+                const center = balls[offset + axis] * resolution
+
+                ballBounds[boundsOffset + axis] = Math.max(1, Math.floor(center - radius))
+                ballBounds[boundsOffset + 3 + axis] = Math.min(resolution - 2, Math.floor(center + radius))
+            }
+
+            this.markDirty(
+                ballBounds[boundsOffset],
+                ballBounds[boundsOffset + 1],
+                ballBounds[boundsOffset + 2],
+                ballBounds[boundsOffset + 3],
+                ballBounds[boundsOffset + 4],
+                ballBounds[boundsOffset + 5],
+            )
+        }
+
+        this.ballCount = count
+    }
+
+    /**
+     * Re-evaluates and polygonizes the blocks marked by `setBalls`
+     *
+     * @returns whether the surface changed
+     */
+    update() {
+        if (!this.dirty) return false
+
+        const { blocksPerSide } = this
+
+        /* field */
+        for (let bz = Math.max(0, this.minBlockZ - 1); bz < Math.min(blocksPerSide, this.maxBlockZ + 1); bz++) {
+            for (let by = 0; by < blocksPerSide; by++) {
+                for (let bx = 0; bx < blocksPerSide; bx++) {
+                    const block = (bz * blocksPerSide + by) * blocksPerSide + bx
+
+                    if (!this.fieldDirty[block]) continue
+
+                    this.fieldDirty[block] = 0
+                    this.evaluateBlock(bx, by, bz)
+                }
+            }
+        }
+
+        /* surface */
+        let vertexCount = 0
+
+        for (let bz = this.minBlockZ; bz < this.maxBlockZ; bz++) {
+            for (let by = 0; by < blocksPerSide; by++) {
+                for (let bx = 0; bx < blocksPerSide; bx++) {
+                    const block = (bz * blocksPerSide + by) * blocksPerSide + bx
+
+                    if (this.meshDirty[block]) {
+                        this.meshDirty[block] = 0
+                        this.polygonizeBlock(block, bx, by, bz)
+                    }
+
+                    vertexCount += this.blockVertexCounts[block]
+                }
+            }
+        }
+
+        this.vertexCount = vertexCount
+        this.dirty = false
+
+        return true
+    }
+
+    /**
+     * Copies the surface to `target`, `VERTEX_STRIDE` values per vertex, starting at vertex `offset`
+     *
+     * @returns the number of vertices written
+     */
+    writeVertices(target: Float32Array, offset = 0) {
+        const { blocksPerSide } = this
+        const capacity = Math.floor(target.length / VERTEX_STRIDE)
+
+        let written = 0
+
+        for (let bz = this.minBlockZ; bz < this.maxBlockZ; bz++) {
+            for (let block = bz * blocksPerSide * blocksPerSide; block < (bz + 1) * blocksPerSide * blocksPerSide; block++) {
+                const count = Math.min(this.blockVertexCounts[block], capacity - offset - written)
+
+                if (count <= 0) continue
+
+                target.set(this.blockVertices[block].subarray(0, count * VERTEX_STRIDE), (offset + written) * VERTEX_STRIDE)
+                written += count
+            }
+        }
+
+        return written
+    }
+
+    /**
+     * Marks the blocks with field points in the given inclusive bounds, and the blocks with cubes that read them
+     */
+    private markDirty(minX: number, minY: number, minZ: number, maxX: number, maxY: number, maxZ: number) {
+        if (minX > maxX || minY > maxY || minZ > maxZ) return
+
+        this.dirty = true
+
+        this.markBlocks(this.fieldDirty, minX, minY, minZ, maxX, maxY, maxZ, Math.max(0, this.minBlockZ - 1), this.maxBlockZ + 1)
+
+        // a cube reads field points from one below to two above it, for normals
+        this.markBlocks(this.meshDirty, minX - 2, minY - 2, minZ - 2, maxX + 1, maxY + 1, maxZ + 1, this.minBlockZ, this.maxBlockZ)
+    }
+
+    private markBlocks(
+        blocks: Uint8Array,
+        minX: number,
+        minY: number,
+        minZ: number,
+        maxX: number,
+        maxY: number,
+        maxZ: number,
+        minBlockZ: number,
+        maxBlockZ: number,
+    ) {
+        const { blocksPerSide } = this
+        const last = blocksPerSide - 1
+
+        const minBX = Math.max(0, Math.floor(minX / BLOCK_SIZE))
+        const minBY = Math.max(0, Math.floor(minY / BLOCK_SIZE))
+        const minBZ = Math.max(minBlockZ, Math.floor(minZ / BLOCK_SIZE))
+        const maxBX = Math.min(last, Math.floor(maxX / BLOCK_SIZE))
+        const maxBY = Math.min(last, Math.floor(maxY / BLOCK_SIZE))
+        const maxBZ = Math.min(last, maxBlockZ - 1, Math.floor(maxZ / BLOCK_SIZE))
+
+        for (let bz = minBZ; bz <= maxBZ; bz++) {
+            for (let by = minBY; by <= maxBY; by++) {
+                for (let bx = minBX; bx <= maxBX; bx++) {
+                    blocks[(bz * blocksPerSide + by) * blocksPerSide + bx] = 1
+                }
+            }
+        }
+    }
+
+    /**
+     * Evaluates the field points of a block from the balls overlapping it
+     */
+    private evaluateBlock(bx: number, by: number, bz: number) {
+        const { resolution, field, palette, paletteWeights, ballBounds } = this
+
+        const minX = bx * BLOCK_SIZE
+        const minY = by * BLOCK_SIZE
+        const minZ = bz * BLOCK_SIZE
+        const maxX = Math.min(resolution, minX + BLOCK_SIZE) - 1
+        const maxY = Math.min(resolution, minY + BLOCK_SIZE) - 1
+        const maxZ = Math.min(resolution, minZ + BLOCK_SIZE) - 1
+
+        /* clear */
+        for (let z = minZ; z <= maxZ; z++) {
+            for (let y = minY; y <= maxY; y++) {
+                const rowStart = (z * resolution + y) * resolution
+
+                field.fill(0, rowStart + minX, rowStart + maxX + 1)
+                paletteWeights.fill(0, rowStart + minX, rowStart + maxX + 1)
+                palette.fill(0, (rowStart + minX) * 3, (rowStart + maxX + 1) * 3)
+            }
+        }
+
+        /* add overlapping balls */
+        for (let ball = 0; ball < this.ballCount; ball++) {
+            const boundsOffset = ball * 6
+
+            const x0 = Math.max(minX, ballBounds[boundsOffset])
+            const y0 = Math.max(minY, ballBounds[boundsOffset + 1])
+            const z0 = Math.max(minZ, ballBounds[boundsOffset + 2])
+            const x1 = Math.min(maxX, ballBounds[boundsOffset + 3])
+            const y1 = Math.min(maxY, ballBounds[boundsOffset + 4])
+            const z1 = Math.min(maxZ, ballBounds[boundsOffset + 5])
+
+            if (x0 > x1 || y0 > y1 || z0 > z1) continue
+
+            this.addBall(ball, x0, y0, z0, x1, y1, z1)
+        }
+    }
+
+    private addBall(ball: number, x0: number, y0: number, z0: number, x1: number, y1: number, z1: number) {
+        const { resolution, field, palette, paletteWeights, balls } = this
+
+        const offset = ball * BALL_STRIDE
+        const ballX = balls[offset]
+        const ballY = balls[offset + 1]
+        const ballZ = balls[offset + 2]
+        const sign = Math.sign(balls[offset + 3])
+        const strength = Math.abs(balls[offset + 3])
+        const subtract = balls[offset + 4]
+        const r = balls[offset + 5]
+        const g = balls[offset + 6]
+        const b = balls[offset + 7]
+
+        const radius = resolution * Math.sqrt(strength / subtract)
+        const xs = ballX * resolution
+        const ys = ballY * resolution
+        const zs = ballZ * resolution
+
+        for (let z = z0; z <= z1; z++) {
+            const fz = z / resolution - ballZ
+            const fz2 = fz * fz
+
+            for (let y = y0; y <= y1; y++) {
+                const fy = y / resolution - ballY
+                const fy2 = fy * fy
+                const rowStart = (z * resolution + y) * resolution
+
+                for (let x = x0; x <= x1; x++) {
+                    const fx = x / resolution - ballX
+                    const value = strength / (0.000001 + fx * fx + fy2 + fz2) - subtract
+
+                    if (value <= 0) continue
+
+                    const point = rowStart + x
+                    field[point] += value * sign
+
+                    // smoothstep falloff of the ball color
+                    const ratio = Math.sqrt((x - xs) * (x - xs) + (y - ys) * (y - ys) + (z - zs) * (z - zs)) / radius
+                    const contribution = 1 - ratio * ratio * ratio * (ratio * (ratio * 6 - 15) + 10)
+
+                    palette[point * 3] += r * contribution
+                    palette[point * 3 + 1] += g * contribution
+                    palette[point * 3 + 2] += b * contribution
+                    paletteWeights[point] += contribution
+                }
+            }
+        }
+    }
+
+    private polygonizeBlock(block: number, bx: number, by: number, bz: number) {
+        const { resolution, field, isolation } = this
+
+        const yd = resolution
+        const zd = resolution * resolution
+
+        // cubes read one field point below and two above for normals
+        const minX = Math.max(1, bx * BLOCK_SIZE)
+        const minY = Math.max(1, by * BLOCK_SIZE)
+        const minZ = Math.max(1, bz * BLOCK_SIZE)
+        const maxX = Math.min(resolution - 2, (bx + 1) * BLOCK_SIZE)
+        const maxY = Math.min(resolution - 2, (by + 1) * BLOCK_SIZE)
+        const maxZ = Math.min(resolution - 2, (bz + 1) * BLOCK_SIZE)
+
+        const halfSize = resolution / 2
+        const delta = 2 / resolution
+
+        let vertexCount = 0
+
+        for (let z = minZ; z < maxZ; z++) {
+            const fz = (z - halfSize) / halfSize
+
+            for (let y = minY; y < maxY; y++) {
+                const fy = (y - halfSize) / halfSize
+
+                for (let x = minX; x < maxX; x++) {
+                    const fx = (x - halfSize) / halfSize
+
+                    const q = (z * resolution + y) * resolution + x
+                    const q1 = q + 1
+                    const qy = q + yd
+                    const qz = q + zd
+                    const q1y = q1 + yd
+                    const q1z = q1 + zd
+                    const qyz = q + yd + zd
+                    const q1yz = q1 + yd + zd
+
+                    const field0 = field[q]
+                    const field1 = field[q1]
+                    const field2 = field[qy]
+                    const field3 = field[q1y]
+                    const field4 = field[qz]
+                    const field5 = field[q1z]
+                    const field6 = field[qyz]
+                    const field7 = field[q1yz]
+
+                    let cubeIndex = 0
+                    if (field0 < isolation) cubeIndex |= 1
+                    if (field1 < isolation) cubeIndex |= 2
+                    if (field2 < isolation) cubeIndex |= 8
+                    if (field3 < isolation) cubeIndex |= 4
+                    if (field4 < isolation) cubeIndex |= 16
+                    if (field5 < isolation) cubeIndex |= 32
+                    if (field6 < isolation) cubeIndex |= 128
+                    if (field7 < isolation) cubeIndex |= 64
+
+                    const bits = edgeTable[cubeIndex]
+
+                    if (bits === 0) continue
+
+                    const fx2 = fx + delta
+                    const fy2 = fy + delta
+                    const fz2 = fz + delta
+
+                    /* top of the cube */
+                    if (bits & 1) this.interpolate(0, 0, fx, fy, fz, delta, field0, field1, q, q1)
+                    if (bits & 2) this.interpolate(1, 1, fx2, fy, fz, delta, field1, field3, q1, q1y)
+                    if (bits & 4) this.interpolate(2, 0, fx, fy2, fz, delta, field2, field3, qy, q1y)
+                    if (bits & 8) this.interpolate(3, 1, fx, fy, fz, delta, field0, field2, q, qy)
+
+                    /* bottom of the cube */
+                    if (bits & 16) this.interpolate(4, 0, fx, fy, fz2, delta, field4, field5, qz, q1z)
+                    if (bits & 32) this.interpolate(5, 1, fx2, fy, fz2, delta, field5, field7, q1z, q1yz)
+                    if (bits & 64) this.interpolate(6, 0, fx, fy2, fz2, delta, field6, field7, qyz, q1yz)
+                    if (bits & 128) this.interpolate(7, 1, fx, fy, fz2, delta, field4, field6, qz, qyz)
+
+                    /* vertical lines of the cube */
+                    if (bits & 256) this.interpolate(8, 2, fx, fy, fz, delta, field0, field4, q, qz)
+                    if (bits & 512) this.interpolate(9, 2, fx2, fy, fz, delta, field1, field5, q1, q1z)
+                    if (bits & 1024) this.interpolate(10, 2, fx2, fy2, fz, delta, field3, field7, q1y, q1yz)
+                    if (bits & 2048) this.interpolate(11, 2, fx, fy2, fz, delta, field2, field6, qy, qyz)
+
+                    const tableOffset = cubeIndex << 4
+
+                    for (let i = 0; triTable[tableOffset + i] !== -1; i += 3) {
+                        this.ensureBlockCapacity(block, vertexCount + 3)
+
+                        const vertices = this.blockVertices[block]
+
+                        for (let corner = 0; corner < 3; corner++) {
+                            const edge = triTable[tableOffset + i + corner] * 3
+                            const out = (vertexCount + corner) * VERTEX_STRIDE
+
+                            vertices[out] = _vlist[edge]
+                            vertices[out + 1] = _vlist[edge + 1]
+                            vertices[out + 2] = _vlist[edge + 2]
+                            vertices[out + 3] = _nlist[edge]
+                            vertices[out + 4] = _nlist[edge + 1]
+                            vertices[out + 5] = _nlist[edge + 2]
+                            vertices[out + 6] = _clist[edge]
+                            vertices[out + 7] = _clist[edge + 1]
+                            vertices[out + 8] = _clist[edge + 2]
+                        }
+
+                        vertexCount += 3
+                    }
+                }
+            }
+        }
+
+        this.blockVertexCounts[block] = vertexCount
+    }
+
+    /**
+     * Writes the surface crossing on an edge from field point `p1` to `p2`, which is `delta` along `axis` from `x`, `y`, `z`
+     */
+    private interpolate(
+        edge: number,
+        axis: number,
+        x: number,
+        y: number,
+        z: number,
+        delta: number,
+        value1: number,
+        value2: number,
+        p1: number,
+        p2: number,
+    ) {
+        const { field, palette, paletteWeights, resolution } = this
+
+        const mu = (this.isolation - value1) / (value2 - value1)
+        const offset = edge * 3
+
+        _vlist[offset] = axis === 0 ? x + mu * delta : x
+        _vlist[offset + 1] = axis === 1 ? y + mu * delta : y
+        _vlist[offset + 2] = axis === 2 ? z + mu * delta : z
+
+        /* normals from the field gradient at both points */
+        const yd = resolution
+        const zd = resolution * resolution
+
+        const nx = field[p1 - 1] - field[p1 + 1] + mu * (field[p2 - 1] - field[p2 + 1] - field[p1 - 1] + field[p1 + 1])
+        const ny = field[p1 - yd] - field[p1 + yd] + mu * (field[p2 - yd] - field[p2 + yd] - field[p1 - yd] + field[p1 + yd])
+        const nz = field[p1 - zd] - field[p1 + zd] + mu * (field[p2 - zd] - field[p2 + zd] - field[p1 - zd] + field[p1 + zd])
+        const length = Math.sqrt(nx * nx + ny * ny + nz * nz) || 1
+
+        _nlist[offset] = nx / length
+        _nlist[offset + 1] = ny / length
+        _nlist[offset + 2] = nz / length
+
+        /* colors, normalized by ball influence */
+        const weight1 = paletteWeights[p1] || 1
+        const weight2 = paletteWeights[p2] || 1
+
+        for (let channel = 0; channel < 3; channel++) {
+            const color1 = palette[p1 * 3 + channel] / weight1
+            const color2 = palette[p2 * 3 + channel] / weight2
+
+            _clist[offset + channel] = color1 + mu * (color2 - color1)
+        }
+    }
+
+    private ensureBlockCapacity(block: number, vertexCount: number) {
+        const vertices = this.blockVertices[block]
+
+        if (vertices.length >= vertexCount * VERTEX_STRIDE) return
+
+        const grown = new Float32Array(Math.max(vertexCount, (vertices.length / VERTEX_STRIDE) * 2, 48) * VERTEX_STRIDE)
+        grown.set(vertices)
+
+        this.blockVertices[block] = grown
+    }
+}
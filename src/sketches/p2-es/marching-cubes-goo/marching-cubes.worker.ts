@@ -0,0 +1,27 @@
+import { IncrementalMarchingCubes, VERTEX_STRIDE } from './marching-cubes'
+import { MarchingCubesWorkerMessageType, UpdatedMessage, WorkerMessage } from './marching-cubes-worker-types'
+
+const worker = self as unknown as Worker
+
+let marchingCubes: IncrementalMarchingCubes
+
+worker.onmessage = (e: MessageEvent<WorkerMessage>) => {
+    const data = e.data
+
+    if (data.type === MarchingCubesWorkerMessageType.INIT) {
+        marchingCubes = new IncrementalMarchingCubes(data)
+    } else if (data.type === MarchingCubesWorkerMessageType.UPDATE) {
+        marchingCubes.setBalls(data.balls, data.ballCount)
+
+        let vertices: Float32Array | null = null
+
+        if (marchingCubes.update()) {
+            vertices = new Float32Array(marchingCubes.vertexCount * VERTEX_STRIDE)
+            marchingCubes.writeVertices(vertices)
+        }
+
+        const message: UpdatedMessage = { type: MarchingCubesWorkerMessageType.UPDATED, vertices }
+
+        worker.postMessage(message, { transfer: vertices ? [vertices.buffer] : [] })
+    }
+}
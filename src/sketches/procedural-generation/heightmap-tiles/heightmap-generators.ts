@@ -0,0 +1,249 @@
+import { HeightmapTileRequest } from '@/common/utils/heightmap-tile-worker-types'
+import { createRandom } from '@/common/utils/random'
+import { NoiseFunction2D, NoiseFunction3D, createNoise2D, createNoise3D } from 'simplex-noise'
+
+export type DiamondSquareParams = {
+    generator: 'diamond-square'
+
+    /**
+     * The degree of randomness
+     */
+    range: number
+}
+
+export type SimplexTerrainParams = {
+    generator: 'simplex'
+
+    /**
+     * World units per tile side
+     */
+    tileSize: number
+
+    /**
+     * Noise frequency per world unit
+     */
+    scale: number
+
+    octaves: number
+    amplitude: number
+}
+
+export type PlanetNoiseParams = {
+    generator: 'planet'
+    radius: number
+    noiseIterations: number
+}
+
+export type ProcgenHeightmapParams = DiamondSquareParams | SimplexTerrainParams | PlanetNoiseParams
+
+/**
+ * Performs a diamond step
+ * @param map the terrain, row major
+ * @param size the size of the map
+ * @param sideLength the side length of the square
+ * @param range the degree of randomness
+ */
+const diamondStep = (map: Float32Array, size: number, sideLength: number, range: number, random: () => number) => {
+    const halfSideLength = Math.floor(sideLength / 2)
+    const squares = Math.floor(size / (sideLength - 1))
+
+    for (let y = 0; y < squares; y++) {
+        for (let x = 0; x < squares; x++) {
+            const top = y * (sideLength - 1)
+            const bottom = (y + 1) * (sideLength - 1)
+            const left = x * (sideLength - 1)
+            const right = (x + 1) * (sideLength - 1)
+
+            // find the average corners value
+            const average = (map[top * size + left] + map[bottom * size + left] + map[top * size + right] + map[bottom * size + right]) / 4
+
+            // set the center of the square to the average of the corners plus a random value between -range and range
+            map[(top + halfSideLength) * size + left + halfSideLength] = average + (random() * 2 - 1) * range
+        }
+    }
+}
+
+/**
+ * Sets a diamond midpoint to the average of the diamond corners plus a random value
+ */
+const squareStepMidpoint = (map: Float32Array, size: number, y: number, x: number, halfSideLength: number, range: number, random: () => number) => {
+    let counter = 0
+    let sum = 0
+
+    if (x !== 0) {
+        sum += map[y * size + x - halfSideLength]
+        counter++
+    }
+    if (y !== 0) {
+        sum += map[(y - halfSideLength) * size + x]
+        counter++
+    }
+    if (x !== size - 1) {
+        sum += map[y * size + x + halfSideLength]
+        counter++
+    }
+    if (y !== size - 1) {
+        sum += map[(y + halfSideLength) * size + x]
+        counter++
+    }
+
+    map[y * size + x] = sum / counter + (random() - 0.5) * range
+}
+
+/**
+ * Performs a square step
+ * @param map the terrain, row major
+ * @param size the size of the map
+ * @param sideLength the side length of the diamond
+ * @param range the degree of randomness
+ */
+const squareStep = (map: Float32Array, size: number, sideLength: number, range: number, random: () => number) => {
+    const halfSideLength = Math.floor(sideLength / 2)
+    const squares = Math.floor(size / (sideLength - 1))
+
+    for (let y = 0; y < squares; y++) {
+        for (let x = 0; x < squares; x++) {
+            const top = y * (sideLength - 1)
+            const left = x * (sideLength - 1)
+
+            squareStepMidpoint(map, size, top + halfSideLength, left, halfSideLength, range, random) // left
+            squareStepMidpoint(map, size, top + halfSideLength, left + sideLength - 1, halfSideLength, range, random) // right
+            squareStepMidpoint(map, size, top, left + halfSideLength, halfSideLength, range, random) // top
+            squareStepMidpoint(map, size, top + sideLength - 1, left + halfSideLength, halfSideLength, range, random) // bottom
+        }
+    }
+}
+
+/**
+ * Generates a terrain map using the diamond square algorithm. The tile must be square, with a power of 2 plus 1 samples per side.
+ * Tiles aren't continuous with their neighbours, so this is for whole maps.
+ */
+export const generateDiamondSquare = (tile: HeightmapTileRequest<DiamondSquareParams>, map: Float32Array) => {
+    const size = tile.width
+    const { range } = tile.params
+    // seeded, so tiles with the same seed are the same in every worker
+    const random = createRandom(tile.seed)
+
+    // initialise corners with random values
+    map[0] = random() * range
+    map[size - 1] = random() * range
+    map[(size - 1) * size] = random() * range
+    map[(size - 1) * size + size - 1] = random() * range
+
+    // do an initial diamond and square step
+    let randomFactor = range / 2
+    diamondStep(map, size, size, randomFactor, random)
+    squareStep(map, size, size, randomFactor, random)
+
+    let sideLength = Math.floor(size / 2)
+
+    // loop until the side length is less than 2
+    while (sideLength >= 2) {
+        diamondStep(map, size, sideLength + 1, randomFactor, random)
+        squareStep(map, size, sideLength + 1, randomFactor, random)
+
+        // half the side length and range
+        sideLength = Math.floor(sideLength / 2)
+        randomFactor = Math.floor(randomFactor / 2)
+    }
+}
+
+/* noise functions for the last seed, tiles are usually requested for one seed at a time */
+let noise2DSeed = -1
+let noise2D: NoiseFunction2D
+
+let noise3DSeed = -1
+let noise3D: NoiseFunction3D
+
+const getNoise2D = (seed: number) => {
+    if (seed !== noise2DSeed) {
+        noise2DSeed = seed
+        noise2D = createNoise2D(createRandom(seed))
+    }
+
+    return noise2D
+}
+
+const getNoise3D = (seed: number) => {
+    if (seed !== noise3DSeed) {
+        noise3DSeed = seed
+        noise3D = createNoise3D(createRandom(seed))
+    }
+
+    return noise3D
+}
+
+/**
+ * Fractal simplex noise terrain. Tile edge samples are at the same world positions as their neighbours' edge samples, so tiles meet without seams.
+ */
+export const generateSimplexTerrain = (tile: HeightmapTileRequest<SimplexTerrainParams>, heights: Float32Array) => {
+    const { width, height } = tile
+    const { tileSize, scale, octaves, amplitude } = tile.params
+    const noise = getNoise2D(tile.seed)
+
+    for (let j = 0; j < height; j++) {
+        const z = (tile.z + j / (height - 1)) * tileSize
+
+        for (let i = 0; i < width; i++) {
+            const x = (tile.x + i / (width - 1)) * tileSize
+
+            let value = 0
+            let frequency = scale
+            let octaveAmplitude = 1
+
+            for (let octave = 0; octave < octaves; octave++) {
+                value += noise(x * frequency, z * frequency) * octaveAmplitude
+
+                frequency *= 2
+                octaveAmplitude /= 2
+            }
+
+            heights[j * width + i] = value * amplitude
+        }
+    }
+}
+
+/**
+ * Noise on the surface of a sphere, as an equirectangular map clamped to -1 to 1. Tile coordinates are ignored.
+ */
+export const generatePlanetNoise = (tile: HeightmapTileRequest<PlanetNoiseParams>, heights: Float32Array) => {
+    const { width, height } = tile
+    const { radius, noiseIterations } = tile.params
+    const noise3d = getNoise3D(tile.seed)
+
+    for (let i = 0; i < width * height; i++) {
+        // convert index to map x and y
+        const textureX = i % width
+        const textureY = Math.floor(i / width)
+
+        // convert x and y to latitude and longitude
+        const lat = (textureY / height) * Math.PI - Math.PI / 2 // Latitude ranges from -π/2 to π/2
+        const lon = (textureX / width) * 2 * Math.PI - Math.PI // Longitude ranges from -π to π
+
+        // convert long and lat to 3D cartesian coordinates
+        const x = radius * Math.cos(lat) * Math.cos(lon)
+        const y = radius * Math.sin(lat)
+        const z = radius * Math.cos(lat) * Math.sin(lon)
+
+        // sample 3d noise
+        let noise = noise3d(x, y, z)
+        for (let iter = 1; iter < noiseIterations; iter++) {
+            noise += noise3d(x * iter * 2, y * iter * 2, z * iter * 2) / (iter * 2)
+        }
+
+        // clamp noise to -1 to 1
+        heights[i] = Math.min(Math.max(noise, -1), 1)
+    }
+}
+
+export const generateProcgenHeightmap = (tile: HeightmapTileRequest<ProcgenHeightmapParams>, heights: Float32Array) => {
+    const { params } = tile
+
+    if (params.generator === 'diamond-square') {
+        generateDiamondSquare(tile as HeightmapTileRequest<DiamondSquareParams>, heights)
+    } else if (params.generator === 'simplex') {
+        generateSimplexTerrain(tile as HeightmapTileRequest<SimplexTerrainParams>, heights)
+    } else if (params.generator === 'planet') {
+        generatePlanetNoise(tile as HeightmapTileRequest<PlanetNoiseParams>, heights)
+    }
+}
@@ -0,0 +1,4 @@
+import { runHeightmapTileWorker } from '@/common/utils/heightmap-tile-worker'
+import { ProcgenHeightmapParams, generateProcgenHeightmap } from './heightmap-generators'
+
+runHeightmapTileWorker<ProcgenHeightmapParams>({ generate: generateProcgenHeightmap })
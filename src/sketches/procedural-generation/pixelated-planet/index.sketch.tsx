@@ -1,11 +1,13 @@
 import { Html, OrbitControls } from '@react-three/drei'
 import { EffectComposer, Pixelation } from '@react-three/postprocessing'
 import { button, useControls } from 'leva'
-import { useMemo, useState } from 'react'
-import { createNoise3D } from 'simplex-noise'
+import { useEffect, useMemo, useState } from 'react'
 import * as THREE from 'three'
 import { Canvas } from '@/common'
+import { HeightmapTiles } from '@/common/utils/heightmap-tiles'
 import { useThree } from '@react-three/fiber'
+import { ProcgenHeightmapParams } from '../heightmap-tiles/heightmap-generators'
+import HeightmapTileWorker from '../heightmap-tiles/heightmap-tile.worker?worker'
 
 type PlanetLayer = {
     /**
@@ -27,21 +29,16 @@ type PlanetLayer = {
 
 type GeneratePlanetTextureProps = {
     layers: PlanetLayer[]
-    noise3d: (x: number, y: number, z: number) => number
-    noiseIterations: number
+
+    /**
+     * Equirectangular noise between -1 and 1, `width` samples per row
+     */
+    noise: Float32Array
     width: number
     height: number
-    radius: number
 }
 
-const generatePlanetTexture = ({
-    layers,
-    noise3d,
-    noiseIterations,
-    width,
-    height,
-    radius,
-}: GeneratePlanetTextureProps): THREE.Texture => {
+const generatePlanetTexture = ({ layers, noise, width, height }: GeneratePlanetTextureProps): THREE.Texture => {
     const size = width * height
     const data = new Uint8Array(size * 4)
 
@@ -50,30 +47,8 @@ const generatePlanetTexture = ({
     for (let i = 0; i < size; i++) {
         const stride = i * 4
 
-        // convert index to map x and y
-        const textureX = i % width
-        const textureY = Math.floor(i / width)
-
-        // convert x and y to latitude and longitude
-        const lat = (textureY / height) * Math.PI - Math.PI / 2 // Latitude ranges from -π/2 to π/2
-        const lon = (textureX / width) * 2 * Math.PI - Math.PI // Longitude ranges from -π to π
-
-        // convert long and lat to 3D cartesian coordinates
-        const x = radius * Math.cos(lat) * Math.cos(lon)
-        const y = radius * Math.sin(lat)
-        const z = radius * Math.cos(lat) * Math.sin(lon)
-
-        // sample 3d noise
-        let noise = noise3d(x, y, z)
-        for (let iter = 1; iter < noiseIterations; iter++) {
-            noise += noise3d(x * iter * 2, y * iter * 2, z * iter * 2) / (iter * 2)
-        }
-
-        // clamp noise to -1 to 1
-        noise = Math.min(Math.max(noise, -1), 1)
-
         // find layer
-        const layer = layers.find((layer) => noise <= layer.max)
+        const layer = layers.find((layer) => noise[i] <= layer.max)
 
         // set color
         color.set(layer?.color ?? '#000000')
@@ -183,8 +158,44 @@ const Effects = () => {
     )
 }
 
+const layers: PlanetLayer[] = [
+    {
+        name: 'ocean',
+        max: 0,
+        color: '#0000ff',
+    },
+    {
+        name: 'shallow ocean',
+        max: 0.15,
+        color: '#6699ff',
+    },
+    {
+        name: 'beach',
+        max: 0.17,
+        color: '#ffffee',
+    },
+    {
+        name: 'landmass',
+        max: 0.8,
+        color: '#66ff66',
+    },
+    {
+        name: 'mountains',
+        max: 0.88,
+        color: '#f3f3f3',
+    },
+    {
+        name: 'snow',
+        max: 1,
+        color: '#ffffff',
+    },
+]
+
+const randomSeed = () => Math.floor(Math.random() * 2 ** 32)
+
 export default () => {
-    const [version, setVersion] = useState(0)
+    const [seed, setSeed] = useState(randomSeed)
+    const [map, setMap] = useState<THREE.Texture>()
 
     const { planetRadius, noiseIterations, textureWidth, textureHeight } = useControls(
         'procgen-pixelated-planet-generation-config',
@@ -203,65 +214,68 @@ export default () => {
             textureWidth: 300,
             textureHeight: 100,
             Regenerate: button(() => {
-                setVersion((v) => v + 1)
+                setSeed(randomSeed())
             }),
         },
     )
 
-    const map = useMemo(() => {
-        const layers: PlanetLayer[] = [
-            {
-                name: 'ocean',
-                max: 0,
-                color: '#0000ff',
-            },
-            {
-                name: 'shallow ocean',
-                max: 0.15,
-                color: '#6699ff',
-            },
-            {
-                name: 'beach',
-                max: 0.17,
-                color: '#ffffee',
-            },
-            {
-                name: 'landmass',
-                max: 0.8,
-                color: '#66ff66',
-            },
-            {
-                name: 'mountains',
-                max: 0.88,
-                color: '#f3f3f3',
-            },
-            {
-                name: 'snow',
-                max: 1,
-                color: '#ffffff',
-            },
-        ]
+    const tiles = useMemo(
+        () =>
+            new HeightmapTiles<ProcgenHeightmapParams>({
+                createWorker: () => new HeightmapTileWorker(),
+                workerPoolSize: 1,
+                width: textureWidth,
+                height: textureHeight,
+                params: { generator: 'planet', radius: planetRadius, noiseIterations },
+            }),
+        [],
+    )
+
+    useEffect(() => {
+        tiles.connect()
 
-        return generatePlanetTexture({
-            noise3d: createNoise3D(Math.random),
-            noiseIterations,
-            layers,
+        return () => tiles.disconnect()
+    }, [])
+
+    useEffect(() => {
+        let cancelled = false
+
+        // the previous planet is shown until the worker returns the new noise
+        tiles.configure({
             width: textureWidth,
             height: textureHeight,
-            radius: planetRadius,
+            params: { generator: 'planet', radius: planetRadius, noiseIterations },
         })
-    }, [noiseIterations, planetRadius, textureWidth, textureHeight, version])
+
+        tiles.requestTile(seed, 0, 0).then((tile) => {
+            if (cancelled) return
+
+            setMap(generatePlanetTexture({ layers, noise: tile.heights, width: tile.width, height: tile.height }))
+        })
+
+        return () => {
+            cancelled = true
+        }
+    }, [noiseIterations, planetRadius, textureWidth, textureHeight, seed])
+
+    useEffect(() => {
+        return () => map?.dispose()
+    }, [map])
 
     return (
         <>
             <Canvas orthographic camera={{ position: [0, 0, 10], zoom: 200 }}>
-                <Planet map={map} radius={planetRadius} />
+                {map && (
+                    <>
+                        <Planet map={map} radius={planetRadius} />
+
+                        <WorldMap map={map} />
+                    </>
+                )}
 
                 <directionalLight position={[10, 0, 10]} intensity={2} />
                 <ambientLight intensity={0.6} />
 
-                <WorldMap map={map} />
-
                 <Effects />
 
                 <OrbitControls enablePan={false} />
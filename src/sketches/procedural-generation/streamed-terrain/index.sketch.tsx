@@ -0,0 +1,198 @@
+import { Canvas } from '@/common'
+import { HeightmapTile } from '@/common/utils/heightmap-tile-worker-types'
+import { HeightmapTiles } from '@/common/utils/heightmap-tiles'
+import { MapControls } from '@react-three/drei'
+import { useFrame, useThree } from '@react-three/fiber'
+import { useControls } from 'leva'
+import { useEffect, useMemo, useRef } from 'react'
+import * as THREE from 'three'
+import { ProcgenHeightmapParams } from '../heightmap-tiles/heightmap-generators'
+import HeightmapTileWorker from '../heightmap-tiles/heightmap-tile.worker?worker'
+
+const TILE_SIZE = 64
+
+// Tile resolutions share edge samples with their neighbours, a power of 2 plus 1
+const resolutionOptions = [17, 33, 65, 129]
+
+const _focus = new THREE.Vector3()
+
+const createTileGeometry = (tile: HeightmapTile) => {
+    const geometry = new THREE.PlaneGeometry(TILE_SIZE, TILE_SIZE, tile.width - 1, tile.height - 1)
+
+    // rows along +z, row major like the heights
+    geometry.rotateX(-Math.PI / 2)
+
+    const positions = geometry.attributes.position
+
+    for (let i = 0; i < tile.heights.length; i++) {
+        positions.setY(i, tile.heights[i])
+    }
+
+    geometry.computeVertexNormals()
+    geometry.computeBoundingSphere()
+
+    return geometry
+}
+
+type TerrainProps = {
+    seed: number
+    resolution: number
+    viewDistance: number
+    amplitude: number
+}
+
+const Terrain = ({ seed, resolution, viewDistance, amplitude }: TerrainProps) => {
+    const controls = useThree((s) => s.controls) as unknown as { target: THREE.Vector3 } | null
+
+    const group = useRef<THREE.Group>(null!)
+    const meshes = useRef(new Map<string, THREE.Mesh>())
+    const lastFocus = useRef({ x: NaN, z: NaN })
+
+    // tiles for a previous seed can arrive after it changes
+    const seedRef = useRef(seed)
+    seedRef.current = seed
+
+    const material = useMemo(() => new THREE.MeshStandardMaterial({ color: '#8a9a6a' }), [])
+
+    const tiles = useMemo(
+        () =>
+            new HeightmapTiles<ProcgenHeightmapParams>({
+                createWorker: () => new HeightmapTileWorker(),
+                workerPoolSize: Math.max(1, Math.min(4, (navigator.hardwareConcurrency ?? 4) - 1)),
+                // more than the tiles within the max view distance
+                maxCachedTiles: 2048,
+                width: resolution,
+                height: resolution,
+                params: { generator: 'simplex', tileSize: TILE_SIZE, scale: 0.004, octaves: 6, amplitude },
+            }),
+        [],
+    )
+
+    const clearMeshes = () => {
+        for (const mesh of meshes.current.values()) {
+            mesh.removeFromParent()
+            mesh.geometry.dispose()
+        }
+
+        meshes.current.clear()
+        lastFocus.current.x = NaN
+    }
+
+    const addMesh = (tile: HeightmapTile) => {
+        const key = `${tile.x}:${tile.z}`
+
+        if (tile.seed !== seedRef.current || meshes.current.has(key)) return
+
+        const mesh = new THREE.Mesh(createTileGeometry(tile), material)
+        mesh.position.set((tile.x + 0.5) * TILE_SIZE, 0, (tile.z + 0.5) * TILE_SIZE)
+        mesh.userData.tile = tile
+
+        group.current.add(mesh)
+        meshes.current.set(key, mesh)
+    }
+
+    useEffect(() => {
+        tiles.onTile = addMesh
+
+        tiles.connect()
+
+        return () => {
+            tiles.disconnect()
+            clearMeshes()
+            material.dispose()
+        }
+    }, [])
+
+    useEffect(() => {
+        tiles.configure({
+            width: resolution,
+            height: resolution,
+            params: { generator: 'simplex', tileSize: TILE_SIZE, scale: 0.004, octaves: 6, amplitude },
+        })
+
+        clearMeshes()
+    }, [resolution, amplitude])
+
+    useEffect(() => {
+        clearMeshes()
+    }, [seed])
+
+    useEffect(() => {
+        lastFocus.current.x = NaN
+    }, [viewDistance])
+
+    useFrame(({ camera }) => {
+        if (controls) {
+            _focus.copy(controls.target)
+        } else {
+            _focus.copy(camera.position)
+        }
+
+        const focusX = _focus.x / TILE_SIZE
+        const focusZ = _focus.z / TILE_SIZE
+
+        /* only restream when the focus moves a good part of a tile */
+        const dx = focusX - lastFocus.current.x
+        const dz = focusZ - lastFocus.current.z
+
+        if (dx * dx + dz * dz < 0.25 * 0.25) return
+
+        lastFocus.current.x = focusX
+        lastFocus.current.z = focusZ
+
+        const radius = viewDistance / TILE_SIZE
+
+        tiles.stream(seed, focusX, focusZ, radius)
+
+        /* meshes for tiles that are still cached from an earlier visit */
+        for (let z = Math.floor(focusZ - radius); z <= Math.ceil(focusZ + radius); z++) {
+            for (let x = Math.floor(focusX - radius); x <= Math.ceil(focusX + radius); x++) {
+                const tile = tiles.getTile(seed, x, z)
+
+                if (tile) addMesh(tile)
+            }
+        }
+
+        /* drop meshes a tile beyond the view distance, the tiles stay cached for a while if the focus comes back */
+        for (const [key, mesh] of meshes.current) {
+            const tile = mesh.userData.tile as HeightmapTile
+
+            const tileDx = tile.x + 0.5 - focusX
+            const tileDz = tile.z + 0.5 - focusZ
+
+            if (Math.sqrt(tileDx * tileDx + tileDz * tileDz) <= radius + 1) continue
+
+            mesh.removeFromParent()
+            mesh.geometry.dispose()
+            meshes.current.delete(key)
+        }
+    })
+
+    return <group ref={group} />
+}
+
+export default () => {
+    const { seed, resolution, viewDistance, amplitude } = useControls('procgen-streamed-terrain', {
+        seed: { value: 1, step: 1 },
+        resolution: {
+            value: resolutionOptions[1],
+            options: resolutionOptions,
+        },
+        viewDistance: { value: 600, min: 100, max: 1500, step: 50 },
+        amplitude: { value: 80, min: 0, max: 200 },
+    })
+
+    return (
+        <Canvas camera={{ position: [0, 250, 350], far: 4000 }}>
+            <Terrain seed={seed} resolution={resolution} viewDistance={viewDistance} amplitude={amplitude} />
+
+            <fog attach="fog" args={['#bcd', viewDistance * 0.5, viewDistance]} />
+            <color attach="background" args={['#bcd']} />
+
+            <ambientLight intensity={0.6} />
+            <directionalLight position={[100, 200, 50]} intensity={2} />
+
+            <MapControls makeDefault />
+        </Canvas>
+    )
+}
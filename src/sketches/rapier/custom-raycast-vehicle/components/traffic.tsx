@@ -0,0 +1,200 @@
+import { InstancedRigidBodies, InstancedRigidBodyProps, RapierRigidBody, useBeforePhysicsStep, useRapier } from '@react-three/rapier'
+import { useEffect, useLayoutEffect, useMemo, useRef } from 'react'
+import * as THREE from 'three'
+import { RapierRaycastVehicleFleet } from '../lib/rapier-raycast-vehicle-fleet'
+import { WheelOptions } from '../lib/rapier-raycast-vehicle'
+
+const TRAFFIC_CENTER = new THREE.Vector3(0, 0, 75)
+const TRAFFIC_SPACING = 8
+const TRAFFIC_LANE_WIDTH = 5
+const TRAFFIC_MIN_RADIUS = 30
+const TRAFFIC_MAX_STEER = 0.6
+const TRAFFIC_ENGINE_FORCE = 15
+
+const CHASSIS_HALF_EXTENTS: THREE.Vector3Tuple = [2.35, 0.55, 1]
+const WHEEL_RADIUS = 0.38
+const COLORS = ['#f0c050', 'skyblue', 'hotpink', 'white', 'orange']
+
+const wheelOptions: Omit<WheelOptions, 'chassisConnectionPointLocal'> = {
+    radius: WHEEL_RADIUS,
+    directionLocal: new THREE.Vector3(0, -1, 0),
+    axleLocal: new THREE.Vector3(0, 0, 1),
+    suspensionStiffness: 30,
+    suspensionRestLength: 0.3,
+    maxSuspensionForce: 100000,
+    maxSuspensionTravel: 0.3,
+    sideFrictionStiffness: 1,
+    frictionSlip: 1.4,
+    dampingRelaxation: 2.3,
+    dampingCompression: 4.4,
+    rollInfluence: 0.01,
+    customSlidingRotationalSpeed: -30,
+    useCustomSlidingRotationalSpeed: true,
+    forwardAcceleration: 1,
+    sideAcceleration: 1,
+}
+
+// steered front wheels first, then driven back wheels
+const wheelConnectionPoints = [
+    new THREE.Vector3(1.3, -0.3, 0.85),
+    new THREE.Vector3(1.3, -0.3, -0.85),
+    new THREE.Vector3(-1.35, -0.3, 0.85),
+    new THREE.Vector3(-1.35, -0.3, -0.85),
+]
+
+const _matrix4 = new THREE.Matrix4()
+const _position = new THREE.Vector3()
+const _quaternion = new THREE.Quaternion()
+const _scale = new THREE.Vector3(1, 1, 1)
+const _color = new THREE.Color()
+
+/**
+ * Cars in lanes around a ring, the steering targets for each lane
+ */
+const getTrafficInstances = (count: number) => {
+    const instances: InstancedRigidBodyProps[] = []
+    const laneRadii: number[] = []
+
+    let radius = TRAFFIC_MIN_RADIUS
+
+    while (instances.length < count) {
+        const carsInLane = Math.floor((2 * Math.PI * radius) / TRAFFIC_SPACING)
+
+        for (let i = 0; i < carsInLane && instances.length < count; i++) {
+            const angle = (i / carsInLane) * Math.PI * 2
+
+            instances.push({
+                key: instances.length,
+                position: [TRAFFIC_CENTER.x + Math.cos(angle) * radius, 1.5, TRAFFIC_CENTER.z + Math.sin(angle) * radius],
+                // face counter clockwise along the ring, forward is +x
+                rotation: [0, -angle - Math.PI / 2, 0],
+            })
+
+            laneRadii.push(radius)
+        }
+
+        radius += TRAFFIC_LANE_WIDTH
+    }
+
+    return { instances, laneRadii }
+}
+
+export type TrafficProps = {
+    count: number
+}
+
+/**
+ * AI cars driving in lanes around a ring, simulated with one `RapierRaycastVehicleFleet`
+ */
+export const Traffic = ({ count }: TrafficProps) => {
+    const { world } = useRapier()
+
+    const rigidBodies = useRef<RapierRigidBody[]>(null)
+    const chassisMesh = useRef<THREE.InstancedMesh>(null!)
+    const wheelMesh = useRef<THREE.InstancedMesh>(null!)
+
+    const fleet = useRef<RapierRaycastVehicleFleet | null>(null)
+
+    const { instances, laneRadii } = useMemo(() => getTrafficInstances(count), [count])
+
+    const wheelGeometry = useMemo(() => {
+        // axle along local z
+        const geometry = new THREE.CylinderGeometry(WHEEL_RADIUS, WHEEL_RADIUS, 0.3, 16)
+        geometry.rotateX(Math.PI / 2)
+
+        return geometry
+    }, [])
+
+    useLayoutEffect(() => {
+        for (let i = 0; i < count; i++) {
+            chassisMesh.current.setColorAt(i, _color.set(COLORS[i % COLORS.length]))
+        }
+
+        chassisMesh.current.instanceColor!.needsUpdate = true
+    }, [count])
+
+    useEffect(() => {
+        if (!rigidBodies.current) return
+
+        const vehicleFleet = new RapierRaycastVehicleFleet({ world, maxVehicles: count })
+
+        const wheels = wheelConnectionPoints.map((chassisConnectionPointLocal) => ({ ...wheelOptions, chassisConnectionPointLocal }))
+
+        for (const body of rigidBodies.current) {
+            vehicleFleet.addVehicle(body, wheels)
+        }
+
+        fleet.current = vehicleFleet
+
+        return () => {
+            fleet.current = null
+        }
+    }, [count])
+
+    useBeforePhysicsStep((world) => {
+        const vehicleFleet = fleet.current
+
+        if (!vehicleFleet) return
+
+        const { chassisTranslation: t, chassisQuaternion: q } = vehicleFleet
+
+        /* steer towards the lane tangent, using chassis state from the last update */
+        for (let vehicle = 0; vehicle < vehicleFleet.vehicleCount; vehicle++) {
+            const x = t[vehicle * 3] - TRAFFIC_CENTER.x
+            const z = t[vehicle * 3 + 2] - TRAFFIC_CENTER.z
+            const radius = Math.sqrt(x * x + z * z) || 1
+
+            // tangent, corrected towards the lane
+            const correction = THREE.MathUtils.clamp((laneRadii[vehicle] - radius) / 10, -0.5, 0.5)
+            const dx = -z / radius + (x / radius) * correction
+            const dz = x / radius + (z / radius) * correction
+
+            // forward, local +x
+            const qx = q[vehicle * 4]
+            const qy = q[vehicle * 4 + 1]
+            const qz = q[vehicle * 4 + 2]
+            const qw = q[vehicle * 4 + 3]
+            const fx = 1 - 2 * (qy * qy + qz * qz)
+            const fz = 2 * (qx * qz - qw * qy)
+
+            // signed angle around +y from forward to the target direction
+            const angle = Math.atan2(fz * dx - fx * dz, fx * dx + fz * dz)
+            const steering = THREE.MathUtils.clamp(angle, -TRAFFIC_MAX_STEER, TRAFFIC_MAX_STEER)
+
+            vehicleFleet.setSteeringValue(steering, vehicle, 0)
+            vehicleFleet.setSteeringValue(steering, vehicle, 1)
+            vehicleFleet.applyEngineForce(TRAFFIC_ENGINE_FORCE, vehicle, 2)
+            vehicleFleet.applyEngineForce(TRAFFIC_ENGINE_FORCE, vehicle, 3)
+        }
+
+        vehicleFleet.update(world.timestep)
+
+        /* wheels */
+        const { wheelPositions, wheelQuaternions } = vehicleFleet
+
+        for (let wheel = 0; wheel < vehicleFleet.wheelCount; wheel++) {
+            _position.fromArray(wheelPositions, wheel * 3)
+            _quaternion.fromArray(wheelQuaternions, wheel * 4)
+            _matrix4.compose(_position, _quaternion, _scale)
+
+            wheelMesh.current.setMatrixAt(wheel, _matrix4)
+        }
+
+        wheelMesh.current.instanceMatrix.needsUpdate = true
+    })
+
+    return (
+        <>
+            <InstancedRigidBodies key={count} ref={rigidBodies} instances={instances} colliders="cuboid" mass={150}>
+                <instancedMesh ref={chassisMesh} args={[undefined, undefined, count]} castShadow frustumCulled={false}>
+                    <boxGeometry args={[CHASSIS_HALF_EXTENTS[0] * 2, CHASSIS_HALF_EXTENTS[1] * 2, CHASSIS_HALF_EXTENTS[2] * 2]} />
+                    <meshStandardMaterial />
+                </instancedMesh>
+            </InstancedRigidBodies>
+
+            <instancedMesh ref={wheelMesh} args={[wheelGeometry, undefined, count * 4]} frustumCulled={false}>
+                <meshStandardMaterial color="#222" />
+            </instancedMesh>
+        </>
+    )
+}
@@ -7,6 +7,7 @@ import styled from 'styled-components'
 import { Quaternion, Vector3 } from 'three'
 import { Canvas, useLoadingAssets, usePageVisible } from '@/common'
 import { LampPost } from './components/lamp-post'
+import { Traffic } from './components/traffic'
 import { TrafficCone } from './components/traffic-cone'
 import { Vehicle, VehicleRef } from './components/vehicle'
 import { AFTER_RAPIER_UPDATE, LEVA_KEY, RAPIER_UPDATE_PRIORITY } from './constants'
@@ -62,6 +63,11 @@ const Game = () => {
         maxBrake: 2,
     })
 
+    const { traffic, trafficCount } = useLeva(`${LEVA_KEY}-traffic`, {
+        traffic: false,
+        trafficCount: { value: 500, min: 50, max: 900, step: 50 },
+    })
+
     useBeforePhysicsStep((world) => {
         if (!raycastVehicle.current || !raycastVehicle.current.rapierRaycastVehicle.current) {
             return
@@ -167,6 +173,9 @@ const Game = () => {
             {/* raycast vehicle */}
             <Vehicle ref={raycastVehicle} position={[0, 5, 0]} rotation={[0, -Math.PI / 2, 0]} />
 
+            {/* ai traffic */}
+            {traffic && <Traffic count={trafficCount} />}
+
             {/* lamp posts */}
             <LampPost position={[10, 0, 0]} />
             <LampPost position={[-10, 0, 25]} rotation-y={Math.PI} />
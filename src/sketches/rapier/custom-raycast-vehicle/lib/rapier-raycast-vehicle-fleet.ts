@@ -0,0 +1,1087 @@
+import Rapier from '@dimforge/rapier3d-compat'
+import { WheelOptions } from './rapier-raycast-vehicle'
+
+export type RaycastVehicleFleetOptions = {
+    world: Rapier.World
+    maxVehicles: number
+
+    /**
+     * @default maxVehicles * 4
+     */
+    maxWheels?: number
+
+    indexRightAxis?: number
+    indexForwardAxis?: number
+    indexUpAxis?: number
+}
+
+const SIDE_FACTOR = 1
+const FORWARD_FACTOR = 0.5
+const CONTACT_DAMPING = 0.2
+
+const _impulse = { x: 0, y: 0, z: 0 }
+const _torque = { x: 0, y: 0, z: 0 }
+
+/* scratch for ground velocity and friction denominators */
+const _vector = new Float32Array(3)
+
+/**
+ * Raycast vehicle solver for many Rapier vehicles, following `RapierRaycastVehicle`.
+ *
+ * Wheel options and state for all vehicles are kept in flat typed arrays, indexed by wheel. Each update reads every chassis once,
+ * casts every suspension ray with one reused ray, solves suspension, friction and wheel rotation in loops over all wheels,
+ * and applies one accumulated impulse and torque impulse per chassis.
+ *
+ * Wheel world transforms are in `wheelPositions` and `wheelQuaternions`, for writing to instanced meshes.
+ */
+export class RapierRaycastVehicleFleet {
+    world: Rapier.World
+
+    maxVehicles: number
+    maxWheels: number
+
+    vehicleCount = 0
+    wheelCount = 0
+
+    indexRightAxis: number
+    indexForwardAxis: number
+    indexUpAxis: number
+
+    /* vehicles */
+    chassisRigidBodies: Rapier.RigidBody[] = []
+    vehicleWheelStart: Int32Array
+    vehicleWheelCount: Int32Array
+
+    speedsKmHour: Float32Array
+    vehicleSliding: Uint8Array
+
+    /* wheel options */
+    radius: Float32Array
+    suspensionRestLength: Float32Array
+    maxSuspensionTravel: Float32Array
+    suspensionStiffness: Float32Array
+    maxSuspensionForce: Float32Array
+    sideFrictionStiffness: Float32Array
+    frictionSlip: Float32Array
+    dampingRelaxation: Float32Array
+    dampingCompression: Float32Array
+    rollInfluence: Float32Array
+    forwardAcceleration: Float32Array
+    sideAcceleration: Float32Array
+    customSlidingRotationalSpeed: Float32Array
+    useCustomSlidingRotationalSpeed: Uint8Array
+    chassisConnectionPointLocal: Float32Array
+    directionLocal: Float32Array
+    axleLocal: Float32Array
+
+    /* wheel controls */
+    engineForce: Float32Array
+    brakeForce: Float32Array
+    steering: Float32Array
+
+    /* wheel state */
+    suspensionLength: Float32Array
+    suspensionRelativeVelocity: Float32Array
+    suspensionForce: Float32Array
+    clippedInvContactDotSuspension: Float32Array
+    inContactWithGround: Uint8Array
+    hitPointWorld: Float32Array
+    hitNormalWorld: Float32Array
+    chassisConnectionPointWorld: Float32Array
+    directionWorld: Float32Array
+    axle: Float32Array
+    forwardWS: Float32Array
+    sideImpulse: Float32Array
+    forwardImpulse: Float32Array
+    rotation: Float32Array
+    deltaRotation: Float32Array
+    skidInfo: Float32Array
+    sliding: Uint8Array
+    groundRigidBodies: (Rapier.RigidBody | null)[] = []
+
+    wheelPositions: Float32Array
+    wheelQuaternions: Float32Array
+
+    /* chassis state read once per update */
+    chassisTranslation: Float32Array
+    chassisQuaternion: Float32Array
+    private chassisCom: Float32Array
+    private chassisLinvel: Float32Array
+    private chassisAngvel: Float32Array
+    private chassisMass: Float32Array
+    private chassisInvMass: Float32Array
+    private chassisInvInertia: Float32Array
+
+    /* impulses accumulated in a solver phase, and in total */
+    private phaseImpulse: Float32Array
+    private phaseTorque: Float32Array
+    private totalImpulse: Float32Array
+    private totalTorque: Float32Array
+
+    /* ground state read for wheels in contact with non fixed bodies */
+    private groundDynamic: Uint8Array
+    private groundCom: Float32Array
+    private groundLinvel: Float32Array
+    private groundAngvel: Float32Array
+    private groundInvMass: Float32Array
+    private groundInvInertia: Float32Array
+
+    private ray = new Rapier.Ray({ x: 0, y: 0, z: 0 }, { x: 0, y: -1, z: 0 })
+
+    constructor({
+        world,
+        maxVehicles,
+        maxWheels = maxVehicles * 4,
+        indexRightAxis = 2,
+        indexForwardAxis = 0,
+        indexUpAxis = 1,
+    }: RaycastVehicleFleetOptions) {
+        this.world = world
+        this.maxVehicles = maxVehicles
+        this.maxWheels = maxWheels
+
+        this.indexRightAxis = indexRightAxis
+        this.indexForwardAxis = indexForwardAxis
+        this.indexUpAxis = indexUpAxis
+
+        const v = maxVehicles
+        const w = maxWheels
+
+        this.vehicleWheelStart = new Int32Array(v)
+        this.vehicleWheelCount = new Int32Array(v)
+        this.speedsKmHour = new Float32Array(v)
+        this.vehicleSliding = new Uint8Array(v)
+
+        this.chassisTranslation = new Float32Array(v * 3)
+        this.chassisCom = new Float32Array(v * 3)
+        this.chassisQuaternion = new Float32Array(v * 4)
+        this.chassisLinvel = new Float32Array(v * 3)
+        this.chassisAngvel = new Float32Array(v * 3)
+        this.chassisMass = new Float32Array(v)
+        this.chassisInvMass = new Float32Array(v)
+        this.chassisInvInertia = new Float32Array(v * 9)
+
+        this.phaseImpulse = new Float32Array(v * 3)
+        this.phaseTorque = new Float32Array(v * 3)
+        this.totalImpulse = new Float32Array(v * 3)
+        this.totalTorque = new Float32Array(v * 3)
+
+        this.radius = new Float32Array(w)
+        this.suspensionRestLength = new Float32Array(w)
+        this.maxSuspensionTravel = new Float32Array(w)
+        this.suspensionStiffness = new Float32Array(w)
+        this.maxSuspensionForce = new Float32Array(w)
+        this.sideFrictionStiffness = new Float32Array(w)
+        this.frictionSlip = new Float32Array(w)
+        this.dampingRelaxation = new Float32Array(w)
+        this.dampingCompression = new Float32Array(w)
+        this.rollInfluence = new Float32Array(w)
+        this.forwardAcceleration = new Float32Array(w)
+        this.sideAcceleration = new Float32Array(w)
+        this.customSlidingRotationalSpeed = new Float32Array(w)
+        this.useCustomSlidingRotationalSpeed = new Uint8Array(w)
+        this.chassisConnectionPointLocal = new Float32Array(w * 3)
+        this.directionLocal = new Float32Array(w * 3)
+        this.axleLocal = new Float32Array(w * 3)
+
+        this.engineForce = new Float32Array(w)
+        this.brakeForce = new Float32Array(w)
+        this.steering = new Float32Array(w)
+
+        this.suspensionLength = new Float32Array(w)
+        this.suspensionRelativeVelocity = new Float32Array(w)
+        this.suspensionForce = new Float32Array(w)
+        this.clippedInvContactDotSuspension = new Float32Array(w)
+        this.inContactWithGround = new Uint8Array(w)
+        this.hitPointWorld = new Float32Array(w * 3)
+        this.hitNormalWorld = new Float32Array(w * 3)
+        this.chassisConnectionPointWorld = new Float32Array(w * 3)
+        this.directionWorld = new Float32Array(w * 3)
+        this.axle = new Float32Array(w * 3)
+        this.forwardWS = new Float32Array(w * 3)
+        this.sideImpulse = new Float32Array(w)
+        this.forwardImpulse = new Float32Array(w)
+        this.rotation = new Float32Array(w)
+        this.deltaRotation = new Float32Array(w)
+        this.skidInfo = new Float32Array(w)
+        this.sliding = new Uint8Array(w)
+
+        this.wheelPositions = new Float32Array(w * 3)
+        this.wheelQuaternions = new Float32Array(w * 4)
+
+        this.groundDynamic = new Uint8Array(w)
+        this.groundCom = new Float32Array(w * 3)
+        this.groundLinvel = new Float32Array(w * 3)
+        this.groundAngvel = new Float32Array(w * 3)
+        this.groundInvMass = new Float32Array(w)
+        this.groundInvInertia = new Float32Array(w * 9)
+    }
+
+    /**
+     * Adds a vehicle with its wheels, wheel `i` of the vehicle is wheel `vehicleWheelStart[vehicle] + i` of the fleet
+     *
+     * @returns the vehicle index
+     */
+    addVehicle(chassisRigidBody: Rapier.RigidBody, wheels: WheelOptions[]) {
+        if (this.vehicleCount >= this.maxVehicles || this.wheelCount + wheels.length > this.maxWheels) {
+            throw new Error('RapierRaycastVehicleFleet: fleet is full')
+        }
+
+        const vehicle = this.vehicleCount++
+
+        this.chassisRigidBodies[vehicle] = chassisRigidBody
+        this.vehicleWheelStart[vehicle] = this.wheelCount
+        this.vehicleWheelCount[vehicle] = wheels.length
+
+        for (const options of wheels) {
+            const wheel = this.wheelCount++
+
+            this.radius[wheel] = options.radius
+            this.suspensionRestLength[wheel] = options.suspensionRestLength
+            this.maxSuspensionTravel[wheel] = options.maxSuspensionTravel
+            this.suspensionStiffness[wheel] = options.suspensionStiffness
+            this.maxSuspensionForce[wheel] = options.maxSuspensionForce
+            this.sideFrictionStiffness[wheel] = options.sideFrictionStiffness
+            this.frictionSlip[wheel] = options.frictionSlip
+            this.dampingRelaxation[wheel] = options.dampingRelaxation
+            this.dampingCompression[wheel] = options.dampingCompression
+            this.rollInfluence[wheel] = options.rollInfluence
+            this.forwardAcceleration[wheel] = options.forwardAcceleration
+            this.sideAcceleration[wheel] = options.sideAcceleration
+            this.customSlidingRotationalSpeed[wheel] = options.customSlidingRotationalSpeed
+            this.useCustomSlidingRotationalSpeed[wheel] = options.useCustomSlidingRotationalSpeed ? 1 : 0
+
+            options.chassisConnectionPointLocal.toArray(this.chassisConnectionPointLocal, wheel * 3)
+            options.directionLocal.toArray(this.directionLocal, wheel * 3)
+            options.axleLocal.toArray(this.axleLocal, wheel * 3)
+
+            this.engineForce[wheel] = 0
+            this.brakeForce[wheel] = 0
+            this.steering[wheel] = 0
+
+            this.suspensionLength[wheel] = 0
+            this.suspensionRelativeVelocity[wheel] = 0
+            this.suspensionForce[wheel] = 0
+            this.clippedInvContactDotSuspension[wheel] = 1
+            this.rotation[wheel] = 0
+            this.deltaRotation[wheel] = 0
+            this.groundRigidBodies[wheel] = null
+        }
+
+        return vehicle
+    }
+
+    applyEngineForce(force: number, vehicle: number, wheelIndex: number): void {
+        this.engineForce[this.vehicleWheelStart[vehicle] + wheelIndex] = force
+    }
+
+    setSteeringValue(steering: number, vehicle: number, wheelIndex: number): void {
+        this.steering[this.vehicleWheelStart[vehicle] + wheelIndex] = steering
+    }
+
+    setBrakeValue(brake: number, vehicle: number, wheelIndex: number): void {
+        this.brakeForce[this.vehicleWheelStart[vehicle] + wheelIndex] = brake
+    }
+
+    update(delta: number): void {
+        this.readChassis()
+        this.updateWheelTransforms()
+        this.updateCurrentSpeeds()
+        this.updateWheelSuspension()
+        this.applyWheelSuspensionForces(delta)
+        this.commitPhase()
+        this.updateFriction(delta)
+        this.commitPhase()
+        this.updateWheelRotation(delta)
+        this.applyImpulses()
+    }
+
+    private readChassis(): void {
+        const { chassisRigidBodies, chassisTranslation, chassisCom, chassisQuaternion, chassisLinvel, chassisAngvel } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const body = chassisRigidBodies[vehicle]
+            const o3 = vehicle * 3
+            const o4 = vehicle * 4
+
+            const translation = body.translation()
+            chassisTranslation[o3] = translation.x
+            chassisTranslation[o3 + 1] = translation.y
+            chassisTranslation[o3 + 2] = translation.z
+
+            const com = body.worldCom()
+            chassisCom[o3] = com.x
+            chassisCom[o3 + 1] = com.y
+            chassisCom[o3 + 2] = com.z
+
+            const rotation = body.rotation()
+            chassisQuaternion[o4] = rotation.x
+            chassisQuaternion[o4 + 1] = rotation.y
+            chassisQuaternion[o4 + 2] = rotation.z
+            chassisQuaternion[o4 + 3] = rotation.w
+
+            const linvel = body.linvel()
+            chassisLinvel[o3] = linvel.x
+            chassisLinvel[o3 + 1] = linvel.y
+            chassisLinvel[o3 + 2] = linvel.z
+
+            const angvel = body.angvel()
+            chassisAngvel[o3] = angvel.x
+            chassisAngvel[o3 + 1] = angvel.y
+            chassisAngvel[o3 + 2] = angvel.z
+
+            this.chassisMass[vehicle] = body.mass()
+            this.chassisInvMass[vehicle] = body.invMass()
+
+            readInvInertia(body, this.chassisInvInertia, vehicle * 9)
+
+            this.vehicleSliding[vehicle] = 0
+        }
+
+        this.totalImpulse.fill(0, 0, this.vehicleCount * 3)
+        this.totalTorque.fill(0, 0, this.vehicleCount * 3)
+        this.phaseImpulse.fill(0, 0, this.vehicleCount * 3)
+        this.phaseTorque.fill(0, 0, this.vehicleCount * 3)
+    }
+
+    private updateWheelTransforms(): void {
+        const { chassisQuaternion: cq, chassisTranslation: ct, wheelQuaternions: wq, wheelPositions: wp } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const start = this.vehicleWheelStart[vehicle]
+            const end = start + this.vehicleWheelCount[vehicle]
+
+            const q = vehicle * 4
+            const qx = cq[q]
+            const qy = cq[q + 1]
+            const qz = cq[q + 2]
+            const qw = cq[q + 3]
+
+            for (let wheel = start; wheel < end; wheel++) {
+                const w3 = wheel * 3
+                const w4 = wheel * 4
+
+                /* connection point and suspension direction in world space */
+                rotateByQuaternion(qx, qy, qz, qw, this.chassisConnectionPointLocal, w3, this.chassisConnectionPointWorld, w3)
+                this.chassisConnectionPointWorld[w3] += ct[vehicle * 3]
+                this.chassisConnectionPointWorld[w3 + 1] += ct[vehicle * 3 + 1]
+                this.chassisConnectionPointWorld[w3 + 2] += ct[vehicle * 3 + 2]
+
+                rotateByQuaternion(qx, qy, qz, qw, this.directionLocal, w3, this.directionWorld, w3)
+
+                /* steering around up, rotation around the axle */
+                let ux = -this.directionLocal[w3]
+                let uy = -this.directionLocal[w3 + 1]
+                let uz = -this.directionLocal[w3 + 2]
+                const uLength = Math.sqrt(ux * ux + uy * uy + uz * uz) || 1
+                ux /= uLength
+                uy /= uLength
+                uz /= uLength
+
+                let rx = this.axleLocal[w3]
+                let ry = this.axleLocal[w3 + 1]
+                let rz = this.axleLocal[w3 + 2]
+                const rLength = Math.sqrt(rx * rx + ry * ry + rz * rz) || 1
+                rx /= rLength
+                ry /= rLength
+                rz /= rLength
+
+                const steeringSin = Math.sin(this.steering[wheel] / 2)
+                const sx = ux * steeringSin
+                const sy = uy * steeringSin
+                const sz = uz * steeringSin
+                const sw = Math.cos(this.steering[wheel] / 2)
+
+                const rotationSin = Math.sin(this.rotation[wheel] / 2)
+                const ox = rx * rotationSin
+                const oy = ry * rotationSin
+                const oz = rz * rotationSin
+                const ow = Math.cos(this.rotation[wheel] / 2)
+
+                // chassis * steering
+                const ax = qw * sx + qx * sw + qy * sz - qz * sy
+                const ay = qw * sy - qx * sz + qy * sw + qz * sx
+                const az = qw * sz + qx * sy - qy * sx + qz * sw
+                const aw = qw * sw - qx * sx - qy * sy - qz * sz
+
+                // * rotating
+                let bx = aw * ox + ax * ow + ay * oz - az * oy
+                let by = aw * oy - ax * oz + ay * ow + az * ox
+                let bz = aw * oz + ax * oy - ay * ox + az * ow
+                let bw = aw * ow - ax * ox - ay * oy - az * oz
+                const bLength = Math.sqrt(bx * bx + by * by + bz * bz + bw * bw) || 1
+                bx /= bLength
+                by /= bLength
+                bz /= bLength
+                bw /= bLength
+
+                wq[w4] = bx
+                wq[w4 + 1] = by
+                wq[w4 + 2] = bz
+                wq[w4 + 3] = bw
+
+                /* wheel position from the previous suspension length */
+                const length = this.suspensionLength[wheel]
+                wp[w3] = this.directionWorld[w3] * length + this.chassisConnectionPointWorld[w3]
+                wp[w3 + 1] = this.directionWorld[w3 + 1] * length + this.chassisConnectionPointWorld[w3 + 1]
+                wp[w3 + 2] = this.directionWorld[w3 + 2] * length + this.chassisConnectionPointWorld[w3 + 2]
+
+                this.inContactWithGround[wheel] = 0
+                this.groundRigidBodies[wheel] = null
+            }
+        }
+    }
+
+    private updateCurrentSpeeds(): void {
+        const { chassisQuaternion: cq, chassisLinvel: lv } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const o3 = vehicle * 3
+            const q = vehicle * 4
+
+            const vx = lv[o3]
+            const vy = lv[o3 + 1]
+            const vz = lv[o3 + 2]
+
+            let speed = 3.6 * Math.sqrt(vx * vx + vy * vy + vz * vz)
+
+            rotateAxisByQuaternion(cq[q], cq[q + 1], cq[q + 2], cq[q + 3], this.indexForwardAxis, _vector)
+
+            if (_vector[0] * vx + _vector[1] * vy + _vector[2] * vz > 0) {
+                speed *= -1
+            }
+
+            this.speedsKmHour[vehicle] = speed
+        }
+    }
+
+    private updateWheelSuspension(): void {
+        const { world, ray, hitPointWorld: hp, hitNormalWorld: hn, directionWorld: dw, chassisConnectionPointWorld: cw } = this
+        const { chassisCom: com, chassisLinvel: lv, chassisAngvel: av } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const chassis = this.chassisRigidBodies[vehicle]
+            const start = this.vehicleWheelStart[vehicle]
+            const end = start + this.vehicleWheelCount[vehicle]
+            const o3 = vehicle * 3
+
+            for (let wheel = start; wheel < end; wheel++) {
+                const w3 = wheel * 3
+
+                const radius = this.radius[wheel]
+                const restLength = this.suspensionRestLength[wheel]
+                const rayLength = radius + restLength
+
+                /* cast, reusing one ray for all wheels */
+                const dx = dw[w3]
+                const dy = dw[w3 + 1]
+                const dz = dw[w3 + 2]
+                const dLength = Math.sqrt(dx * dx + dy * dy + dz * dz) || 1
+
+                ray.origin.x = cw[w3]
+                ray.origin.y = cw[w3 + 1]
+                ray.origin.z = cw[w3 + 2]
+                ray.dir.x = dx / dLength
+                ray.dir.y = dy / dLength
+                ray.dir.z = dz / dLength
+
+                const hit = world.castRayAndGetNormal(ray, rayLength, false, undefined, undefined, undefined, chassis)
+
+                if (hit && hit.collider) {
+                    this.groundRigidBodies[wheel] = hit.collider.parent()
+                    this.inContactWithGround[wheel] = 1
+
+                    const toi = hit.timeOfImpact
+
+                    hn[w3] = hit.normal.x
+                    hn[w3 + 1] = hit.normal.y
+                    hn[w3 + 2] = hit.normal.z
+
+                    hp[w3] = ray.origin.x + ray.dir.x * toi
+                    hp[w3 + 1] = ray.origin.y + ray.dir.y * toi
+                    hp[w3 + 2] = ray.origin.z + ray.dir.z * toi
+
+                    /* suspension length, clamped on max travel */
+                    let suspensionLength = toi - radius
+
+                    const maxTravel = this.maxSuspensionTravel[wheel]
+                    const minSuspensionLength = restLength - maxTravel
+                    const maxSuspensionLength = restLength + maxTravel
+
+                    if (suspensionLength < minSuspensionLength) {
+                        suspensionLength = minSuspensionLength
+                    }
+                    if (suspensionLength > maxSuspensionLength) {
+                        suspensionLength = maxSuspensionLength
+
+                        this.groundRigidBodies[wheel] = null
+                        this.inContactWithGround[wheel] = 0
+                        hn.fill(0, w3, w3 + 3)
+                        hp.fill(0, w3, w3 + 3)
+                    }
+
+                    this.suspensionLength[wheel] = suspensionLength
+
+                    const denominator = hn[w3] * dx + hn[w3 + 1] * dy + hn[w3 + 2] * dz
+
+                    /* chassis velocity at the contact point */
+                    const rx = hp[w3] - com[o3]
+                    const ry = hp[w3 + 1] - com[o3 + 1]
+                    const rz = hp[w3 + 2] - com[o3 + 2]
+                    const vx = lv[o3] + av[o3 + 1] * rz - av[o3 + 2] * ry
+                    const vy = lv[o3 + 1] + av[o3 + 2] * rx - av[o3] * rz
+                    const vz = lv[o3 + 2] + av[o3] * ry - av[o3 + 1] * rx
+
+                    const projVel = hn[w3] * vx + hn[w3 + 1] * vy + hn[w3 + 2] * vz
+
+                    if (denominator >= -0.1) {
+                        this.suspensionRelativeVelocity[wheel] = 0
+                        this.clippedInvContactDotSuspension[wheel] = 1 / 0.1
+                    } else {
+                        const inv = -1 / denominator
+                        this.suspensionRelativeVelocity[wheel] = projVel * inv
+                        this.clippedInvContactDotSuspension[wheel] = inv
+                    }
+                } else {
+                    // put wheel info as in rest position
+                    this.suspensionLength[wheel] = restLength
+                    this.suspensionRelativeVelocity[wheel] = 0
+                    hn[w3] = -dx
+                    hn[w3 + 1] = -dy
+                    hn[w3 + 2] = -dz
+                    this.clippedInvContactDotSuspension[wheel] = 1
+                }
+
+                /* suspension force */
+                this.suspensionForce[wheel] = 0
+
+                if (this.inContactWithGround[wheel] === 1) {
+                    // spring
+                    const lengthDifference = restLength - this.suspensionLength[wheel]
+
+                    let force = this.suspensionStiffness[wheel] * lengthDifference * this.clippedInvContactDotSuspension[wheel]
+
+                    // damper
+                    const projectedRelativeVelocity = this.suspensionRelativeVelocity[wheel]
+                    const suspensionDamping =
+                        projectedRelativeVelocity < 0 ? this.dampingCompression[wheel] : this.dampingRelaxation[wheel]
+                    force -= suspensionDamping * projectedRelativeVelocity
+
+                    this.suspensionForce[wheel] = Math.max(0, force * this.chassisMass[vehicle])
+
+                    this.readGround(wheel)
+                }
+            }
+        }
+    }
+
+    private applyWheelSuspensionForces(delta: number): void {
+        const { hitNormalWorld: hn, hitPointWorld: hp } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const start = this.vehicleWheelStart[vehicle]
+            const end = start + this.vehicleWheelCount[vehicle]
+
+            for (let wheel = start; wheel < end; wheel++) {
+                const suspensionForce = Math.min(this.suspensionForce[wheel], this.maxSuspensionForce[wheel])
+
+                if (suspensionForce === 0) continue
+
+                const w3 = wheel * 3
+                const scale = suspensionForce * delta
+
+                this.accumulate(vehicle, hn[w3] * scale, hn[w3 + 1] * scale, hn[w3 + 2] * scale, hp[w3], hp[w3 + 1], hp[w3 + 2])
+            }
+        }
+    }
+
+    private updateFriction(delta: number): void {
+        const { hitNormalWorld: hn, hitPointWorld: hp, axle, forwardWS: fw, wheelQuaternions: wq } = this
+        const { chassisTranslation: ct, chassisQuaternion: cq } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const start = this.vehicleWheelStart[vehicle]
+            const end = start + this.vehicleWheelCount[vehicle]
+            const o3 = vehicle * 3
+            const q = vehicle * 4
+
+            /* side impulses */
+            for (let wheel = start; wheel < end; wheel++) {
+                this.sideImpulse[wheel] = 0
+                this.forwardImpulse[wheel] = 0
+
+                if (this.inContactWithGround[wheel] === 0 || !this.groundRigidBodies[wheel]) continue
+
+                const w3 = wheel * 3
+                const w4 = wheel * 4
+
+                // world axle, projected on the ground plane
+                rotateAxisByQuaternion(wq[w4], wq[w4 + 1], wq[w4 + 2], wq[w4 + 3], this.indexRightAxis, _vector)
+
+                const nx = hn[w3]
+                const ny = hn[w3 + 1]
+                const nz = hn[w3 + 2]
+
+                const proj = _vector[0] * nx + _vector[1] * ny + _vector[2] * nz
+                let ax = _vector[0] - nx * proj
+                let ay = _vector[1] - ny * proj
+                let az = _vector[2] - nz * proj
+                const aLength = Math.sqrt(ax * ax + ay * ay + az * az) || 1
+                ax /= aLength
+                ay /= aLength
+                az /= aLength
+
+                axle[w3] = ax
+                axle[w3 + 1] = ay
+                axle[w3 + 2] = az
+
+                let fx = ny * az - nz * ay
+                let fy = nz * ax - nx * az
+                let fz = nx * ay - ny * ax
+                const fLength = Math.sqrt(fx * fx + fy * fy + fz * fz) || 1
+                fx /= fLength
+                fy /= fLength
+                fz /= fLength
+
+                fw[w3] = fx
+                fw[w3 + 1] = fy
+                fw[w3 + 2] = fz
+
+                // bilateral constraint between the chassis and the ground
+                const relativeVelocity = this.relativeVelocityAlong(vehicle, wheel, ax, ay, az)
+                const massTerm = 1 / (this.chassisInvMass[vehicle] + this.groundInvMass[wheel])
+
+                this.sideImpulse[wheel] = -CONTACT_DAMPING * relativeVelocity * massTerm * this.sideFrictionStiffness[wheel]
+            }
+
+            /* rolling friction, acceleration and sliding */
+            for (let wheel = start; wheel < end; wheel++) {
+                this.skidInfo[wheel] = 1
+
+                if (!this.groundRigidBodies[wheel]) continue
+
+                const w3 = wheel * 3
+
+                const fx = fw[w3]
+                const fy = fw[w3 + 1]
+                const fz = fw[w3 + 2]
+
+                // brake
+                const maxImpulse = this.brakeForce[wheel] ? this.brakeForce[wheel] : 0
+
+                const relativeVelocity = this.relativeVelocityAlong(vehicle, wheel, fx, fy, fz)
+
+                const denominator0 =
+                    this.chassisInvMass[vehicle] +
+                    impulseDenominator(this.chassisInvInertia, vehicle * 9, this.chassisCom, o3, hp, w3, fx, fy, fz)
+
+                const denominator1 =
+                    this.groundDynamic[wheel] === 1
+                        ? this.groundInvMass[wheel] +
+                          impulseDenominator(this.groundInvInertia, wheel * 9, this.groundCom, w3, hp, w3, fx, fy, fz)
+                        : 0
+
+                let rollingFriction = -relativeVelocity / (denominator0 + denominator1)
+
+                if (maxImpulse < rollingFriction) rollingFriction = maxImpulse
+                if (rollingFriction < -maxImpulse) rollingFriction = -maxImpulse
+
+                // acceleration
+                rollingFriction += this.engineForce[wheel] * delta
+
+                this.forwardImpulse[wheel] = rollingFriction
+
+                const maxImp = this.suspensionForce[wheel] * delta * this.frictionSlip[wheel]
+                const maxImpSquared = maxImp * maxImp
+
+                const x = (rollingFriction * FORWARD_FACTOR) / this.forwardAcceleration[wheel]
+                const y = (this.sideImpulse[wheel] * SIDE_FACTOR) / this.sideAcceleration[wheel]
+
+                const impulseSquared = x * x + y * y
+
+                this.sliding[wheel] = 0
+
+                if (impulseSquared > maxImpSquared) {
+                    this.vehicleSliding[vehicle] = 1
+                    this.sliding[wheel] = 1
+
+                    this.skidInfo[wheel] *= maxImp / Math.sqrt(impulseSquared)
+                }
+            }
+
+            if (this.vehicleSliding[vehicle] === 1) {
+                for (let wheel = start; wheel < end; wheel++) {
+                    if (this.sideImpulse[wheel] !== 0 && this.skidInfo[wheel] < 1) {
+                        this.forwardImpulse[wheel] *= this.skidInfo[wheel]
+                        this.sideImpulse[wheel] *= this.skidInfo[wheel]
+                    }
+                }
+            }
+
+            /* accumulate impulses */
+            const qx = cq[q]
+            const qy = cq[q + 1]
+            const qz = cq[q + 2]
+            const qw = cq[q + 3]
+
+            for (let wheel = start; wheel < end; wheel++) {
+                const w3 = wheel * 3
+
+                const forwardImpulse = this.forwardImpulse[wheel]
+
+                if (forwardImpulse !== 0) {
+                    this.accumulate(
+                        vehicle,
+                        fw[w3] * forwardImpulse,
+                        fw[w3 + 1] * forwardImpulse,
+                        fw[w3 + 2] * forwardImpulse,
+                        hp[w3],
+                        hp[w3 + 1],
+                        hp[w3 + 2],
+                    )
+                }
+
+                const sideImpulse = this.sideImpulse[wheel]
+
+                if (sideImpulse === 0) continue
+
+                const jx = axle[w3] * sideImpulse
+                const jy = axle[w3 + 1] * sideImpulse
+                const jz = axle[w3 + 2] * sideImpulse
+
+                // scale the relative position in the up direction with rollInfluence, in chassis space.
+                // If rollInfluence is 1, the impulse will be applied on the hitPoint (easy to roll over), if it is zero it will be applied in the same plane as the center of mass (not easy to roll over).
+                _vector[0] = hp[w3] - ct[o3]
+                _vector[1] = hp[w3 + 1] - ct[o3 + 1]
+                _vector[2] = hp[w3 + 2] - ct[o3 + 2]
+
+                rotateByQuaternion(-qx, -qy, -qz, qw, _vector, 0, _vector, 0)
+                _vector[this.indexUpAxis] *= this.rollInfluence[wheel]
+                rotateByQuaternion(qx, qy, qz, qw, _vector, 0, _vector, 0)
+
+                this.accumulate(vehicle, jx, jy, jz, _vector[0] + ct[o3], _vector[1] + ct[o3 + 1], _vector[2] + ct[o3 + 2])
+
+                // friction impulse on the ground, only bodies that can move
+                const ground = this.groundRigidBodies[wheel]!
+
+                if (this.groundDynamic[wheel] === 1) {
+                    _impulse.x = -jx
+                    _impulse.y = -jy
+                    _impulse.z = -jz
+                    _torque.x = hp[w3]
+                    _torque.y = hp[w3 + 1]
+                    _torque.z = hp[w3 + 2]
+
+                    ground.applyImpulseAtPoint(_impulse, _torque, true)
+                }
+            }
+        }
+    }
+
+    private updateWheelRotation(delta: number): void {
+        const { chassisQuaternion: cq, chassisCom: com, chassisLinvel: lv, chassisAngvel: av, hitNormalWorld: hn } = this
+        const { chassisConnectionPointWorld: cw } = this
+
+        // hack to get the rotation in the correct direction
+        const m = this.indexUpAxis === 1 ? -1 : 1
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const start = this.vehicleWheelStart[vehicle]
+            const end = start + this.vehicleWheelCount[vehicle]
+            const o3 = vehicle * 3
+            const q = vehicle * 4
+
+            rotateAxisByQuaternion(cq[q], cq[q + 1], cq[q + 2], cq[q + 3], this.indexForwardAxis, _vector)
+            const forwardX = _vector[0]
+            const forwardY = _vector[1]
+            const forwardZ = _vector[2]
+
+            for (let wheel = start; wheel < end; wheel++) {
+                const w3 = wheel * 3
+
+                if (this.inContactWithGround[wheel] === 1) {
+                    // chassis velocity at the connection point
+                    const rx = cw[w3] - com[o3]
+                    const ry = cw[w3 + 1] - com[o3 + 1]
+                    const rz = cw[w3 + 2] - com[o3 + 2]
+                    const vx = lv[o3] + av[o3 + 1] * rz - av[o3 + 2] * ry
+                    const vy = lv[o3 + 1] + av[o3 + 2] * rx - av[o3] * rz
+                    const vz = lv[o3 + 2] + av[o3] * ry - av[o3 + 1] * rx
+
+                    const nx = hn[w3]
+                    const ny = hn[w3 + 1]
+                    const nz = hn[w3 + 2]
+
+                    const proj = forwardX * nx + forwardY * ny + forwardZ * nz
+                    const fx = forwardX - nx * proj
+                    const fy = forwardY - ny * proj
+                    const fz = forwardZ - nz * proj
+
+                    const proj2 = fx * vx + fy * vy + fz * vz
+
+                    this.deltaRotation[wheel] = (m * proj2 * delta) / this.radius[wheel]
+                }
+
+                const engineForce = this.engineForce[wheel]
+
+                if (
+                    (this.sliding[wheel] === 1 || this.inContactWithGround[wheel] === 0) &&
+                    engineForce !== 0 &&
+                    this.useCustomSlidingRotationalSpeed[wheel] === 1
+                ) {
+                    // apply custom rotation when accelerating and sliding
+                    this.deltaRotation[wheel] = (engineForce > 0 ? 1 : -1) * this.customSlidingRotationalSpeed[wheel] * delta
+                }
+
+                // lock wheels
+                if (Math.abs(this.brakeForce[wheel]) > Math.abs(engineForce)) {
+                    this.deltaRotation[wheel] = 0
+                }
+
+                this.rotation[wheel] += this.deltaRotation[wheel] // use the old value
+                this.deltaRotation[wheel] *= 0.99 // damping of rotation when not in contact
+            }
+        }
+    }
+
+    private applyImpulses(): void {
+        const { totalImpulse, totalTorque } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const o3 = vehicle * 3
+
+            _impulse.x = totalImpulse[o3]
+            _impulse.y = totalImpulse[o3 + 1]
+            _impulse.z = totalImpulse[o3 + 2]
+
+            _torque.x = totalTorque[o3]
+            _torque.y = totalTorque[o3 + 1]
+            _torque.z = totalTorque[o3 + 2]
+
+            if (_impulse.x === 0 && _impulse.y === 0 && _impulse.z === 0 && _torque.x === 0 && _torque.y === 0 && _torque.z === 0) {
+                continue
+            }
+
+            const body = this.chassisRigidBodies[vehicle]
+            body.applyImpulse(_impulse, true)
+            body.applyTorqueImpulse(_torque, true)
+        }
+    }
+
+    /**
+     * Adds an impulse at a world point to the current phase of a vehicle
+     */
+    private accumulate(vehicle: number, jx: number, jy: number, jz: number, px: number, py: number, pz: number) {
+        const o3 = vehicle * 3
+        const com = this.chassisCom
+
+        const rx = px - com[o3]
+        const ry = py - com[o3 + 1]
+        const rz = pz - com[o3 + 2]
+
+        this.phaseImpulse[o3] += jx
+        this.phaseImpulse[o3 + 1] += jy
+        this.phaseImpulse[o3 + 2] += jz
+
+        this.phaseTorque[o3] += ry * jz - rz * jy
+        this.phaseTorque[o3 + 1] += rz * jx - rx * jz
+        this.phaseTorque[o3 + 2] += rx * jy - ry * jx
+    }
+
+    /**
+     * Applies impulses from the current phase to the cached chassis velocities, so later phases see them as if they were applied
+     * to the bodies, and adds them to the impulses applied at the end of the update
+     */
+    private commitPhase() {
+        const { phaseImpulse, phaseTorque, totalImpulse, totalTorque, chassisLinvel, chassisAngvel, chassisInvInertia: ii } = this
+
+        for (let vehicle = 0; vehicle < this.vehicleCount; vehicle++) {
+            const o3 = vehicle * 3
+            const o9 = vehicle * 9
+            const invMass = this.chassisInvMass[vehicle]
+
+            const jx = phaseImpulse[o3]
+            const jy = phaseImpulse[o3 + 1]
+            const jz = phaseImpulse[o3 + 2]
+            const tx = phaseTorque[o3]
+            const ty = phaseTorque[o3 + 1]
+            const tz = phaseTorque[o3 + 2]
+
+            chassisLinvel[o3] += jx * invMass
+            chassisLinvel[o3 + 1] += jy * invMass
+            chassisLinvel[o3 + 2] += jz * invMass
+
+            chassisAngvel[o3] += ii[o9] * tx + ii[o9 + 1] * ty + ii[o9 + 2] * tz
+            chassisAngvel[o3 + 1] += ii[o9 + 3] * tx + ii[o9 + 4] * ty + ii[o9 + 5] * tz
+            chassisAngvel[o3 + 2] += ii[o9 + 6] * tx + ii[o9 + 7] * ty + ii[o9 + 8] * tz
+
+            totalImpulse[o3] += jx
+            totalImpulse[o3 + 1] += jy
+            totalImpulse[o3 + 2] += jz
+            totalTorque[o3] += tx
+            totalTorque[o3 + 1] += ty
+            totalTorque[o3 + 2] += tz
+        }
+
+        phaseImpulse.fill(0, 0, this.vehicleCount * 3)
+        phaseTorque.fill(0, 0, this.vehicleCount * 3)
+    }
+
+    /**
+     * Reads the state of a wheel's ground body, fixed bodies are treated as immovable without reading them
+     */
+    private readGround(wheel: number) {
+        const ground = this.groundRigidBodies[wheel]
+        const w3 = wheel * 3
+
+        if (!ground || ground.isFixed()) {
+            this.groundDynamic[wheel] = 0
+            this.groundInvMass[wheel] = 0
+            this.groundLinvel.fill(0, w3, w3 + 3)
+            this.groundAngvel.fill(0, w3, w3 + 3)
+            return
+        }
+
+        this.groundDynamic[wheel] = 1
+
+        const com = ground.worldCom()
+        this.groundCom[w3] = com.x
+        this.groundCom[w3 + 1] = com.y
+        this.groundCom[w3 + 2] = com.z
+
+        const linvel = ground.linvel()
+        this.groundLinvel[w3] = linvel.x
+        this.groundLinvel[w3 + 1] = linvel.y
+        this.groundLinvel[w3 + 2] = linvel.z
+
+        const angvel = ground.angvel()
+        this.groundAngvel[w3] = angvel.x
+        this.groundAngvel[w3 + 1] = angvel.y
+        this.groundAngvel[w3 + 2] = angvel.z
+
+        this.groundInvMass[wheel] = ground.invMass()
+
+        readInvInertia(ground, this.groundInvInertia, wheel * 9)
+    }
+
+    /**
+     * Velocity of the chassis relative to the ground at a wheel's hit point, along a direction
+     */
+    private relativeVelocityAlong(vehicle: number, wheel: number, dx: number, dy: number, dz: number) {
+        const { chassisCom: com, chassisLinvel: lv, chassisAngvel: av, hitPointWorld: hp } = this
+        const o3 = vehicle * 3
+        const w3 = wheel * 3
+
+        const rx = hp[w3] - com[o3]
+        const ry = hp[w3 + 1] - com[o3 + 1]
+        const rz = hp[w3 + 2] - com[o3 + 2]
+        let vx = lv[o3] + av[o3 + 1] * rz - av[o3 + 2] * ry
+        let vy = lv[o3 + 1] + av[o3 + 2] * rx - av[o3] * rz
+        let vz = lv[o3 + 2] + av[o3] * ry - av[o3 + 1] * rx
+
+        if (this.groundDynamic[wheel] === 1) {
+            const { groundCom: gc, groundLinvel: glv, groundAngvel: gav } = this
+
+            const gx = hp[w3] - gc[w3]
+            const gy = hp[w3 + 1] - gc[w3 + 1]
+            const gz = hp[w3 + 2] - gc[w3 + 2]
+            vx -= glv[w3] + gav[w3 + 1] * gz - gav[w3 + 2] * gy
+            vy -= glv[w3 + 1] + gav[w3 + 2] * gx - gav[w3] * gz
+            vz -= glv[w3 + 2] + gav[w3] * gy - gav[w3 + 1] * gx
+        }
+
+        return dx * vx + dy * vy + dz * vz
+    }
+}
+
+/**
+ * Rotates the vector at `offset` by a quaternion, `target` may be `vector`
+ */
+const rotateByQuaternion = (
+    qx: number,
+    qy: number,
+    qz: number,
+    qw: number,
+    vector: Float32Array,
+    offset: number,
+    target: Float32Array,
+    targetOffset: number,
+) => {
+    const vx = vector[offset]
+    const vy = vector[offset + 1]
+    const vz = vector[offset + 2]
+
+    // t = 2 * cross(q.xyz, v)
+    const tx = 2 * (qy * vz - qz * vy)
+    const ty = 2 * (qz * vx - qx * vz)
+    const tz = 2 * (qx * vy - qy * vx)
+
+    // v + w * t + cross(q.xyz, t)
+    target[targetOffset] = vx + qw * tx + qy * tz - qz * ty
+    target[targetOffset + 1] = vy + qw * ty + qz * tx - qx * tz
+    target[targetOffset + 2] = vz + qw * tz + qx * ty - qy * tx
+}
+
+/**
+ * Rotates a unit axis by a quaternion, into `target`
+ */
+const rotateAxisByQuaternion = (qx: number, qy: number, qz: number, qw: number, axis: number, target: Float32Array) => {
+    target[0] = axis === 0 ? 1 : 0
+    target[1] = axis === 1 ? 1 : 0
+    target[2] = axis === 2 ? 1 : 0
+
+    rotateByQuaternion(qx, qy, qz, qw, target, 0, target, 0)
+}
+
+/**
+ * Reads the world space inverse inertia of a body, row major, from the square root Rapier provides
+ */
+const readInvInertia = (body: Rapier.RigidBody, target: Float32Array, offset: number) => {
+    const { m11, m12, m13, m22, m23, m33 } = body.effectiveWorldInvInertiaSqrt()
+
+    // symmetric, so the inverse inertia is sqrt * sqrt
+    target[offset] = m11 * m11 + m12 * m12 + m13 * m13
+    target[offset + 1] = m11 * m12 + m12 * m22 + m13 * m23
+    target[offset + 2] = m11 * m13 + m12 * m23 + m13 * m33
+    target[offset + 3] = target[offset + 1]
+    target[offset + 4] = m12 * m12 + m22 * m22 + m23 * m23
+    target[offset + 5] = m12 * m13 + m22 * m23 + m23 * m33
+    target[offset + 6] = target[offset + 2]
+    target[offset + 7] = target[offset + 5]
+    target[offset + 8] = m13 * m13 + m23 * m23 + m33 * m33
+}
+
+/**
+ * Angular part of the impulse denominator of a body along a direction at a point: n . ((I^-1 (r x n)) x r)
+ */
+const impulseDenominator = (
+    invInertia: Float32Array,
+    inertiaOffset: number,
+    com: Float32Array,
+    comOffset: number,
+    point: Float32Array,
+    pointOffset: number,
+    nx: number,
+    ny: number,
+    nz: number,
+) => {
+    const rx = point[pointOffset] - com[comOffset]
+    const ry = point[pointOffset + 1] - com[comOffset + 1]
+    const rz = point[pointOffset + 2] - com[comOffset + 2]
+
+    const cx = ry * nz - rz * ny
+    const cy = rz * nx - rx * nz
+    const cz = rx * ny - ry * nx
+
+    const i = invInertia
+    const o = inertiaOffset
+    const mx = i[o] * cx + i[o + 1] * cy + i[o + 2] * cz
+    const my = i[o + 3] * cx + i[o + 4] * cy + i[o + 5] * cz
+    const mz = i[o + 6] * cx + i[o + 7] * cy + i[o + 8] * cz
+
+    const vx = my * rz - mz * ry
+    const vy = mz * rx - mx * rz
+    const vz = mx * ry - my * rx
+
+    return nx * vx + ny * vy + nz * vz
+}
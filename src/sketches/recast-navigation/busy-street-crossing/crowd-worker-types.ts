@@ -0,0 +1,69 @@
+import { CrowdAgentParams } from 'recast-navigation'
+
+export const CrowdWorkerMessageType = {
+    INIT: 0,
+    STEP: 1,
+} as const
+
+/**
+ * Per agent floats in each state buffer: position xyz, velocity xyz
+ */
+export const CROWD_AGENT_STRIDE = 6
+
+/**
+ * Int32 slots in the control buffer
+ */
+export const CrowdControl = {
+    /* index of the state buffer the worker last finished writing */
+    FRONT: 0,
+    /* completed crowd updates */
+    FRAME: 1,
+    /* 1 while a step is being run */
+    BUSY: 2,
+    LENGTH: 3,
+} as const
+
+/**
+ * Float32 slots in the stats buffer
+ */
+export const CrowdStats = {
+    /* milliseconds spent in the last crowd.update */
+    UPDATE_MS: 0,
+    /* milliseconds spent writing agent state in the last step */
+    SYNC_MS: 1,
+    LENGTH: 2,
+} as const
+
+export type CrowdWorkerInitMessage = {
+    type: typeof CrowdWorkerMessageType.INIT
+    navMeshExport: Uint8Array
+    agentCount: number
+    maxAgentRadius: number
+    agentParams: Partial<CrowdAgentParams>
+
+    /**
+     * Points agents spawn at and walk between, xyz per point
+     */
+    targets: Float32Array
+    targetTolerance: number
+
+    /**
+     * Two state buffers of `agentCount * CROWD_AGENT_STRIDE` floats, written alternately so reads never see a partial update
+     */
+    state: SharedArrayBuffer
+    control: SharedArrayBuffer
+    stats: SharedArrayBuffer
+}
+
+export type CrowdWorkerStepMessage = {
+    type: typeof CrowdWorkerMessageType.STEP
+    dt: number
+}
+
+export type CrowdWorkerMessage = CrowdWorkerInitMessage | CrowdWorkerStepMessage
+
+export const createCrowdBuffers = (agentCount: number) => ({
+    state: new SharedArrayBuffer(2 * agentCount * CROWD_AGENT_STRIDE * Float32Array.BYTES_PER_ELEMENT),
+    control: new SharedArrayBuffer(CrowdControl.LENGTH * Int32Array.BYTES_PER_ELEMENT),
+    stats: new SharedArrayBuffer(CrowdStats.LENGTH * Float32Array.BYTES_PER_ELEMENT),
+})
@@ -0,0 +1,143 @@
+import { Crowd, CrowdAgent, importNavMesh, init } from 'recast-navigation'
+import {
+    CROWD_AGENT_STRIDE,
+    CrowdControl,
+    CrowdStats,
+    CrowdWorkerInitMessage,
+    CrowdWorkerMessage,
+    CrowdWorkerMessageType,
+} from './crowd-worker-types'
+
+let ready = false
+
+const inbox: CrowdWorkerMessage[] = []
+
+let props: CrowdWorkerInitMessage | undefined
+let crowd: Crowd | undefined
+let agents: CrowdAgent[] = []
+let agentTargets: Int32Array
+
+let states: [Float32Array, Float32Array]
+let control: Int32Array
+let stats: Float32Array
+
+const _target = { x: 0, y: 0, z: 0 }
+
+const requestRandomTarget = (agent: CrowdAgent, index: number) => {
+    const targets = props!.targets
+    const target = Math.floor(Math.random() * (targets.length / 3))
+
+    agentTargets[index] = target
+
+    _target.x = targets[target * 3]
+    _target.y = targets[target * 3 + 1]
+    _target.z = targets[target * 3 + 2]
+
+    agent.requestMoveTarget(_target)
+}
+
+const initCrowd = (message: CrowdWorkerInitMessage) => {
+    props = message
+
+    const { navMesh } = importNavMesh(message.navMeshExport)
+
+    crowd = new Crowd(navMesh, { maxAgents: message.agentCount, maxAgentRadius: message.maxAgentRadius })
+
+    const agentFloats = message.agentCount * CROWD_AGENT_STRIDE
+    states = [new Float32Array(message.state, 0, agentFloats), new Float32Array(message.state, agentFloats * 4, agentFloats)]
+    control = new Int32Array(message.control)
+    stats = new Float32Array(message.stats)
+
+    agents = []
+    agentTargets = new Int32Array(message.agentCount)
+
+    const { targets } = message
+
+    for (let i = 0; i < message.agentCount; i++) {
+        const spawn = Math.floor(Math.random() * (targets.length / 3))
+
+        const agent = crowd.addAgent(
+            { x: targets[spawn * 3], y: targets[spawn * 3 + 1], z: targets[spawn * 3 + 2] },
+            { height: 1, radius: 0.5, ...message.agentParams },
+        )
+
+        agents.push(agent)
+
+        requestRandomTarget(agent, i)
+    }
+}
+
+const step = (dt: number) => {
+    if (!crowd || !props) return
+
+    const updateStart = performance.now()
+
+    crowd.update(dt)
+
+    const syncStart = performance.now()
+
+    /* write agent state to the buffer the main thread isn't reading */
+    const back = 1 - Atomics.load(control, CrowdControl.FRONT)
+    const state = states[back]
+
+    const { targets, targetTolerance } = props
+
+    for (let i = 0; i < agents.length; i++) {
+        const agent = agents[i]
+
+        const { x, y, z } = agent.position()
+        const { x: vx, y: vy, z: vz } = agent.velocity()
+
+        const offset = i * CROWD_AGENT_STRIDE
+        state[offset] = x
+        state[offset + 1] = y
+        state[offset + 2] = z
+        state[offset + 3] = vx
+        state[offset + 4] = vy
+        state[offset + 5] = vz
+
+        /* pick a new target on arrival */
+        const target = agentTargets[i] * 3
+
+        if (
+            Math.abs(x - targets[target]) < targetTolerance &&
+            Math.abs(y - targets[target + 1]) < targetTolerance &&
+            Math.abs(z - targets[target + 2]) < targetTolerance
+        ) {
+            requestRandomTarget(agent, i)
+        }
+    }
+
+    const end = performance.now()
+
+    stats[CrowdStats.UPDATE_MS] = syncStart - updateStart
+    stats[CrowdStats.SYNC_MS] = end - syncStart
+
+    Atomics.store(control, CrowdControl.FRONT, back)
+    Atomics.add(control, CrowdControl.FRAME, 1)
+    Atomics.store(control, CrowdControl.BUSY, 0)
+}
+
+const process = (message: CrowdWorkerMessage) => {
+    if (message.type === CrowdWorkerMessageType.INIT) {
+        initCrowd(message)
+    } else if (message.type === CrowdWorkerMessageType.STEP) {
+        step(message.dt)
+    }
+}
+
+self.onmessage = (msg) => {
+    if (ready) {
+        process(msg.data)
+    } else {
+        inbox.push(msg.data)
+    }
+}
+
+init().then(() => {
+    ready = true
+
+    for (const message of inbox) {
+        process(message)
+    }
+})
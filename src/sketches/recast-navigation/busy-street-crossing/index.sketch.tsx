@@ -6,7 +6,9 @@ import { World } from 'arancini'
 import { createReactAPI } from 'arancini/react'
 import { useControls } from 'leva'
 import { CrowdAgent, Vector3, vec3 } from 'recast-navigation'
-import { Object3D } from 'three'
+import { useMemo } from 'react'
+import { CylinderGeometry, MeshStandardMaterial, Object3D } from 'three'
+import { LargeCrowd } from './large-crowd'
 import { Agent, Navigation, Traversable } from './recast-react-api'
 
 const targets = [
@@ -44,10 +46,17 @@ const queries = {
 const { useQuery, Entity, Entities, Component } = createReactAPI(world)
 
 const App = () => {
-    const { debugNavMesh } = useControls('ai-busy-crossing', {
+    const { debugNavMesh, largeCrowd, largeCrowdAgents } = useControls('ai-busy-crossing', {
         debugNavMesh: false,
+        largeCrowd: false,
+        largeCrowdAgents: { value: 5000, min: 1000, max: 10000, step: 1000 },
     })
 
+    const [agentGeometry, agentMaterial] = useMemo(
+        () => [new CylinderGeometry(0.5, 0.5, 1).translate(0, 0.5, 0), new MeshStandardMaterial({ color: 'orange' })],
+        [],
+    )
+
     const agents = useQuery(queries.agentsWithObject3D)
 
     /* update agent positions */
@@ -80,19 +89,30 @@ const App = () => {
     return (
         <>
             <Navigation debug={debugNavMesh} generatorConfig={{ walkableRadius: 2 }}>
-                {/* create some agents */}
-                {Array.from({ length: 200 }).map((_, idx) => (
-                    <Entity key={idx}>
-                        <Component name="agent">
-                            <Agent
-                                initialPosition={vec3.toArray(targets[Math.floor(Math.random() * targets.length)])}
-                                maxSpeed={4}
-                                maxAcceleration={3}
-                                separationWeight={10}
-                            />
-                        </Component>
-                    </Entity>
-                ))}
+                {/* create some agents, or simulate a large crowd in a worker */}
+                {largeCrowd ? (
+                    <LargeCrowd
+                        key={largeCrowdAgents}
+                        count={largeCrowdAgents}
+                        targets={targets}
+                        agentParams={{ maxSpeed: 4, maxAcceleration: 3, separationWeight: 10 }}
+                        geometry={agentGeometry}
+                        material={agentMaterial}
+                    />
+                ) : (
+                    Array.from({ length: 200 }).map((_, idx) => (
+                        <Entity key={idx}>
+                            <Component name="agent">
+                                <Agent
+                                    initialPosition={vec3.toArray(targets[Math.floor(Math.random() * targets.length)])}
+                                    maxSpeed={4}
+                                    maxAcceleration={3}
+                                    separationWeight={10}
+                                />
+                            </Component>
+                        </Entity>
+                    ))
+                )}
 
                 {/* create a walkable surface */}
                 <Traversable>
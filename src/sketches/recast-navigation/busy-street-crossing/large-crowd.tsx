@@ -0,0 +1,169 @@
+import { useFrame } from '@react-three/fiber'
+import { monitor, useControls } from 'leva'
+import { useEffect, useMemo, useRef } from 'react'
+import { CrowdAgentParams, Vector3, exportNavMesh } from 'recast-navigation'
+import * as THREE from 'three'
+import {
+    CROWD_AGENT_STRIDE,
+    CrowdControl,
+    CrowdStats,
+    CrowdWorkerInitMessage,
+    CrowdWorkerMessageType,
+    CrowdWorkerStepMessage,
+    createCrowdBuffers,
+} from './crowd-worker-types'
+import CrowdWorker from './crowd.worker?worker'
+import { useNavigation } from './recast-react-api'
+
+export type LargeCrowdProps = {
+    count: number
+    targets: Vector3[]
+    targetTolerance?: number
+    maxAgentRadius?: number
+    agentParams?: Partial<CrowdAgentParams>
+    geometry: THREE.BufferGeometry
+    material: THREE.Material
+}
+
+type CrowdSimulation = {
+    worker: InstanceType<typeof CrowdWorker>
+    states: [Float32Array, Float32Array]
+    control: Int32Array
+    stats: Float32Array
+    pendingDelta: number
+}
+
+/**
+ * Simulates a crowd in a worker, with agent state read from shared memory each frame and written to one InstancedMesh.
+ *
+ * Steps are dropped while the worker is still running the previous one, and their time is added to the next step.
+ */
+export const LargeCrowd = ({
+    count,
+    targets,
+    targetTolerance = 5,
+    maxAgentRadius = 0.5,
+    agentParams,
+    geometry,
+    material,
+}: LargeCrowdProps) => {
+    const { navMesh } = useNavigation()
+
+    const instancedMesh = useRef<THREE.InstancedMesh>(null!)
+    const simulation = useRef<CrowdSimulation>()
+
+    const yaws = useMemo(() => new Float32Array(count), [count])
+    const syncMs = useRef(0)
+
+    useControls('ai-busy-crossing-large-crowd', {
+        crowdUpdateMs: monitor(() => simulation.current?.stats[CrowdStats.UPDATE_MS] ?? 0, { graph: true, interval: 100 }),
+        workerSyncMs: monitor(() => simulation.current?.stats[CrowdStats.SYNC_MS] ?? 0, { graph: true, interval: 100 }),
+        instanceSyncMs: monitor(() => syncMs.current, { graph: true, interval: 100 }),
+    })
+
+    useEffect(() => {
+        if (!navMesh) return
+
+        const worker = new CrowdWorker()
+
+        const buffers = createCrowdBuffers(count)
+        const agentFloats = count * CROWD_AGENT_STRIDE
+
+        const targetsArray = new Float32Array(targets.length * 3)
+        targets.forEach(({ x, y, z }, i) => targetsArray.set([x, y, z], i * 3))
+
+        const init: CrowdWorkerInitMessage = {
+            type: CrowdWorkerMessageType.INIT,
+            navMeshExport: exportNavMesh(navMesh),
+            agentCount: count,
+            maxAgentRadius,
+            agentParams: agentParams ?? {},
+            targets: targetsArray,
+            targetTolerance,
+            ...buffers,
+        }
+
+        worker.postMessage(init)
+
+        // no agents until the worker writes the first step
+        instancedMesh.current.count = 0
+
+        simulation.current = {
+            worker,
+            states: [new Float32Array(buffers.state, 0, agentFloats), new Float32Array(buffers.state, agentFloats * 4, agentFloats)],
+            control: new Int32Array(buffers.control),
+            stats: new Float32Array(buffers.stats),
+            pendingDelta: 0,
+        }
+
+        return () => {
+            worker.terminate()
+            simulation.current = undefined
+        }
+    }, [navMesh, count])
+
+    useFrame((_, delta) => {
+        const sim = simulation.current
+        if (!sim) return
+
+        /* sync the latest state to instances */
+        if (Atomics.load(sim.control, CrowdControl.FRAME) > 0) {
+            const start = performance.now()
+
+            const state = sim.states[Atomics.load(sim.control, CrowdControl.FRONT)]
+            const matrices = instancedMesh.current.instanceMatrix.array as Float32Array
+
+            for (let i = 0; i < count; i++) {
+                const offset = i * CROWD_AGENT_STRIDE
+                const vx = state[offset + 3]
+                const vz = state[offset + 5]
+
+                // keep facing the same way when stopped
+                if (vx * vx + vz * vz > 0.0001) {
+                    yaws[i] = Math.atan2(vx, vz)
+                }
+
+                const cos = Math.cos(yaws[i])
+                const sin = Math.sin(yaws[i])
+
+                /* rotation about y, column major */
+                const m = i * 16
+                matrices[m] = cos
+                matrices[m + 1] = 0
+                matrices[m + 2] = -sin
+                matrices[m + 3] = 0
+                matrices[m + 4] = 0
+                matrices[m + 5] = 1
+                matrices[m + 6] = 0
+                matrices[m + 7] = 0
+                matrices[m + 8] = sin
+                matrices[m + 9] = 0
+                matrices[m + 10] = cos
+                matrices[m + 11] = 0
+                matrices[m + 12] = state[offset]
+                matrices[m + 13] = state[offset + 1]
+                matrices[m + 14] = state[offset + 2]
+                matrices[m + 15] = 1
+            }
+
+            instancedMesh.current.count = count
+            instancedMesh.current.instanceMatrix.needsUpdate = true
+
+            syncMs.current = performance.now() - start
+        }
+
+        /* step the crowd */
+        sim.pendingDelta += delta
+
+        if (Atomics.load(sim.control, CrowdControl.BUSY) === 1) return
+
+        Atomics.store(sim.control, CrowdControl.BUSY, 1)
+
+        const step: CrowdWorkerStepMessage = { type: CrowdWorkerMessageType.STEP, dt: Math.min(sim.pendingDelta, 0.1) }
+        sim.worker.postMessage(step)
+
+        sim.pendingDelta = 0
+    })
+
+    return <instancedMesh ref={instancedMesh} args={[geometry, material, count]} frustumCulled={false} />
+}
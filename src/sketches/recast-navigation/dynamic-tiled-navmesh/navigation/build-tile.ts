@@ -35,6 +35,9 @@ import {
     freeCompactHeightfield,
     freeContourSet,
     freeHeightfield,
+    freePolyMesh,
+    freePolyMeshDetail,
+    markBoxArea,
     markWalkableTriangles,
     rasterizeTriangles,
     vec3,
@@ -133,9 +136,7 @@ export type TileIntermediates = {
     contourSet?: RecastContourSet
 }
 
-export type BuildTileMeshProps = {
-    positions: Float32Array
-    indices: Uint32Array
+type TileProps = {
     recastConfig: RecastConfig
     tileX: number
     tileY: number
@@ -145,6 +146,11 @@ export type BuildTileMeshProps = {
     keepIntermediates: boolean
 }
 
+export type BuildTileMeshProps = TileProps & {
+    positions: Float32Array
+    indices: Uint32Array
+}
+
 export type BuildTileMeshResult = (
     | { success: true; data?: UnsignedCharArray }
     | { success: false; error: string }
@@ -153,56 +159,37 @@ export type BuildTileMeshResult = (
     buildContext: RecastBuildContext
 }
 
-export const buildTile = ({
-    positions,
-    indices,
-    navMeshBounds,
-    recastConfig,
-    tileX,
-    tileY,
-    tileBoundsMin,
-    tileBoundsMax,
-    keepIntermediates,
-}: BuildTileMeshProps): BuildTileMeshResult => {
-    const buildContext = new RecastBuildContext()
-
-    /* verts and tris */
-    const vertices = positions as ArrayLike<number> as number[]
-    const numVertices = indices.length
-    const verticesArray = new VerticesArray()
-    verticesArray.copy(vertices)
-
-    const triangles = indices as ArrayLike<number> as number[]
-    const numTriangles = indices.length / 3
-    const trianglesArray = new TrianglesArray()
-    trianglesArray.copy(triangles)
-
-    const tileIntermediates: TileIntermediates = { tileX, tileY }
-
-    const cleanup = () => {
-        if (keepIntermediates) return
+export type BuildTileCompactHeightfieldResult = (
+    | { success: true; compactHeightfield: RecastCompactHeightfield }
+    | { success: false; error: string }
+) & {
+    tileIntermediates: TileIntermediates
+    buildContext: RecastBuildContext
+}
 
-        if (tileIntermediates.compactHeightfield) {
-            freeCompactHeightfield(tileIntermediates.compactHeightfield)
-        }
+export type BuildTileFromCompactHeightfieldProps = TileProps & {
+    /**
+     * Compact heightfield from `buildTileCompactHeightfield`. Its areas are eroded and marked in place.
+     */
+    compactHeightfield: RecastCompactHeightfield
 
-        if (tileIntermediates.heightfield) {
-            freeHeightfield(tileIntermediates.heightfield)
-        }
+    /**
+     * Boxes to mark as unwalkable, min xyz then max xyz per box
+     */
+    obstacles?: Float32Array
 
-        if (tileIntermediates.contourSet) {
-            freeContourSet(tileIntermediates.contourSet)
-        }
-    }
-
-    const failTileMesh = (error: string) => {
-        buildContext.log(Recast.RC_LOG_ERROR, error)
-
-        cleanup()
+    buildContext?: RecastBuildContext
+    tileIntermediates?: TileIntermediates
+}
 
-        return { success: false as const, error, tileIntermediates, buildContext }
-    }
+const NULL_AREA = 0
 
+const getTileConfig = ({
+    recastConfig,
+    navMeshBounds,
+    tileBoundsMin,
+    tileBoundsMax,
+}: Pick<TileProps, 'recastConfig' | 'navMeshBounds' | 'tileBoundsMin' | 'tileBoundsMax'>) => {
     const { config } = buildConfig({ recastConfig, navMeshBounds: navMeshBounds })
     const tileConfig = cloneRcConfig(config)
 
@@ -245,6 +232,93 @@ export const buildTile = ({
     tileConfig.set_bmax(1, expandedTileBoundsMax[1])
     tileConfig.set_bmax(2, expandedTileBoundsMax[2])
 
+    return { config, tileConfig, expandedTileBoundsMin, expandedTileBoundsMax }
+}
+
+const freeTileIntermediates = (tileIntermediates: TileIntermediates) => {
+    if (tileIntermediates.compactHeightfield) {
+        freeCompactHeightfield(tileIntermediates.compactHeightfield)
+        tileIntermediates.compactHeightfield = undefined
+    }
+
+    if (tileIntermediates.heightfield) {
+        freeHeightfield(tileIntermediates.heightfield)
+        tileIntermediates.heightfield = undefined
+    }
+
+    if (tileIntermediates.contourSet) {
+        freeContourSet(tileIntermediates.contourSet)
+        tileIntermediates.contourSet = undefined
+    }
+}
+
+/**
+ * Copies the area id of each span in a compact heightfield, so it can be restored with `setCompactHeightfieldAreas` before the
+ * heightfield is eroded and marked again
+ */
+export const getCompactHeightfieldAreas = (compactHeightfield: RecastCompactHeightfield) => {
+    const spanCount = compactHeightfield.spanCount()
+    const areas = new Uint8Array(spanCount)
+
+    for (let i = 0; i < spanCount; i++) {
+        areas[i] = compactHeightfield.areas(i)
+    }
+
+    return areas
+}
+
+export const setCompactHeightfieldAreas = (compactHeightfield: RecastCompactHeightfield, areas: Uint8Array) => {
+    for (let i = 0; i < areas.length; i++) {
+        compactHeightfield.raw.set_areas(i, areas[i])
+    }
+}
+
+/**
+ * Rasterizes geometry for a tile into a compact heightfield, before erosion and area marking.
+ * The compact heightfield is owned by the caller, and can be passed to `buildTileFromCompactHeightfield` more than once.
+ */
+export const buildTileCompactHeightfield = ({
+    positions,
+    indices,
+    navMeshBounds,
+    recastConfig,
+    tileX,
+    tileY,
+    tileBoundsMin,
+    tileBoundsMax,
+    keepIntermediates,
+}: BuildTileMeshProps): BuildTileCompactHeightfieldResult => {
+    const buildContext = new RecastBuildContext()
+
+    /* verts and tris */
+    const vertices = positions as ArrayLike<number> as number[]
+    const numVertices = indices.length
+    const verticesArray = new VerticesArray()
+    verticesArray.copy(vertices)
+
+    const numTriangles = indices.length / 3
+
+    const tileIntermediates: TileIntermediates = { tileX, tileY }
+
+    const failTileMesh = (error: string) => {
+        buildContext.log(Recast.RC_LOG_ERROR, error)
+
+        verticesArray.destroy()
+
+        if (!keepIntermediates) {
+            freeTileIntermediates(tileIntermediates)
+        }
+
+        return { success: false as const, error, tileIntermediates, buildContext }
+    }
+
+    const { config, tileConfig, expandedTileBoundsMin, expandedTileBoundsMax } = getTileConfig({
+        recastConfig,
+        navMeshBounds,
+        tileBoundsMin,
+        tileBoundsMax,
+    })
+
     // Reset build timer
     buildContext.resetTimers()
 
@@ -314,11 +388,14 @@ export const buildTile = ({
     )
 
     triangleAreasArray.destroy()
+    trianglessInBoundsArray.destroy()
 
     if (!success) {
         return failTileMesh('Could not rasterize triangles')
     }
 
+    verticesArray.destroy()
+
     // Once all geometry is rasterized, we do initial pass of filtering to
     // remove unwanted overhangs caused by the conservative rasterization
     // as well as filter spans where the character cannot possibly stand.
@@ -349,14 +426,71 @@ export const buildTile = ({
         tileIntermediates.heightfield = undefined
     }
 
+    return { success: true, compactHeightfield, tileIntermediates, buildContext }
+}
+
+/**
+ * Builds navmesh tile data from a compact heightfield, marking obstacles as unwalkable before eroding by the agent radius.
+ * The compact heightfield is not freed.
+ */
+export const buildTileFromCompactHeightfield = ({
+    compactHeightfield,
+    obstacles,
+    navMeshBounds,
+    recastConfig,
+    tileX,
+    tileY,
+    tileBoundsMin,
+    tileBoundsMax,
+    keepIntermediates,
+    buildContext = new RecastBuildContext(),
+    tileIntermediates = { tileX, tileY, compactHeightfield },
+}: BuildTileFromCompactHeightfieldProps): BuildTileMeshResult => {
+    const failTileMesh = (error: string) => {
+        buildContext.log(Recast.RC_LOG_ERROR, error)
+
+        if (!keepIntermediates && tileIntermediates.contourSet) {
+            freeContourSet(tileIntermediates.contourSet)
+            tileIntermediates.contourSet = undefined
+        }
+
+        return { success: false as const, error, tileIntermediates, buildContext }
+    }
+
+    const { tileConfig, expandedTileBoundsMin, expandedTileBoundsMax } = getTileConfig({
+        recastConfig,
+        navMeshBounds,
+        tileBoundsMin,
+        tileBoundsMax,
+    })
+
+    // Mark obstacles before eroding, so the agent radius keeps agents clear of them
+    if (obstacles) {
+        for (let i = 0; i < obstacles.length; i += 6) {
+            if (
+                obstacles[i + 3] < expandedTileBoundsMin[0] ||
+                obstacles[i + 5] < expandedTileBoundsMin[2] ||
+                obstacles[i] > expandedTileBoundsMax[0] ||
+                obstacles[i + 2] > expandedTileBoundsMax[2]
+            ) {
+                continue
+            }
+
+            markBoxArea(
+                buildContext,
+                [obstacles[i], obstacles[i + 1], obstacles[i + 2]],
+                [obstacles[i + 3], obstacles[i + 4], obstacles[i + 5]],
+                NULL_AREA,
+                compactHeightfield,
+            )
+        }
+    }
+
     // Erode the walkable area by agent radius
     if (!erodeWalkableArea(buildContext, tileConfig.walkableRadius, compactHeightfield)) {
         return failTileMesh('Could not erode walkable area')
     }
 
-    // (Optional) Mark areas
-    // markConvexPolyArea(...)
-
     // Prepare for region partitioning, by calculating Distance field along the walkable surface.
     if (!buildDistanceField(buildContext, compactHeightfield)) {
         return failTileMesh('Failed to build distance field')
@@ -399,6 +533,7 @@ export const buildTile = ({
     //
     const polyMesh = allocPolyMesh()
     if (!buildPolyMesh(buildContext, contourSet, tileConfig.maxVertsPerPoly, polyMesh)) {
+        freePolyMesh(polyMesh)
         return failTileMesh('Failed to triangulate contours')
     }
 
@@ -416,13 +551,12 @@ export const buildTile = ({
             polyMeshDetail,
         )
     ) {
+        freePolyMesh(polyMesh)
+        freePolyMeshDetail(polyMeshDetail)
         return failTileMesh('Failed to build detail mesh')
     }
 
     if (!keepIntermediates) {
-        freeCompactHeightfield(compactHeightfield)
-        tileIntermediates.compactHeightfield = undefined
-
         freeContourSet(contourSet)
         tileIntermediates.contourSet = undefined
     }
@@ -456,13 +590,32 @@ export const buildTile = ({
 
     const createNavMeshDataResult = createNavMeshData(navMeshCreateParams)
 
+    buildContext.log(Recast.RC_LOG_PROGRESS, `>> Polymesh: ${polyMesh.nverts()} vertices  ${polyMesh.npolys()} polygons`)
+
+    freePolyMesh(polyMesh)
+    freePolyMeshDetail(polyMeshDetail)
+
     if (!createNavMeshDataResult.success) {
         return failTileMesh('Failed to create Detour navmesh data')
     }
 
-    buildContext.log(Recast.RC_LOG_PROGRESS, `>> Polymesh: ${polyMesh.nverts()} vertices  ${polyMesh.npolys()} polygons`)
+    return { success: true, data: createNavMeshDataResult.navMeshData, tileIntermediates, buildContext }
+}
 
-    cleanup()
+export const buildTile = (props: BuildTileMeshProps): BuildTileMeshResult => {
+    const compactHeightfieldResult = buildTileCompactHeightfield(props)
 
-    return { success: true, data: createNavMeshDataResult.navMeshData, tileIntermediates, buildContext }
+    if (!compactHeightfieldResult.success) {
+        return compactHeightfieldResult
+    }
+
+    const { compactHeightfield, tileIntermediates, buildContext } = compactHeightfieldResult
+
+    const result = buildTileFromCompactHeightfield({ ...props, compactHeightfield, tileIntermediates, buildContext })
+
+    if (!props.keepIntermediates) {
+        freeTileIntermediates(tileIntermediates)
+    }
+
+    return result
 }
@@ -0,0 +1,59 @@
+import { RecastConfig, Vector3Tuple } from 'recast-navigation'
+
+export const DynamicTiledNavMeshWorkerMessageType = {
+    STATIC_GEOMETRY: 0,
+    BUILD_TILE: 1,
+    TILE_RESULT: 2,
+    TRACING: 3,
+} as const
+
+/**
+ * Geometry that doesn't move, e.g. the level. Workers keep the latest version, and rasterize it when a tile is first built
+ * with that version.
+ */
+export type StaticGeometryMessage = {
+    type: typeof DynamicTiledNavMeshWorkerMessageType.STATIC_GEOMETRY
+    version: number
+    positions: Float32Array
+    indices: Uint32Array
+}
+
+export type BuildTileMessage = {
+    type: typeof DynamicTiledNavMeshWorkerMessageType.BUILD_TILE
+    tileX: number
+    tileY: number
+    generation: number
+    staticGeometryVersion: number
+
+    /**
+     * Boxes to mark as unwalkable, min xyz then max xyz per box
+     */
+    obstacles: Float32Array
+
+    tileBoundsMin: Vector3Tuple
+    tileBoundsMax: Vector3Tuple
+    recastConfig: RecastConfig
+    navMeshBounds: [Vector3Tuple, Vector3Tuple]
+}
+
+export type TileResultMessage = {
+    type: typeof DynamicTiledNavMeshWorkerMessageType.TILE_RESULT
+    tileX: number
+    tileY: number
+    generation: number
+
+    /**
+     * Serialised tile data, undefined if the tile has no polygons or failed to build
+     */
+    navMeshData?: Uint8Array
+}
+
+/**
+ * Sent to each worker when tracing is on, see `getTraceBuffer`
+ */
+export type TracingMessage = {
+    type: typeof DynamicTiledNavMeshWorkerMessageType.TRACING
+    traceBuffer: SharedArrayBuffer
+}
+
+export type DynamicTiledNavMeshWorkerMessage = StaticGeometryMessage | BuildTileMessage | TileResultMessage | TracingMessage
@@ -1,3 +1,4 @@
+import { getTraceBuffer, traceCounter, traceStart } from '@/common/utils/tracing'
 import { Topic } from 'arancini/events'
 import {
     Detour,
@@ -12,9 +13,29 @@ import {
     statusToReadableString,
 } from 'recast-navigation'
 import * as THREE from 'three'
-import { BuildTileMeshProps, buildConfig } from './build-tile'
+import { buildConfig } from './build-tile'
+import {
+    BuildTileMessage,
+    DynamicTiledNavMeshWorkerMessageType,
+    StaticGeometryMessage,
+    TileResultMessage,
+    TracingMessage,
+} from './dynamic-tiled-navmesh-worker-types'
 import DynamicTiledNavMeshWorker from './dynamic-tiled-navmesh.worker?worker'
 
+/**
+ * Writes serialised tile data into wasm memory with one bulk copy at the array's data pointer, rather than setting each byte
+ * through the array bindings. The heap is read after resizing, as growing wasm memory replaces the heap views.
+ */
+const toWasmNavMeshData = (bytes: Uint8Array) => {
+    const navMeshData = new UnsignedCharArray()
+    navMeshData.resize(bytes.length)
+
+    Raw.Module.HEAPU8.set(bytes, navMeshData.raw.getDataPointer())
+
+    return navMeshData
+}
+
 export type DynamicTiledNavMeshProps = {
     navMeshBounds: THREE.Box3
     recastConfig: Partial<RecastConfig>
@@ -40,7 +61,19 @@ export class DynamicTiledNavMesh {
     recastConfig: RecastConfig
 
     workers: InstanceType<typeof DynamicTiledNavMeshWorker>[]
-    workerRoundRobin = 0
+
+    private staticPositions = new Float32Array(0)
+    private staticIndices = new Uint32Array(0)
+    private staticGeometryVersion = 0
+    private workerStaticGeometryVersions: number[] = []
+
+    private obstacles = new Float32Array(0)
+
+    /* latest requested build per tile, at most one build per tile is in flight */
+    private tileGenerations = new Map<string, number>()
+    /* trace start time of the build in flight per tile */
+    private tilesInFlight = new Map<string, number>()
+    private pendingTiles = new Map<string, [x: number, y: number]>()
 
     constructor(props: DynamicTiledNavMeshProps) {
         const navMeshBoundsMin = props.navMeshBounds.min
@@ -84,81 +117,84 @@ export class DynamicTiledNavMesh {
             const worker = new DynamicTiledNavMeshWorker()
 
             worker.onmessage = (e) => {
-                const {
-                    tileX,
-                    tileY,
-                    navMeshData: serialisedNavMeshData,
-                } = e.data as { tileX: number; tileY: number; navMeshData: Uint8Array }
-
-                const navMeshData = new UnsignedCharArray()
-                navMeshData.copy(serialisedNavMeshData as ArrayLike<number> as number[])
-
-                navMesh.removeTile(navMesh.getTileRefAt(tileX, tileY, 0))
-
-                const addTileResult = navMesh.addTile(navMeshData, Detour.DT_TILE_FREE_DATA, 0)
+                this.onTileResult(e.data as TileResultMessage)
+            }
 
-                if (Raw.Detour.statusFailed(addTileResult.status)) {
-                    console.error(
-                        Recast.RC_LOG_WARNING,
-                        `Failed to add tile to nav mesh` +
-                            '\n\t' +
-                            `tx: ${tileX}, ty: ${tileY},` +
-                            `status: ${statusToReadableString(addTileResult.status)} (${addTileResult.status})`,
-                    )
+            const traceBuffer = getTraceBuffer()
 
-                    navMeshData.destroy()
+            if (traceBuffer) {
+                const tracing: TracingMessage = {
+                    type: DynamicTiledNavMeshWorkerMessageType.TRACING,
+                    traceBuffer: traceBuffer.buffer,
                 }
 
-                this.navMeshVersion++
-                this.onNavMeshUpdate.emit(this.navMeshVersion, [tileX, tileY])
+                worker.postMessage(tracing)
             }
 
             this.workers.push(worker)
+            this.workerStaticGeometryVersions.push(-1)
         }
     }
 
-    buildTile(positions: Float32Array, indices: Uint32Array, [tileX, tileY]: [x: number, y: number]) {
-        const clonedPositions = new Float32Array(positions)
-        const clonedIndices = new Uint32Array(indices)
+    /**
+     * Sets geometry that doesn't move. Workers rasterize it once per tile, and reuse the result while only obstacles change.
+     * Tiles are not rebuilt until `buildTile` or `buildAllTiles` is called.
+     */
+    setStaticGeometry(positions: Float32Array, indices: Uint32Array) {
+        this.staticPositions = positions
+        this.staticIndices = indices
+        this.staticGeometryVersion++
+    }
 
-        const tileBoundsMin: Vector3Tuple = [
-            this.navMeshBoundsMin.x + tileX * this.tcs,
-            this.navMeshBoundsMin.y,
-            this.navMeshBoundsMin.z + tileY * this.tcs,
-        ]
+    /**
+     * Sets boxes to mark as unwalkable, min xyz then max xyz per box, for later tile builds
+     */
+    setObstacles(obstacles: Float32Array) {
+        this.obstacles = obstacles
+    }
 
-        const tileBoundsMax: Vector3Tuple = [
-            this.navMeshBoundsMax.x + (tileX + 1) * this.tcs,
-            this.navMeshBoundsMax.y,
-            this.navMeshBoundsMax.z + (tileY + 1) * this.tcs,
-        ]
+    /**
+     * Requests a tile build. Requests for a tile that is already building are coalesced into one build that starts when
+     * the current one finishes, and only the result of the latest requested build is applied.
+     */
+    buildTile([tileX, tileY]: [x: number, y: number]) {
+        const key = `${tileX},${tileY}`
 
-        const job: BuildTileMeshProps = {
-            tileX,
-            tileY,
-            tileBoundsMin: tileBoundsMin,
-            tileBoundsMax: tileBoundsMax,
-            recastConfig: this.recastConfig,
-            navMeshBounds: this.navMeshBounds,
-            keepIntermediates: false,
-            positions: clonedPositions,
-            indices: clonedIndices,
-        }
+        this.tileGenerations.set(key, (this.tileGenerations.get(key) ?? 0) + 1)
 
-        const worker = this.workers[this.workerRoundRobin]
-        this.workerRoundRobin = (this.workerRoundRobin + 1) % this.workers.length
+        if (this.tilesInFlight.has(key)) {
+            this.pendingTiles.set(key, [tileX, tileY])
+            return
+        }
 
-        worker.postMessage(job, [clonedPositions.buffer, clonedIndices.buffer])
+        this.dispatchTile(key, tileX, tileY)
     }
 
-    buildAllTiles(positions: Float32Array, indices: Uint32Array) {
+    /**
+     * Requests builds for all tiles, nearest to `origin` first if given, so areas that are needed soonest are ready first
+     */
+    buildAllTiles(origin?: THREE.Vector3) {
         const { tileWidth, tileHeight } = this
 
+        const tiles: [x: number, y: number][] = []
+
         for (let y = 0; y < tileHeight; y++) {
             for (let x = 0; x < tileWidth; x++) {
-                this.buildTile(positions, indices, [x, y])
+                tiles.push([x, y])
             }
         }
+
+        if (origin) {
+            const [originX, originY] = this.getTileForWorldPosition(origin)
+
+            const distance = ([x, y]: [number, number]) => (x - originX) ** 2 + (y - originY) ** 2
+
+            tiles.sort((a, b) => distance(a) - distance(b))
+        }
+
+        for (const tile of tiles) {
+            this.buildTile(tile)
+        }
     }
 
     getTileForWorldPosition(worldPosition: THREE.Vector3) {
@@ -190,4 +226,117 @@ export class DynamicTiledNavMesh {
             worker.terminate()
         }
     }
+
+    private dispatchTile(key: string, tileX: number, tileY: number) {
+        const tileBoundsMin: Vector3Tuple = [
+            this.navMeshBoundsMin.x + tileX * this.tcs,
+            this.navMeshBoundsMin.y,
+            this.navMeshBoundsMin.z + tileY * this.tcs,
+        ]
+
+        const tileBoundsMax: Vector3Tuple = [
+            this.navMeshBoundsMax.x + (tileX + 1) * this.tcs,
+            this.navMeshBoundsMax.y,
+            this.navMeshBoundsMax.z + (tileY + 1) * this.tcs,
+        ]
+
+        // tiles always build on the same worker, which caches their static compact heightfields
+        const workerIndex = this.getTileWorker(tileX, tileY)
+        const worker = this.workers[workerIndex]
+
+        if (this.workerStaticGeometryVersions[workerIndex] !== this.staticGeometryVersion) {
+            const staticGeometry: StaticGeometryMessage = {
+                type: DynamicTiledNavMeshWorkerMessageType.STATIC_GEOMETRY,
+                version: this.staticGeometryVersion,
+                positions: this.staticPositions,
+                indices: this.staticIndices,
+            }
+
+            worker.postMessage(staticGeometry)
+
+            this.workerStaticGeometryVersions[workerIndex] = this.staticGeometryVersion
+        }
+
+        const job: BuildTileMessage = {
+            type: DynamicTiledNavMeshWorkerMessageType.BUILD_TILE,
+            tileX,
+            tileY,
+            generation: this.tileGenerations.get(key)!,
+            staticGeometryVersion: this.staticGeometryVersion,
+            obstacles: this.obstacles,
+            tileBoundsMin: tileBoundsMin,
+            tileBoundsMax: tileBoundsMax,
+            recastConfig: this.recastConfig,
+            navMeshBounds: this.navMeshBounds,
+        }
+
+        this.tilesInFlight.set(key, traceStart())
+
+        worker.postMessage(job)
+
+        traceCounter('navmesh-tiles-in-flight', this.tilesInFlight.size)
+    }
+
+    private onTileResult({ tileX, tileY, generation, navMeshData: serialisedNavMeshData }: TileResultMessage) {
+        const key = `${tileX},${tileY}`
+
+        const dispatchTime = this.tilesInFlight.get(key)
+        this.tilesInFlight.delete(key)
+
+        // from dispatch to result, including time queued behind other tiles on the worker
+        if (dispatchTime) traceCounter('navmesh-tile-latency', traceStart() - dispatchTime)
+        traceCounter('navmesh-tiles-in-flight', this.tilesInFlight.size)
+
+        const pending = this.pendingTiles.get(key)
+
+        if (pending) {
+            this.pendingTiles.delete(key)
+            this.dispatchTile(key, pending[0], pending[1])
+        }
+
+        // a newer build was requested while this one was in flight
+        if (generation !== this.tileGenerations.get(key)) return
+
+        const navMesh = this.navMesh
+        const existingTileRef = navMesh.getTileRefAt(tileX, tileY, 0)
+
+        if (!serialisedNavMeshData) {
+            // e.g. obstacles cover the whole tile
+            if (!existingTileRef) return
+
+            navMesh.removeTile(existingTileRef)
+
+            this.navMeshVersion++
+            this.onNavMeshUpdate.emit(this.navMeshVersion, [tileX, tileY])
+
+            return
+        }
+
+        const navMeshData = toWasmNavMeshData(serialisedNavMeshData)
+
+        navMesh.removeTile(existingTileRef)
+
+        const addTileResult = navMesh.addTile(navMeshData, Detour.DT_TILE_FREE_DATA, 0)
+
+        if (Raw.Detour.statusFailed(addTileResult.status)) {
+            console.error(
+                Recast.RC_LOG_WARNING,
+                `Failed to add tile to nav mesh` +
+                    '\n\t' +
+                    `tx: ${tileX}, ty: ${tileY},` +
+                    `status: ${statusToReadableString(addTileResult.status)} (${addTileResult.status})`,
+            )
+
+            navMeshData.destroy()
+        }
+
+        this.navMeshVersion++
+        this.onNavMeshUpdate.emit(this.navMeshVersion, [tileX, tileY])
+    }
+
+    private getTileWorker(tileX: number, tileY: number) {
+        const n = this.workers.length
+
+        return (((tileX + tileY * this.tileWidth) % n) + n) % n
+    }
 }
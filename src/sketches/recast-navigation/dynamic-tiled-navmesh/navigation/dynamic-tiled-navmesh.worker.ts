@@ -1,9 +1,38 @@
+import { connectTracing, traceEnd, traceStart } from '@/common/utils/tracing'
+import { RecastCompactHeightfield, freeCompactHeightfield } from '@recast-navigation/core'
 import { init } from 'recast-navigation'
-import { BuildTileMeshProps, buildTile } from './build-tile'
+import {
+    buildTileCompactHeightfield,
+    buildTileFromCompactHeightfield,
+    getCompactHeightfieldAreas,
+    setCompactHeightfieldAreas,
+} from './build-tile'
+import {
+    BuildTileMessage,
+    DynamicTiledNavMeshWorkerMessage,
+    DynamicTiledNavMeshWorkerMessageType,
+    StaticGeometryMessage,
+    TileResultMessage,
+} from './dynamic-tiled-navmesh-worker-types'
+
+type CachedTile = {
+    staticGeometryVersion: number
+    compactHeightfield: RecastCompactHeightfield
+
+    /**
+     * Span areas before obstacles are marked and the walkable area is eroded
+     */
+    areas: Uint8Array
+}
 
 let ready = false
 
-const inbox: BuildTileMeshProps[] = []
+const inbox: DynamicTiledNavMeshWorkerMessage[] = []
+
+let staticGeometry: StaticGeometryMessage | undefined
+
+/* compact heightfields of static geometry, so obstacle changes don't rasterize the level again */
+const tileCache = new Map<string, CachedTile>()
 
 self.onmessage = (msg) => {
     if (ready) {
@@ -13,16 +42,86 @@ self.onmessage = (msg) => {
     }
 }
 
-const process = (props: BuildTileMeshProps) => {
-    const result = buildTile(props)
+const process = (message: DynamicTiledNavMeshWorkerMessage) => {
+    if (message.type === DynamicTiledNavMeshWorkerMessageType.STATIC_GEOMETRY) {
+        staticGeometry = message
+    } else if (message.type === DynamicTiledNavMeshWorkerMessageType.TRACING) {
+        connectTracing(message.traceBuffer, 'navmesh-tile-worker')
+    } else if (message.type === DynamicTiledNavMeshWorkerMessageType.BUILD_TILE) {
+        const start = traceStart()
+        const navMeshData = buildTile(message)
+        traceEnd('navmesh-build-tile', start)
+
+        const result: TileResultMessage = {
+            type: DynamicTiledNavMeshWorkerMessageType.TILE_RESULT,
+            tileX: message.tileX,
+            tileY: message.tileY,
+            generation: message.generation,
+            navMeshData,
+        }
+
+        self.postMessage(result, (navMeshData ? [navMeshData.buffer] : []) as never) // todo: type woes
+    }
+}
+
+const getCachedTile = (job: BuildTileMessage) => {
+    const key = `${job.tileX},${job.tileY}`
+
+    const cached = tileCache.get(key)
+
+    if (cached) {
+        if (cached.staticGeometryVersion === job.staticGeometryVersion) {
+            setCompactHeightfieldAreas(cached.compactHeightfield, cached.areas)
+
+            return cached
+        }
+
+        freeCompactHeightfield(cached.compactHeightfield)
+        tileCache.delete(key)
+    }
+
+    if (!staticGeometry || staticGeometry.version !== job.staticGeometryVersion) return undefined
+
+    const result = buildTileCompactHeightfield({
+        ...job,
+        positions: staticGeometry.positions,
+        indices: staticGeometry.indices,
+        keepIntermediates: false,
+    })
+
+    if (!result.success) return undefined
+
+    const tile: CachedTile = {
+        staticGeometryVersion: job.staticGeometryVersion,
+        compactHeightfield: result.compactHeightfield,
+        areas: getCompactHeightfieldAreas(result.compactHeightfield),
+    }
+
+    tileCache.set(key, tile)
+
+    return tile
+}
+
+const buildTile = (job: BuildTileMessage) => {
+    const cached = getCachedTile(job)
+
+    if (!cached) return undefined
 
-    if (!result.success || !result.data) return
+    const result = buildTileFromCompactHeightfield({
+        ...job,
+        compactHeightfield: cached.compactHeightfield,
+        obstacles: job.obstacles,
+        keepIntermediates: false,
+    })
+
+    if (!result.success || !result.data) return undefined
+
+    // a copy out of the wasm heap, so only the tile bytes are transferred
+    const navMeshData = result.data.toTypedArray()
 
-    const navMeshData = result.data.toTypedArray();
-    
     result.data.destroy()
 
-    self.postMessage({ tileX: props.tileX, tileY: props.tileY, navMeshData: navMeshData }, [navMeshData.buffer] as never) // todo: type woes
+    return navMeshData
 }
 
 init().then(() => {
@@ -32,4 +131,3 @@ init().then(() => {
         process(job)
     }
 })
-
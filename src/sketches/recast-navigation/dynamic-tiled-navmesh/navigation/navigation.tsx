@@ -1,11 +1,11 @@
 import { useInterval } from '@/common'
 import { useFrame } from '@react-three/fiber'
-import { useEffect, useMemo, useState } from 'react'
+import { useEffect, useMemo, useRef, useState } from 'react'
 import { Crowd, NavMesh, NavMeshQuery, RecastConfig } from 'recast-navigation'
 import { NavMeshHelper, getPositionsAndIndices } from 'recast-navigation/three'
 import * as THREE from 'three'
 import { create } from 'zustand'
-import { traversableQuery } from '../ecs'
+import { EntityType, traversableQuery } from '../ecs'
 import { DynamicTiledNavMesh } from './dynamic-tiled-navmesh'
 import { useControls } from 'leva'
 import { SKETCH } from '../const'
@@ -45,22 +45,26 @@ const navMeshWorkers = navigator.hardwareConcurrency ?? 3
 const maxAgents = 50
 const maxAgentRadius = 0.5
 
-export const getTraversableMeshes = () => {
-    const traversable = traversableQuery.entities.map((e) => e.three)
-
-    const traversableMeshes = new Set<THREE.Mesh>()
+const getMeshes = (objects: (THREE.Object3D | undefined)[]) => {
+    const meshes = new Set<THREE.Mesh>()
 
-    for (const obj of traversable) {
+    for (const obj of objects) {
         obj?.traverse((child) => {
             if (child instanceof THREE.Mesh) {
-                traversableMeshes.add(child)
+                meshes.add(child)
             }
         })
     }
 
-    return Array.from(traversableMeshes)
+    return Array.from(meshes)
 }
 
+export const getTraversableMeshes = () => {
+    return getMeshes(traversableQuery.entities.map((e) => e.three))
+}
+
+const getTileKey = (tile: [x: number, y: number]) => `${tile[0]},${tile[1]}`
+
 export const Navigation = () => {
     const { boundsDebug, navMeshDebug } = useControls(`${SKETCH}-navigation`, {
         boundsDebug: false,
@@ -70,12 +74,10 @@ export const Navigation = () => {
 
     const [dynamicTiledNavMesh, setDynamicTiledNavMesh] = useState<DynamicTiledNavMesh>()
 
-    const getTraversablePositionsAndIndices = (): [positions: Float32Array, indices: Uint32Array] => {
-        const traversableMeshes = getTraversableMeshes()
-        const [positions, indices] = getPositionsAndIndices(traversableMeshes)
-
-        return [positions, indices]
-    }
+    const staticGeometryDirty = useRef(false)
+    const staticEntities = useRef<EntityType[]>([])
+    const dirtyTiles = useRef(new Map<string, [x: number, y: number]>())
+    const previousRigidBodyTiles = useRef(new Map<string, [x: number, y: number]>())
 
     useEffect(() => {
         const dynamicTiledNavMesh = new DynamicTiledNavMesh({ navMeshBounds, recastConfig, maxTiles, workers: navMeshWorkers })
@@ -87,24 +89,14 @@ export const Navigation = () => {
         setDynamicTiledNavMesh(dynamicTiledNavMesh)
         useNav.setState({ dynamicTiledNavMesh, navMesh: dynamicTiledNavMesh.navMesh, navMeshQuery, crowd })
 
-        /* build tiles where traversable entities are added */
+        /* build tiles where traversable entities are added, once their components are known */
         const unsubTraversableQueryAdd = traversableQuery.onEntityAdded.add((entity) => {
-            const bounds = new THREE.Box3()
-
-            const meshes: THREE.Mesh[] = []
-            entity.three.traverse((child) => {
-                if (child instanceof THREE.Mesh) {
-                    meshes.push(child)
-                    bounds.expandByObject(child)
-                }
-            })
-
-            const [positions, indices] = getTraversablePositionsAndIndices()
+            const bounds = new THREE.Box3().expandByObject(entity.three)
 
-            const tiles = dynamicTiledNavMesh.getTilesForBounds(bounds)
+            staticGeometryDirty.current = true
 
-            for (const tile of tiles) {
-                dynamicTiledNavMesh.buildTile(positions, indices, tile)
+            for (const tile of dynamicTiledNavMesh.getTilesForBounds(bounds)) {
+                dirtyTiles.current.set(getTileKey(tile), tile)
             }
         })
 
@@ -119,31 +111,69 @@ export const Navigation = () => {
         }
     }, [])
 
-    /* rebuild tiles with active rigid bodies */
+    /* rebuild tiles with active rigid bodies, rigid bodies are obstacles marked on cached static tiles */
     useInterval(() => {
         if (!dynamicTiledNavMesh) return
 
-        const [positions, indices] = getTraversablePositionsAndIndices()
+        const tiles = dirtyTiles.current
+        dirtyTiles.current = new Map()
 
-        const tiles = new Map<string, [x: number, y: number]>()
+        /* static geometry, only sent again when static entities change */
+        if (staticGeometryDirty.current) {
+            staticGeometryDirty.current = false
 
-        for (const entity of traversableQuery) {
-            if (!entity.rigidBody) continue
-            if (entity.rigidBody.isSleeping()) continue
+            const entities = traversableQuery.entities.filter((e) => !e.rigidBody)
 
-            const box3 = new THREE.Box3()
+            const changed =
+                entities.length !== staticEntities.current.length ||
+                entities.some((entity, i) => entity !== staticEntities.current[i])
+
+            if (changed) {
+                staticEntities.current = entities
+
+                const [positions, indices] = getPositionsAndIndices(getMeshes(entities.map((e) => e.three)))
+                dynamicTiledNavMesh.setStaticGeometry(positions, indices)
+            }
+        }
+
+        /* obstacles */
+        const rigidBodyEntities = traversableQuery.entities.filter((e) => e.rigidBody)
+        const obstacles = new Float32Array(rigidBodyEntities.length * 6)
+        const rigidBodyTiles = new Map<string, [x: number, y: number]>()
+
+        const box3 = new THREE.Box3()
+
+        for (let i = 0; i < rigidBodyEntities.length; i++) {
+            const entity = rigidBodyEntities[i]
+
+            box3.makeEmpty()
             box3.expandByObject(entity.three)
 
-            const entityTiles = dynamicTiledNavMesh.getTilesForBounds(box3)
+            box3.min.toArray(obstacles, i * 6)
+            box3.max.toArray(obstacles, i * 6 + 3)
+
+            if (entity.rigidBody!.isSleeping()) continue
 
-            for (const tile of entityTiles) {
-                const key = `${tile[0]},${tile[1]}`
-                tiles.set(key, tile)
+            for (const tile of dynamicTiledNavMesh.getTilesForBounds(box3)) {
+                rigidBodyTiles.set(getTileKey(tile), tile)
             }
         }
 
+        dynamicTiledNavMesh.setObstacles(obstacles)
+
+        // tiles that awake rigid bodies are in now, or were in last time, as they may have moved out of them since
+        for (const [key, tile] of rigidBodyTiles) {
+            tiles.set(key, tile)
+        }
+
+        for (const [key, tile] of previousRigidBodyTiles.current) {
+            tiles.set(key, tile)
+        }
+
+        previousRigidBodyTiles.current = rigidBodyTiles
+
         for (const [, tileCoords] of tiles) {
-            dynamicTiledNavMesh.buildTile(positions, indices, tileCoords)
+            dynamicTiledNavMesh.buildTile(tileCoords)
         }
     }, 200)
 
@@ -17,6 +17,7 @@ const radius = 0.5
 const height = 1.5
 
 const _agentPosition = new THREE.Vector3()
+const _playerPosition = new THREE.Vector3()
 const _agentLookAt = new THREE.Vector3()
 const _direction = new THREE.Vector3()
 const _targetQuat = new THREE.Quaternion()
@@ -44,24 +45,43 @@ export const Agent = ({ position }: AgentProps) => {
     const pathIndex = useRef(1)
 
     /* compute path */
+    const pathQuery = useRef<number>()
+
     useInterval(() => {
-        const navMeshQuery = navQuery.first?.nav.navMeshQuery
-        if (!navMeshQuery) return
+        const pathQueryService = navQuery.first?.nav.pathQueryService
+        if (!pathQueryService) return
 
         const player = playerQuery.first
         if (!player) return
 
-        const rigidBody = ref.current
+        // the player has moved, a path to where they were is no longer needed
+        if (pathQuery.current !== undefined) {
+            pathQueryService.cancel(pathQuery.current)
+        }
 
-        const { point: closestPoint } = navMeshQuery.findClosestPoint(rigidBody.translation(), { halfExtents: queryHalfExtents })
-        const agentPosition = _agentPosition.copy(closestPoint)
+        const agentPosition = _agentPosition.copy(ref.current.translation())
+        const playerPosition = _playerPosition.copy(player.rigidBody.translation())
 
-        const { point: playerPosition } = navMeshQuery.findClosestPoint(player.rigidBody.translation(), { halfExtents: queryHalfExtents })
+        const query = {
+            start: agentPosition.toArray(),
+            end: playerPosition.toArray(),
+            halfExtents: queryHalfExtents.toArray(),
+        }
+
+        pathQuery.current = pathQueryService.request(query, ({ success, waypoints }) => {
+            pathQuery.current = undefined
+
+            if (!success) return
 
-        const { path } = navMeshQuery.computePath(agentPosition, playerPosition)
-        pathIndex.current = 1
+            const path: THREE.Vector3[] = []
+
+            for (let i = 0; i < waypoints.length; i += 3) {
+                path.push(new THREE.Vector3().fromArray(waypoints, i))
+            }
 
-        setPath(path.map((p) => new THREE.Vector3(p.x, p.y, p.z)))
+            pathIndex.current = 1
+            setPath(path)
+        })
     }, 1000 / 10)
 
     /* movement */
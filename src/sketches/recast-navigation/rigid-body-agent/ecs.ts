@@ -1,10 +1,21 @@
+import { PathQueryService } from '@/common/utils/path-query-service'
 import { RapierRigidBody } from '@react-three/rapier'
 import { World } from 'arancini'
 import { createReactAPI } from 'arancini/react'
 import { NavMesh, NavMeshQuery } from 'recast-navigation'
 import * as THREE from 'three'
+import type { NavMeshPathQuery, NavMeshPathQueryContext } from './navmesh/path-query-worker-types'
 
-export type NavComponent = { navMesh?: NavMesh; navMeshQuery?: NavMeshQuery; navMeshVersion: number }
+export type NavComponent = {
+    navMesh?: NavMesh
+    navMeshQuery?: NavMeshQuery
+    navMeshVersion: number
+
+    /**
+     * Runs navmesh path queries in workers
+     */
+    pathQueryService?: PathQueryService<NavMeshPathQuery, NavMeshPathQueryContext>
+}
 
 export type EntityType = {
     isPlayer?: true
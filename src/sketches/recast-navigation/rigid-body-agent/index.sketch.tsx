@@ -7,7 +7,7 @@ import { Agent } from './agent/agent'
 import { BoxTool } from './box-tool'
 import { SKETCH } from './const'
 import { Component, Entity } from './ecs'
-import { NavMeshDebug, NavMeshGenerator } from './navmesh/navmesh'
+import { NavMeshDebug, NavMeshGenerator, TiledNavMeshGenerator } from './navmesh/navmesh'
 import { Player, PlayerControls } from './player'
 
 const Scene = () => {
@@ -45,9 +45,10 @@ const Scene = () => {
 export default function Sketch() {
     const loading = useLoadingAssets()
 
-    const { physicsDebug, navMeshDebug } = useControls(`${SKETCH}-physics`, {
+    const { physicsDebug, navMeshDebug, tiledNavMesh } = useControls(`${SKETCH}-physics`, {
         physicsDebug: false,
         navMeshDebug: true,
+        tiledNavMesh: false,
     })
 
     return (
@@ -64,7 +65,7 @@ export default function Sketch() {
 
                     <BoxTool />
 
-                    <NavMeshGenerator />
+                    {tiledNavMesh ? <TiledNavMeshGenerator /> : <NavMeshGenerator />}
                 </Physics>
 
                 {navMeshDebug && <NavMeshDebug />}
@@ -1,12 +1,16 @@
 import { useConst, useInterval } from '@/common'
+import { PathQueryService } from '@/common/utils/path-query-service'
 import { useFrame } from '@react-three/fiber'
 import { useRapier } from '@react-three/rapier'
 import { useEffect, useRef, useState } from 'react'
-import { NavMesh, NavMeshQuery, RecastConfig, UnsignedCharArray, init } from 'recast-navigation'
+import { NavMesh, NavMeshQuery, RecastConfig, UnsignedCharArray, exportNavMesh, init } from 'recast-navigation'
 import { NavMeshHelper, getPositionsAndIndices } from 'recast-navigation/three'
 import * as THREE from 'three'
-import { Entity, NavComponent, navQuery, traversableQuery } from '../ecs'
+import { DynamicTiledNavMesh } from '../../dynamic-tiled-navmesh/navigation/dynamic-tiled-navmesh'
+import { Entity, NavComponent, navQuery, playerQuery, traversableQuery } from '../ecs'
 import NavMeshGeneratorWorker from './navmesh-generator.worker?worker'
+import { NavMeshPathQuery, NavMeshPathQueryContext } from './path-query-worker-types'
+import PathQueryWorker from './path-query.worker?worker'
 
 await init()
 
@@ -46,11 +50,22 @@ export const NavMeshGenerator = () => {
         nav.navMesh = navMesh
         nav.navMeshQuery = navMeshQuery
 
+        const pathQueryService = new PathQueryService<NavMeshPathQuery, NavMeshPathQueryContext>({
+            createWorker: () => new PathQueryWorker(),
+        })
+
+        pathQueryService.connect()
+        nav.pathQueryService = pathQueryService
+
         const worker = new NavMeshGeneratorWorker()
 
         worker.onmessage = ({ data: { navMeshData: serialisedNavMeshData } }) => {
             inProgress.current = false
 
+            // only the latest navmesh is needed by path query workers
+            pathQueryService.clearContext()
+            pathQueryService.setContext({ navMeshData: serialisedNavMeshData })
+
             const navMeshData = new UnsignedCharArray()
             navMeshData.copy(serialisedNavMeshData)
 
@@ -69,9 +84,16 @@ export const NavMeshGenerator = () => {
             worker.terminate()
             navMesh.destroy()
             navMeshQuery.destroy()
+
+            pathQueryService.disconnect()
+            nav.pathQueryService = undefined
         }
     }, [])
 
+    useFrame(() => {
+        nav.pathQueryService?.flush()
+    })
+
     useInterval(() => {
         if (inProgress.current) return
 
@@ -118,6 +140,158 @@ export const NavMeshGenerator = () => {
     )
 }
 
+const tiledNavMeshBounds = new THREE.Box3(new THREE.Vector3(-100, -100, -100), new THREE.Vector3(100, 100, 100))
+
+const tiledNavMeshCellSize = 0.2
+const tiledNavMeshCellHeight = 0.2
+
+const tiledRecastConfig: Partial<RecastConfig> = {
+    tileSize: 64,
+    cs: tiledNavMeshCellSize,
+    ch: tiledNavMeshCellHeight,
+    walkableRadius: 0.5 / tiledNavMeshCellSize,
+    walkableHeight: 2 / tiledNavMeshCellHeight,
+}
+
+const tiledNavMeshWorkers = navigator.hardwareConcurrency ?? 3
+
+/**
+ * Builds the level as a tiled navmesh across the dynamic tiled navmesh workers, nearest the player first,
+ * so agents can move on finished tiles while the rest are built.
+ */
+export const TiledNavMeshGenerator = () => {
+    const { rapier } = useRapier()
+
+    const dynamicTiledNavMesh = useRef<DynamicTiledNavMesh>()
+    const first = useRef(true)
+    const contextDirty = useRef(false)
+    const previousTiles = useRef(new Map<string, [x: number, y: number]>())
+
+    const nav = useConst<NavComponent>(() => ({
+        navMesh: undefined,
+        navMeshQuery: undefined,
+        navMeshVersion: 0,
+    }))
+
+    useEffect(() => {
+        const tiledNavMesh = new DynamicTiledNavMesh({
+            navMeshBounds: tiledNavMeshBounds,
+            recastConfig: tiledRecastConfig,
+            maxTiles: 1024,
+            workers: tiledNavMeshWorkers,
+        })
+
+        const navMeshQuery = new NavMeshQuery(tiledNavMesh.navMesh)
+
+        nav.navMesh = tiledNavMesh.navMesh
+        nav.navMeshQuery = navMeshQuery
+
+        const pathQueryService = new PathQueryService<NavMeshPathQuery, NavMeshPathQueryContext>({
+            createWorker: () => new PathQueryWorker(),
+        })
+
+        pathQueryService.connect()
+        nav.pathQueryService = pathQueryService
+
+        const unsubNavMeshUpdate = tiledNavMesh.onNavMeshUpdate.add((version) => {
+            nav.navMeshVersion = version
+            contextDirty.current = true
+        })
+
+        dynamicTiledNavMesh.current = tiledNavMesh
+
+        return () => {
+            unsubNavMeshUpdate()
+
+            dynamicTiledNavMesh.current = undefined
+            first.current = true
+
+            tiledNavMesh.destroy()
+            navMeshQuery.destroy()
+
+            pathQueryService.disconnect()
+            nav.pathQueryService = undefined
+        }
+    }, [])
+
+    useFrame(() => {
+        nav.pathQueryService?.flush()
+    })
+
+    useInterval(() => {
+        const tiledNavMesh = dynamicTiledNavMesh.current
+        if (!tiledNavMesh) return
+
+        /* path query workers get the navmesh as tiles are added */
+        if (contextDirty.current && nav.navMesh) {
+            contextDirty.current = false
+
+            nav.pathQueryService?.clearContext()
+            nav.pathQueryService?.setContext({ navMeshExport: exportNavMesh(nav.navMesh) })
+        }
+
+        /* tiles with awake dynamic rigid bodies, now and at the last rebuild, as bodies may have moved out of them */
+        const tiles = new Map<string, [x: number, y: number]>()
+
+        if (!first.current) {
+            const awakeTiles = new Map<string, [x: number, y: number]>()
+            const box = new THREE.Box3()
+
+            for (const entity of traversableQuery.entities) {
+                if (!entity.rigidBody || !entity.three) continue
+                if (entity.rigidBody.bodyType() !== rapier.RigidBodyType.Dynamic) continue
+                if (entity.rigidBody.isSleeping()) continue
+
+                box.setFromObject(entity.three)
+
+                for (const tile of tiledNavMesh.getTilesForBounds(box)) {
+                    awakeTiles.set(`${tile[0]},${tile[1]}`, tile)
+                }
+            }
+
+            for (const [key, tile] of [...awakeTiles, ...previousTiles.current]) {
+                tiles.set(key, tile)
+            }
+
+            previousTiles.current = awakeTiles
+
+            if (tiles.size === 0) return
+        }
+
+        const meshes = getTraversableMeshes().filter((mesh) => {
+            const box = new THREE.Box3().setFromObject(mesh)
+            return tiledNavMeshBounds.containsBox(box)
+        })
+
+        if (meshes.length === 0) return
+
+        const [positions, indices] = getPositionsAndIndices(meshes)
+
+        tiledNavMesh.setStaticGeometry(positions, indices)
+
+        if (first.current) {
+            first.current = false
+
+            const player = playerQuery.first
+            const origin = player ? new THREE.Vector3().copy(player.rigidBody.translation()) : undefined
+
+            tiledNavMesh.buildAllTiles(origin)
+
+            return
+        }
+
+        for (const [, tile] of tiles) {
+            tiledNavMesh.buildTile(tile)
+        }
+    }, 100)
+
+    return (
+        <>
+            <Entity nav={nav} />
+        </>
+    )
+}
+
 export const NavMeshDebug = () => {
     const [helper, setHelper] = useState<NavMeshHelper>()
     const prevNavMeshVersion = useRef<number>(0)
@@ -0,0 +1,25 @@
+import * as THREE from 'three'
+
+export type NavMeshPathQuery = {
+    start: THREE.Vector3Tuple
+    end: THREE.Vector3Tuple
+
+    /**
+     * Search extents for the closest points on the navmesh to the start and end
+     */
+    halfExtents: THREE.Vector3Tuple
+}
+
+export type NavMeshPathQueryContext =
+    | {
+          /**
+           * Serialised solo navmesh data
+           */
+          navMeshData: Uint8Array
+      }
+    | {
+          /**
+           * A navmesh from `exportNavMesh`, e.g. a tiled navmesh that is still being built
+           */
+          navMeshExport: Uint8Array
+      }
@@ -0,0 +1,72 @@
+import { PathQuerySearch, runPathQueryWorker } from '@/common/utils/path-query-worker'
+import { NavMesh, NavMeshQuery, UnsignedCharArray, importNavMesh, init } from 'recast-navigation'
+import { NavMeshPathQuery, NavMeshPathQueryContext } from './path-query-worker-types'
+
+let ready = false
+
+let navMesh: NavMesh | undefined
+let navMeshQuery: NavMeshQuery | undefined
+
+// the latest navmesh, kept until recast is ready
+let pendingContext: NavMeshPathQueryContext | undefined
+
+const loadNavMesh = () => {
+    if (!ready || !pendingContext) return
+
+    navMeshQuery?.destroy()
+    navMesh?.destroy()
+
+    if ('navMeshExport' in pendingContext) {
+        navMesh = importNavMesh(pendingContext.navMeshExport).navMesh
+    } else {
+        const navMeshData = new UnsignedCharArray()
+        navMeshData.copy(pendingContext.navMeshData)
+
+        navMesh = new NavMesh()
+        navMesh.initSolo(navMeshData)
+    }
+
+    navMeshQuery = new NavMeshQuery(navMesh)
+
+    pendingContext = undefined
+}
+
+const onContext = (context: NavMeshPathQueryContext) => {
+    pendingContext = context
+    loadNavMesh()
+}
+
+const computeNavMeshPath = ({ start, end, halfExtents }: NavMeshPathQuery) => {
+    if (!navMeshQuery) return null
+
+    const extents = { x: halfExtents[0], y: halfExtents[1], z: halfExtents[2] }
+
+    const { point: startPoint } = navMeshQuery.findClosestPoint({ x: start[0], y: start[1], z: start[2] }, { halfExtents: extents })
+    const { point: endPoint } = navMeshQuery.findClosestPoint({ x: end[0], y: end[1], z: end[2] }, { halfExtents: extents })
+
+    const { success, path } = navMeshQuery.computePath(startPoint, endPoint)
+
+    if (!success) return null
+
+    const waypoints = new Float32Array(path.length * 3)
+
+    for (let i = 0; i < path.length; i++) {
+        waypoints[i * 3] = path[i].x
+        waypoints[i * 3 + 1] = path[i].y
+        waypoints[i * 3 + 2] = path[i].z
+    }
+
+    return waypoints
+}
+
+// navmesh path queries are a single call into recast, so these searches finish in one step
+const searchNavMeshPath = (query: NavMeshPathQuery): PathQuerySearch => ({
+    next: () => ({ done: true, value: computeNavMeshPath(query) }),
+})
+
+runPathQueryWorker<NavMeshPathQuery, NavMeshPathQueryContext>({ search: searchNavMeshPath, onContext })
+
+init().then(() => {
+    ready = true
+    loadNavMesh()
+})
@@ -55,8 +55,11 @@ const Player = () => {
 }
 
 export default function Sketch() {
-    const { chunkHelper } = useControls(SKETCH, {
+    const { chunkHelper, lod, occlusionCulling, batched } = useControls(SKETCH, {
         chunkHelper: false,
+        lod: false,
+        occlusionCulling: false,
+        batched: false,
     })
 
     return (
@@ -64,8 +67,8 @@ export default function Sketch() {
             <Crosshair />
 
             <Canvas camera={{ near: 0.001 }}>
-                <Voxels>
-                    <VoxelChunkMeshes chunkHelper={chunkHelper} />
+                <Voxels lodDistances={lod ? [64, 128] : []} occlusionCulling={occlusionCulling}>
+                    <VoxelChunkMeshes chunkHelper={chunkHelper} batched={batched} />
 
                     <SimpleLevel />
 
@@ -1,84 +1,28 @@
+import { IndexedBinaryHeap } from '@/common/utils/indexed-binary-heap'
 import * as THREE from 'three'
 import { World } from '../lib/world'
 import { sweep } from './sweep'
 
-class PriorityQueue<T> {
-    heap: { element: T; priority: number }[] = []
-
-    enqueue(element: T, priority: number): void {
-        this.heap.push({ element, priority })
-        this.heapifyUp(this.heap.length - 1)
-    }
-
-    dequeue(): T | undefined {
-        if (this.heap.length === 0) {
-            return undefined
-        }
-
-        const first = this.heap[0]
-        const last = this.heap.pop()!
-
-        if (this.heap.length > 0) {
-            this.heap[0] = last
-            this.heapifyDown(0)
-        }
-
-        return first.element
-    }
-
-    private heapifyUp(index: number): void {
-        const parentIndex = Math.floor((index - 1) / 2)
-
-        if (parentIndex >= 0 && this.heap[parentIndex].priority > this.heap[index].priority) {
-            this.swap(index, parentIndex)
-            this.heapifyUp(parentIndex)
-        }
-    }
-
-    private heapifyDown(index: number): void {
-        const leftChildIndex = 2 * index + 1
-        const rightChildIndex = 2 * index + 2
-        let smallestIndex = index
-
-        if (leftChildIndex < this.heap.length && this.heap[leftChildIndex].priority < this.heap[smallestIndex].priority) {
-            smallestIndex = leftChildIndex
-        }
-
-        if (rightChildIndex < this.heap.length && this.heap[rightChildIndex].priority < this.heap[smallestIndex].priority) {
-            smallestIndex = rightChildIndex
-        }
-
-        if (smallestIndex !== index) {
-            this.swap(index, smallestIndex)
-            this.heapifyDown(smallestIndex)
-        }
-    }
-
-    private swap(i: number, j: number): void {
-        const temp = this.heap[i]
-        this.heap[i] = this.heap[j]
-        this.heap[j] = temp
-    }
-}
+const _position = new THREE.Vector3()
 
 const canGoThrough = (world: World, height: number, x: number, y: number, z: number): boolean => {
     for (let h = 0; h < height; h++) {
-        if (world.getSolid({ x, y: y + h, z })) {
+        if (world.getSolid(_position.set(x, y + h, z))) {
             return false
         }
     }
     return true
 }
 
-const canStepAt = (world: World, height: number, x: number, y: number, z: number): boolean => {
-    if (!world.getSolid({ x, y: y - 1, z })) {
+export const canStepAt = (world: World, height: number, x: number, y: number, z: number): boolean => {
+    if (!world.getSolid(_position.set(x, y - 1, z))) {
         return false
     }
 
     return canGoThrough(world, height, x, y, z)
 }
 
-const directions: THREE.Vector3[] = [
+export const directions: THREE.Vector3[] = [
     new THREE.Vector3(-1, 0, 0),
     new THREE.Vector3(-1, 1, 0),
     new THREE.Vector3(-1, -1, 0),
@@ -162,8 +106,27 @@ const heuristic = (start: THREE.Vector3Like, goal: THREE.Vector3Like) => {
 //     return Math.abs(start.x - goal.x) + Math.abs(start.y - goal.y) + Math.abs(start.z - goal.z)
 // }
 
-const vector3ToString = (position: THREE.Vector3Like) => {
-    return `${position.x},${position.y},${position.z}`
+const POSITION_KEY_OFFSET = 1 << 16
+const POSITION_KEY_AXIS = 1 << 17
+
+/**
+ * Packs an integer voxel position into a single number, exact for coordinates in the range [-65536, 65535]
+ */
+export const positionKey = (position: THREE.Vector3Like) => {
+    const x = position.x + POSITION_KEY_OFFSET
+    const y = position.y + POSITION_KEY_OFFSET
+    const z = position.z + POSITION_KEY_OFFSET
+
+    return (x * POSITION_KEY_AXIS + y) * POSITION_KEY_AXIS + z
+}
+
+export const positionFromKey = (key: number, out = new THREE.Vector3()) => {
+    const z = key % POSITION_KEY_AXIS
+    const xy = (key - z) / POSITION_KEY_AXIS
+    const y = xy % POSITION_KEY_AXIS
+    const x = (xy - y) / POSITION_KEY_AXIS
+
+    return out.set(x - POSITION_KEY_OFFSET, y - POSITION_KEY_OFFSET, z - POSITION_KEY_OFFSET)
 }
 
 export type SearchType = 'greedy' | 'shortest'
@@ -174,21 +137,30 @@ type FindPathProps = {
     goal: THREE.Vector3
     searchType: SearchType
     earlyExit?: ComputePathEarlyExit
+    stepIterations: number
 }
 
 type FindPathResult = {
     success: boolean
     path: Node[]
     iterations: number
-    explored: Map<string, Node>
+    explored: Map<number, Node>
 }
 
-const findPath = ({ world, start, goal, searchType, earlyExit }: FindPathProps): FindPathResult => {
-    const frontier = new PriorityQueue<Node>()
-    const explored = new Map<string, Node>()
+function* findPath({ world, start, goal, searchType, earlyExit, stepIterations }: FindPathProps): Generator<void, FindPathResult> {
+    const explored = new Map<number, Node>()
+
+    // frontier entries are indices into openNodes, openNodeIds maps position keys to those indices
+    const frontier = new IndexedBinaryHeap()
+
+    const openNodes: Node[] = []
+    const openNodeIds = new Map<number, number>()
 
     const initialNode: Node = { position: start, parent: null, g: 0, h: heuristic(start, goal), f: heuristic(start, goal) }
-    frontier.enqueue(initialNode, initialNode.f)
+
+    openNodes.push(initialNode)
+    openNodeIds.set(positionKey(start), 0)
+    frontier.push(0, initialNode.f)
 
     let iterations = 0
 
@@ -200,11 +172,13 @@ const findPath = ({ world, start, goal, searchType, earlyExit }: FindPathProps):
         return { success: true, path, iterations, explored }
     }
 
-    while (frontier.heap.length > 0) {
+    while (!frontier.isEmpty()) {
         if (earlyExit && iterations >= earlyExit.searchIterations) return fail()
         iterations++
 
-        const currentNode = frontier.dequeue()!
+        if (iterations % stepIterations === 0) yield
+
+        const currentNode = openNodes[frontier.pop()]
 
         if (currentNode.position.equals(goal)) {
             const path: Node[] = []
@@ -217,12 +191,12 @@ const findPath = ({ world, start, goal, searchType, earlyExit }: FindPathProps):
             return succeed(path)
         }
 
-        explored.set(vector3ToString(currentNode.position), currentNode)
+        explored.set(positionKey(currentNode.position), currentNode)
 
         for (const action of actions(world, currentNode.position)) {
-            const existingNode = explored.get(vector3ToString(action.newPosition))
+            const key = positionKey(action.newPosition)
 
-            if (existingNode) continue
+            if (explored.has(key)) continue
 
             const g = currentNode.g + action.cost
             const h = heuristic(action.newPosition, goal)
@@ -234,17 +208,17 @@ const findPath = ({ world, start, goal, searchType, earlyExit }: FindPathProps):
             // greedy best-first search
             // const f = h
 
-            const openNode = frontier.heap.find((item) => item.element.position.equals(action.newPosition))
-
-            if (!openNode || f < openNode.element.f) {
-                const newNode: Node = { position: action.newPosition, parent: currentNode, g, h, f, action }
+            let openNodeId = openNodeIds.get(key)
 
-                if (openNode) {
-                    const openNodeIndex = frontier.heap.indexOf(openNode)
-                    frontier.heap.splice(openNodeIndex, 1)
-                }
+            if (openNodeId === undefined) {
+                openNodeId = openNodes.length
+                openNodeIds.set(key, openNodeId)
+                openNodes.push(null!)
+            }
 
-                frontier.enqueue(newNode, f)
+            // adds the node, or lowers its priority if it is already in the frontier with a higher f
+            if (frontier.push(openNodeId, f)) {
+                openNodes[openNodeId] = { position: action.newPosition, parent: currentNode, g, h, f, action }
             }
         }
     }
@@ -344,21 +318,31 @@ export type ComputePathResult = {
     success: boolean
     path: Node[]
     intermediates?: {
-        explored: Map<string, Node>
+        explored: Map<number, Node>
         iterations: number
     }
 }
 
-export const computePath = ({
-    world,
-    start,
-    goal,
-    smooth = true,
-    searchType,
-    earlyExit,
-    keepIntermediates = false,
-}: ComputePathProps): ComputePathResult => {
-    const { success, path, iterations, explored } = findPath({ world, start, goal, searchType, earlyExit })
+export const computePath = (props: ComputePathProps): ComputePathResult => {
+    const search = computePathSteps(props, Infinity)
+
+    let step = search.next()
+
+    while (!step.done) {
+        step = search.next()
+    }
+
+    return step.value
+}
+
+/**
+ * Resumable `computePath`, yields every `stepIterations` search iterations so the search can be time sliced
+ */
+export function* computePathSteps(
+    { world, start, goal, smooth = true, searchType, earlyExit, keepIntermediates = false }: ComputePathProps,
+    stepIterations = 1024,
+): Generator<void, ComputePathResult> {
+    const { success, path, iterations, explored } = yield* findPath({ world, start, goal, searchType, earlyExit, stepIterations })
 
     const intermediates = keepIntermediates ? { explored, iterations } : undefined
 
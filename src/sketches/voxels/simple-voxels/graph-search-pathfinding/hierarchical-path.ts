@@ -0,0 +1,552 @@
+import { IndexedBinaryHeap } from '@/common/utils/indexed-binary-heap'
+import { SpatialHashMap, packSpatialHashKey } from '@/common/utils/spatial-hash'
+import * as THREE from 'three'
+import type { Voxels, VoxelsChange } from '../lib/voxels'
+import { CHUNK_BITS, CHUNK_SIZE, World } from '../lib/world'
+import { canStepAt, directions, positionFromKey, positionKey } from './compute-path'
+
+type ClusterNode = {
+    key: number
+    position: THREE.Vector3
+
+    /**
+     * Position keys of connected nodes, in the same cluster or across a chunk border
+     */
+    edges: number[]
+    costs: number[]
+}
+
+type Cluster = {
+    x: number
+    y: number
+    z: number
+    nodes: Map<number, ClusterNode>
+}
+
+type LocalSearchResult = {
+    success: boolean
+    costs: Map<number, number>
+    parents: Map<number, number>
+}
+
+const _localFrontier = new IndexedBinaryHeap()
+const _localPosition = new THREE.Vector3()
+const _localGoal = new THREE.Vector3()
+
+/**
+ * Dijkstra over the standable cells of one chunk, or A* if a goal is given
+ */
+const searchCluster = (world: World, agentHeight: number, cluster: Cluster, start: number, goal?: number): LocalSearchResult => {
+    const minX = cluster.x * CHUNK_SIZE
+    const minY = cluster.y * CHUNK_SIZE
+    const minZ = cluster.z * CHUNK_SIZE
+
+    const costs = new Map<number, number>()
+    const parents = new Map<number, number>()
+
+    // frontier entries are indices into keys
+    const keys: number[] = []
+    const ids = new Map<number, number>()
+    const g: number[] = []
+
+    const hasGoal = goal !== undefined
+
+    if (hasGoal) positionFromKey(goal, _localGoal)
+
+    const heuristic = (position: THREE.Vector3) => (hasGoal ? position.distanceTo(_localGoal) : 0)
+
+    const frontier = _localFrontier
+    frontier.clear()
+
+    keys.push(start)
+    ids.set(start, 0)
+    g.push(0)
+    frontier.push(0, heuristic(positionFromKey(start, _localPosition)))
+
+    while (!frontier.isEmpty()) {
+        const id = frontier.pop()
+        const key = keys[id]
+        const cost = g[id]
+
+        costs.set(key, cost)
+
+        if (key === goal) return { success: true, costs, parents }
+
+        const position = positionFromKey(key, _localPosition)
+        const x = position.x
+        const y = position.y
+        const z = position.z
+
+        for (const direction of directions) {
+            const nx = x + direction.x
+            const ny = y + direction.y
+            const nz = z + direction.z
+
+            if (nx < minX || nx >= minX + CHUNK_SIZE || ny < minY || ny >= minY + CHUNK_SIZE || nz < minZ || nz >= minZ + CHUNK_SIZE) {
+                continue
+            }
+
+            if (!canStepAt(world, agentHeight, nx, ny, nz)) continue
+
+            const neighbour = _localPosition.set(nx, ny, nz)
+            const neighbourKey = positionKey(neighbour)
+
+            if (costs.has(neighbourKey)) continue
+
+            const neighbourCost = cost + 1
+
+            let neighbourId = ids.get(neighbourKey)
+
+            if (neighbourId === undefined) {
+                neighbourId = keys.length
+                ids.set(neighbourKey, neighbourId)
+                keys.push(neighbourKey)
+                g.push(Infinity)
+            }
+
+            if (neighbourCost >= g[neighbourId]) continue
+
+            g[neighbourId] = neighbourCost
+            parents.set(neighbourKey, key)
+            frontier.push(neighbourId, neighbourCost + heuristic(neighbour))
+        }
+    }
+
+    return { success: !hasGoal, costs, parents }
+}
+
+const _cell = new THREE.Vector3()
+const _neighbour = new THREE.Vector3()
+
+/**
+ * Finds transitions between standable cells on either side of a chunk border, and picks one portal per run of adjacent transitions.
+ *
+ * Both chunks on a border derive the same portals, so clusters can be built and rebuilt independently.
+ */
+const findPortals = (world: World, agentHeight: number, cluster: Cluster) => {
+    const clusterId = packSpatialHashKey(cluster.x, cluster.y, cluster.z)
+
+    const minX = cluster.x * CHUNK_SIZE
+    const minY = cluster.y * CHUNK_SIZE
+    const minZ = cluster.z * CHUNK_SIZE
+    const max = CHUNK_SIZE - 1
+
+    /* transitions from a border cell to a cell in another chunk, grouped by the other chunk */
+    const groups = new Map<number, [inside: number, outside: number][]>()
+
+    for (let ly = 0; ly < CHUNK_SIZE; ly++) {
+        for (let lz = 0; lz < CHUNK_SIZE; lz++) {
+            for (let lx = 0; lx < CHUNK_SIZE; lx++) {
+                const border = lx === 0 || lx === max || ly === 0 || ly === max || lz === 0 || lz === max
+
+                if (!border) continue
+
+                const x = minX + lx
+                const y = minY + ly
+                const z = minZ + lz
+
+                if (!canStepAt(world, agentHeight, x, y, z)) continue
+
+                const inside = positionKey(_cell.set(x, y, z))
+
+                for (const direction of directions) {
+                    const nx = x + direction.x
+                    const ny = y + direction.y
+                    const nz = z + direction.z
+
+                    const ncx = nx >> CHUNK_BITS
+                    const ncy = ny >> CHUNK_BITS
+                    const ncz = nz >> CHUNK_BITS
+
+                    if (ncx === cluster.x && ncy === cluster.y && ncz === cluster.z) continue
+
+                    if (!canStepAt(world, agentHeight, nx, ny, nz)) continue
+
+                    const neighbourId = packSpatialHashKey(ncx, ncy, ncz)
+
+                    let group = groups.get(neighbourId)
+
+                    if (!group) {
+                        group = []
+                        groups.set(neighbourId, group)
+                    }
+
+                    group.push([inside, positionKey(_neighbour.set(nx, ny, nz))])
+                }
+            }
+        }
+    }
+
+    /* one portal per connected run of transitions */
+    const portals: [inside: number, outside: number][] = []
+
+    for (const [neighbourId, transitions] of groups) {
+        // sort from the side of the chunk with the lower id, so both sides use the same order
+        const low = clusterId < neighbourId ? 0 : 1
+        const high = 1 - low
+
+        transitions.sort((a, b) => a[low] - b[low] || a[high] - b[high])
+
+        const count = transitions.length
+
+        const insidePositions = transitions.map(([inside]) => positionFromKey(inside))
+        const outsidePositions = transitions.map(([, outside]) => positionFromKey(outside))
+
+        const parent = transitions.map((_, i) => i)
+
+        const find = (i: number): number => {
+            while (parent[i] !== i) {
+                parent[i] = parent[parent[i]]
+                i = parent[i]
+            }
+
+            return i
+        }
+
+        const adjacent = (a: THREE.Vector3, b: THREE.Vector3) =>
+            Math.abs(a.x - b.x) <= 1 && Math.abs(a.y - b.y) <= 1 && Math.abs(a.z - b.z) <= 1
+
+        for (let i = 0; i < count; i++) {
+            for (let j = i + 1; j < count; j++) {
+                if (!adjacent(insidePositions[i], insidePositions[j]) || !adjacent(outsidePositions[i], outsidePositions[j])) continue
+
+                const ri = find(i)
+                const rj = find(j)
+
+                // keep the lowest index as the root, so the result doesn't depend on the side
+                if (ri < rj) parent[rj] = ri
+                else if (rj < ri) parent[ri] = rj
+            }
+        }
+
+        const runs = new Map<number, number[]>()
+
+        for (let i = 0; i < count; i++) {
+            const root = find(i)
+
+            let run = runs.get(root)
+
+            if (!run) {
+                run = []
+                runs.set(root, run)
+            }
+
+            run.push(i)
+        }
+
+        for (const run of runs.values()) {
+            portals.push(transitions[run[run.length >>> 1]])
+        }
+    }
+
+    return portals
+}
+
+export type HierarchicalPathfinderParams = {
+    world: World
+
+    /**
+     * @default 2
+     */
+    agentHeight?: number
+}
+
+export type HierarchicalComputePathProps = {
+    start: THREE.Vector3
+    goal: THREE.Vector3
+
+    /**
+     * Maximum abstract graph nodes to expand
+     * @default 10000
+     */
+    maxIterations?: number
+}
+
+export type HierarchicalComputePathResult = {
+    success: boolean
+    path: THREE.Vector3[]
+
+    /**
+     * Portal positions the path goes through
+     */
+    abstractPath: THREE.Vector3[]
+}
+
+const _abstractFrontier = new IndexedBinaryHeap()
+const _abstractPosition = new THREE.Vector3()
+
+/**
+ * Hierarchical A* (HPA*) over voxel chunks, for one agent height.
+ *
+ * Each chunk is a cluster. Portals are standable cells on chunk borders, connected to the portals of neighbouring chunks,
+ * and to the other portals in their chunk by paths found with a local search. Queries search the graph of portals first,
+ * then refine each step with a local search inside one chunk.
+ *
+ * Clusters are built when a query first reaches them, and changed blocks invalidate only the clusters around them.
+ */
+export class HierarchicalPathfinder {
+    world: World
+
+    agentHeight: number
+
+    private clusters = new SpatialHashMap<Cluster>()
+
+    constructor({ world, agentHeight = 2 }: HierarchicalPathfinderParams) {
+        this.world = world
+        this.agentHeight = agentHeight
+    }
+
+    /**
+     * Invalidates clusters when blocks change
+     *
+     * @returns a function that disconnects from the voxels
+     */
+    connect(voxels: Voxels) {
+        return voxels.onUpdate.add((changes) => {
+            this.invalidate(changes)
+        })
+    }
+
+    /**
+     * Removes clusters that could be affected by block changes, they are rebuilt when next needed
+     */
+    invalidate(changes: VoxelsChange[]) {
+        const invalidated = new Set<number>()
+
+        for (const { position } of changes) {
+            const cx = position.x >> CHUNK_BITS
+            const cz = position.z >> CHUNK_BITS
+
+            // a block affects cells it supports above it, and cells whose clearance it fills below it
+            const minCy = (position.y - this.agentHeight + 1) >> CHUNK_BITS
+            const maxCy = (position.y + 1) >> CHUNK_BITS
+
+            for (let cy = minCy; cy <= maxCy; cy++) {
+                const chunkId = packSpatialHashKey(cx, cy, cz)
+
+                if (invalidated.has(chunkId)) continue
+                invalidated.add(chunkId)
+
+                // neighbouring clusters share portals on their borders
+                for (let dx = -1; dx <= 1; dx++) {
+                    for (let dy = -1; dy <= 1; dy++) {
+                        for (let dz = -1; dz <= 1; dz++) {
+                            this.clusters.delete(packSpatialHashKey(cx + dx, cy + dy, cz + dz))
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    clear() {
+        this.clusters.clear()
+    }
+
+    computePath({ start, goal, maxIterations = 10000 }: HierarchicalComputePathProps): HierarchicalComputePathResult {
+        const { world, agentHeight } = this
+
+        const fail = (): HierarchicalComputePathResult => ({ success: false, path: [], abstractPath: [] })
+
+        const startKey = positionKey(start)
+        const goalKey = positionKey(goal)
+
+        const startCluster = this.getCluster(start.x >> CHUNK_BITS, start.y >> CHUNK_BITS, start.z >> CHUNK_BITS)
+        const goalCluster = this.getCluster(goal.x >> CHUNK_BITS, goal.y >> CHUNK_BITS, goal.z >> CHUNK_BITS)
+
+        /* start and goal in the same chunk, try a local path first */
+        if (startCluster === goalCluster) {
+            const local = searchCluster(world, agentHeight, startCluster, startKey, goalKey)
+
+            if (local.success) {
+                return { success: true, path: this.localPath(local, startKey, goalKey), abstractPath: [] }
+            }
+        }
+
+        /* temporary edges from the start and to the goal */
+        const startCosts = searchCluster(world, agentHeight, startCluster, startKey).costs
+        const goalCosts = searchCluster(world, agentHeight, goalCluster, goalKey).costs
+
+        /* search the abstract graph */
+        const frontier = _abstractFrontier
+        frontier.clear()
+
+        const keys: number[] = [startKey]
+        const ids = new Map<number, number>([[startKey, 0]])
+        const g: number[] = [0]
+        const parents: number[] = [-1]
+        const closed: boolean[] = []
+
+        frontier.push(0, start.distanceTo(goal))
+
+        let iterations = 0
+        let goalId = -1
+
+        const visit = (fromId: number, key: number, cost: number) => {
+            let id = ids.get(key)
+
+            if (id === undefined) {
+                id = keys.length
+                ids.set(key, id)
+                keys.push(key)
+                g.push(Infinity)
+                parents.push(-1)
+            }
+
+            if (closed[id] || cost >= g[id]) return
+
+            g[id] = cost
+            parents[id] = fromId
+            frontier.push(id, cost + positionFromKey(key, _abstractPosition).distanceTo(goal))
+        }
+
+        while (!frontier.isEmpty()) {
+            if (iterations++ >= maxIterations) return fail()
+
+            const id = frontier.pop()
+            const key = keys[id]
+
+            closed[id] = true
+
+            if (key === goalKey) {
+                goalId = id
+                break
+            }
+
+            if (id === 0) {
+                for (const node of startCluster.nodes.values()) {
+                    const cost = startCosts.get(node.key)
+
+                    if (cost !== undefined) visit(id, node.key, cost)
+                }
+
+                // the start can be a portal itself, its edges across the chunk border are followed below
+            }
+
+            const node = this.getNode(key)
+
+            if (!node) continue
+
+            for (let i = 0; i < node.edges.length; i++) {
+                visit(id, node.edges[i], g[id] + node.costs[i])
+            }
+
+            const goalCost = goalCosts.get(key)
+
+            if (goalCost !== undefined && goalCluster.nodes.has(key)) {
+                visit(id, goalKey, g[id] + goalCost)
+            }
+        }
+
+        if (goalId === -1) return fail()
+
+        const abstractKeys: number[] = []
+
+        for (let id = goalId; id !== -1; id = parents[id]) {
+            abstractKeys.push(keys[id])
+        }
+
+        abstractKeys.reverse()
+
+        /* refine each abstract step */
+        const path: THREE.Vector3[] = [positionFromKey(startKey)]
+
+        for (let i = 1; i < abstractKeys.length; i++) {
+            const from = positionFromKey(abstractKeys[i - 1])
+            const to = positionFromKey(abstractKeys[i])
+
+            const sameCluster =
+                from.x >> CHUNK_BITS === to.x >> CHUNK_BITS &&
+                from.y >> CHUNK_BITS === to.y >> CHUNK_BITS &&
+                from.z >> CHUNK_BITS === to.z >> CHUNK_BITS
+
+            if (!sameCluster) {
+                path.push(to)
+                continue
+            }
+
+            const cluster = this.getCluster(from.x >> CHUNK_BITS, from.y >> CHUNK_BITS, from.z >> CHUNK_BITS)
+            const local = searchCluster(world, agentHeight, cluster, abstractKeys[i - 1], abstractKeys[i])
+
+            if (!local.success) return fail()
+
+            const localPath = this.localPath(local, abstractKeys[i - 1], abstractKeys[i])
+
+            for (let j = 1; j < localPath.length; j++) {
+                path.push(localPath[j])
+            }
+        }
+
+        const abstractPath = abstractKeys.slice(1, -1).map((key) => positionFromKey(key))
+
+        return { success: true, path, abstractPath }
+    }
+
+    private localPath({ parents }: LocalSearchResult, startKey: number, goalKey: number) {
+        const path: THREE.Vector3[] = []
+
+        for (let key: number | undefined = goalKey; key !== undefined; key = parents.get(key)) {
+            path.push(positionFromKey(key))
+
+            if (key === startKey) break
+        }
+
+        return path.reverse()
+    }
+
+    private getNode(key: number) {
+        const position = positionFromKey(key, _abstractPosition)
+
+        const cluster = this.getCluster(position.x >> CHUNK_BITS, position.y >> CHUNK_BITS, position.z >> CHUNK_BITS)
+
+        return cluster.nodes.get(key)
+    }
+
+    private getCluster(x: number, y: number, z: number) {
+        const id = packSpatialHashKey(x, y, z)
+
+        let cluster = this.clusters.get(id)
+
+        if (!cluster) {
+            cluster = this.buildCluster(x, y, z)
+            this.clusters.set(id, cluster)
+        }
+
+        return cluster
+    }
+
+    private buildCluster(x: number, y: number, z: number): Cluster {
+        const cluster: Cluster = { x, y, z, nodes: new Map() }
+
+        /* portal nodes, with edges across the chunk border */
+        for (const [inside, outside] of findPortals(this.world, this.agentHeight, cluster)) {
+            let node = cluster.nodes.get(inside)
+
+            if (!node) {
+                node = { key: inside, position: positionFromKey(inside), edges: [], costs: [] }
+                cluster.nodes.set(inside, node)
+            }
+
+            node.edges.push(outside)
+            node.costs.push(1)
+        }
+
+        /* edges between portals in the chunk */
+        for (const node of cluster.nodes.values()) {
+            const { costs } = searchCluster(this.world, this.agentHeight, cluster, node.key)
+
+            for (const other of cluster.nodes.values()) {
+                if (other === node) continue
+
+                const cost = costs.get(other.key)
+
+                if (cost === undefined) continue
+
+                node.edges.push(other.key)
+                node.costs.push(cost)
+            }
+        }
+
+        return cluster
+    }
+}
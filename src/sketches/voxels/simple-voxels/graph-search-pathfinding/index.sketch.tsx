@@ -1,5 +1,7 @@
-import { Canvas } from '@/common'
+import { Canvas, useConst } from '@/common'
+import { PathQueryService } from '@/common/utils/path-query-service'
 import { Line, OrbitControls, PerspectiveCamera, PivotControls } from '@react-three/drei'
+import { useFrame } from '@react-three/fiber'
 import { useControls } from 'leva'
 import { Generator, noise } from 'maath/random'
 import { useEffect, useMemo, useRef, useState } from 'react'
@@ -7,6 +9,9 @@ import * as THREE from 'three'
 import { VoxelChunkMeshes, Voxels, useVoxels } from '../lib/react'
 import { PointerBuildTool, PointerBuildToolColorPicker } from '../pointer-build-tool'
 import { SearchType, computePath } from './compute-path'
+import { HierarchicalPathfinder } from './hierarchical-path'
+import { VoxelPathQuery, VoxelPathQueryContext } from './path-query-worker-types'
+import PathQueryWorker from './path-query.worker?worker'
 
 type PathProps = {
     start: THREE.Vector3
@@ -15,11 +20,54 @@ type PathProps = {
     showExplored: boolean
     earlyExitSearchIterations: number
     searchType: 'greedy' | 'shortest'
+    hierarchical: boolean
+    worker: boolean
 }
 
-const Path = ({ start, goal, smooth, showExplored, earlyExitSearchIterations, searchType }: PathProps) => {
+const Path = ({ start, goal, smooth, showExplored, earlyExitSearchIterations, searchType, hierarchical, worker }: PathProps) => {
     const { voxels } = useVoxels()
 
+    const hierarchicalPathfinder = useMemo(() => new HierarchicalPathfinder({ world: voxels.world }), [])
+
+    useEffect(() => hierarchicalPathfinder.connect(voxels), [])
+
+    const pathQueryService = useConst(
+        () => new PathQueryService<VoxelPathQuery, VoxelPathQueryContext>({ createWorker: () => new PathQueryWorker() }),
+    )
+
+    const sentChunkPages = useRef(0)
+
+    useEffect(() => {
+        const { world } = voxels
+        const directory = world.directory!
+
+        pathQueryService.connect()
+
+        pathQueryService.setContext({
+            worldId: world.id,
+            chunkDirectoryIndexBuffer: directory.indexBuffer,
+            chunkDirectoryPages: [...directory.pages],
+        })
+
+        sentChunkPages.current = directory.pages.length
+
+        return () => {
+            pathQueryService.disconnect()
+            pathQueryService.clearContext()
+        }
+    }, [])
+
+    useFrame(() => {
+        const pages = voxels.world.directory!.pages
+
+        if (pages.length > sentChunkPages.current) {
+            pathQueryService.setContext({ chunkDirectoryPages: pages.slice(sentChunkPages.current) })
+            sentChunkPages.current = pages.length
+        }
+
+        pathQueryService.flush()
+    })
+
     const [path, setPath] = useState<THREE.Vector3[]>([])
     const [explored, setExplored] = useState<THREE.Vector3[]>([])
     const [version, setVersion] = useState(0)
@@ -34,6 +82,43 @@ const Path = ({ start, goal, smooth, showExplored, earlyExitSearchIterations, se
     useEffect(() => {
         const { world } = voxels
 
+        if (worker) {
+            const query: VoxelPathQuery = {
+                start: start.toArray(),
+                goal: goal.toArray(),
+                smooth,
+                searchType,
+                searchIterations: earlyExitSearchIterations,
+            }
+
+            const id = pathQueryService.request(query, ({ success, waypoints }) => {
+                const path: THREE.Vector3[] = []
+
+                for (let i = 0; success && i < waypoints.length; i += 3) {
+                    path.push(new THREE.Vector3().fromArray(waypoints, i).addScalar(0.5))
+                }
+
+                setPath(path)
+                setExplored([])
+            })
+
+            // cancel if the start or goal moves before the result arrives
+            return () => pathQueryService.cancel(id)
+        }
+
+        if (hierarchical) {
+            console.time('hierarchical pathfinding')
+            const result = hierarchicalPathfinder.computePath({ start, goal })
+            console.timeEnd('hierarchical pathfinding')
+
+            setPath(result.path.map((position) => position.clone().addScalar(0.5)))
+
+            // show the portals the path goes through
+            setExplored(result.abstractPath.map((position) => position.clone().addScalar(0.5)))
+
+            return
+        }
+
         console.time('pathfinding')
         const result = computePath({
             world,
@@ -78,6 +163,8 @@ const Path = ({ start, goal, smooth, showExplored, earlyExitSearchIterations, se
         showExplored,
         earlyExitSearchIterations,
         searchType,
+        hierarchical,
+        worker,
     ])
 
     if (!path.length) return null
@@ -196,20 +283,25 @@ const Scene = () => {
         voxels: { world },
     } = useVoxels()
 
-    const { smooth, showExplored, earlyExitSearchIterations, searchType } = useControls('simple-voxels/a-star-pathfinding', {
-        smooth: true,
-        showExplored: true,
-        earlyExitSearchIterations: {
-            value: 1000,
-            min: 0,
-            max: 10000,
-            step: 1,
-        },
-        searchType: {
-            value: 'greedy',
-            options: ['greedy', 'shortest'],
+    const { smooth, showExplored, earlyExitSearchIterations, searchType, hierarchical, worker } = useControls(
+        'simple-voxels/a-star-pathfinding',
+        {
+            worker: false,
+            hierarchical: false,
+            smooth: true,
+            showExplored: true,
+            earlyExitSearchIterations: {
+                value: 1000,
+                min: 0,
+                max: 10000,
+                step: 1,
+            },
+            searchType: {
+                value: 'greedy',
+                options: ['greedy', 'shortest'],
+            },
         },
-    })
+    )
 
     const [start, setStart] = useState<THREE.Vector3>(new THREE.Vector3(20, 20, 20))
     const [goal, setGoal] = useState<THREE.Vector3>(new THREE.Vector3(-20, 20, -20))
@@ -258,6 +350,8 @@ const Scene = () => {
                 earlyExitSearchIterations={earlyExitSearchIterations}
                 showExplored={showExplored}
                 searchType={searchType as SearchType}
+                hierarchical={hierarchical}
+                worker={worker}
             />
         </>
     )
@@ -0,0 +1,20 @@
+import * as THREE from 'three'
+import type { SearchType } from './compute-path'
+
+export type VoxelPathQuery = {
+    start: THREE.Vector3Tuple
+    goal: THREE.Vector3Tuple
+    smooth: boolean
+    searchType: SearchType
+    searchIterations: number
+}
+
+export type VoxelPathQueryContext =
+    | {
+          worldId: number
+          chunkDirectoryIndexBuffer: SharedArrayBuffer
+          chunkDirectoryPages: SharedArrayBuffer[]
+      }
+    | {
+          chunkDirectoryPages: SharedArrayBuffer[]
+      }
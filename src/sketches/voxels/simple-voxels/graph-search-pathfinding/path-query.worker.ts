@@ -0,0 +1,43 @@
+import { PathQuerySearch, runPathQueryWorker } from '@/common/utils/path-query-worker'
+import * as THREE from 'three'
+import { ChunkDirectory } from '../lib/chunk-directory'
+import { World } from '../lib/world'
+import { computePathSteps } from './compute-path'
+import { VoxelPathQuery, VoxelPathQueryContext } from './path-query-worker-types'
+
+// reads chunks from the main thread's shared chunk directory
+let world: World | undefined
+
+const onContext = (context: VoxelPathQueryContext) => {
+    if ('worldId' in context) {
+        const directory = new ChunkDirectory(context.chunkDirectoryIndexBuffer, context.chunkDirectoryPages)
+        world = new World({ id: context.worldId, directory })
+    } else {
+        world?.directory?.addPages(context.chunkDirectoryPages)
+    }
+}
+
+function* searchVoxelPath({ start, goal, smooth, searchType, searchIterations }: VoxelPathQuery): PathQuerySearch {
+    if (!world) return null
+
+    const result = yield* computePathSteps({
+        world,
+        start: new THREE.Vector3(...start),
+        goal: new THREE.Vector3(...goal),
+        smooth,
+        searchType,
+        earlyExit: { searchIterations },
+    })
+
+    if (!result.success) return null
+
+    const waypoints = new Float32Array(result.path.length * 3)
+
+    for (let i = 0; i < result.path.length; i++) {
+        result.path[i].position.toArray(waypoints, i * 3)
+    }
+
+    return waypoints
+}
+
+runPathQueryWorker<VoxelPathQuery, VoxelPathQueryContext>({ search: searchVoxelPath, onContext })
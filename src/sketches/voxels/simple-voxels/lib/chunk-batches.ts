@@ -0,0 +1,242 @@
+import * as THREE from 'three'
+import { ChunkGeometry } from './chunk-geometry'
+import { chunkMaterial } from './chunk-material'
+
+type ChunkBatch = {
+    mesh: THREE.BatchedMesh
+    geometryCount: number
+    usedVertices: number
+    usedIndices: number
+    liveVertices: number
+}
+
+type ChunkBatchEntry = {
+    batch: ChunkBatch
+    geometryId: number
+    geometry: ChunkGeometry
+    matrix: THREE.Matrix4
+
+    /**
+     * Vertices counted in the batch's live vertices.
+     * Chunk geometries are updated in place, so this can't be read from the geometry.
+     */
+    vertexCount: number
+
+    reservedVertices: number
+    reservedIndices: number
+    visible: boolean
+}
+
+export type ChunkBatchesParams = {
+    material?: THREE.Material
+
+    /**
+     * @default 1024
+     */
+    maxGeometryCount?: number
+
+    /**
+     * @default 1048576
+     */
+    maxVertexCount?: number
+}
+
+// extra space reserved for each chunk, so small edits can update a chunk in place
+const RESERVE_FACTOR = 1.5
+
+/**
+ * Merges chunk meshes into a few multi draw batches.
+ *
+ * Each chunk reserves a vertex and index range in a `THREE.BatchedMesh`, and is updated in place while its geometry fits.
+ * When a chunk outgrows its range it is moved to the end of a batch with space, and a batch is rebuilt when
+ * more than half of it is unused.
+ */
+export class ChunkBatches {
+    group = new THREE.Group()
+
+    private material: THREE.Material
+    private maxGeometryCount: number
+    private maxVertexCount: number
+    private maxIndexCount: number
+
+    private batches: ChunkBatch[] = []
+    private entries = new Map<number, ChunkBatchEntry>()
+
+    constructor({ material = chunkMaterial, maxGeometryCount = 1024, maxVertexCount = 1048576 }: ChunkBatchesParams = {}) {
+        this.material = material
+        this.maxGeometryCount = maxGeometryCount
+        this.maxVertexCount = maxVertexCount
+
+        // voxel faces are quads, 6 indices per 4 vertices
+        this.maxIndexCount = maxVertexCount * 1.5
+    }
+
+    update(chunkId: number, geometry: ChunkGeometry, matrix: THREE.Matrix4) {
+        const vertexCount = geometry.getAttribute('position')?.count ?? 0
+        const indexCount = geometry.getIndex()?.count ?? 0
+
+        if (vertexCount === 0 || indexCount === 0) {
+            this.remove(chunkId)
+            return
+        }
+
+        const entry = this.entries.get(chunkId)
+
+        if (entry && vertexCount <= entry.reservedVertices && indexCount <= entry.reservedIndices) {
+            entry.batch.mesh.setGeometryAt(entry.geometryId, geometry)
+            entry.batch.mesh.setMatrixAt(entry.geometryId, entry.matrix.copy(matrix))
+
+            entry.batch.liveVertices += vertexCount - entry.vertexCount
+            entry.vertexCount = vertexCount
+            entry.geometry = geometry
+
+            return
+        }
+
+        const visible = entry?.visible ?? true
+
+        if (entry) {
+            this.remove(chunkId)
+        }
+
+        const reservedVertices = Math.min(Math.ceil(vertexCount * RESERVE_FACTOR), this.maxVertexCount)
+        const reservedIndices = Math.min(Math.ceil(indexCount * RESERVE_FACTOR), this.maxIndexCount)
+
+        const batch = this.getBatchWithSpace(reservedVertices, reservedIndices)
+
+        this.add(batch, chunkId, geometry, matrix.clone(), reservedVertices, reservedIndices, visible)
+    }
+
+    remove(chunkId: number) {
+        const entry = this.entries.get(chunkId)
+
+        if (!entry) return
+
+        entry.batch.mesh.deleteGeometry(entry.geometryId)
+        entry.batch.liveVertices -= entry.vertexCount
+
+        this.entries.delete(chunkId)
+    }
+
+    setVisible(chunkId: number, visible: boolean) {
+        const entry = this.entries.get(chunkId)
+
+        if (!entry || entry.visible === visible) return
+
+        entry.visible = visible
+        entry.batch.mesh.setVisibleAt(entry.geometryId, visible)
+    }
+
+    dispose() {
+        for (const batch of this.batches) {
+            this.group.remove(batch.mesh)
+            batch.mesh.dispose()
+        }
+
+        this.batches = []
+        this.entries.clear()
+    }
+
+    private createBatchMesh() {
+        const mesh = new THREE.BatchedMesh(this.maxGeometryCount, this.maxVertexCount, this.maxIndexCount, this.material)
+
+        // chunks are culled individually
+        mesh.frustumCulled = false
+        mesh.perObjectFrustumCulled = true
+        mesh.sortObjects = false
+
+        return mesh
+    }
+
+    private createBatch(): ChunkBatch {
+        const mesh = this.createBatchMesh()
+
+        const batch: ChunkBatch = { mesh, geometryCount: 0, usedVertices: 0, usedIndices: 0, liveVertices: 0 }
+
+        this.batches.push(batch)
+        this.group.add(mesh)
+
+        return batch
+    }
+
+    private hasSpace(batch: ChunkBatch, vertices: number, indices: number) {
+        return (
+            batch.geometryCount < this.maxGeometryCount &&
+            batch.usedVertices + vertices <= this.maxVertexCount &&
+            batch.usedIndices + indices <= this.maxIndexCount
+        )
+    }
+
+    private getBatchWithSpace(vertices: number, indices: number) {
+        for (const batch of this.batches) {
+            if (this.hasSpace(batch, vertices, indices)) return batch
+        }
+
+        /* rebuild a mostly unused batch before creating another */
+        for (const batch of this.batches) {
+            if (batch.liveVertices * 2 > this.maxVertexCount) continue
+
+            this.rebuildBatch(batch)
+
+            if (this.hasSpace(batch, vertices, indices)) return batch
+        }
+
+        return this.createBatch()
+    }
+
+    private add(
+        batch: ChunkBatch,
+        chunkId: number,
+        geometry: ChunkGeometry,
+        matrix: THREE.Matrix4,
+        reservedVertices: number,
+        reservedIndices: number,
+        visible: boolean,
+    ) {
+        const geometryId = batch.mesh.addGeometry(geometry, reservedVertices, reservedIndices)
+        batch.mesh.setMatrixAt(geometryId, matrix)
+        batch.mesh.setVisibleAt(geometryId, visible)
+
+        batch.geometryCount++
+        batch.usedVertices += reservedVertices
+        batch.usedIndices += reservedIndices
+        const vertexCount = geometry.getAttribute('position').count
+        batch.liveVertices += vertexCount
+
+        this.entries.set(chunkId, {
+            batch,
+            geometryId,
+            geometry,
+            matrix,
+            vertexCount,
+            reservedVertices,
+            reservedIndices,
+            visible,
+        })
+    }
+
+    private rebuildBatch(batch: ChunkBatch) {
+        const live: [number, ChunkBatchEntry][] = []
+
+        for (const [chunkId, entry] of this.entries) {
+            if (entry.batch === batch) live.push([chunkId, entry])
+        }
+
+        this.group.remove(batch.mesh)
+        batch.mesh.dispose()
+
+        const mesh = this.createBatchMesh()
+
+        batch.mesh = mesh
+        batch.geometryCount = 0
+        batch.usedVertices = 0
+        batch.usedIndices = 0
+        batch.liveVertices = 0
+
+        this.group.add(mesh)
+
+        for (const [chunkId, entry] of live) {
+            this.add(batch, chunkId, entry.geometry, entry.matrix, entry.reservedVertices, entry.reservedIndices, entry.visible)
+        }
+    }
+}
@@ -0,0 +1,22 @@
+export const ChunkColliderWorkerMessageType = {
+    BUILD_CHUNK_COLLIDER: 0,
+    CHUNK_COLLIDER_RESULT: 1,
+} as const
+
+export type BuildChunkColliderMessage = {
+    type: typeof ChunkColliderWorkerMessageType.BUILD_CHUNK_COLLIDER
+    worldId: number
+    chunkId: number
+    version: number
+    solid: Uint16Array
+}
+
+export type ChunkColliderResultMessage = {
+    type: typeof ChunkColliderWorkerMessageType.CHUNK_COLLIDER_RESULT
+    worldId: number
+    chunkId: number
+    version: number
+    boxes: Uint8Array
+}
+
+export type ChunkColliderWorkerMessage = BuildChunkColliderMessage | ChunkColliderResultMessage
@@ -0,0 +1,84 @@
+import { CHUNK_SIZE } from './world'
+
+/**
+ * Number of values per box in a chunk collider boxes array: x, y, z, width, height, depth
+ */
+export const CHUNK_COLLIDER_BOX_STRIDE = 6
+
+const _remaining = new Uint16Array(CHUNK_SIZE * CHUNK_SIZE)
+
+// every solid voxel in its own box is the upper bound
+const _boxes = new Uint8Array(CHUNK_SIZE ** 3 * CHUNK_COLLIDER_BOX_STRIDE)
+
+const columnsContain = (columns: Uint16Array, index: number, width: number, mask: number) => {
+    for (let i = 0; i < width; i++) {
+        if ((columns[index + i] & mask) !== mask) return false
+    }
+
+    return true
+}
+
+/**
+ * Merges the solid voxels of a chunk into boxes.
+ *
+ * Each box starts as the run of solid voxels at the bottom of a column, then grows along x, then z, while the neighbouring columns contain the whole run.
+ * Works on the chunk's column bitfields, so only needs the chunk's own solid data, and doesn't need neighbour chunks.
+ *
+ * @returns chunk local boxes, `CHUNK_COLLIDER_BOX_STRIDE` values per box
+ */
+export const createChunkColliderBoxes = (solid: Uint16Array): Uint8Array => {
+    const remaining = _remaining
+    remaining.set(solid)
+
+    let count = 0
+
+    for (let z = 0; z < CHUNK_SIZE; z++) {
+        for (let x = 0; x < CHUNK_SIZE; x++) {
+            const columnIndex = x + z * CHUNK_SIZE
+
+            let column: number
+
+            while ((column = remaining[columnIndex]) !== 0) {
+                /* find the lowest run of solid voxels in the column */
+                const y = 31 - Math.clz32(column & -column)
+
+                const runEnd = ~(column >>> y)
+                const height = 31 - Math.clz32(runEnd & -runEnd)
+
+                const mask = ((1 << height) - 1) << y
+
+                /* grow along x, then z */
+                let width = 1
+
+                while (x + width < CHUNK_SIZE && (remaining[columnIndex + width] & mask) === mask) {
+                    width++
+                }
+
+                let depth = 1
+
+                while (z + depth < CHUNK_SIZE && columnsContain(remaining, columnIndex + depth * CHUNK_SIZE, width, mask)) {
+                    depth++
+                }
+
+                /* remove the box from the remaining voxels */
+                for (let dz = 0; dz < depth; dz++) {
+                    for (let dx = 0; dx < width; dx++) {
+                        remaining[columnIndex + dx + dz * CHUNK_SIZE] &= ~mask
+                    }
+                }
+
+                const offset = count * CHUNK_COLLIDER_BOX_STRIDE
+                _boxes[offset] = x
+                _boxes[offset + 1] = y
+                _boxes[offset + 2] = z
+                _boxes[offset + 3] = width
+                _boxes[offset + 4] = height
+                _boxes[offset + 5] = depth
+
+                count++
+            }
+        }
+    }
+
+    return _boxes.slice(0, count * CHUNK_COLLIDER_BOX_STRIDE)
+}
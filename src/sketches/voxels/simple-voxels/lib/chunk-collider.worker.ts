@@ -0,0 +1,20 @@
+import { createChunkColliderBoxes } from './chunk-collider'
+import { BuildChunkColliderMessage, ChunkColliderResultMessage, ChunkColliderWorkerMessageType } from './chunk-collider-worker-types'
+
+const worker = self as unknown as Worker
+
+worker.onmessage = (e) => {
+    const { worldId, chunkId, version, solid } = e.data as BuildChunkColliderMessage
+
+    const boxes = createChunkColliderBoxes(solid)
+
+    const result: ChunkColliderResultMessage = {
+        type: ChunkColliderWorkerMessageType.CHUNK_COLLIDER_RESULT,
+        worldId,
+        chunkId,
+        version,
+        boxes,
+    }
+
+    worker.postMessage(result, { transfer: [boxes.buffer] })
+}
@@ -0,0 +1,154 @@
+import { SpatialHashMap } from '@/common/utils/spatial-hash'
+import Rapier from '@dimforge/rapier3d-compat'
+import { Topic } from 'arancini/events'
+import { CHUNK_COLLIDER_BOX_STRIDE } from './chunk-collider'
+import {
+    BuildChunkColliderMessage,
+    ChunkColliderResultMessage,
+    ChunkColliderWorkerMessage,
+    ChunkColliderWorkerMessageType,
+} from './chunk-collider-worker-types'
+import ChunkColliderWorker from './chunk-collider.worker?worker'
+import { CHUNK_SIZE, Chunk, World } from './world'
+
+/**
+ * Builds chunk collider boxes in a worker.
+ *
+ * Each build sends a copy of the chunk's solid data, so edits made while a build is in flight don't affect it.
+ * Results made stale by a newer build of the same chunk are dropped.
+ */
+export class ChunkColliderBuilder {
+    onBuilt = new Topic<[worldId: number, chunkId: number, boxes: Uint8Array]>()
+
+    private worker: InstanceType<typeof ChunkColliderWorker> | null = null
+
+    private versions = new Map<number, SpatialHashMap<number>>()
+
+    build(world: World, chunk: Chunk) {
+        if (!this.worker) return
+
+        let worldVersions = this.versions.get(world.id)
+
+        if (!worldVersions) {
+            worldVersions = new SpatialHashMap<number>()
+            this.versions.set(world.id, worldVersions)
+        }
+
+        const version = (worldVersions.get(chunk.id) ?? 0) + 1
+        worldVersions.set(chunk.id, version)
+
+        const message: BuildChunkColliderMessage = {
+            type: ChunkColliderWorkerMessageType.BUILD_CHUNK_COLLIDER,
+            worldId: world.id,
+            chunkId: chunk.id,
+            version,
+            solid: chunk.solid.slice(),
+        }
+
+        this.worker.postMessage(message, { transfer: [message.solid.buffer] })
+    }
+
+    connect() {
+        this.worker = new ChunkColliderWorker()
+
+        this.worker.onmessage = (e) => {
+            const { data: message } = e as { data: ChunkColliderWorkerMessage }
+
+            if (message.type === ChunkColliderWorkerMessageType.CHUNK_COLLIDER_RESULT) {
+                this.processResult(message)
+            }
+        }
+    }
+
+    disconnect() {
+        this.worker?.terminate()
+        this.worker = null
+        this.versions.clear()
+    }
+
+    private processResult({ worldId, chunkId, version, boxes }: ChunkColliderResultMessage) {
+        if (this.versions.get(worldId)?.get(chunkId) !== version) return
+
+        this.onBuilt.emit(worldId, chunkId, boxes)
+    }
+}
+
+export type RapierChunkCollidersParams = {
+    physicsWorld: Rapier.World
+    rigidBody: Rapier.RigidBody
+
+    /**
+     * @default 1
+     */
+    scale?: number
+}
+
+/**
+ * Maintains cuboid colliders for chunk collider boxes on a rigid body.
+ *
+ * Updating a chunk creates the chunk's new colliders before removing the old ones,
+ * so bodies resting on the chunk always have colliders to rest on.
+ */
+export class RapierChunkColliders {
+    colliders = new SpatialHashMap<Rapier.Collider[]>()
+
+    physicsWorld: Rapier.World
+    rigidBody: Rapier.RigidBody
+    scale: number
+
+    constructor({ physicsWorld, rigidBody, scale = 1 }: RapierChunkCollidersParams) {
+        this.physicsWorld = physicsWorld
+        this.rigidBody = rigidBody
+        this.scale = scale
+    }
+
+    update(chunk: Chunk, boxes: Uint8Array) {
+        const { physicsWorld, rigidBody, scale } = this
+
+        const previous = this.colliders.get(chunk.id)
+        const next: Rapier.Collider[] = []
+
+        const chunkX = chunk.position.x * CHUNK_SIZE
+        const chunkY = chunk.position.y * CHUNK_SIZE
+        const chunkZ = chunk.position.z * CHUNK_SIZE
+
+        for (let i = 0; i < boxes.length; i += CHUNK_COLLIDER_BOX_STRIDE) {
+            const halfWidth = boxes[i + 3] / 2
+            const halfHeight = boxes[i + 4] / 2
+            const halfDepth = boxes[i + 5] / 2
+
+            const colliderDesc = Rapier.ColliderDesc.cuboid(halfWidth * scale, halfHeight * scale, halfDepth * scale)
+            colliderDesc.setTranslation(
+                (chunkX + boxes[i] + halfWidth) * scale,
+                (chunkY + boxes[i + 1] + halfHeight) * scale,
+                (chunkZ + boxes[i + 2] + halfDepth) * scale,
+            )
+
+            next.push(physicsWorld.createCollider(colliderDesc, rigidBody))
+        }
+
+        if (previous) {
+            for (const collider of previous) {
+                physicsWorld.removeCollider(collider, false)
+            }
+        }
+
+        if (next.length > 0) {
+            this.colliders.set(chunk.id, next)
+        } else {
+            this.colliders.delete(chunk.id)
+        }
+    }
+
+    dispose() {
+        for (const colliders of this.colliders.values()) {
+            for (const collider of colliders) {
+                if (collider.isValid()) {
+                    this.physicsWorld.removeCollider(collider, false)
+                }
+            }
+        }
+
+        this.colliders.clear()
+    }
+}
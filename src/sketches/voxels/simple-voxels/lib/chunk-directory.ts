@@ -0,0 +1,260 @@
+import { unpackSpatialHashKeyX, unpackSpatialHashKeyY, unpackSpatialHashKeyZ } from '@/common/utils/spatial-hash'
+import * as THREE from 'three'
+import { CHUNK_SIZE, Chunk } from './world'
+
+/**
+ * Number of chunks stored in each shared page
+ */
+export const CHUNK_DIRECTORY_PAGE_CHUNKS = 256
+
+const SOLID_LENGTH = CHUNK_SIZE ** 2
+const COLOR_LENGTH = CHUNK_SIZE ** 3
+const SOLID_BYTES = SOLID_LENGTH * Uint16Array.BYTES_PER_ELEMENT
+const COLOR_BYTES = COLOR_LENGTH * Uint32Array.BYTES_PER_ELEMENT
+const PAGE_COLOR_OFFSET = CHUNK_DIRECTORY_PAGE_CHUNKS * SOLID_BYTES
+const PAGE_BYTES = CHUNK_DIRECTORY_PAGE_CHUNKS * (SOLID_BYTES + COLOR_BYTES)
+
+const HEADER_COUNT = 0
+const HEADER_MAX_CHUNKS = 1
+const HEADER_TABLE_SIZE = 2
+const HEADER_LENGTH = 4
+
+const KEY_LENGTH = 2
+const EMPTY = -1
+
+/**
+ * Creates an empty page of chunk data, in the layout the directory stores chunks in
+ */
+export const createChunkDirectoryPage = () => new SharedArrayBuffer(PAGE_BYTES)
+
+/**
+ * @returns views of the solid and color data of a chunk in a page
+ */
+export const getChunkDirectoryPageChunk = (page: SharedArrayBuffer, pageIndex: number) => {
+    const solid = new Uint16Array(page, pageIndex * SOLID_BYTES, SOLID_LENGTH)
+    const color = new Uint32Array(page, PAGE_COLOR_OFFSET + pageIndex * COLOR_BYTES, COLOR_LENGTH)
+
+    return { solid, color }
+}
+
+const hash = (worldId: number, chunkId: number) => {
+    let h = Math.imul(worldId, 0x27d4eb2d)
+    h = Math.imul(h ^ chunkId, 0x85ebca6b)
+    return (h ^ (h >>> 15)) >>> 0
+}
+
+/**
+ * A directory of chunks shared by the main thread and mesher workers.
+ *
+ * Chunk data is stored in SharedArrayBuffer pages of `CHUNK_DIRECTORY_PAGE_CHUNKS` chunks, and each chunk gets a slot index.
+ * A shared open addressing hash table maps (world id, `Chunk.id` key) to slots, so workers can look up chunks lazily
+ * instead of being sent every chunk.
+ *
+ * Only the main thread allocates. Table entries are published by atomically storing the slot after the key is written,
+ * so readers on other threads never see a partially written entry. New pages are sent to workers in batches.
+ */
+export class ChunkDirectory {
+    indexBuffer: SharedArrayBuffer
+
+    pages: SharedArrayBuffer[] = []
+
+    /**
+     * Incremented when a lookup finds a chunk whose page has not been received by this thread yet
+     */
+    missingPages = 0
+
+    private header: Int32Array
+    private tableKeys: Int32Array
+    private tableSlots: Int32Array
+    private slotKeys: Int32Array
+
+    private chunks: (Chunk | undefined)[] = []
+
+    constructor(indexBuffer: SharedArrayBuffer, pages: SharedArrayBuffer[] = []) {
+        this.indexBuffer = indexBuffer
+
+        this.header = new Int32Array(indexBuffer, 0, HEADER_LENGTH)
+
+        const maxChunks = this.header[HEADER_MAX_CHUNKS]
+        const tableSize = this.header[HEADER_TABLE_SIZE]
+
+        let offset = HEADER_LENGTH * Int32Array.BYTES_PER_ELEMENT
+
+        this.tableKeys = new Int32Array(indexBuffer, offset, tableSize * KEY_LENGTH)
+        offset += this.tableKeys.byteLength
+        this.tableSlots = new Int32Array(indexBuffer, offset, tableSize)
+        offset += this.tableSlots.byteLength
+        this.slotKeys = new Int32Array(indexBuffer, offset, maxChunks * KEY_LENGTH)
+
+        this.addPages(pages)
+    }
+
+    static create(maxChunks: number) {
+        const tableSize = 1 << Math.ceil(Math.log2(maxChunks * 2))
+
+        const indexBuffer = new SharedArrayBuffer(
+            (HEADER_LENGTH + tableSize * (KEY_LENGTH + 1) + maxChunks * KEY_LENGTH) * Int32Array.BYTES_PER_ELEMENT,
+        )
+
+        const header = new Int32Array(indexBuffer, 0, HEADER_LENGTH)
+        header[HEADER_MAX_CHUNKS] = maxChunks
+        header[HEADER_TABLE_SIZE] = tableSize
+
+        const directory = new ChunkDirectory(indexBuffer)
+        directory.tableSlots.fill(EMPTY)
+
+        return directory
+    }
+
+    get count() {
+        return Atomics.load(this.header, HEADER_COUNT)
+    }
+
+    get maxChunks() {
+        return this.header[HEADER_MAX_CHUNKS]
+    }
+
+    /**
+     * Allocates a new chunk, only call on the thread that owns the directory.
+     */
+    allocate(worldId: number, chunkPosition: THREE.Vector3Like): Chunk {
+        const slot = this.header[HEADER_COUNT]
+
+        if (slot >= this.maxChunks) {
+            throw new Error(`ChunkDirectory: cannot allocate more than ${this.maxChunks} chunks`)
+        }
+
+        if (slot % CHUNK_DIRECTORY_PAGE_CHUNKS === 0) {
+            this.pages.push(createChunkDirectoryPage())
+        }
+
+        this.insert(worldId, Chunk.id(chunkPosition), slot)
+
+        Atomics.store(this.header, HEADER_COUNT, slot + 1)
+
+        return this.getChunk(slot)!
+    }
+
+    /**
+     * Adds a page of chunks that was filled elsewhere, e.g. by a loader worker, without copying the chunk data.
+     * Only call on the thread that owns the directory.
+     *
+     * The page takes the next whole page of slots, so any unused slots in the current page are skipped.
+     * Chunks that already exist in the directory are copied into the existing chunk instead.
+     *
+     * @returns the chunks for the first `count` chunk ids, in order
+     */
+    adoptPage(worldId: number, page: SharedArrayBuffer, chunkIds: ArrayLike<number>, count: number): Chunk[] {
+        const start = Math.ceil(this.header[HEADER_COUNT] / CHUNK_DIRECTORY_PAGE_CHUNKS) * CHUNK_DIRECTORY_PAGE_CHUNKS
+
+        if (start + count > this.maxChunks) {
+            throw new Error(`ChunkDirectory: cannot allocate more than ${this.maxChunks} chunks`)
+        }
+
+        this.pages.push(page)
+
+        const chunks: Chunk[] = []
+
+        for (let i = 0; i < count; i++) {
+            const chunkId = chunkIds[i]
+            const existing = this.getChunk(this.find(worldId, chunkId))
+
+            if (existing) {
+                const { solid, color } = getChunkDirectoryPageChunk(page, i)
+                existing.solid.set(solid)
+                existing.color.set(color)
+
+                chunks.push(existing)
+                continue
+            }
+
+            const slot = start + i
+
+            this.insert(worldId, chunkId, slot)
+
+            chunks.push(this.getChunk(slot)!)
+        }
+
+        Atomics.store(this.header, HEADER_COUNT, start + count)
+
+        return chunks
+    }
+
+    /**
+     * @returns the slot of the chunk, or -1 if it does not exist
+     */
+    find(worldId: number, chunkId: number): number {
+        const mask = this.header[HEADER_TABLE_SIZE] - 1
+        let index = hash(worldId, chunkId) & mask
+
+        while (true) {
+            const slot = Atomics.load(this.tableSlots, index)
+
+            if (slot === EMPTY) return EMPTY
+
+            const tableKeyIndex = index * KEY_LENGTH
+
+            if (this.tableKeys[tableKeyIndex] === worldId && this.tableKeys[tableKeyIndex + 1] === chunkId) {
+                return slot
+            }
+
+            index = (index + 1) & mask
+        }
+    }
+
+    /**
+     * @returns the chunk in the slot, or undefined if the slot is empty or its page has not been received yet
+     */
+    getChunk(slot: number): Chunk | undefined {
+        if (slot < 0) return undefined
+
+        const existing = this.chunks[slot]
+        if (existing) return existing
+
+        const page = this.pages[Math.floor(slot / CHUNK_DIRECTORY_PAGE_CHUNKS)]
+
+        if (!page) {
+            this.missingPages++
+            return undefined
+        }
+
+        const { solid, color } = getChunkDirectoryPageChunk(page, slot % CHUNK_DIRECTORY_PAGE_CHUNKS)
+
+        const chunkId = this.slotKeys[slot * KEY_LENGTH + 1]
+        const position = new THREE.Vector3(unpackSpatialHashKeyX(chunkId), unpackSpatialHashKeyY(chunkId), unpackSpatialHashKeyZ(chunkId))
+
+        const chunk = new Chunk(chunkId, position, solid, color)
+        this.chunks[slot] = chunk
+
+        return chunk
+    }
+
+    getWorldId(slot: number) {
+        return this.slotKeys[slot * KEY_LENGTH]
+    }
+
+    addPages(pages: SharedArrayBuffer[]) {
+        for (const page of pages) {
+            this.pages.push(page)
+        }
+    }
+
+    private insert(worldId: number, chunkId: number, slot: number) {
+        const slotKeyIndex = slot * KEY_LENGTH
+        this.slotKeys[slotKeyIndex] = worldId
+        this.slotKeys[slotKeyIndex + 1] = chunkId
+
+        const mask = this.header[HEADER_TABLE_SIZE] - 1
+        let index = hash(worldId, chunkId) & mask
+
+        while (this.tableSlots[index] !== EMPTY) {
+            index = (index + 1) & mask
+        }
+
+        const tableKeyIndex = index * KEY_LENGTH
+        this.tableKeys[tableKeyIndex] = worldId
+        this.tableKeys[tableKeyIndex + 1] = chunkId
+
+        Atomics.store(this.tableSlots, index, slot)
+    }
+}
@@ -0,0 +1,319 @@
+import { CHUNK_SIZE, Chunk, World } from './world'
+
+/**
+ * Binary chunk format, little endian.
+ *
+ * Header:
+ * - magic u32 'VXC1'
+ * - version u16
+ * - reserved u16
+ * - chunk count u32
+ *
+ * Followed by chunk records, each prefixed with its byte length so records can be read from a stream one at a time:
+ * - byte length u32, not including this field
+ * - chunk position x, y, z i16
+ * - reserved u16
+ * - solid column runs count u16, then runs of [length - 1 u8, column u16] over the 256 `Chunk.solid` columns
+ * - palette size u16, then palette colors u32
+ * - color runs count u16, then runs of [length u16, palette index u8 or u16] over the solid voxels in `Chunk.color` order.
+ *   Palette indices are u8 if the palette has 256 colors or less. Colors of air voxels are not stored.
+ */
+export const CHUNK_FORMAT_MAGIC = 0x31435856
+
+export const CHUNK_FORMAT_VERSION = 1
+
+export const CHUNK_FORMAT_HEADER_BYTES = 12
+
+export const CHUNK_FORMAT_RECORD_PREFIX_BYTES = 4
+
+const SOLID_LENGTH = CHUNK_SIZE * CHUNK_SIZE
+const COLOR_LENGTH = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE
+
+/**
+ * Growable little endian byte writer
+ */
+class ByteWriter {
+    bytes = new Uint8Array(1024)
+    view = new DataView(this.bytes.buffer)
+    length = 0
+
+    reserve(byteLength: number) {
+        if (this.length + byteLength <= this.bytes.length) return
+
+        let size = this.bytes.length * 2
+        while (size < this.length + byteLength) size *= 2
+
+        const bytes = new Uint8Array(size)
+        bytes.set(this.bytes.subarray(0, this.length))
+
+        this.bytes = bytes
+        this.view = new DataView(bytes.buffer)
+    }
+
+    u8(value: number) {
+        this.reserve(1)
+        this.view.setUint8(this.length, value)
+        this.length += 1
+    }
+
+    u16(value: number) {
+        this.reserve(2)
+        this.view.setUint16(this.length, value, true)
+        this.length += 2
+    }
+
+    i16(value: number) {
+        this.reserve(2)
+        this.view.setInt16(this.length, value, true)
+        this.length += 2
+    }
+
+    u32(value: number) {
+        this.reserve(4)
+        this.view.setUint32(this.length, value, true)
+        this.length += 4
+    }
+
+    setU16(offset: number, value: number) {
+        this.view.setUint16(offset, value, true)
+    }
+
+    setU32(offset: number, value: number) {
+        this.view.setUint32(offset, value, true)
+    }
+
+    finish() {
+        return this.bytes.slice(0, this.length)
+    }
+}
+
+const _palette = new Map<number, number>()
+const _paletteColors: number[] = []
+
+const writeChunk = (writer: ByteWriter, chunk: Chunk) => {
+    const { solid, color } = chunk
+
+    const recordStart = writer.length
+    writer.u32(0)
+
+    writer.i16(chunk.position.x)
+    writer.i16(chunk.position.y)
+    writer.i16(chunk.position.z)
+    writer.u16(0)
+
+    /* solid column runs */
+    const solidRunsOffset = writer.length
+    writer.u16(0)
+
+    let solidRuns = 0
+
+    for (let i = 0; i < SOLID_LENGTH; ) {
+        const column = solid[i]
+
+        let length = 1
+        while (i + length < SOLID_LENGTH && length < 256 && solid[i + length] === column) length++
+
+        writer.u8(length - 1)
+        writer.u16(column)
+
+        solidRuns++
+        i += length
+    }
+
+    writer.setU16(solidRunsOffset, solidRuns)
+
+    /* palette */
+    _palette.clear()
+    _paletteColors.length = 0
+
+    for (let i = 0; i < COLOR_LENGTH; i++) {
+        const y = i >>> 8
+        if (((solid[i & (SOLID_LENGTH - 1)] >>> y) & 1) === 0) continue
+
+        const c = color[i]
+
+        if (!_palette.has(c)) {
+            _palette.set(c, _paletteColors.length)
+            _paletteColors.push(c)
+        }
+    }
+
+    writer.u16(_paletteColors.length)
+
+    for (const c of _paletteColors) {
+        writer.u32(c)
+    }
+
+    /* color runs over solid voxels */
+    const wideIndices = _paletteColors.length > 256
+
+    const colorRunsOffset = writer.length
+    writer.u16(0)
+
+    let colorRuns = 0
+    let runIndex = -1
+    let runLength = 0
+
+    const writeRun = () => {
+        if (runLength === 0) return
+
+        writer.u16(runLength)
+
+        if (wideIndices) {
+            writer.u16(runIndex)
+        } else {
+            writer.u8(runIndex)
+        }
+
+        colorRuns++
+    }
+
+    for (let i = 0; i < COLOR_LENGTH; i++) {
+        const y = i >>> 8
+        if (((solid[i & (SOLID_LENGTH - 1)] >>> y) & 1) === 0) continue
+
+        const index = _palette.get(color[i])!
+
+        if (index === runIndex) {
+            runLength++
+            continue
+        }
+
+        writeRun()
+
+        runIndex = index
+        runLength = 1
+    }
+
+    writeRun()
+
+    writer.setU16(colorRunsOffset, colorRuns)
+
+    writer.setU32(recordStart, writer.length - recordStart - CHUNK_FORMAT_RECORD_PREFIX_BYTES)
+}
+
+/**
+ * Encodes the chunks of a world.
+ *
+ * Chunks are written nearest to `origin` first, so a streamed load fills in the area around the origin first.
+ */
+export const encodeWorld = (world: World, origin: { x: number; y: number; z: number } = { x: 0, y: 0, z: 0 }) => {
+    const distance = (chunk: Chunk) => {
+        const dx = (chunk.position.x + 0.5) * CHUNK_SIZE - origin.x
+        const dy = (chunk.position.y + 0.5) * CHUNK_SIZE - origin.y
+        const dz = (chunk.position.z + 0.5) * CHUNK_SIZE - origin.z
+        return dx * dx + dy * dy + dz * dz
+    }
+
+    const chunks = [...world.chunks.values()].sort((a, b) => distance(a) - distance(b))
+
+    const writer = new ByteWriter()
+
+    writer.u32(CHUNK_FORMAT_MAGIC)
+    writer.u16(CHUNK_FORMAT_VERSION)
+    writer.u16(0)
+    writer.u32(chunks.length)
+
+    for (const chunk of chunks) {
+        writeChunk(writer, chunk)
+    }
+
+    return writer.finish()
+}
+
+export type ChunkFormatHeader = {
+    version: number
+    chunkCount: number
+}
+
+export const readHeader = (bytes: Uint8Array): ChunkFormatHeader => {
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength)
+
+    if (view.getUint32(0, true) !== CHUNK_FORMAT_MAGIC) {
+        throw new Error('chunk format: invalid magic')
+    }
+
+    const version = view.getUint16(4, true)
+
+    if (version !== CHUNK_FORMAT_VERSION) {
+        throw new Error(`chunk format: unsupported version ${version}`)
+    }
+
+    return { version, chunkCount: view.getUint32(8, true) }
+}
+
+/**
+ * Reads the chunk position of a record, `bytes` starts after the record length prefix
+ */
+export const readChunkPosition = (bytes: Uint8Array, out: { x: number; y: number; z: number }) => {
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength)
+
+    out.x = view.getInt16(0, true)
+    out.y = view.getInt16(2, true)
+    out.z = view.getInt16(4, true)
+
+    return out
+}
+
+/**
+ * Decodes a chunk record straight into solid and color arrays, e.g. views of a chunk directory page.
+ * `bytes` starts after the record length prefix.
+ */
+export const decodeChunk = (bytes: Uint8Array, solidOut: Uint16Array, colorOut: Uint32Array) => {
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength)
+
+    let offset = 8
+
+    /* solid column runs */
+    const solidRuns = view.getUint16(offset, true)
+    offset += 2
+
+    let column = 0
+
+    for (let run = 0; run < solidRuns; run++) {
+        const length = view.getUint8(offset) + 1
+        const value = view.getUint16(offset + 1, true)
+        offset += 3
+
+        solidOut.fill(value, column, column + length)
+        column += length
+    }
+
+    /* palette */
+    const paletteSize = view.getUint16(offset, true)
+    offset += 2
+
+    const paletteOffset = offset
+    offset += paletteSize * 4
+
+    const wideIndices = paletteSize > 256
+
+    /* color runs over solid voxels */
+    const colorRuns = view.getUint16(offset, true)
+    offset += 2
+
+    let runColor = 0
+    let runRemaining = 0
+    let run = 0
+
+    for (let i = 0; i < COLOR_LENGTH; i++) {
+        const y = i >>> 8
+
+        if (((solidOut[i & (SOLID_LENGTH - 1)] >>> y) & 1) === 0) {
+            colorOut[i] = 0
+            continue
+        }
+
+        if (runRemaining === 0 && run < colorRuns) {
+            runRemaining = view.getUint16(offset, true)
+            const paletteIndex = wideIndices ? view.getUint16(offset + 2, true) : view.getUint8(offset + 2)
+            offset += wideIndices ? 4 : 3
+
+            runColor = view.getUint32(paletteOffset + paletteIndex * 4, true)
+            run++
+        }
+
+        colorOut[i] = runColor
+        runRemaining--
+    }
+}
@@ -0,0 +1,41 @@
+export type ChunkStreamSource =
+    | { type: 'url'; url: string }
+    | { type: 'indexeddb'; database: string; store: string; key: string }
+
+export const ChunkLoaderWorkerMessageType = {
+    LOAD: 0,
+    SET_ACTOR: 1,
+    CHUNK_PAGE: 2,
+    DONE: 3,
+    ERROR: 4,
+} as const
+
+export type LoadMessage = {
+    type: typeof ChunkLoaderWorkerMessageType.LOAD
+    source: ChunkStreamSource
+    actor: { x: number; y: number; z: number }
+}
+
+export type SetActorMessage = {
+    type: typeof ChunkLoaderWorkerMessageType.SET_ACTOR
+    actor: { x: number; y: number; z: number }
+}
+
+export type ChunkPageMessage = {
+    type: typeof ChunkLoaderWorkerMessageType.CHUNK_PAGE
+    page: SharedArrayBuffer
+    chunkIds: Int32Array
+    count: number
+}
+
+export type DoneMessage = {
+    type: typeof ChunkLoaderWorkerMessageType.DONE
+    chunkCount: number
+}
+
+export type ErrorMessage = {
+    type: typeof ChunkLoaderWorkerMessageType.ERROR
+    message: string
+}
+
+export type ChunkLoaderWorkerMessage = LoadMessage | SetActorMessage | ChunkPageMessage | DoneMessage | ErrorMessage
@@ -0,0 +1,196 @@
+import { CHUNK_DIRECTORY_PAGE_CHUNKS, createChunkDirectoryPage, getChunkDirectoryPageChunk } from './chunk-directory'
+import { CHUNK_FORMAT_HEADER_BYTES, CHUNK_FORMAT_RECORD_PREFIX_BYTES, decodeChunk, readChunkPosition, readHeader } from './chunk-format'
+import {
+    ChunkLoaderWorkerMessage,
+    ChunkLoaderWorkerMessageType,
+    ChunkPageMessage,
+    ChunkStreamSource,
+    DoneMessage,
+    ErrorMessage,
+} from './chunk-loader-worker-types'
+import { getChunkStorageBlob } from './chunk-storage'
+import { Chunk } from './world'
+
+type PendingChunk = {
+    id: number
+    x: number
+    y: number
+    z: number
+    distance: number
+    record: Uint8Array
+}
+
+const state = {
+    actor: { x: 0, y: 0, z: 0 },
+    pending: [] as PendingChunk[],
+    sorted: false,
+}
+
+const worker = self as unknown as Worker
+
+const openStream = async (source: ChunkStreamSource): Promise<ReadableStream<Uint8Array>> => {
+    if (source.type === 'url') {
+        const response = await fetch(source.url)
+
+        if (!response.ok || !response.body) {
+            throw new Error(`failed to fetch ${source.url}: ${response.status}`)
+        }
+
+        return response.body
+    }
+
+    const blob = await getChunkStorageBlob(source.database, source.store, source.key)
+
+    if (!blob) {
+        throw new Error(`no chunks stored for ${source.database}/${source.store}/${source.key}`)
+    }
+
+    return blob.stream()
+}
+
+/**
+ * Sorts pending chunks furthest from the actor first, so the nearest chunks can be popped off the end
+ */
+const sortPending = () => {
+    if (state.sorted) return
+
+    const { actor, pending } = state
+
+    for (const chunk of pending) {
+        const dx = chunk.x - actor.x
+        const dy = chunk.y - actor.y
+        const dz = chunk.z - actor.z
+        chunk.distance = dx * dx + dy * dy + dz * dz
+    }
+
+    pending.sort((a, b) => b.distance - a.distance)
+
+    state.sorted = true
+}
+
+const yieldToMessages = () => new Promise((resolve) => setTimeout(resolve, 0))
+
+/**
+ * Decodes pending chunks into chunk directory pages nearest to the actor first, and sends the pages to the main thread.
+ * Only full pages are sent until the stream is done.
+ */
+const sendPages = async (final: boolean) => {
+    const { pending } = state
+
+    while (pending.length >= CHUNK_DIRECTORY_PAGE_CHUNKS || (final && pending.length > 0)) {
+        sortPending()
+
+        const count = Math.min(CHUNK_DIRECTORY_PAGE_CHUNKS, pending.length)
+
+        const page = createChunkDirectoryPage()
+        const chunkIds = new Int32Array(count)
+
+        for (let i = 0; i < count; i++) {
+            const chunk = pending.pop()!
+            const { solid, color } = getChunkDirectoryPageChunk(page, i)
+
+            decodeChunk(chunk.record, solid, color)
+
+            chunkIds[i] = chunk.id
+        }
+
+        const message: ChunkPageMessage = {
+            type: ChunkLoaderWorkerMessageType.CHUNK_PAGE,
+            page,
+            chunkIds,
+            count,
+        }
+
+        worker.postMessage(message, { transfer: [chunkIds.buffer] })
+
+        // let actor updates arrive before choosing the next page
+        await yieldToMessages()
+    }
+}
+
+const _position = { x: 0, y: 0, z: 0 }
+
+const load = async (source: ChunkStreamSource) => {
+    const reader = (await openStream(source)).getReader()
+
+    let buffer = new Uint8Array(64 * 1024)
+    let start = 0
+    let end = 0
+
+    let headerRead = false
+    let chunkCount = 0
+
+    while (true) {
+        const { done, value } = await reader.read()
+
+        if (value) {
+            /* append to the buffer, compacting or growing it if needed */
+            if (end + value.length > buffer.length) {
+                const used = end - start
+
+                if (used + value.length > buffer.length) {
+                    const next = new Uint8Array(Math.max(buffer.length * 2, used + value.length))
+                    next.set(buffer.subarray(start, end))
+                    buffer = next
+                } else {
+                    buffer.copyWithin(0, start, end)
+                }
+
+                start = 0
+                end = used
+            }
+
+            buffer.set(value, end)
+            end += value.length
+        }
+
+        /* read as many whole records as are available */
+        if (!headerRead && end - start >= CHUNK_FORMAT_HEADER_BYTES) {
+            readHeader(buffer.subarray(start, start + CHUNK_FORMAT_HEADER_BYTES))
+            start += CHUNK_FORMAT_HEADER_BYTES
+            headerRead = true
+        }
+
+        while (headerRead && end - start >= CHUNK_FORMAT_RECORD_PREFIX_BYTES) {
+            const length = new DataView(buffer.buffer, start, CHUNK_FORMAT_RECORD_PREFIX_BYTES).getUint32(0, true)
+
+            if (end - start < CHUNK_FORMAT_RECORD_PREFIX_BYTES + length) break
+
+            const recordStart = start + CHUNK_FORMAT_RECORD_PREFIX_BYTES
+            const record = buffer.slice(recordStart, recordStart + length)
+
+            const { x, y, z } = readChunkPosition(record, _position)
+            const id = Chunk.id(_position)
+
+            state.pending.push({ id, x, y, z, distance: 0, record })
+            state.sorted = false
+
+            start = recordStart + length
+            chunkCount++
+        }
+
+        await sendPages(done)
+
+        if (done) break
+    }
+
+    const message: DoneMessage = { type: ChunkLoaderWorkerMessageType.DONE, chunkCount }
+    worker.postMessage(message)
+}
+
+worker.onmessage = (e) => {
+    const data = e.data as ChunkLoaderWorkerMessage
+
+    if (data.type === ChunkLoaderWorkerMessageType.LOAD) {
+        state.actor = data.actor
+        state.sorted = false
+
+        load(data.source).catch((error) => {
+            const message: ErrorMessage = { type: ChunkLoaderWorkerMessageType.ERROR, message: String(error) }
+            worker.postMessage(message)
+        })
+    } else if (data.type === ChunkLoaderWorkerMessageType.SET_ACTOR) {
+        state.actor = data.actor
+        state.sorted = false
+    }
+}
@@ -0,0 +1,47 @@
+const openDatabase = (database: string, store: string) => {
+    return new Promise<IDBDatabase>((resolve, reject) => {
+        const request = indexedDB.open(database)
+
+        request.onupgradeneeded = () => {
+            request.result.createObjectStore(store)
+        }
+
+        request.onsuccess = () => resolve(request.result)
+        request.onerror = () => reject(request.error)
+    })
+}
+
+const requestToPromise = <T>(request: IDBRequest<T>) => {
+    return new Promise<T>((resolve, reject) => {
+        request.onsuccess = () => resolve(request.result)
+        request.onerror = () => reject(request.error)
+    })
+}
+
+/**
+ * Stores encoded chunks in IndexedDB, works on the main thread and in workers
+ */
+export const putChunkStorageBlob = async (database: string, store: string, key: string, bytes: Uint8Array | Blob) => {
+    const db = await openDatabase(database, store)
+
+    try {
+        const blob = bytes instanceof Blob ? bytes : new Blob([bytes])
+        await requestToPromise(db.transaction(store, 'readwrite').objectStore(store).put(blob, key))
+    } finally {
+        db.close()
+    }
+}
+
+/**
+ * @returns encoded chunks stored with `putChunkStorageBlob`, or undefined if there is nothing stored for the key
+ */
+export const getChunkStorageBlob = async (database: string, store: string, key: string): Promise<Blob | undefined> => {
+    const db = await openDatabase(database, store)
+
+    try {
+        const result = await requestToPromise(db.transaction(store, 'readonly').objectStore(store).get(key))
+        return result instanceof Blob ? result : undefined
+    } finally {
+        db.close()
+    }
+}
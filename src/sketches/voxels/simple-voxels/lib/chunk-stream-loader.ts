@@ -0,0 +1,108 @@
+import * as THREE from 'three'
+import { encodeWorld } from './chunk-format'
+import {
+    ChunkLoaderWorkerMessage,
+    ChunkLoaderWorkerMessageType,
+    ChunkStreamSource,
+    LoadMessage,
+    SetActorMessage,
+} from './chunk-loader-worker-types'
+import ChunkLoaderWorker from './chunk-loader.worker?worker'
+import { putChunkStorageBlob } from './chunk-storage'
+import type { Voxels } from './voxels'
+import { worldPositionToChunkPosition } from './world'
+
+const _actorChunkPosition = new THREE.Vector3()
+
+/**
+ * Streams encoded chunks into a `Voxels` world.
+ *
+ * A worker reads the source stream, decodes chunks straight into chunk directory pages nearest to the actor first,
+ * and the pages are adopted by the world's chunk directory without copying.
+ */
+export class ChunkStreamLoader {
+    private voxels: Voxels
+
+    private worker: InstanceType<typeof ChunkLoaderWorker> | null = null
+
+    private actorChunkPosition = new THREE.Vector3(Infinity, Infinity, Infinity)
+
+    constructor(voxels: Voxels) {
+        this.voxels = voxels
+    }
+
+    /**
+     * @returns a promise that resolves with the number of chunks loaded once the whole stream has been added to the world
+     */
+    load(source: ChunkStreamSource): Promise<number> {
+        this.dispose()
+
+        const worker = new ChunkLoaderWorker()
+        this.worker = worker
+
+        this.actorChunkPosition.copy(worldPositionToChunkPosition(this.voxels.actor, _actorChunkPosition))
+
+        return new Promise((resolve, reject) => {
+            worker.onmessage = (e) => {
+                const { data: message } = e as { data: ChunkLoaderWorkerMessage }
+
+                if (message.type === ChunkLoaderWorkerMessageType.CHUNK_PAGE) {
+                    this.voxels.addChunkPage(message.page, message.chunkIds, message.count)
+                } else if (message.type === ChunkLoaderWorkerMessageType.DONE) {
+                    this.dispose()
+                    resolve(message.chunkCount)
+                } else if (message.type === ChunkLoaderWorkerMessageType.ERROR) {
+                    this.dispose()
+                    reject(new Error(message.message))
+                }
+            }
+
+            const { x, y, z } = this.actorChunkPosition
+
+            const loadMessage: LoadMessage = {
+                type: ChunkLoaderWorkerMessageType.LOAD,
+                source,
+                actor: { x, y, z },
+            }
+
+            worker.postMessage(loadMessage)
+        })
+    }
+
+    /**
+     * Sends the actor position to the worker when it moves to another chunk, so the nearest chunks keep being loaded first.
+     * Call once per frame while loading.
+     */
+    update() {
+        if (!this.worker) return
+
+        const actorChunkPosition = worldPositionToChunkPosition(this.voxels.actor, _actorChunkPosition)
+
+        if (actorChunkPosition.equals(this.actorChunkPosition)) return
+
+        this.actorChunkPosition.copy(actorChunkPosition)
+
+        const { x, y, z } = actorChunkPosition
+
+        const message: SetActorMessage = {
+            type: ChunkLoaderWorkerMessageType.SET_ACTOR,
+            actor: { x, y, z },
+        }
+
+        this.worker.postMessage(message)
+    }
+
+    dispose() {
+        this.worker?.terminate()
+        this.worker = null
+    }
+}
+
+/**
+ * Encodes a voxels world and stores it in IndexedDB, to be loaded later with an 'indexeddb' `ChunkStreamSource`
+ */
+export const saveVoxelsToIndexedDB = (voxels: Voxels, database: string, store: string, key: string) => {
+    const bytes = encodeWorld(voxels.world, voxels.actor)
+
+    return putChunkStorageBlob(database, store, key, bytes)
+}
@@ -0,0 +1,272 @@
+import { packSpatialHashKey, unpackSpatialHashKeyX, unpackSpatialHashKeyY, unpackSpatialHashKeyZ } from '@/common/utils/spatial-hash'
+import * as THREE from 'three'
+import { CHUNK_SIZE } from './world'
+
+/**
+ * Chunk faces, in the same order as the neighbour directions: -x, +x, -y, +y, -z, +z
+ */
+const FACE_DIRECTIONS = [
+    [-1, 0, 0],
+    [1, 0, 0],
+    [0, -1, 0],
+    [0, 1, 0],
+    [0, 0, -1],
+    [0, 0, 1],
+]
+
+const oppositeFace = (face: number) => face ^ 1
+
+/* bit index for each unordered pair of different faces, 15 pairs */
+const FACE_PAIR_BITS: number[] = new Array(36).fill(-1)
+
+{
+    let bit = 0
+
+    for (let a = 0; a < 6; a++) {
+        for (let b = a + 1; b < 6; b++) {
+            FACE_PAIR_BITS[a * 6 + b] = bit
+            FACE_PAIR_BITS[b * 6 + a] = bit
+            bit++
+        }
+    }
+}
+
+/**
+ * Connectivity of a chunk where every face can see every other face, e.g. an empty chunk
+ */
+export const CHUNK_CONNECTIVITY_ALL = (1 << 15) - 1
+
+export const isChunkFaceConnected = (connectivity: number, a: number, b: number) => {
+    if (a === b) return true
+
+    return ((connectivity >>> FACE_PAIR_BITS[a * 6 + b]) & 1) === 1
+}
+
+const SOLID_LENGTH = CHUNK_SIZE * CHUNK_SIZE
+const VOXEL_COUNT = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE
+const MAX = CHUNK_SIZE - 1
+
+const _visited = new Uint8Array(VOXEL_COUNT)
+const _queue = new Uint16Array(VOXEL_COUNT)
+
+const isSolid = (solid: Uint16Array, index: number) => ((solid[index & (SOLID_LENGTH - 1)] >>> (index >>> 8)) & 1) === 1
+
+/**
+ * Flood fills the air in a chunk, and records which pairs of chunk faces are connected by air.
+ * Voxel indices are in `Chunk.color` order, x + z * 16 + y * 256.
+ *
+ * @returns a bitmask of connected face pairs, see `isChunkFaceConnected`
+ */
+export const computeChunkConnectivity = (solid: Uint16Array): number => {
+    let empty = true
+    let full = true
+
+    for (let i = 0; i < SOLID_LENGTH; i++) {
+        if (solid[i] !== 0) empty = false
+        if (solid[i] !== 0xffff) full = false
+    }
+
+    if (empty) return CHUNK_CONNECTIVITY_ALL
+    if (full) return 0
+
+    const visited = _visited
+    visited.fill(0)
+
+    let connectivity = 0
+
+    for (let start = 0; start < VOXEL_COUNT; start++) {
+        if (visited[start] || isSolid(solid, start)) continue
+
+        /* flood fill one air region */
+        let head = 0
+        let tail = 0
+
+        _queue[tail++] = start
+        visited[start] = 1
+
+        let faces = 0
+
+        while (head < tail) {
+            const index = _queue[head++]
+
+            const x = index & MAX
+            const z = (index >>> 4) & MAX
+            const y = index >>> 8
+
+            if (x === 0) faces |= 1 << 0
+            if (x === MAX) faces |= 1 << 1
+            if (y === 0) faces |= 1 << 2
+            if (y === MAX) faces |= 1 << 3
+            if (z === 0) faces |= 1 << 4
+            if (z === MAX) faces |= 1 << 5
+
+            for (let face = 0; face < 6; face++) {
+                const [dx, dy, dz] = FACE_DIRECTIONS[face]
+
+                const nx = x + dx
+                const ny = y + dy
+                const nz = z + dz
+
+                if (nx < 0 || nx > MAX || ny < 0 || ny > MAX || nz < 0 || nz > MAX) continue
+
+                const neighbour = nx + nz * CHUNK_SIZE + ny * SOLID_LENGTH
+
+                if (visited[neighbour] || isSolid(solid, neighbour)) continue
+
+                visited[neighbour] = 1
+                _queue[tail++] = neighbour
+            }
+        }
+
+        /* connect every pair of faces the region touches */
+        for (let a = 0; a < 6; a++) {
+            if (((faces >>> a) & 1) === 0) continue
+
+            for (let b = a + 1; b < 6; b++) {
+                if ((faces >>> b) & 1) {
+                    connectivity |= 1 << FACE_PAIR_BITS[a * 6 + b]
+                }
+            }
+        }
+
+        if (connectivity === CHUNK_CONNECTIVITY_ALL) break
+    }
+
+    return connectivity
+}
+
+const _inverseWorldMatrix = new THREE.Matrix4()
+const _projectionMatrix = new THREE.Matrix4()
+const _frustum = new THREE.Frustum()
+const _cameraPosition = new THREE.Vector3()
+const _chunkBox = new THREE.Box3()
+
+/**
+ * Finds chunks that may be visible from a camera, with a breadth first search out from the camera's chunk.
+ *
+ * The search only moves away from the camera, only enters chunks in the camera frustum, and only leaves a chunk through a face
+ * that is connected by air to the face it entered through. Chunks behind solid terrain are never reached.
+ * Chunks that don't exist are treated as empty.
+ */
+export class ChunkVisibilityCuller {
+    /**
+     * Chunk ids of the chunks found by the last `update`
+     */
+    visible = new Set<number>()
+
+    private queueIds: number[] = []
+    private queueEnteredFaces: number[] = []
+    private queueDirections: number[] = []
+
+    /**
+     * @param camera the camera to find visible chunks for
+     * @param bounds inclusive bounds of the chunks in the world, in chunk coordinates
+     * @param maxChunkDistance maximum distance from the camera to search, in chunks
+     * @param getConnectivity returns the connectivity of a chunk
+     * @param worldMatrix the world matrix of the voxel world, if it is transformed
+     * @returns false if the camera is outside the world bounds and nothing was culled
+     */
+    update(
+        camera: THREE.Camera,
+        bounds: THREE.Box3,
+        maxChunkDistance: number,
+        getConnectivity: (chunkId: number) => number,
+        worldMatrix?: THREE.Matrix4,
+    ) {
+        const visible = this.visible
+        visible.clear()
+
+        /* camera frustum and position in voxel world space */
+        _projectionMatrix.multiplyMatrices(camera.projectionMatrix, camera.matrixWorldInverse)
+
+        const cameraPosition = _cameraPosition.setFromMatrixPosition(camera.matrixWorld)
+
+        if (worldMatrix) {
+            _projectionMatrix.multiply(worldMatrix)
+            cameraPosition.applyMatrix4(_inverseWorldMatrix.copy(worldMatrix).invert())
+        }
+
+        _frustum.setFromProjectionMatrix(_projectionMatrix)
+
+        const startX = Math.floor(cameraPosition.x / CHUNK_SIZE)
+        const startY = Math.floor(cameraPosition.y / CHUNK_SIZE)
+        const startZ = Math.floor(cameraPosition.z / CHUNK_SIZE)
+
+        if (
+            bounds.isEmpty() ||
+            startX < bounds.min.x ||
+            startX > bounds.max.x ||
+            startY < bounds.min.y ||
+            startY > bounds.max.y ||
+            startZ < bounds.min.z ||
+            startZ > bounds.max.z
+        ) {
+            return false
+        }
+
+        const { queueIds, queueEnteredFaces, queueDirections } = this
+        queueIds.length = 0
+        queueEnteredFaces.length = 0
+        queueDirections.length = 0
+
+        const startId = packSpatialHashKey(startX, startY, startZ)
+
+        visible.add(startId)
+        queueIds.push(startId)
+        queueEnteredFaces.push(-1)
+        queueDirections.push(0)
+
+        const maxDistanceSquared = maxChunkDistance * maxChunkDistance
+
+        for (let head = 0; head < queueIds.length; head++) {
+            const id = queueIds[head]
+            const enteredFace = queueEnteredFaces[head]
+            const directions = queueDirections[head]
+
+            const x = unpackSpatialHashKeyX(id)
+            const y = unpackSpatialHashKeyY(id)
+            const z = unpackSpatialHashKeyZ(id)
+
+            const connectivity = getConnectivity(id)
+
+            for (let face = 0; face < 6; face++) {
+                // only move away from the camera
+                if ((directions >>> oppositeFace(face)) & 1) continue
+
+                if (enteredFace !== -1 && !isChunkFaceConnected(connectivity, enteredFace, face)) continue
+
+                const [dx, dy, dz] = FACE_DIRECTIONS[face]
+
+                const nx = x + dx
+                const ny = y + dy
+                const nz = z + dz
+
+                if (nx < bounds.min.x || nx > bounds.max.x || ny < bounds.min.y || ny > bounds.max.y || nz < bounds.min.z || nz > bounds.max.z) {
+                    continue
+                }
+
+                const distanceX = nx - startX
+                const distanceY = ny - startY
+                const distanceZ = nz - startZ
+
+                if (distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ > maxDistanceSquared) continue
+
+                const neighbourId = packSpatialHashKey(nx, ny, nz)
+
+                if (visible.has(neighbourId)) continue
+
+                _chunkBox.min.set(nx * CHUNK_SIZE, ny * CHUNK_SIZE, nz * CHUNK_SIZE)
+                _chunkBox.max.set((nx + 1) * CHUNK_SIZE, (ny + 1) * CHUNK_SIZE, (nz + 1) * CHUNK_SIZE)
+
+                if (!_frustum.intersectsBox(_chunkBox)) continue
+
+                visible.add(neighbourId)
+                queueIds.push(neighbourId)
+                queueEnteredFaces.push(oppositeFace(face))
+                queueDirections.push(directions | (1 << face))
+            }
+        }
+
+        return true
+    }
+}
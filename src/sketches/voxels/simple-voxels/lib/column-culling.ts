@@ -0,0 +1,84 @@
+import { CHUNK_SIZE, Chunk, World } from './world'
+
+const COLUMN_MASK = (1 << CHUNK_SIZE) - 1
+const TOP_BIT = CHUNK_SIZE - 1
+
+/**
+ * Per face direction visible face masks, in the same order as `VOXEL_FACE_DIRECTIONS`: top, bottom, left, right, front, back.
+ * Each mask is indexed like `Chunk.solid`, and bit y is set when the face of the voxel at y in that column is exposed.
+ */
+export type VisibleFaces = [top: Uint16Array, bottom: Uint16Array, left: Uint16Array, right: Uint16Array, front: Uint16Array, back: Uint16Array]
+
+export const createVisibleFaces = (): VisibleFaces => [
+    new Uint16Array(CHUNK_SIZE * CHUNK_SIZE),
+    new Uint16Array(CHUNK_SIZE * CHUNK_SIZE),
+    new Uint16Array(CHUNK_SIZE * CHUNK_SIZE),
+    new Uint16Array(CHUNK_SIZE * CHUNK_SIZE),
+    new Uint16Array(CHUNK_SIZE * CHUNK_SIZE),
+    new Uint16Array(CHUNK_SIZE * CHUNK_SIZE),
+]
+
+const _neighbourChunkPosition = { x: 0, y: 0, z: 0 }
+
+const getNeighbourSolid = (world: World, chunk: Chunk, dx: number, dy: number, dz: number): Uint16Array | undefined => {
+    _neighbourChunkPosition.x = chunk.position.x + dx
+    _neighbourChunkPosition.y = chunk.position.y + dy
+    _neighbourChunkPosition.z = chunk.position.z + dz
+
+    return world.getChunk(_neighbourChunkPosition)?.solid
+}
+
+/**
+ * Finds exposed faces a whole column at a time.
+ *
+ * Faces along y are found by shifting a column against itself, with the end bits taken from the chunk above or below.
+ * Faces along x and z are found by masking a column against its neighbour column, which is read from the adjacent chunk on chunk borders.
+ * Missing neighbour chunks are treated as air.
+ */
+export const cullFaces = (chunk: Chunk, world: World, out: VisibleFaces = createVisibleFaces()): VisibleFaces => {
+    const [top, bottom, left, right, front, back] = out
+
+    const solid = chunk.solid
+
+    const above = getNeighbourSolid(world, chunk, 0, 1, 0)
+    const below = getNeighbourSolid(world, chunk, 0, -1, 0)
+    const negX = getNeighbourSolid(world, chunk, -1, 0, 0)
+    const posX = getNeighbourSolid(world, chunk, 1, 0, 0)
+    const negZ = getNeighbourSolid(world, chunk, 0, 0, -1)
+    const posZ = getNeighbourSolid(world, chunk, 0, 0, 1)
+
+    for (let z = 0; z < CHUNK_SIZE; z++) {
+        for (let x = 0; x < CHUNK_SIZE; x++) {
+            const index = x + z * CHUNK_SIZE
+            const column = solid[index]
+
+            if (column === 0) {
+                top[index] = bottom[index] = left[index] = right[index] = front[index] = back[index] = 0
+                continue
+            }
+
+            /* y faces, shift the column by one voxel against itself */
+            const aboveColumn = (column >>> 1) | (above ? (above[index] & 1) << TOP_BIT : 0)
+            const belowColumn = ((column << 1) & COLUMN_MASK) | (below ? below[index] >>> TOP_BIT : 0)
+
+            top[index] = column & ~aboveColumn
+            bottom[index] = column & ~belowColumn
+
+            /* x faces */
+            const leftColumn = x > 0 ? solid[index - 1] : negX ? negX[index + CHUNK_SIZE - 1] : 0
+            const rightColumn = x < CHUNK_SIZE - 1 ? solid[index + 1] : posX ? posX[index - (CHUNK_SIZE - 1)] : 0
+
+            left[index] = column & ~leftColumn
+            right[index] = column & ~rightColumn
+
+            /* z faces */
+            const frontColumn = z > 0 ? solid[index - CHUNK_SIZE] : negZ ? negZ[index + CHUNK_SIZE * (CHUNK_SIZE - 1)] : 0
+            const backColumn = z < CHUNK_SIZE - 1 ? solid[index + CHUNK_SIZE] : posZ ? posZ[index - CHUNK_SIZE * (CHUNK_SIZE - 1)] : 0
+
+            front[index] = column & ~frontColumn
+            back[index] = column & ~backColumn
+        }
+    }
+
+    return out
+}
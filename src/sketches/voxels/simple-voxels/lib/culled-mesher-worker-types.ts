@@ -1,29 +1,48 @@
 import { CulledMesherChunkResult } from './culled-mesher'
 
 export const CulledMesherWorkerMessageType = {
-    REGISTER_CHUNK: 0,
-    REQUEST_CHUNK_MESH_UPDATE: 1,
+    ADD_CHUNK_PAGES: 0,
+    PROCESS_CHUNK_MESH_JOBS: 1,
     CHUNK_MESH_UPDATE_RESULT: 2,
+    INIT: 3,
 } as const
 
-export type RegisterChunkMessage = {
-    type: typeof CulledMesherWorkerMessageType.REGISTER_CHUNK
-    worldId: number
-    chunkId: string
-    position: [number, number, number]
-    solidBuffer: SharedArrayBuffer
-    colorBuffer: SharedArrayBuffer
+export type VoxelsMesherType = 'culled' | 'greedy'
+
+export type InitMessage = {
+    type: typeof CulledMesherWorkerMessageType.INIT
+    jobQueueBuffer: SharedArrayBuffer
+    chunkDirectoryIndexBuffer: SharedArrayBuffer
+    chunkDirectoryPages: SharedArrayBuffer[]
+
+    /**
+     * See `getTraceBuffer`, null when tracing is off
+     */
+    traceBuffer: SharedArrayBuffer | null
 }
 
-export type RequestChunkMeshUpdateMessage = {
-    type: typeof CulledMesherWorkerMessageType.REQUEST_CHUNK_MESH_UPDATE
-    worldId: number
-    chunkId: string
+export type AddChunkPagesMessage = {
+    type: typeof CulledMesherWorkerMessageType.ADD_CHUNK_PAGES
+    pages: SharedArrayBuffer[]
+}
+
+export type ProcessChunkMeshJobsMessage = {
+    type: typeof CulledMesherWorkerMessageType.PROCESS_CHUNK_MESH_JOBS
 }
 
 export type ChunkMeshUpdateResultMessage = {
     type: typeof CulledMesherWorkerMessageType.CHUNK_MESH_UPDATE_RESULT
     worldId: number
+
+    /**
+     * Which pairs of chunk faces are connected by air, see `computeChunkConnectivity`
+     */
+    connectivity: number
+
+    /**
+     * Milliseconds spent meshing the chunk
+     */
+    meshTime: number
 } & CulledMesherChunkResult
 
-export type WorkerMessage = RegisterChunkMessage | RequestChunkMeshUpdateMessage | ChunkMeshUpdateResultMessage
+export type WorkerMessage = InitMessage | AddChunkPagesMessage | ProcessChunkMeshJobsMessage | ChunkMeshUpdateResultMessage
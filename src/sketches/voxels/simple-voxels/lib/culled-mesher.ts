@@ -1,8 +1,9 @@
 import { Color, Vector3 } from 'three'
+import { createVisibleFaces, cullFaces } from './column-culling'
 import { CHUNK_SIZE, Chunk, World } from './world'
 
 export type CulledMesherChunkResult = {
-    chunkId: string
+    chunkId: number
     positions: Float32Array
     indices: Uint32Array
     normals: Float32Array
@@ -10,7 +11,7 @@ export type CulledMesherChunkResult = {
     ambientOcclusion: Float32Array
 }
 
-const VOXEL_FACE_DIRECTIONS: {
+export const VOXEL_FACE_DIRECTIONS: {
     // direction of the face / normal
     dx: number
     dy: number
@@ -125,13 +126,12 @@ const _color = new Color()
 
 const _mesh_chunkLocalPosition = new Vector3()
 const _mesh_worldPosition = new Vector3()
-const _mesh_worldNeighbourPosition = new Vector3()
-const _mesh_localNeighbourPosition = new Vector3()
+const _mesh_visibleFaces = createVisibleFaces()
 
 const _ao_worldPosition = new Vector3()
 const _ao_grid = new Uint32Array(9)
 
-const vertexAmbientOcclusion = (side1: number, side2: number, corner: number) => {
+export const vertexAmbientOcclusion = (side1: number, side2: number, corner: number) => {
     if (side1 && side2) {
         return 0
     }
@@ -152,59 +152,44 @@ export const mesh = (chunk: Chunk, world: World): CulledMesherChunkResult => {
 
     const chunkLocalPosition = _mesh_chunkLocalPosition
     const worldPosition = _mesh_worldPosition
-    const localNeighbourPosition = _mesh_localNeighbourPosition
-    const worldNeighbourPosition = _mesh_worldNeighbourPosition
 
     const colorCache = new Map<number, [r: number, g: number, b: number]>()
 
-    for (let localX = 0; localX < CHUNK_SIZE; localX++) {
+    /* find exposed faces a column at a time */
+    const visibleFaces = cullFaces(chunk, world, _mesh_visibleFaces)
+
+    for (let face = 0; face < VOXEL_FACE_DIRECTIONS.length; face++) {
+        const { dx, dy, dz, lx, ly, lz, ux, uy, uz, vx, vy, vz } = VOXEL_FACE_DIRECTIONS[face]
+
+        const faceMask = visibleFaces[face]
+
         for (let localZ = 0; localZ < CHUNK_SIZE; localZ++) {
-            for (let localY = 0; localY < CHUNK_SIZE; localY++) {
-                /* skip air */
-                chunkLocalPosition.set(localX, localY, localZ)
+            for (let localX = 0; localX < CHUNK_SIZE; localX++) {
+                let column = faceMask[localX + localZ * CHUNK_SIZE]
 
-                if (!chunk.getSolid(chunkLocalPosition)) continue
+                /* visit each exposed face in the column, lowest bit first */
+                while (column !== 0) {
+                    const localY = 31 - Math.clz32(column & -column)
+                    column &= column - 1
 
-                /* get voxel color */
-                const colorHex = chunk.getColor(chunkLocalPosition)
+                    /* get voxel color */
+                    chunkLocalPosition.set(localX, localY, localZ)
 
-                let color = colorCache.get(colorHex)
+                    const colorHex = chunk.getColor(chunkLocalPosition)
 
-                if (!color) {
-                    _color.setHex(colorHex)
-                    color = [_color.r, _color.g, _color.b]
-                    colorCache.set(colorHex, color)
-                }
+                    let color = colorCache.get(colorHex)
 
-                const [colorR, colorG, colorB] = color
-
-                /* check which faces are visible */
-                const worldX = chunkX + localX
-                const worldY = chunkY + localY
-                const worldZ = chunkZ + localZ
-
-                for (const voxelFaceDirection of VOXEL_FACE_DIRECTIONS) {
-                    const { dx, dy, dz, lx, ly, lz, ux, uy, uz, vx, vy, vz } = voxelFaceDirection
-
-                    localNeighbourPosition.set(localX + dx, localY + dy, localZ + dz)
-
-                    /* skip creating faces when neighbour is solid */
-                    let solid: boolean
-                    if (
-                        localNeighbourPosition.x < 0 ||
-                        localNeighbourPosition.x >= CHUNK_SIZE ||
-                        localNeighbourPosition.y < 0 ||
-                        localNeighbourPosition.y >= CHUNK_SIZE ||
-                        localNeighbourPosition.z < 0 ||
-                        localNeighbourPosition.z >= CHUNK_SIZE
-                    ) {
-                        worldNeighbourPosition.set(worldX + dx, worldY + dy, worldZ + dz)
-                        solid = world.getSolid(worldNeighbourPosition)
-                    } else {
-                        solid = chunk.getSolid(localNeighbourPosition)
+                    if (!color) {
+                        _color.setHex(colorHex)
+                        color = [_color.r, _color.g, _color.b]
+                        colorCache.set(colorHex, color)
                     }
 
-                    if (solid) continue
+                    const [colorR, colorG, colorB] = color
+
+                    const worldX = chunkX + localX
+                    const worldY = chunkY + localY
+                    const worldZ = chunkZ + localZ
 
                     worldPosition.set(worldX, worldY, worldZ)
 
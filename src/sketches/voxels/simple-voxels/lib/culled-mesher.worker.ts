@@ -1,103 +1,138 @@
-import { Vector3 } from 'three'
+import { connectTracing, traceCounter, traceEnd, traceStart } from '@/common/utils/tracing'
+import { ChunkDirectory } from './chunk-directory'
+import { computeChunkConnectivity } from './chunk-visibility'
 import {
+    AddChunkPagesMessage,
     ChunkMeshUpdateResultMessage,
     CulledMesherWorkerMessageType,
-    RegisterChunkMessage,
-    RequestChunkMeshUpdateMessage,
+    InitMessage,
     WorkerMessage,
 } from './culled-mesher-worker-types'
-import { Chunk, World } from './world'
+import { World } from './world'
 import { mesh } from './culled-mesher'
+import { greedyMesh } from './greedy-mesher'
+import { MesherJobQueue } from './mesher-job-queue'
+
+const meshers = {
+    culled: mesh,
+    greedy: greedyMesh,
+}
 
 const state = {
     worlds: new Map<number, World>(),
-    worldChunkMeshJobs: new Map<number, Set<string>>(),
+    jobQueue: null as MesherJobQueue | null,
+    chunkDirectory: null as ChunkDirectory | null,
 }
 
 const worker = self as unknown as Worker
 
-const update = () => {
-    for (const [worldId, chunkIds] of state.worldChunkMeshJobs) {
-        const remoteWorld = state.worlds.get(worldId)
+// a world with no directory, for meshing chunks without their neighbours
+const isolatedWorld = new World()
 
-        if (!remoteWorld) {
-            continue
-        }
+const getWorld = (worldId: number, chunkDirectory: ChunkDirectory) => {
+    let world = state.worlds.get(worldId)
+
+    if (!world) {
+        world = new World({ id: worldId, directory: chunkDirectory })
+        state.worlds.set(worldId, world)
+    }
+
+    return world
+}
+
+/**
+ * Pulls jobs from the shared queue until it is empty.
+ * All workers pull from the same queue, so an idle worker always takes the highest priority job that no other worker has started.
+ */
+const processJobs = () => {
+    const { jobQueue, chunkDirectory } = state
+
+    if (!jobQueue || !chunkDirectory) return
+
+    while (true) {
+        const slot = jobQueue.pop()
 
-        const incomplete = new Set(chunkIds)
+        if (slot === -1) return
 
-        const chunksToProcess = chunkIds
+        traceCounter('voxels-mesher-queue-depth', jobQueue.size)
 
-        state.worldChunkMeshJobs.set(worldId, new Set())
+        const version = jobQueue.version(slot)
+        const mesherType = jobQueue.mesher(slot)
+        const mesher = meshers[mesherType]
+        const isolated = jobQueue.isolated(slot)
 
-        for (const chunkId of chunksToProcess) {
-            const chunk = remoteWorld.chunks.get(chunkId)
+        const missingPages = chunkDirectory.missingPages
 
-            if (!chunk) {
-                continue
+        const chunk = chunkDirectory.getChunk(slot)
+        const worldId = chunkDirectory.getWorldId(slot)
+        let world = getWorld(worldId, chunkDirectory)
+
+        if (isolated && chunk) {
+            isolatedWorld.chunks.clear()
+            isolatedWorld.chunks.set(chunk.id, chunk)
+            world = isolatedWorld
+        }
+
+        try {
+            const traceStartTime = traceStart()
+            const meshStart = performance.now()
+            const result = chunk ? mesher(chunk, world) : undefined
+            const meshTime = performance.now() - meshStart
+            traceEnd('voxels-mesh-chunk', traceStartTime)
+
+            // the chunk or a neighbour is in a page this worker hasn't received yet, put the job back for the next wake up
+            if (!result || chunkDirectory.missingPages !== missingPages) {
+                jobQueue.push(slot, jobQueue.poppedPriority, mesherType, isolated)
+                return
             }
 
-            try {
-                const { positions, indices, normals, colors, ambientOcclusion } = mesh(chunk, remoteWorld)
-
-                const chunkMeshUpdateNotification: ChunkMeshUpdateResultMessage = {
-                    type: CulledMesherWorkerMessageType.CHUNK_MESH_UPDATE_RESULT,
-                    worldId,
-                    chunkId: chunkId,
-                    positions,
-                    indices,
-                    normals,
-                    colors,
-                    ambientOcclusion,
-                }
-
-                worker.postMessage(chunkMeshUpdateNotification, {
-                    transfer: [positions.buffer, indices.buffer, normals.buffer, colors.buffer, ambientOcclusion.buffer],
-                })
-
-                incomplete.delete(chunkId)
-            } catch (e) {
-                // swallow
+            // drop the result if a newer edit requested another remesh while meshing
+            if (jobQueue.version(slot) !== version) continue
+
+            const { positions, indices, normals, colors, ambientOcclusion } = result
+
+            const chunkMeshUpdateNotification: ChunkMeshUpdateResultMessage = {
+                type: CulledMesherWorkerMessageType.CHUNK_MESH_UPDATE_RESULT,
+                worldId,
+                connectivity: computeChunkConnectivity(chunk!.solid),
+                meshTime,
+                chunkId: result.chunkId,
+                positions,
+                indices,
+                normals,
+                colors,
+                ambientOcclusion,
             }
 
-            state.worldChunkMeshJobs.set(worldId, new Set([...incomplete, ...state.worldChunkMeshJobs.get(worldId)!]))
+            worker.postMessage(chunkMeshUpdateNotification, {
+                transfer: [positions.buffer, indices.buffer, normals.buffer, colors.buffer, ambientOcclusion.buffer],
+            })
+        } catch (e) {
+            // swallow
         }
     }
 }
 
-const registerChunk = ({ worldId, chunkId, position, solidBuffer, colorBuffer }: RegisterChunkMessage) => {
-    let remoteWorld = state.worlds.get(worldId)
-
-    if (!remoteWorld) {
-        remoteWorld = new World()
-        state.worlds.set(worldId, remoteWorld)
-    }
-
-    const chunk = new Chunk(chunkId, new Vector3(...position), solidBuffer, colorBuffer)
+const init = ({ jobQueueBuffer, chunkDirectoryIndexBuffer, chunkDirectoryPages, traceBuffer }: InitMessage) => {
+    connectTracing(traceBuffer, 'culled-mesher')
 
-    remoteWorld.chunks.set(chunkId, chunk)
+    state.jobQueue = new MesherJobQueue(jobQueueBuffer)
+    state.chunkDirectory = new ChunkDirectory(chunkDirectoryIndexBuffer, chunkDirectoryPages)
 }
 
-const requestChunkMeshUpdate = ({ worldId, chunkId }: RequestChunkMeshUpdateMessage) => {
-    let jobs = state.worldChunkMeshJobs.get(worldId)
-
-    if (!jobs) {
-        jobs = new Set()
-        state.worldChunkMeshJobs.set(worldId, jobs)
-    }
-
-    jobs.add(chunkId)
+const addChunkPages = ({ pages }: AddChunkPagesMessage) => {
+    state.chunkDirectory?.addPages(pages)
 }
 
 worker.onmessage = (e) => {
     const data = e.data as WorkerMessage
     const { type } = data
 
-    if (type === CulledMesherWorkerMessageType.REGISTER_CHUNK) {
-        registerChunk(data)
-    } else if (type === CulledMesherWorkerMessageType.REQUEST_CHUNK_MESH_UPDATE) {
-        requestChunkMeshUpdate(data)
+    if (type === CulledMesherWorkerMessageType.INIT) {
+        init(data)
+    } else if (type === CulledMesherWorkerMessageType.ADD_CHUNK_PAGES) {
+        addChunkPages(data)
+    } else if (type === CulledMesherWorkerMessageType.PROCESS_CHUNK_MESH_JOBS) {
+        processJobs()
     }
 }
-
-setInterval(update, 1000 / 120)
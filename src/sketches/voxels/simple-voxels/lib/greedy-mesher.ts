@@ -0,0 +1,241 @@
+import { Color, Vector3 } from 'three'
+import { createVisibleFaces, cullFaces } from './column-culling'
+import { CulledMesherChunkResult, VOXEL_FACE_DIRECTIONS, vertexAmbientOcclusion } from './culled-mesher'
+import { CHUNK_SIZE, Chunk, World } from './world'
+
+const _color = new Color()
+
+const _mesh_chunkLocalPosition = new Vector3()
+const _mesh_visibleFaces = createVisibleFaces()
+
+const _ao_worldPosition = new Vector3()
+const _ao_grid = new Uint32Array(9)
+
+/**
+ * Visible faces for the current slice.
+ * `_mask_ao` is -1 where there is no face, otherwise the four vertex AO levels packed into 2 bits each.
+ */
+const _mask_color = new Uint32Array(CHUNK_SIZE * CHUNK_SIZE)
+const _mask_ao = new Int16Array(CHUNK_SIZE * CHUNK_SIZE)
+
+const NO_FACE = -1
+
+const packAmbientOcclusion = (ao00: number, ao01: number, ao10: number, ao11: number) => {
+    return Math.round(ao00 * 3) | (Math.round(ao01 * 3) << 2) | (Math.round(ao10 * 3) << 4) | (Math.round(ao11 * 3) << 6)
+}
+
+const isUniformAmbientOcclusion = (packed: number) => {
+    const ao00 = packed & 3
+    return ao00 === ((packed >> 2) & 3) && ao00 === ((packed >> 4) & 3) && ao00 === ((packed >> 6) & 3)
+}
+
+/**
+ * Greedy mesher, produces the same output as `mesh` from './culled-mesher', but merges coplanar faces into larger quads.
+ *
+ * Faces are merged when they share a color and have uniform ambient occlusion.
+ * Faces with an AO gradient are emitted as single quads, as stretching a gradient over a merged quad would look wrong.
+ *
+ * @see https://0fps.net/2012/06/30/meshing-in-a-minecraft-game/
+ */
+export const greedyMesh = (chunk: Chunk, world: World): CulledMesherChunkResult => {
+    const chunkX = chunk.position.x * CHUNK_SIZE
+    const chunkY = chunk.position.y * CHUNK_SIZE
+    const chunkZ = chunk.position.z * CHUNK_SIZE
+
+    const positions: number[] = []
+    const indices: number[] = []
+    const normals: number[] = []
+    const colors: number[] = []
+    const ambientOcclusion: number[] = []
+
+    const chunkLocalPosition = _mesh_chunkLocalPosition
+
+    const maskColor = _mask_color
+    const maskAo = _mask_ao
+
+    const colorCache = new Map<number, [r: number, g: number, b: number]>()
+
+    /* find exposed faces a column at a time */
+    const visibleFaces = cullFaces(chunk, world, _mesh_visibleFaces)
+
+    for (let face = 0; face < VOXEL_FACE_DIRECTIONS.length; face++) {
+        const { dx, dy, dz, lx, ly, lz, ux, uy, uz, vx, vy, vz } = VOXEL_FACE_DIRECTIONS[face]
+
+        const faceMask = visibleFaces[face]
+
+        /*
+         * each face direction is swept in slices along its normal axis.
+         * within a slice, 'a' steps along the face u axis and 'b' steps along the face v axis,
+         * starting from the corner of the chunk that keeps u and v steps in bounds.
+         */
+        const sx = Math.abs(dx)
+        const sy = Math.abs(dy)
+        const sz = Math.abs(dz)
+
+        const baseX = ux < 0 || vx < 0 ? CHUNK_SIZE - 1 : 0
+        const baseY = uy < 0 || vy < 0 ? CHUNK_SIZE - 1 : 0
+        const baseZ = uz < 0 || vz < 0 ? CHUNK_SIZE - 1 : 0
+
+        for (let s = 0; s < CHUNK_SIZE; s++) {
+            /* build the face mask for this slice */
+            let n = 0
+
+            for (let b = 0; b < CHUNK_SIZE; b++) {
+                for (let a = 0; a < CHUNK_SIZE; a++, n++) {
+                    maskAo[n] = NO_FACE
+
+                    const localX = baseX + sx * s + ux * a + vx * b
+                    const localY = baseY + sy * s + uy * a + vy * b
+                    const localZ = baseZ + sz * s + uz * a + vz * b
+
+                    /* skip voxels without an exposed face in this direction */
+                    if (((faceMask[localX + localZ * CHUNK_SIZE] >>> localY) & 1) === 0) continue
+
+                    const worldX = chunkX + localX
+                    const worldY = chunkY + localY
+                    const worldZ = chunkZ + localZ
+
+                    /* calculate ambient occlusion grid, see './culled-mesher' */
+                    const aoGridWorldPosition = _ao_worldPosition
+                    const aoGrid = _ao_grid
+
+                    let aoGridIndex = 0
+                    for (let q = -1; q < 2; q++) {
+                        for (let p = -1; p < 2; p++) {
+                            aoGridWorldPosition.set(
+                                worldX + dx + ux * p + vx * q,
+                                worldY + dy + uy * p + vy * q,
+                                worldZ + dz + uz * p + vz * q,
+                            )
+
+                            aoGrid[aoGridIndex] = world.getSolid(aoGridWorldPosition) ? 1 : 0
+
+                            aoGridIndex++
+                        }
+                    }
+
+                    const ao00 = vertexAmbientOcclusion(aoGrid[3], aoGrid[1], aoGrid[0])
+                    const ao01 = vertexAmbientOcclusion(aoGrid[1], aoGrid[5], aoGrid[2])
+                    const ao10 = vertexAmbientOcclusion(aoGrid[5], aoGrid[7], aoGrid[8])
+                    const ao11 = vertexAmbientOcclusion(aoGrid[3], aoGrid[7], aoGrid[6])
+
+                    maskAo[n] = packAmbientOcclusion(ao00, ao01, ao10, ao11)
+                    maskColor[n] = chunk.getColor(chunkLocalPosition.set(localX, localY, localZ))
+                }
+            }
+
+            /* merge the face mask into quads */
+            n = 0
+
+            for (let b = 0; b < CHUNK_SIZE; b++) {
+                for (let a = 0; a < CHUNK_SIZE; ) {
+                    const ao = maskAo[n]
+
+                    if (ao === NO_FACE) {
+                        a++
+                        n++
+                        continue
+                    }
+
+                    const colorHex = maskColor[n]
+
+                    let width = 1
+                    let height = 1
+
+                    if (isUniformAmbientOcclusion(ao)) {
+                        while (a + width < CHUNK_SIZE && maskAo[n + width] === ao && maskColor[n + width] === colorHex) {
+                            width++
+                        }
+
+                        grow: while (b + height < CHUNK_SIZE) {
+                            const row = n + height * CHUNK_SIZE
+
+                            for (let k = 0; k < width; k++) {
+                                if (maskAo[row + k] !== ao || maskColor[row + k] !== colorHex) break grow
+                            }
+
+                            height++
+                        }
+                    }
+
+                    /* clear merged faces from the mask */
+                    for (let h = 0; h < height; h++) {
+                        const row = n + h * CHUNK_SIZE
+
+                        for (let w = 0; w < width; w++) {
+                            maskAo[row + w] = NO_FACE
+                        }
+                    }
+
+                    /* get voxel color */
+                    let color = colorCache.get(colorHex)
+
+                    if (!color) {
+                        _color.setHex(colorHex)
+                        color = [_color.r, _color.g, _color.b]
+                        colorCache.set(colorHex, color)
+                    }
+
+                    const [colorR, colorG, colorB] = color
+
+                    /* create face */
+                    const voxelFaceLocalX = baseX + sx * s + ux * a + vx * b + lx
+                    const voxelFaceLocalY = baseY + sy * s + uy * a + vy * b + ly
+                    const voxelFaceLocalZ = baseZ + sz * s + uz * a + vz * b + lz
+
+                    const uwx = ux * width
+                    const uwy = uy * width
+                    const uwz = uz * width
+                    const vhx = vx * height
+                    const vhy = vy * height
+                    const vhz = vz * height
+
+                    // prettier-ignore
+                    positions.push(
+                        voxelFaceLocalX, voxelFaceLocalY, voxelFaceLocalZ,
+                        voxelFaceLocalX + uwx, voxelFaceLocalY + uwy, voxelFaceLocalZ + uwz,
+                        voxelFaceLocalX + uwx + vhx, voxelFaceLocalY + uwy + vhy, voxelFaceLocalZ + uwz + vhz,
+                        voxelFaceLocalX + vhx, voxelFaceLocalY + vhy, voxelFaceLocalZ + vhz
+                    )
+
+                    normals.push(dx, dy, dz, dx, dy, dz, dx, dy, dz, dx, dy, dz)
+
+                    colors.push(colorR, colorG, colorB, colorR, colorG, colorB, colorR, colorG, colorB, colorR, colorG, colorB)
+
+                    const ao00 = (ao & 3) / 3
+                    const ao01 = ((ao >> 2) & 3) / 3
+                    const ao10 = ((ao >> 4) & 3) / 3
+                    const ao11 = ((ao >> 6) & 3) / 3
+
+                    ambientOcclusion.push(ao00, ao01, ao10, ao11)
+
+                    const index = positions.length / 3 - 4
+                    const i0 = index
+                    const i1 = index + 1
+                    const i2 = index + 2
+                    const i3 = index + 3
+
+                    if (ao00 + ao10 > ao11 + ao01) {
+                        // generate flipped quad
+                        indices.push(i0, i1, i2, i0, i2, i3)
+                    } else {
+                        // generate normal quad
+                        indices.push(i0, i1, i3, i1, i2, i3)
+                    }
+
+                    a += width
+                    n += width
+                }
+            }
+        }
+    }
+
+    return {
+        chunkId: chunk.id,
+        positions: new Float32Array(positions),
+        indices: new Uint32Array(indices),
+        normals: new Float32Array(normals),
+        colors: new Float32Array(colors),
+        ambientOcclusion: new Float32Array(ambientOcclusion),
+    }
+}
@@ -0,0 +1,160 @@
+import { SpatialHashMap } from '@/common/utils/spatial-hash'
+import * as THREE from 'three'
+import type { ChunkDirectory } from './chunk-directory'
+import { ChunkGeometry } from './chunk-geometry'
+import { chunkMaterial } from './chunk-material'
+import { CHUNK_SIZE, Chunk, World } from './world'
+
+const HALF_CHUNK_SIZE = CHUNK_SIZE / 2
+const OCTANT_COLUMN_MASK = (1 << HALF_CHUNK_SIZE) - 1
+
+/**
+ * Halves a column, bit i of the result is set if bit 2i or 2i + 1 of the column is set
+ */
+const downsampleColumn = (column: number) => {
+    let bits = (column | (column >>> 1)) & 0x5555
+    bits = (bits | (bits >>> 1)) & 0x3333
+    bits = (bits | (bits >>> 2)) & 0x0f0f
+    bits = (bits | (bits >>> 4)) & 0x00ff
+
+    return bits
+}
+
+/**
+ * Downsamples a chunk into one octant of a chunk at the next level of detail.
+ *
+ * Each cell of the octant covers 2x2x2 voxels of the source chunk. A cell is solid if any of its voxels are solid,
+ * so a lower level of detail never has holes where the higher level has solid voxels. Cell colors are the average of the solid voxel colors.
+ *
+ * If the source chunk doesn't exist, the octant is cleared.
+ */
+export const downsampleChunk = (source: Chunk | undefined, target: Chunk, octantX: number, octantY: number, octantZ: number) => {
+    const offsetX = octantX * HALF_CHUNK_SIZE
+    const offsetY = octantY * HALF_CHUNK_SIZE
+    const offsetZ = octantZ * HALF_CHUNK_SIZE
+
+    const octantMask = OCTANT_COLUMN_MASK << offsetY
+
+    for (let tz = 0; tz < HALF_CHUNK_SIZE; tz++) {
+        for (let tx = 0; tx < HALF_CHUNK_SIZE; tx++) {
+            const targetIndex = offsetX + tx + (offsetZ + tz) * CHUNK_SIZE
+
+            if (!source) {
+                target.solid[targetIndex] &= ~octantMask
+                continue
+            }
+
+            const sourceX = tx * 2
+            const sourceZ = tz * 2
+            const sourceIndex = sourceX + sourceZ * CHUNK_SIZE
+
+            const solid = source.solid
+
+            const column = downsampleColumn(
+                solid[sourceIndex] | solid[sourceIndex + 1] | solid[sourceIndex + CHUNK_SIZE] | solid[sourceIndex + CHUNK_SIZE + 1],
+            )
+
+            target.solid[targetIndex] = (target.solid[targetIndex] & ~octantMask) | (column << offsetY)
+
+            /* average the colors of the solid voxels in each solid cell */
+            let bits = column
+
+            while (bits !== 0) {
+                const ty = 31 - Math.clz32(bits & -bits)
+                bits &= bits - 1
+
+                let r = 0
+                let g = 0
+                let b = 0
+                let count = 0
+
+                for (let dz = 0; dz < 2; dz++) {
+                    for (let dx = 0; dx < 2; dx++) {
+                        const voxelColumn = solid[sourceIndex + dx + dz * CHUNK_SIZE]
+
+                        for (let dy = 0; dy < 2; dy++) {
+                            const sourceY = ty * 2 + dy
+
+                            if (((voxelColumn >>> sourceY) & 1) === 0) continue
+
+                            const color = source.color[sourceX + dx + (sourceZ + dz) * CHUNK_SIZE + sourceY * CHUNK_SIZE * CHUNK_SIZE]
+
+                            r += (color >>> 16) & 0xff
+                            g += (color >>> 8) & 0xff
+                            b += color & 0xff
+                            count++
+                        }
+                    }
+                }
+
+                const targetColorIndex = targetIndex + (offsetY + ty) * CHUNK_SIZE * CHUNK_SIZE
+
+                target.color[targetColorIndex] = (Math.round(r / count) << 16) | (Math.round(g / count) << 8) | Math.round(b / count)
+            }
+        }
+    }
+}
+
+export type LodNode = {
+    chunk: Chunk
+    loaded: boolean
+    priority: number
+    initialised: boolean
+    mesh: THREE.Mesh<ChunkGeometry, THREE.Material>
+}
+
+/**
+ * One level of detail of a voxel world.
+ *
+ * Nodes are stored as chunks in their own world, so the existing meshers and worker pool can mesh them.
+ * A node at level n covers 2^n x 2^n x 2^n chunks of the full resolution world, and each of its cells covers 2^n voxels per axis.
+ */
+export class VoxelsLodLevel {
+    level: number
+
+    world: World
+
+    nodes = new SpatialHashMap<LodNode>()
+
+    /**
+     * Nodes that need to be downsampled from the level below
+     */
+    dirtyNodes = new Set<number>()
+
+    /**
+     * Nodes that need to be remeshed
+     */
+    dirtyMeshes = new Set<number>()
+
+    /**
+     * Nodes that need to be remeshed when they are next loaded
+     */
+    dirtyUnloadedMeshes = new Set<number>()
+
+    /**
+     * Nodes that should be shown this frame, collected while updating chunk states
+     */
+    shownNodes = new Set<number>()
+
+    constructor(level: number, directory?: ChunkDirectory) {
+        this.level = level
+        this.world = new World({ directory })
+
+        this.world.onChunkCreated.add((chunk) => {
+            this.nodes.set(chunk.id, {
+                chunk,
+                loaded: false,
+                priority: 0,
+                initialised: false,
+                mesh: new THREE.Mesh(new ChunkGeometry(), chunkMaterial),
+            })
+        })
+    }
+
+    /**
+     * Size of a node in full resolution chunks, per axis
+     */
+    get nodeSize() {
+        return 1 << this.level
+    }
+}
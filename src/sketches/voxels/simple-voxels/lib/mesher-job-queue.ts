@@ -0,0 +1,250 @@
+import type { VoxelsMesherType } from './culled-mesher-worker-types'
+
+export const MESHER_TYPES: VoxelsMesherType[] = ['culled', 'greedy']
+
+const HEADER_LOCK = 0
+const HEADER_SIZE = 1
+const HEADER_CAPACITY = 2
+const HEADER_LENGTH = 4
+
+const NOT_QUEUED = -1
+
+// set in a slot's mesher value when the job should mesh the chunk without looking at neighbour chunks
+const ISOLATED_BIT = 1 << 8
+
+/**
+ * A max priority queue of chunk mesh jobs, shared between the main thread and all mesher workers via a SharedArrayBuffer.
+ *
+ * Chunks are identified by a slot index assigned by the worker pool.
+ * Each slot has at most one queued job, requesting a remesh for a queued slot updates the job priority instead of adding another job.
+ * Each request also bumps the slot version, so a worker can tell when a result it is working on has been superseded by a newer edit.
+ *
+ * Access is guarded by a spin lock, the critical sections are O(log n) heap operations.
+ */
+export class MesherJobQueue {
+    buffer: SharedArrayBuffer
+
+    /**
+     * Priority of the job last returned by `pop` on this thread
+     */
+    poppedPriority = 0
+
+    private header: Int32Array
+    private slotVersion: Int32Array
+    private slotHeapIndex: Int32Array
+    private slotMesher: Int32Array
+    private heapSlot: Int32Array
+    private heapPriority: Float32Array
+
+    constructor(buffer: SharedArrayBuffer) {
+        this.buffer = buffer
+
+        this.header = new Int32Array(buffer, 0, HEADER_LENGTH)
+
+        const capacity = this.header[HEADER_CAPACITY]
+        const stride = capacity * Int32Array.BYTES_PER_ELEMENT
+        let offset = HEADER_LENGTH * Int32Array.BYTES_PER_ELEMENT
+
+        this.slotVersion = new Int32Array(buffer, offset, capacity)
+        offset += stride
+        this.slotHeapIndex = new Int32Array(buffer, offset, capacity)
+        offset += stride
+        this.slotMesher = new Int32Array(buffer, offset, capacity)
+        offset += stride
+        this.heapSlot = new Int32Array(buffer, offset, capacity)
+        offset += stride
+        this.heapPriority = new Float32Array(buffer, offset, capacity)
+    }
+
+    static create(capacity: number) {
+        const buffer = new SharedArrayBuffer(
+            HEADER_LENGTH * Int32Array.BYTES_PER_ELEMENT + capacity * (Int32Array.BYTES_PER_ELEMENT * 4 + Float32Array.BYTES_PER_ELEMENT),
+        )
+
+        new Int32Array(buffer, 0, HEADER_LENGTH)[HEADER_CAPACITY] = capacity
+
+        const queue = new MesherJobQueue(buffer)
+        queue.slotHeapIndex.fill(NOT_QUEUED)
+
+        return queue
+    }
+
+    get capacity() {
+        return this.header[HEADER_CAPACITY]
+    }
+
+    get size() {
+        return Atomics.load(this.header, HEADER_SIZE)
+    }
+
+    /**
+     * Queues a mesh job for a slot, or updates the priority of an already queued job.
+     * Isolated jobs mesh the chunk as if all neighbour chunks were air.
+     * @returns the new version of the slot
+     */
+    push(slot: number, priority: number, mesher: VoxelsMesherType, isolated = false) {
+        this.lock()
+
+        const version = ++this.slotVersion[slot]
+        this.slotMesher[slot] = MESHER_TYPES.indexOf(mesher) | (isolated ? ISOLATED_BIT : 0)
+
+        const heapIndex = this.slotHeapIndex[slot]
+
+        if (heapIndex === NOT_QUEUED) {
+            const size = this.header[HEADER_SIZE]
+            this.header[HEADER_SIZE] = size + 1
+
+            this.heapSlot[size] = slot
+            this.heapPriority[size] = priority
+            this.slotHeapIndex[slot] = size
+
+            this.siftUp(size)
+        } else {
+            this.updatePriority(heapIndex, priority)
+        }
+
+        this.unlock()
+
+        return version
+    }
+
+    /**
+     * Updates the priority of a queued job, does nothing if the slot has no queued job.
+     */
+    setPriority(slot: number, priority: number) {
+        this.lock()
+
+        const heapIndex = this.slotHeapIndex[slot]
+
+        if (heapIndex !== NOT_QUEUED) {
+            this.updatePriority(heapIndex, priority)
+        }
+
+        this.unlock()
+    }
+
+    /**
+     * Removes the highest priority job.
+     * @returns the slot of the job, or -1 if the queue is empty
+     */
+    pop(): number {
+        this.lock()
+
+        const size = this.header[HEADER_SIZE]
+
+        if (size === 0) {
+            this.unlock()
+            return -1
+        }
+
+        const slot = this.heapSlot[0]
+        this.poppedPriority = this.heapPriority[0]
+        this.slotHeapIndex[slot] = NOT_QUEUED
+
+        const last = size - 1
+        this.header[HEADER_SIZE] = last
+
+        if (last > 0) {
+            this.move(last, 0)
+            this.siftDown(0)
+        }
+
+        this.unlock()
+
+        return slot
+    }
+
+    version(slot: number) {
+        return Atomics.load(this.slotVersion, slot)
+    }
+
+    mesher(slot: number): VoxelsMesherType {
+        return MESHER_TYPES[Atomics.load(this.slotMesher, slot) & ~ISOLATED_BIT] ?? 'culled'
+    }
+
+    isolated(slot: number) {
+        return (Atomics.load(this.slotMesher, slot) & ISOLATED_BIT) !== 0
+    }
+
+    clear() {
+        this.lock()
+
+        for (let i = 0; i < this.header[HEADER_SIZE]; i++) {
+            this.slotHeapIndex[this.heapSlot[i]] = NOT_QUEUED
+        }
+
+        this.header[HEADER_SIZE] = 0
+
+        this.unlock()
+    }
+
+    private lock() {
+        while (Atomics.compareExchange(this.header, HEADER_LOCK, 0, 1) !== 0) {
+            // spin
+        }
+    }
+
+    private unlock() {
+        Atomics.store(this.header, HEADER_LOCK, 0)
+    }
+
+    private updatePriority(heapIndex: number, priority: number) {
+        const previous = this.heapPriority[heapIndex]
+        this.heapPriority[heapIndex] = priority
+
+        if (priority > previous) {
+            this.siftUp(heapIndex)
+        } else if (priority < previous) {
+            this.siftDown(heapIndex)
+        }
+    }
+
+    private move(from: number, to: number) {
+        const slot = this.heapSlot[from]
+        this.heapSlot[to] = slot
+        this.heapPriority[to] = this.heapPriority[from]
+        this.slotHeapIndex[slot] = to
+    }
+
+    private siftUp(index: number) {
+        const slot = this.heapSlot[index]
+        const priority = this.heapPriority[index]
+
+        while (index > 0) {
+            const parent = (index - 1) >> 1
+
+            if (this.heapPriority[parent] >= priority) break
+
+            this.move(parent, index)
+            index = parent
+        }
+
+        this.heapSlot[index] = slot
+        this.heapPriority[index] = priority
+        this.slotHeapIndex[slot] = index
+    }
+
+    private siftDown(index: number) {
+        const size = this.header[HEADER_SIZE]
+        const slot = this.heapSlot[index]
+        const priority = this.heapPriority[index]
+
+        while (true) {
+            const left = index * 2 + 1
+
+            if (left >= size) break
+
+            const right = left + 1
+            const child = right < size && this.heapPriority[right] > this.heapPriority[left] ? right : left
+
+            if (this.heapPriority[child] <= priority) break
+
+            this.move(child, index)
+            index = child
+        }
+
+        this.heapSlot[index] = slot
+        this.heapPriority[index] = priority
+        this.slotHeapIndex[slot] = index
+    }
+}
@@ -0,0 +1,267 @@
+import * as THREE from 'three'
+import { CHUNK_BITS, CHUNK_SIZE, type Chunk, type World } from './world'
+
+export type RaycastBatchProps = {
+    /**
+     * Ray origins, xyz per ray
+     */
+    origins: Float32Array
+
+    /**
+     * Ray directions, xyz per ray, don't need to be normalized
+     */
+    directions: Float32Array
+
+    /**
+     * Number of rays to cast
+     * @default origins.length / 3
+     */
+    count?: number
+
+    maxDistance?: number
+
+    /**
+     * 1 per ray if the ray hit a solid voxel, otherwise 0
+     */
+    outHits: Uint8Array
+
+    /**
+     * Hit positions, xyz per ray
+     */
+    outHitPositions?: Float32Array
+
+    /**
+     * Normals of the voxel faces that were hit, xyz per ray
+     */
+    outHitNormals?: Float32Array
+
+    /**
+     * Distances along the normalized ray direction to the hit
+     */
+    outHitDistances?: Float32Array
+}
+
+const HIT_RESULT = { distance: 0, nx: 0, ny: 0, nz: 0 }
+
+const _chunkPosition = new THREE.Vector3()
+
+// axis of the face the last `boxExit` call exited through
+let exitAxis = 0
+
+/**
+ * @returns the ray distance at which the ray exits the box, and sets `exitAxis` to the axis of the exit face
+ */
+const boxExit = (
+    ox: number,
+    oy: number,
+    oz: number,
+    dx: number,
+    dy: number,
+    dz: number,
+    minX: number,
+    minY: number,
+    minZ: number,
+    maxX: number,
+    maxY: number,
+    maxZ: number,
+) => {
+    const tx = dx > 0 ? (maxX - ox) / dx : dx < 0 ? (minX - ox) / dx : Infinity
+    const ty = dy > 0 ? (maxY - oy) / dy : dy < 0 ? (minY - oy) / dy : Infinity
+    const tz = dz > 0 ? (maxZ - oz) / dz : dz < 0 ? (minZ - oz) / dz : Infinity
+
+    if (tx <= ty && tx <= tz) {
+        exitAxis = 0
+        return tx
+    }
+
+    if (ty <= tz) {
+        exitAxis = 1
+        return ty
+    }
+
+    exitAxis = 2
+    return tz
+}
+
+/**
+ * Hierarchical DDA over a voxel world.
+ *
+ * Steps voxel by voxel with a 3D DDA, but when the ray is in a chunk that doesn't exist, or a column of a chunk with no solid voxels,
+ * the ray jumps straight to where it exits that chunk or column.
+ */
+const traceRay = (world: World, ox: number, oy: number, oz: number, dx: number, dy: number, dz: number, maxDistance: number) => {
+    const stepX = dx > 0 ? 1 : dx < 0 ? -1 : 0
+    const stepY = dy > 0 ? 1 : dy < 0 ? -1 : 0
+    const stepZ = dz > 0 ? 1 : dz < 0 ? -1 : 0
+
+    const tDeltaX = stepX !== 0 ? Math.abs(1 / dx) : Infinity
+    const tDeltaY = stepY !== 0 ? Math.abs(1 / dy) : Infinity
+    const tDeltaZ = stepZ !== 0 ? Math.abs(1 / dz) : Infinity
+
+    let t = 0
+
+    let ix = Math.floor(ox)
+    let iy = Math.floor(oy)
+    let iz = Math.floor(oz)
+
+    // axis of the face the ray entered the current voxel through, -1 if the ray started in it
+    let enteredAxis = -1
+
+    let chunk: Chunk | undefined
+    let chunkX = 0
+    let chunkY = 0
+    let chunkZ = 0
+    let hasChunk = false
+
+    while (t <= maxDistance) {
+        /* init the DDA from the current voxel */
+        const px = ox + dx * t
+        const py = oy + dy * t
+        const pz = oz + dz * t
+
+        let tMaxX = stepX > 0 ? t + (ix + 1 - px) / dx : stepX < 0 ? t + (ix - px) / dx : Infinity
+        let tMaxY = stepY > 0 ? t + (iy + 1 - py) / dy : stepY < 0 ? t + (iy - py) / dy : Infinity
+        let tMaxZ = stepZ > 0 ? t + (iz + 1 - pz) / dz : stepZ < 0 ? t + (iz - pz) / dz : Infinity
+
+        let skip = false
+
+        while (t <= maxDistance) {
+            const cx = ix >> CHUNK_BITS
+            const cy = iy >> CHUNK_BITS
+            const cz = iz >> CHUNK_BITS
+
+            if (!hasChunk || cx !== chunkX || cy !== chunkY || cz !== chunkZ) {
+                chunk = world.getChunk(_chunkPosition.set(cx, cy, cz))
+                chunkX = cx
+                chunkY = cy
+                chunkZ = cz
+                hasChunk = true
+            }
+
+            /* skip air chunks */
+            if (!chunk) {
+                const minX = cx * CHUNK_SIZE
+                const minY = cy * CHUNK_SIZE
+                const minZ = cz * CHUNK_SIZE
+
+                t = boxExit(ox, oy, oz, dx, dy, dz, minX, minY, minZ, minX + CHUNK_SIZE, minY + CHUNK_SIZE, minZ + CHUNK_SIZE)
+                skip = true
+                break
+            }
+
+            /* skip empty columns */
+            const column = chunk.solid[(ix & (CHUNK_SIZE - 1)) + (iz & (CHUNK_SIZE - 1)) * CHUNK_SIZE]
+
+            if (column === 0) {
+                const minY = cy * CHUNK_SIZE
+
+                t = boxExit(ox, oy, oz, dx, dy, dz, ix, minY, iz, ix + 1, minY + CHUNK_SIZE, iz + 1)
+                skip = true
+                break
+            }
+
+            if ((column >>> (iy & (CHUNK_SIZE - 1))) & 1) {
+                HIT_RESULT.distance = t
+                HIT_RESULT.nx = enteredAxis === 0 ? -stepX : 0
+                HIT_RESULT.ny = enteredAxis === 1 ? -stepY : 0
+                HIT_RESULT.nz = enteredAxis === 2 ? -stepZ : 0
+
+                return true
+            }
+
+            /* step to the next voxel */
+            if (tMaxX < tMaxY && tMaxX < tMaxZ) {
+                ix += stepX
+                t = tMaxX
+                tMaxX += tDeltaX
+                enteredAxis = 0
+            } else if (tMaxY < tMaxZ) {
+                iy += stepY
+                t = tMaxY
+                tMaxY += tDeltaY
+                enteredAxis = 1
+            } else {
+                iz += stepZ
+                t = tMaxZ
+                tMaxZ += tDeltaZ
+                enteredAxis = 2
+            }
+        }
+
+        if (!skip) break
+
+        /* continue the DDA from the voxel the ray enters after the skipped box */
+        enteredAxis = exitAxis
+
+        ix = exitAxis === 0 ? Math.round(ox + dx * t) + (stepX > 0 ? 0 : -1) : Math.floor(ox + dx * t)
+        iy = exitAxis === 1 ? Math.round(oy + dy * t) + (stepY > 0 ? 0 : -1) : Math.floor(oy + dy * t)
+        iz = exitAxis === 2 ? Math.round(oz + dz * t) + (stepZ > 0 ? 0 : -1) : Math.floor(oz + dz * t)
+    }
+
+    return false
+}
+
+/**
+ * Casts many rays against a voxel world, writing results into the given output arrays.
+ *
+ * Doesn't allocate, and works on any `World`, including worker side worlds that look up chunks in a shared `ChunkDirectory`.
+ *
+ * @returns the number of rays that hit
+ */
+export const raycastBatch = (
+    world: World,
+    { origins, directions, count = origins.length / 3, maxDistance = 500, outHits, outHitPositions, outHitNormals, outHitDistances }: RaycastBatchProps,
+) => {
+    let hits = 0
+
+    for (let i = 0; i < count; i++) {
+        const i3 = i * 3
+
+        const ox = origins[i3]
+        const oy = origins[i3 + 1]
+        const oz = origins[i3 + 2]
+
+        let dx = directions[i3]
+        let dy = directions[i3 + 1]
+        let dz = directions[i3 + 2]
+
+        const ds = Math.sqrt(dx * dx + dy * dy + dz * dz)
+
+        if (ds === 0) {
+            outHits[i] = 0
+            continue
+        }
+
+        dx /= ds
+        dy /= ds
+        dz /= ds
+
+        const hit = traceRay(world, ox, oy, oz, dx, dy, dz, maxDistance)
+
+        outHits[i] = hit ? 1 : 0
+
+        if (!hit) continue
+
+        hits++
+
+        const { distance, nx, ny, nz } = HIT_RESULT
+
+        if (outHitPositions) {
+            outHitPositions[i3] = ox + dx * distance
+            outHitPositions[i3 + 1] = oy + dy * distance
+            outHitPositions[i3 + 2] = oz + dz * distance
+        }
+
+        if (outHitNormals) {
+            outHitNormals[i3] = nx
+            outHitNormals[i3 + 1] = ny
+            outHitNormals[i3 + 2] = nz
+        }
+
+        if (outHitDistances) {
+            outHitDistances[i] = distance
+        }
+    }
+
+    return hits
+}
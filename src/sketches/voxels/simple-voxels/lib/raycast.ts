@@ -1,6 +1,8 @@
 import * as THREE from 'three'
 import type { World } from './world'
 
+const _position = new THREE.Vector3()
+
 const traceRay = (
     world: World,
     origin: THREE.Vector3Like,
@@ -41,7 +43,7 @@ const traceRay = (
         fx = ox - ix
         fy = oy - iy
         fz = oz - iz
-        b = world.getSolid({ x: ix, y: iy, z: iz })
+        b = world.getSolid(_position.set(ix, iy, iz))
 
         if (b) {
             if (hitPosition) {
@@ -65,7 +67,7 @@ const traceRay = (
             ey = ny < 0 ? fy <= minStep : fy >= 1.0 - minStep
             ez = nz < 0 ? fz <= minStep : fz >= 1.0 - minStep
             if (ex && ey && ez) {
-                b = world.getSolid({ x: ix + nx, y: iy + ny, z: iz }) || world.getSolid({ x: ix, y: iy + ny, z: iz + nz }) || world.getSolid({ x: ix + nx, y: iy, z: iz + nz })
+                b = world.getSolid(_position.set(ix + nx, iy + ny, iz)) || world.getSolid(_position.set(ix, iy + ny, iz + nz)) || world.getSolid(_position.set(ix + nx, iy, iz + nz))
                 if (b) {
                     if (hitPosition) {
                         hitPosition.x = nx < 0 ? ix - epsilon : ix + 1.0 - epsilon
@@ -81,7 +83,7 @@ const traceRay = (
                 }
             }
             if (ex && (ey || ez)) {
-                b = world.getSolid({ x: ix + nx, y: iy, z: iz })
+                b = world.getSolid(_position.set(ix + nx, iy, iz))
                 if (b) {
                     if (hitPosition) {
                         hitPosition.x = nx < 0 ? ix - epsilon : ix + 1.0 - epsilon
@@ -97,7 +99,7 @@ const traceRay = (
                 }
             }
             if (ey && (ex || ez)) {
-                b = world.getSolid({ x: ix, y: iy + ny, z: iz })
+                b = world.getSolid(_position.set(ix, iy + ny, iz))
                 if (b) {
                     if (hitPosition) {
                         hitPosition.x = fx < epsilon ? +ix : ox
@@ -113,7 +115,7 @@ const traceRay = (
                 }
             }
             if (ez && (ex || ey)) {
-                b = world.getSolid({x: ix, y: iy, z: iz + nz })
+                b = world.getSolid(_position.set(ix, iy, iz + nz))
                 if (b) {
                     if (hitPosition) {
                         hitPosition.x = fx < epsilon ? +ix : ox
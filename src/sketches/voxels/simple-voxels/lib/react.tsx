@@ -2,6 +2,8 @@ import { useConst } from '@/common'
 import { ThreeElements, useFrame } from '@react-three/fiber'
 import { Fragment, createContext, forwardRef, useContext, useEffect, useImperativeHandle, useMemo, useState } from 'react'
 import * as THREE from 'three'
+import { ChunkBatches } from './chunk-batches'
+import { VoxelsMesherType } from './culled-mesher-worker-types'
 import { Voxels as VoxelsImpl, VoxelsWorkerPool } from './voxels'
 import { Chunk, getChunkBounds } from './world'
 
@@ -24,19 +26,41 @@ export const useVoxels = () => {
 export type VoxelsProps = {
     voxels?: VoxelsImpl
     voxelsWorkerPool?: VoxelsWorkerPool
+    mesher?: VoxelsMesherType
+
+    /**
+     * Distances from the actor, in voxels, beyond which chunks are shown at each lower level of detail
+     */
+    lodDistances?: number[]
+
+    /**
+     * Hide chunks that are behind solid terrain from the default camera
+     */
+    occlusionCulling?: boolean
+
     children: React.ReactNode
 }
 
 export type VoxelsRef = VoxelsImpl
 
 export const Voxels = forwardRef<VoxelsImpl, VoxelsProps>(
-    ({ voxels: existingVoxels, voxelsWorkerPool: existingVoxelsWorkerPool, children }, ref) => {
+    ({ voxels: existingVoxels, voxelsWorkerPool: existingVoxelsWorkerPool, mesher, lodDistances, occlusionCulling = false, children }, ref) => {
         const voxelsWorkerPool = useConst(() => existingVoxelsWorkerPool ?? new VoxelsWorkerPool())
 
-        const voxels = useConst(() => existingVoxels ?? new VoxelsImpl({ voxelsWorkerPool }))
+        const voxels = useConst(() => existingVoxels ?? new VoxelsImpl({ voxelsWorkerPool, mesher }))
 
         useImperativeHandle(ref, () => voxels, [voxels])
 
+        useEffect(() => {
+            if (!lodDistances) return
+
+            voxels.lodDistances = lodDistances
+        }, [lodDistances?.join()])
+
+        useEffect(() => {
+            voxels.occlusionCulling = occlusionCulling
+        }, [occlusionCulling])
+
         useEffect(() => {
             if (existingVoxelsWorkerPool) return
 
@@ -47,8 +71,9 @@ export const Voxels = forwardRef<VoxelsImpl, VoxelsProps>(
             }
         }, [])
 
-        useFrame(() => {
+        useFrame(({ camera }) => {
             voxels.update()
+            voxels.updateVisibility(camera)
         })
 
         const contextValue = useMemo(() => ({ voxels }), [voxels])
@@ -69,45 +94,154 @@ const ChunkHelper = ({ chunk }: ChunkHelperProps) => {
 
 type VoxelChunkMeshesProps = {
     chunkHelper?: boolean
+
+    /**
+     * Draw full resolution chunks with a few multi draw batches instead of a mesh per chunk
+     */
+    batched?: boolean
 } & ThreeElements['group']
 
-export const VoxelChunkMeshes = ({ chunkHelper = false, ...groupProps }: VoxelChunkMeshesProps) => {
+export const VoxelChunkMeshes = ({ batched = false, ...props }: VoxelChunkMeshesProps) => {
+    if (batched) return <BatchedVoxelChunkMeshes {...props} />
+
+    return <SeparateVoxelChunkMeshes {...props} />
+}
+
+const BatchedVoxelChunkMeshes = ({ chunkHelper = false, ...groupProps }: VoxelChunkMeshesProps) => {
+    const { voxels } = useVoxels()
+
+    const batches = useConst(() => new ChunkBatches())
+
+    type LodMesh = { key: string; mesh: THREE.Mesh }
+
+    const [lodMeshes, setLodMeshes] = useState<LodMesh[]>([])
+    const [chunks, setChunks] = useState<Chunk[]>([])
+
+    useEffect(() => {
+        const initialChunks: Chunk[] = []
+
+        for (const chunk of voxels.world.chunks.values()) {
+            const { mesh, initialised } = voxels.chunkMeshes.get(chunk.id) ?? {}
+
+            if (!mesh || !initialised) continue
+
+            mesh.updateMatrix()
+            batches.update(chunk.id, mesh.geometry, mesh.matrix)
+            initialChunks.push(chunk)
+        }
+
+        setChunks(initialChunks)
+
+        const initialLodMeshes: LodMesh[] = []
+
+        for (const { level, nodes } of voxels.lodLevels) {
+            for (const { chunk, mesh, initialised } of nodes.values()) {
+                if (!initialised) continue
+
+                initialLodMeshes.push({ key: `${level}:${chunk.id}`, mesh })
+            }
+        }
+
+        setLodMeshes(initialLodMeshes)
+
+        const unsubOnChunkMeshInitialised = voxels.onChunkMeshInitialised.add((chunk) => {
+            setChunks((prev) => [...prev, chunk])
+        })
+
+        const unsubOnChunkMeshUpdated = voxels.onChunkMeshUpdated.add((chunk, mesh) => {
+            mesh.updateMatrix()
+            batches.update(chunk.id, mesh.geometry, mesh.matrix)
+        })
+
+        const unsubOnLodMeshInitialised = voxels.onLodMeshInitialised.add((level, chunk, mesh) => {
+            setLodMeshes((prev) => [...prev, { key: `${level}:${chunk.id}`, mesh }])
+        })
+
+        return () => {
+            setChunks([])
+            setLodMeshes([])
+
+            unsubOnChunkMeshInitialised()
+            unsubOnChunkMeshUpdated()
+            unsubOnLodMeshInitialised()
+
+            batches.dispose()
+        }
+    }, [])
+
+    useFrame(() => {
+        for (const chunk of voxels.world.chunks.values()) {
+            const chunkMesh = voxels.chunkMeshes.get(chunk.id)
+
+            if (!chunkMesh || !chunkMesh.initialised) continue
+
+            batches.setVisible(chunk.id, chunkMesh.mesh.visible)
+        }
+    })
+
+    return (
+        <group {...groupProps}>
+            <primitive object={batches.group} />
+
+            {lodMeshes.map(({ key, mesh }) => (
+                <primitive key={key} object={mesh} />
+            ))}
+
+            {chunkHelper && chunks.map((chunk) => <ChunkHelper key={chunk.id} chunk={chunk} />)}
+        </group>
+    )
+}
+
+const SeparateVoxelChunkMeshes = ({ chunkHelper = false, ...groupProps }: VoxelChunkMeshesProps) => {
     const { voxels } = useVoxels()
 
-    type ChunkAndMesh = { chunk: Chunk; mesh: THREE.Mesh }
+    type ChunkAndMesh = { key: string; level: number; chunk: Chunk; mesh: THREE.Mesh }
 
     const [meshes, setMeshes] = useState<ChunkAndMesh[]>([])
 
     useEffect(() => {
         const meshes: ChunkAndMesh[] = []
 
-        for (const [, chunk] of voxels.world.chunks) {
+        for (const chunk of voxels.world.chunks.values()) {
             const { mesh, initialised } = voxels.chunkMeshes.get(chunk.id) ?? {}
 
             if (!mesh || !initialised) continue
 
-            meshes.push({ chunk, mesh })
+            meshes.push({ key: `0:${chunk.id}`, level: 0, chunk, mesh })
+        }
+
+        for (const { level, nodes } of voxels.lodLevels) {
+            for (const { chunk, mesh, initialised } of nodes.values()) {
+                if (!initialised) continue
+
+                meshes.push({ key: `${level}:${chunk.id}`, level, chunk, mesh })
+            }
         }
 
         setMeshes(meshes)
 
         const unsubOnChunkMeshInitialised = voxels.onChunkMeshInitialised.add((chunk, mesh) => {
-            setMeshes((prev) => [...prev, { chunk, mesh }])
+            setMeshes((prev) => [...prev, { key: `0:${chunk.id}`, level: 0, chunk, mesh }])
+        })
+
+        const unsubOnLodMeshInitialised = voxels.onLodMeshInitialised.add((level, chunk, mesh) => {
+            setMeshes((prev) => [...prev, { key: `${level}:${chunk.id}`, level, chunk, mesh }])
         })
 
         return () => {
             setMeshes([])
 
             unsubOnChunkMeshInitialised()
+            unsubOnLodMeshInitialised()
         }
     }, [])
 
     return (
         <group {...groupProps}>
-            {meshes.map(({ chunk, mesh }) => (
-                <Fragment key={chunk.id}>
+            {meshes.map(({ key, level, chunk, mesh }) => (
+                <Fragment key={key}>
                     <primitive object={mesh} />
-                    {chunkHelper && <ChunkHelper chunk={chunk} />}
+                    {chunkHelper && level === 0 && <ChunkHelper chunk={chunk} />}
                 </Fragment>
             ))}
         </group>
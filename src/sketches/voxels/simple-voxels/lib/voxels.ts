@@ -1,15 +1,24 @@
+import { recordBenchmarkTime } from '@/common/utils/benchmark'
+import { SpatialHashMap, unpackSpatialHashKeyX, unpackSpatialHashKeyY, unpackSpatialHashKeyZ } from '@/common/utils/spatial-hash'
+import { getTraceBuffer, traceCounter } from '@/common/utils/tracing'
 import { Topic } from 'arancini/events'
 import * as THREE from 'three'
+import { ChunkDirectory } from './chunk-directory'
 import { ChunkGeometry } from './chunk-geometry'
+import { CHUNK_CONNECTIVITY_ALL, ChunkVisibilityCuller } from './chunk-visibility'
 import { chunkMaterial } from './chunk-material'
 import {
     ChunkMeshUpdateResultMessage,
     CulledMesherWorkerMessageType,
-    RegisterChunkMessage,
-    RequestChunkMeshUpdateMessage,
+    AddChunkPagesMessage,
+    InitMessage,
+    ProcessChunkMeshJobsMessage,
+    VoxelsMesherType,
     WorkerMessage,
 } from './culled-mesher-worker-types'
 import CulledMesherWorker from './culled-mesher.worker?worker'
+import { VoxelsLodLevel, downsampleChunk } from './lod'
+import { MesherJobQueue } from './mesher-job-queue'
 import { BlockValue, CHUNK_SIZE, Chunk, World, worldPositionToChunkLocalPosition, worldPositionToChunkPosition } from './world'
 
 const _vector3 = new THREE.Vector3()
@@ -17,6 +26,9 @@ const _vector3 = new THREE.Vector3()
 const _chunkLocal = new THREE.Vector3()
 const _neighbourPosition = new THREE.Vector3()
 const _neighbourChunk = new THREE.Vector3()
+const _lodNodePosition = new THREE.Vector3()
+const _lodNodeCentre = new THREE.Vector3()
+const _lodSourcePosition = new THREE.Vector3()
 
 const neighbourDirections = [
     { x: -1, y: 0, z: 0 },
@@ -35,58 +47,101 @@ type ChunkState = {
 type ChunkMesh = {
     initialised: boolean
     mesh: THREE.Mesh<ChunkGeometry, THREE.Material>
+
+    /**
+     * Which pairs of chunk faces are connected by air, from the last mesher result
+     */
+    connectivity: number
 }
 
 export type VoxelsChange = { position: THREE.Vector3Like; value: BlockValue; chunk: Chunk }
 
 export type VoxelsWorkerPoolParams = {
     workerPoolSize?: number
+
+    /**
+     * The maximum number of chunks that can be allocated in the pool chunk directory, across all worlds
+     * @default 131072
+     */
+    maxChunks?: number
 }
 
+/**
+ * Meshes chunks in a pool of workers.
+ *
+ * Chunks of all worlds using the pool are allocated in a shared chunk directory, which workers look up chunks in lazily.
+ * New directory pages are sent to workers once per frame.
+ *
+ * Mesh jobs are queued in a shared priority queue that all workers pull from, highest priority first.
+ * Remeshing a chunk that is already queued updates the queued job, and results made stale by a newer edit are dropped by the worker.
+ */
 export class VoxelsWorkerPool {
+    chunkDirectory: ChunkDirectory
+
     private workers: InstanceType<typeof CulledMesherWorker>[] = []
-    private workerRoundRobin = 0
-    private pendingMeshUpdates: Map<string, number> = new Map()
     private workerPoolSize: number
 
+    private jobQueue: MesherJobQueue
+    private sentChunkPages = 0
+
     constructor(params?: VoxelsWorkerPoolParams) {
+        const maxChunks = params?.maxChunks ?? 131072
+
         this.workerPoolSize = params?.workerPoolSize ?? 3
+        this.chunkDirectory = ChunkDirectory.create(maxChunks)
+        this.jobQueue = MesherJobQueue.create(maxChunks)
     }
 
     onMesherResult = new Topic<[ChunkMeshUpdateResultMessage]>()
 
-    remesh(world: World, chunkId: string) {
-        const data: RequestChunkMeshUpdateMessage = {
-            type: CulledMesherWorkerMessageType.REQUEST_CHUNK_MESH_UPDATE,
-            worldId: world.id,
-            chunkId,
-        }
+    /**
+     * Queues a mesh job for a chunk. Isolated jobs mesh the chunk as if all neighbour chunks were air.
+     */
+    remesh(world: World, chunk: Chunk, priority = 0, mesher: VoxelsMesherType = 'culled', isolated = false) {
+        const slot = this.chunkDirectory.find(world.id, chunk.id)
 
-        const jobId = VoxelsWorkerPool.jobId(world.id, chunkId)
-        const workerWithPendingMeshUpdate = this.pendingMeshUpdates.get(jobId)
+        if (slot === -1) return
 
-        if (workerWithPendingMeshUpdate) {
-            this.workers[workerWithPendingMeshUpdate].postMessage(data)
-            return
-        }
+        this.jobQueue.push(slot, priority, mesher, isolated)
+    }
 
-        const workerIndex = this.workerRoundRobin
-        const worker = this.workers[workerIndex]
-        this.pendingMeshUpdates.set(jobId, workerIndex)
+    /**
+     * Updates the priority of a chunk's queued mesh job, if it has one
+     */
+    setPriority(world: World, chunk: Chunk, priority: number) {
+        const slot = this.chunkDirectory.find(world.id, chunk.id)
 
-        worker.postMessage(data)
+        if (slot === -1) return
 
-        this.workerRoundRobin = (this.workerRoundRobin + 1) % this.workers.length
+        this.jobQueue.setPriority(slot, priority)
     }
 
-    registerChunk(world: World, chunk: Chunk) {
-        const data: RegisterChunkMessage = {
-            type: CulledMesherWorkerMessageType.REGISTER_CHUNK,
-            worldId: world.id,
-            chunkId: chunk.id,
-            position: chunk.position.toArray(),
-            solidBuffer: chunk.solidBuffer,
-            colorBuffer: chunk.colorBuffer,
+    /**
+     * Sends new chunk directory pages to workers, and wakes workers to process queued mesh jobs.
+     * Called once per frame after all jobs for the frame have been queued, woken workers drain the shared queue until it is empty.
+     */
+    flush() {
+        const pages = this.chunkDirectory.pages
+
+        if (this.sentChunkPages < pages.length) {
+            const data: AddChunkPagesMessage = {
+                type: CulledMesherWorkerMessageType.ADD_CHUNK_PAGES,
+                pages: pages.slice(this.sentChunkPages),
+            }
+
+            for (const worker of this.workers) {
+                worker.postMessage(data)
+            }
+
+            this.sentChunkPages = pages.length
+        }
+
+        traceCounter('voxels-mesher-queue-depth', this.jobQueue.size)
+
+        if (this.jobQueue.size === 0) return
+
+        const data: ProcessChunkMeshJobsMessage = {
+            type: CulledMesherWorkerMessageType.PROCESS_CHUNK_MESH_JOBS,
         }
 
         for (const worker of this.workers) {
@@ -95,6 +150,16 @@ export class VoxelsWorkerPool {
     }
 
     connect() {
+        const init: InitMessage = {
+            type: CulledMesherWorkerMessageType.INIT,
+            jobQueueBuffer: this.jobQueue.buffer,
+            chunkDirectoryIndexBuffer: this.chunkDirectory.indexBuffer,
+            chunkDirectoryPages: [...this.chunkDirectory.pages],
+            traceBuffer: getTraceBuffer()?.buffer ?? null,
+        }
+
+        this.sentChunkPages = init.chunkDirectoryPages.length
+
         /* create workers */
         for (let i = 0; i < this.workerPoolSize; i++) {
             const worker = new CulledMesherWorker()
@@ -102,18 +167,20 @@ export class VoxelsWorkerPool {
             worker.onmessage = (e) => {
                 const { data: message } = e as { data: WorkerMessage }
                 if (message.type === CulledMesherWorkerMessageType.CHUNK_MESH_UPDATE_RESULT) {
+                    recordBenchmarkTime('voxels-mesher-job', message.meshTime)
+
                     this.onMesherResult.emit(message)
-                    this.pendingMeshUpdates.delete(VoxelsWorkerPool.jobId(message.worldId, message.chunkId))
                 }
             }
 
+            worker.postMessage(init)
+
             this.workers.push(worker)
         }
     }
 
     disconnect() {
-        this.workerRoundRobin = 0
-        this.pendingMeshUpdates.clear()
+        this.jobQueue.clear()
 
         for (const worker of this.workers) {
             worker.terminate()
@@ -121,14 +188,17 @@ export class VoxelsWorkerPool {
 
         this.workers = []
     }
-
-    static jobId(worldId: number, chunkId: string) {
-        return `${worldId}:${chunkId}`
-    }
 }
 
 type VoxelsParams = {
     voxelsWorkerPool: VoxelsWorkerPool
+
+    /**
+     * 'culled' creates a quad per visible voxel face.
+     * 'greedy' merges coplanar faces with the same color and ambient occlusion into larger quads.
+     * @default 'culled'
+     */
+    mesher?: VoxelsMesherType
 }
 
 export class Voxels {
@@ -136,34 +206,74 @@ export class Voxels {
 
     viewDistance = 500
 
+    mesher: VoxelsMesherType
+
     get chunkViewDistance() {
         return Math.ceil(this.viewDistance / CHUNK_SIZE)
     }
 
-    world = new World()
+    /**
+     * Distances from the actor, in voxels, beyond which chunks are shown at each lower level of detail.
+     * Level n + 1 merges 2x2x2 nodes of level n, so `lodDistances[0]` is where chunks switch from full resolution to half resolution.
+     * Empty to always show chunks at full resolution.
+     */
+    lodDistances: number[] = []
+
+    lodLevels: VoxelsLodLevel[] = []
+
+    /**
+     * Hide chunks that are behind solid terrain, see `updateVisibility`
+     */
+    occlusionCulling = false
+
+    /**
+     * Inclusive bounds of all chunks, in chunk coordinates
+     */
+    chunkBounds = new THREE.Box3()
+
+    private chunkVisibilityCuller = new ChunkVisibilityCuller()
+
+    world: World
 
     onUpdate = new Topic<[changes: VoxelsChange[]]>()
 
     onChunkMeshInitialised = new Topic<[chunk: Chunk, mesh: THREE.Mesh<ChunkGeometry, THREE.Material>]>()
     onChunkMeshUpdated = new Topic<[chunk: Chunk, mesh: THREE.Mesh<ChunkGeometry, THREE.Material>]>()
 
-    chunkState = new Map<string, ChunkState>()
-    chunkMeshes = new Map<string, ChunkMesh>()
+    /**
+     * Emitted when whole chunks are added with `addChunkPage`, which doesn't emit `onUpdate`
+     */
+    onChunksAdded = new Topic<[chunks: Chunk[]]>()
+
+    onLodMeshInitialised = new Topic<[level: number, node: Chunk, mesh: THREE.Mesh<ChunkGeometry, THREE.Material>]>()
+
+    chunkState = new SpatialHashMap<ChunkState>()
+    chunkMeshes = new SpatialHashMap<ChunkMesh>()
 
-    private dirtyChunks = new Set<string>()
-    private dirtyUnloadedChunks = new Set<string>()
+    private dirtyChunks = new Set<number>()
+    private dirtyUnloadedChunks = new Set<number>()
 
     private setBlockRequests: { position: THREE.Vector3Like; value: BlockValue }[] = []
 
     private voxelsWorkerPool: VoxelsWorkerPool
 
-    constructor({ voxelsWorkerPool }: VoxelsParams) {
+    constructor({ voxelsWorkerPool, mesher = 'culled' }: VoxelsParams) {
         this.voxelsWorkerPool = voxelsWorkerPool
+        this.mesher = mesher
+
+        this.world = new World({ directory: voxelsWorkerPool.chunkDirectory })
 
         this.voxelsWorkerPool.onMesherResult.add((message) => {
-            if (message.worldId !== this.world.id) return
+            if (message.worldId === this.world.id) {
+                this.processMesherResult(message)
+                return
+            }
 
-            this.processMesherResult(message)
+            const lodLevel = this.lodLevels.find((lodLevel) => lodLevel.world.id === message.worldId)
+
+            if (lodLevel) {
+                this.processLodMesherResult(lodLevel, message)
+            }
         })
 
         this.world.onChunkCreated.add((chunk) => {
@@ -173,26 +283,77 @@ export class Voxels {
             const mesh = {
                 initialised: false,
                 mesh: new THREE.Mesh(new ChunkGeometry(), chunkMaterial),
+                connectivity: CHUNK_CONNECTIVITY_ALL,
             }
             this.chunkMeshes.set(chunk.id, mesh)
 
             this.dirtyChunks.add(chunk.id)
 
-            /* register chunk with mesher workers */
-            this.voxelsWorkerPool.registerChunk(this.world, chunk)
+            this.chunkBounds.expandByPoint(chunk.position)
         })
     }
 
     update() {
         const changes = this.processBlockChanges()
+        this.updateLodNodes(changes)
         this.updateChunkStates()
         this.createMesherJobs(changes)
     }
 
+    /**
+     * Hides loaded chunks that can't be seen from the camera, if `occlusionCulling` is enabled.
+     * Call after `update`. Pass the voxel world's world matrix if the voxel world is transformed.
+     */
+    updateVisibility(camera: THREE.Camera, worldMatrix?: THREE.Matrix4) {
+        if (!this.occlusionCulling) return
+
+        const culled = this.chunkVisibilityCuller.update(
+            camera,
+            this.chunkBounds,
+            this.chunkViewDistance,
+            (chunkId) => this.chunkMeshes.get(chunkId)?.connectivity ?? CHUNK_CONNECTIVITY_ALL,
+            worldMatrix,
+        )
+
+        if (!culled) return
+
+        const visible = this.chunkVisibilityCuller.visible
+
+        for (const chunk of this.world.chunks.values()) {
+            const chunkMesh = this.chunkMeshes.get(chunk.id)!
+
+            chunkMesh.mesh.visible = this.chunkState.get(chunk.id)!.loaded && visible.has(chunk.id)
+        }
+    }
+
     setBlock({ x, y, z }: THREE.Vector3Like, value: BlockValue) {
         this.setBlockRequests.push({ position: { x, y, z }, value })
     }
 
+    /**
+     * Adds a page of decoded chunks to the world without copying, see `World.addChunkPage`.
+     * The chunks and their neighbours are remeshed on the next update.
+     */
+    addChunkPage(page: SharedArrayBuffer, chunkIds: ArrayLike<number>, count: number) {
+        const chunks = this.world.addChunkPage(page, chunkIds, count)
+
+        for (const chunk of chunks) {
+            const { x, y, z } = chunk.position
+
+            this.dirtyChunks.add(chunk.id)
+
+            for (const { x: dx, y: dy, z: dz } of neighbourDirections) {
+                this.dirtyChunks.add(Chunk.id(_neighbourChunk.set(x + dx, y + dy, z + dz)))
+            }
+
+            this.lodLevels[0]?.dirtyNodes.add(Chunk.id(_lodNodePosition.set(x >> 1, y >> 1, z >> 1)))
+        }
+
+        this.onChunksAdded.emit(chunks)
+
+        return chunks
+    }
+
     private processBlockChanges(): VoxelsChange[] {
         const changes: VoxelsChange[] = []
 
@@ -212,15 +373,117 @@ export class Voxels {
         return changes
     }
 
+    /**
+     * Downsamples changed chunks into each level of detail, from the highest resolution level to the lowest
+     */
+    private updateLodNodes(changes: VoxelsChange[]) {
+        /* create levels when lod distances are added, and downsample everything into them */
+        while (this.lodLevels.length < this.lodDistances.length) {
+            const lodLevel = new VoxelsLodLevel(this.lodLevels.length + 1, this.voxelsWorkerPool.chunkDirectory)
+
+            const sourceWorld = this.lodLevels.length === 0 ? this.world : this.lodLevels[this.lodLevels.length - 1].world
+
+            for (const source of sourceWorld.chunks.values()) {
+                lodLevel.dirtyNodes.add(Chunk.id(_lodNodePosition.set(source.position.x >> 1, source.position.y >> 1, source.position.z >> 1)))
+            }
+
+            this.lodLevels.push(lodLevel)
+        }
+
+        if (this.lodLevels.length === 0) return
+
+        for (const { chunk } of changes) {
+            const { x, y, z } = chunk.position
+
+            this.lodLevels[0].dirtyNodes.add(Chunk.id(_lodNodePosition.set(x >> 1, y >> 1, z >> 1)))
+        }
+
+        for (let i = 0; i < this.lodLevels.length; i++) {
+            const lodLevel = this.lodLevels[i]
+            const parent = this.lodLevels[i + 1]
+            const sourceWorld = i === 0 ? this.world : this.lodLevels[i - 1].world
+
+            if (lodLevel.dirtyNodes.size === 0) continue
+
+            for (const nodeId of lodLevel.dirtyNodes) {
+                const nodePosition = _lodNodePosition.set(
+                    unpackSpatialHashKeyX(nodeId),
+                    unpackSpatialHashKeyY(nodeId),
+                    unpackSpatialHashKeyZ(nodeId),
+                )
+
+                const node = lodLevel.world.getOrCreateChunk(nodePosition)
+
+                for (let octant = 0; octant < 8; octant++) {
+                    const octantX = octant & 1
+                    const octantY = (octant >> 1) & 1
+                    const octantZ = (octant >> 2) & 1
+
+                    const sourcePosition = _lodSourcePosition.set(
+                        nodePosition.x * 2 + octantX,
+                        nodePosition.y * 2 + octantY,
+                        nodePosition.z * 2 + octantZ,
+                    )
+
+                    const source = sourceWorld.chunks.get(Chunk.id(sourcePosition))
+
+                    downsampleChunk(source, node, octantX, octantY, octantZ)
+                }
+
+                lodLevel.dirtyMeshes.add(nodeId)
+
+                parent?.dirtyNodes.add(Chunk.id(nodePosition.set(nodePosition.x >> 1, nodePosition.y >> 1, nodePosition.z >> 1)))
+            }
+
+            lodLevel.dirtyNodes.clear()
+        }
+    }
+
+    /**
+     * @returns the level of detail a chunk should be shown at, 0 for full resolution
+     *
+     * A chunk is shown at the lowest level of detail whose node containing the chunk is beyond that level's distance.
+     * This only depends on the nodes, so all chunks in a node always agree on whether the node is shown.
+     */
+    private getChunkLodLevel(chunkPosition: THREE.Vector3Like, actorChunkPosition: THREE.Vector3) {
+        const levels = Math.min(this.lodDistances.length, this.lodLevels.length)
+
+        for (let level = levels; level > 0; level--) {
+            const nodeSize = 1 << level
+
+            const nodeCentre = _lodNodeCentre.set(
+                ((chunkPosition.x >> level) + 0.5) * nodeSize,
+                ((chunkPosition.y >> level) + 0.5) * nodeSize,
+                ((chunkPosition.z >> level) + 0.5) * nodeSize,
+            )
+
+            if (nodeCentre.distanceTo(actorChunkPosition) * CHUNK_SIZE >= this.lodDistances[level - 1]) {
+                return level
+            }
+        }
+
+        return 0
+    }
+
     private updateChunkStates() {
-        for (const [, chunk] of this.world.chunks) {
-            const playerCurrentChunk = worldPositionToChunkPosition(this.actor, _vector3)
+        const playerCurrentChunk = worldPositionToChunkPosition(this.actor, _vector3)
 
+        for (const chunk of this.world.chunks.values()) {
             const chunkDistance = playerCurrentChunk.distanceTo(chunk.position)
 
             const chunkState = this.chunkState.get(chunk.id)!
 
-            const shouldBeLoaded = chunkDistance <= this.chunkViewDistance
+            const inViewDistance = chunkDistance <= this.chunkViewDistance
+            const lodLevel = this.lodLevels.length > 0 ? this.getChunkLodLevel(chunk.position, playerCurrentChunk) : 0
+
+            if (inViewDistance && lodLevel > 0) {
+                const { x, y, z } = chunk.position
+
+                this.lodLevels[lodLevel - 1].shownNodes.add(Chunk.id(_lodNodePosition.set(x >> lodLevel, y >> lodLevel, z >> lodLevel)))
+            }
+
+            // chunks shown at a lower level of detail are not meshed at full resolution
+            const shouldBeLoaded = inViewDistance && lodLevel === 0
             const loaded = chunkState.loaded
 
             if (shouldBeLoaded && !loaded) {
@@ -237,7 +500,48 @@ export class Voxels {
             const chunkMesh = this.chunkMeshes.get(chunk.id)!
             chunkMesh.mesh.visible = chunkState.loaded
 
-            chunkState.priority = -chunkDistance
+            const priority = -chunkDistance
+
+            if (chunkState.priority !== priority) {
+                chunkState.priority = priority
+
+                // keep queued mesh jobs ordered by distance as the actor moves
+                this.voxelsWorkerPool.setPriority(this.world, chunk, priority)
+            }
+        }
+
+        for (const lodLevel of this.lodLevels) {
+            const nodeSize = lodLevel.nodeSize
+
+            for (const node of lodLevel.nodes.values()) {
+                const shouldBeLoaded = lodLevel.shownNodes.has(node.chunk.id)
+
+                if (shouldBeLoaded && !node.loaded) {
+                    node.loaded = true
+
+                    if (lodLevel.dirtyUnloadedMeshes.has(node.chunk.id)) {
+                        lodLevel.dirtyMeshes.add(node.chunk.id)
+                        lodLevel.dirtyUnloadedMeshes.delete(node.chunk.id)
+                    }
+                } else if (!shouldBeLoaded && node.loaded) {
+                    node.loaded = false
+                }
+
+                node.mesh.visible = node.loaded
+
+                const { x, y, z } = node.chunk.position
+                const nodeCentre = _lodNodeCentre.set((x + 0.5) * nodeSize, (y + 0.5) * nodeSize, (z + 0.5) * nodeSize)
+
+                const priority = -nodeCentre.distanceTo(playerCurrentChunk)
+
+                if (node.priority !== priority) {
+                    node.priority = priority
+
+                    this.voxelsWorkerPool.setPriority(lodLevel.world, node.chunk, priority)
+                }
+            }
+
+            lodLevel.shownNodes.clear()
         }
     }
 
@@ -291,7 +595,7 @@ export class Voxels {
             }
         }
 
-        const toRemesh: string[] = []
+        const toRemesh: number[] = []
 
         const dirty = Array.from(this.dirtyChunks)
         this.dirtyChunks.clear()
@@ -309,16 +613,34 @@ export class Voxels {
             }
         }
 
-        const prioritised = toRemesh.sort((a, b) => {
-            const aState = this.chunkState.get(a)!
-            const bState = this.chunkState.get(b)!
+        // the worker pool job queue orders jobs by priority
+        for (const chunkId of toRemesh) {
+            const chunk = this.world.chunks.get(chunkId)!
 
-            return bState.priority - aState.priority
-        })
+            this.voxelsWorkerPool.remesh(this.world, chunk, this.chunkState.get(chunkId)!.priority, this.mesher)
+        }
+
+        // lod nodes are meshed in isolation, so the faces on node borders are always present and
+        // there are no cracks where a node meets chunks or nodes at other levels of detail
+        for (const lodLevel of this.lodLevels) {
+            if (lodLevel.dirtyMeshes.size === 0) continue
+
+            for (const nodeId of lodLevel.dirtyMeshes) {
+                const node = lodLevel.nodes.get(nodeId)
 
-        for (const chunkId of prioritised) {
-            this.voxelsWorkerPool.remesh(this.world, chunkId)
+                if (!node) continue
+
+                if (node.loaded) {
+                    this.voxelsWorkerPool.remesh(lodLevel.world, node.chunk, node.priority, this.mesher, true)
+                } else {
+                    lodLevel.dirtyUnloadedMeshes.add(nodeId)
+                }
+            }
+
+            lodLevel.dirtyMeshes.clear()
         }
+
+        this.voxelsWorkerPool.flush()
     }
 
     private processMesherResult(chunkMesherData: ChunkMeshUpdateResultMessage) {
@@ -333,6 +655,8 @@ export class Voxels {
 
         geometry.updateChunk(chunkMesherData)
 
+        chunkMesh.connectivity = chunkMesherData.connectivity
+
         chunkMesh.mesh.position.set(chunk.position.x * CHUNK_SIZE, chunk.position.y * CHUNK_SIZE, chunk.position.z * CHUNK_SIZE)
 
         if (!chunkMesh.initialised) {
@@ -343,4 +667,24 @@ export class Voxels {
 
         this.onChunkMeshUpdated.emit(chunk, chunkMesh.mesh)
     }
+
+    private processLodMesherResult(lodLevel: VoxelsLodLevel, chunkMesherData: ChunkMeshUpdateResultMessage) {
+        const node = lodLevel.nodes.get(chunkMesherData.chunkId)
+
+        if (!node) return
+
+        node.mesh.geometry.updateChunk(chunkMesherData)
+
+        const nodeSize = lodLevel.nodeSize
+        const { x, y, z } = node.chunk.position
+
+        node.mesh.position.set(x * CHUNK_SIZE * nodeSize, y * CHUNK_SIZE * nodeSize, z * CHUNK_SIZE * nodeSize)
+        node.mesh.scale.setScalar(nodeSize)
+
+        if (!node.initialised) {
+            node.initialised = true
+
+            this.onLodMeshInitialised.emit(lodLevel.level, node.chunk, node.mesh)
+        }
+    }
 }
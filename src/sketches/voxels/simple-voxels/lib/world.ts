@@ -1,6 +1,9 @@
 import * as THREE from 'three'
 import { Topic } from 'arancini/events'
+import { SpatialHashMap, packSpatialHashKey } from '@/common/utils/spatial-hash'
+import type { ChunkDirectory } from './chunk-directory'
 import { RaycastResult, raycast } from './raycast'
+import { RaycastBatchProps, raycastBatch } from './raycast-batch'
 
 export const CHUNK_BITS = 4
 export const CHUNK_SIZE = Math.pow(2, CHUNK_BITS)
@@ -33,22 +36,18 @@ export const getChunkBounds = (chunk: Chunk): THREE.Box3 => {
 }
 
 export class Chunk {
-    id: string
+    id: number
     position: THREE.Vector3
 
     solid: Uint16Array
-    solidBuffer: SharedArrayBuffer
 
     color: Uint32Array
-    colorBuffer: SharedArrayBuffer
 
-    constructor(id: string, position: THREE.Vector3, solidBuffer: SharedArrayBuffer, colorBuffer: SharedArrayBuffer) {
+    constructor(id: number, position: THREE.Vector3, solid: Uint16Array, color: Uint32Array) {
         this.id = id
         this.position = position
-        this.solidBuffer = solidBuffer
-        this.solid = new Uint16Array(solidBuffer)
-        this.colorBuffer = colorBuffer
-        this.color = new Uint32Array(colorBuffer)
+        this.solid = solid
+        this.color = color
     }
 
     setBlock(chunkLocalPosition: THREE.Vector3Like, value: BlockValue) {
@@ -95,8 +94,11 @@ export class Chunk {
         return chunkLocalPosition.x + chunkLocalPosition.z * CHUNK_SIZE + chunkLocalPosition.y * CHUNK_SIZE * CHUNK_SIZE
     }
 
-    static id({ x, y, z }: THREE.Vector3Like): string {
-        return `${x},${y},${z}`
+    /**
+     * Packs a chunk position into an integer key, chunk positions must be in the range [-512, 511] on each axis
+     */
+    static id({ x, y, z }: THREE.Vector3Like): number {
+        return packSpatialHashKey(x, y, z)
     }
 }
 
@@ -112,15 +114,47 @@ export type RaycastProps = {
 
 let worldId = 0
 
+export type WorldParams = {
+    id?: number
+
+    /**
+     * Shared chunk directory to allocate chunks in, and to lazily look up chunks that are not yet in `chunks`
+     */
+    directory?: ChunkDirectory
+}
+
 export class World {
-    id = worldId++
-    
-    chunks = new Map<string, Chunk>()
+    id: number
+
+    chunks = new SpatialHashMap<Chunk>()
+
+    directory?: ChunkDirectory
 
     onChunkCreated = new Topic<[chunk: Chunk]>()
 
+    constructor({ id = worldId++, directory }: WorldParams = {}) {
+        this.id = id
+        this.directory = directory
+    }
+
+    getChunk(chunkPosition: THREE.Vector3Like): Chunk | undefined {
+        const id = Chunk.id(chunkPosition)
+
+        let chunk = this.chunks.get(id)
+
+        if (!chunk && this.directory) {
+            chunk = this.directory.getChunk(this.directory.find(this.id, id))
+
+            if (chunk) {
+                this.chunks.set(id, chunk)
+            }
+        }
+
+        return chunk
+    }
+
     getBlock(position: THREE.Vector3Like): BlockValue {
-        const chunk = this.chunks.get(Chunk.id(worldPositionToChunkPosition(position, _chunkPosition)))
+        const chunk = this.getChunk(worldPositionToChunkPosition(position, _chunkPosition))
 
         if (!chunk) {
             return {
@@ -135,7 +169,7 @@ export class World {
     }
 
     getSolid(position: THREE.Vector3Like) {
-        const chunk = this.chunks.get(Chunk.id(worldPositionToChunkPosition(position, _chunkPosition)))
+        const chunk = this.getChunk(worldPositionToChunkPosition(position, _chunkPosition))
 
         if (!chunk) {
             return false
@@ -146,23 +180,58 @@ export class World {
         return chunk.getSolid(chunkLocalPosition)
     }
 
-    setBlock(position: THREE.Vector3Like, value: BlockValue) {
-        const chunkPosition = worldPositionToChunkPosition(position, _chunkPosition)
+    /**
+     * Gets the chunk at the given chunk position, creating an empty chunk if it doesn't exist
+     */
+    getOrCreateChunk(chunkPosition: THREE.Vector3Like): Chunk {
         const id = Chunk.id(chunkPosition)
 
         let chunk = this.chunks.get(id)
 
         if (!chunk) {
-            const solidBuffer = new SharedArrayBuffer(Uint16Array.BYTES_PER_ELEMENT * CHUNK_SIZE ** 2)
-            const colorBuffer = new SharedArrayBuffer(Uint32Array.BYTES_PER_ELEMENT * CHUNK_SIZE ** 3)
+            if (this.directory) {
+                chunk = this.directory.allocate(this.id, chunkPosition)
+            } else {
+                const solid = new Uint16Array(new SharedArrayBuffer(Uint16Array.BYTES_PER_ELEMENT * CHUNK_SIZE ** 2))
+                const color = new Uint32Array(new SharedArrayBuffer(Uint32Array.BYTES_PER_ELEMENT * CHUNK_SIZE ** 3))
 
-            chunk = new Chunk(id, chunkPosition.clone(), solidBuffer, colorBuffer)
+                chunk = new Chunk(id, new THREE.Vector3(chunkPosition.x, chunkPosition.y, chunkPosition.z), solid, color)
+            }
 
             this.chunks.set(id, chunk)
 
             this.onChunkCreated.emit(chunk)
         }
 
+        return chunk
+    }
+
+    /**
+     * Adds a page of chunks in the chunk directory page layout, e.g. decoded by a loader worker.
+     * The page is adopted by the chunk directory without copying. Chunks that already exist are overwritten.
+     * @returns the added chunks
+     */
+    addChunkPage(page: SharedArrayBuffer, chunkIds: ArrayLike<number>, count: number): Chunk[] {
+        if (!this.directory) {
+            throw new Error('World: addChunkPage requires a chunk directory')
+        }
+
+        const chunks = this.directory.adoptPage(this.id, page, chunkIds, count)
+
+        for (const chunk of chunks) {
+            if (this.chunks.has(chunk.id)) continue
+
+            this.chunks.set(chunk.id, chunk)
+
+            this.onChunkCreated.emit(chunk)
+        }
+
+        return chunks
+    }
+
+    setBlock(position: THREE.Vector3Like, value: BlockValue) {
+        const chunk = this.getOrCreateChunk(worldPositionToChunkPosition(position, _chunkPosition))
+
         const chunkLocalPosition = worldPositionToChunkLocalPosition(position, _chunkLocalPosition)
 
         chunk.setBlock(chunkLocalPosition, value)
@@ -182,6 +251,14 @@ export class World {
     }: RaycastProps): RaycastResult {
         return raycast(this, origin, direction, maxDistance, outHitPosition, outHitNormal)
     }
+
+    /**
+     * Casts many rays at once without allocating, skipping empty chunks and columns.
+     * @returns the number of rays that hit
+     */
+    raycastBatch(props: RaycastBatchProps): number {
+        return raycastBatch(this, props)
+    }
 }
 
 const _chunkPosition = new THREE.Vector3()
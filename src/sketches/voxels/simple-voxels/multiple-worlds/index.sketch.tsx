@@ -1,18 +1,17 @@
 import { Canvas, Crosshair } from '@/common'
-import { ColliderDesc } from '@dimforge/rapier3d-compat'
 import { KeyboardControls, PointerLockControls, useKeyboardControls } from '@react-three/drei'
 import { useFrame, useThree } from '@react-three/fiber'
-import { Physics, RapierCollider, RapierRigidBody, RigidBody, quat, useRapier, vec3 } from '@react-three/rapier'
+import { Physics, RapierRigidBody, RigidBody, quat, useRapier, vec3 } from '@react-three/rapier'
 import { With, World } from 'arancini'
 import { createReactAPI } from 'arancini/react'
 import { useControls } from 'leva'
-import { useEffect, useMemo, useRef, useState } from 'react'
+import { createContext, useContext, useEffect, useMemo, useRef, useState } from 'react'
 import { HexColorPicker } from 'react-colorful'
 import * as THREE from 'three'
 import { create } from 'zustand'
+import { ChunkColliderBuilder, RapierChunkColliders } from '../lib/chunk-colliders'
 import { VoxelChunkMeshes, Voxels as VoxelsComponent } from '../lib/react'
 import { Voxels, VoxelsWorkerPool } from '../lib/voxels'
-import { Chunk, chunkPositionToWorldPosition } from '../lib/world'
 import { toolTunnel } from './tunnels'
 
 const SKETCH = 'simple-voxels/multiple-worlds'
@@ -79,13 +78,16 @@ const InitialWorlds = () => {
     return null
 }
 
+const chunkColliderBuilderContext = createContext<ChunkColliderBuilder>(null!)
+
+const useChunkColliderBuilder = () => useContext(chunkColliderBuilderContext)
+
 const VoxelWorld = ({ entity }: { entity: (typeof voxelWorldsQuery.entities)[number] }) => {
     const groupRef = useRef<THREE.Group>(null!)
 
     const { world: physicsWorld } = useRapier()
 
-    const [version, setVersion] = useState(0)
-    const regeneratePhysicsBody = () => setVersion((v) => v + 1)
+    const chunkColliderBuilder = useChunkColliderBuilder()
 
     const initial = useMemo(() => {
         const position = new THREE.Vector3()
@@ -95,103 +97,40 @@ const VoxelWorld = ({ entity }: { entity: (typeof voxelWorldsQuery.entities)[num
         entity.voxelWorld.matrix.decompose(position, quaternion, scale)
 
         return { position, quaternion, scale }
-    }, [entity, version])
-
-    useEffect(() => {
-        const unsub = entity.voxels.onChunkMeshUpdated.add(() => {
-            regeneratePhysicsBody()
-        })
-
-        return () => {
-            unsub()
-        }
-    }, [])
-
-    const colliders = useRef<Map<string, RapierCollider>>(new Map())
+    }, [entity])
 
     useEffect(() => {
-        if (entity.voxelWorld.type !== 'fixed') return
+        let chunkColliders: RapierChunkColliders | undefined
 
-        const unsub = entity.voxels.onChunkMeshUpdated.add((chunk, mesh) => {
-            const existingCollider = colliders.current.get(chunk.id)
+        // only rebuild the colliders of chunks that changed, and swap them in when the worker is done
+        const unsubUpdate = entity.voxels.onUpdate.add((changes) => {
+            const chunks = new Set(changes.map((change) => change.chunk))
 
-            if (existingCollider) {
-                physicsWorld.removeCollider(existingCollider, false)
+            for (const chunk of chunks) {
+                chunkColliderBuilder.build(entity.voxels.world, chunk)
             }
+        })
 
-            const positions = new Float32Array(mesh.geometry.getAttribute('position').array) as Float32Array
-            const indices = mesh.geometry.getIndex()!.array as Uint32Array
-
-            if (positions.length === 0 || indices.length === 0) return
-
-            const chunkWorldPosition = chunkPositionToWorldPosition(chunk.position, _vector3)
-            chunkWorldPosition.multiplyScalar(entity.voxelWorld.scale)
+        const unsubBuilt = chunkColliderBuilder.onBuilt.add((worldId, chunkId, boxes) => {
+            if (worldId !== entity.voxels.world.id) return
 
-            for (let i = 0; i < positions.length; i += 3) {
-                const x = positions[i]
-                const y = positions[i + 1]
-                const z = positions[i + 2]
+            const chunk = entity.voxels.world.chunks.get(chunkId)
+            if (!chunk || !entity.rigidBody) return
 
-                positions[i] = x * entity.voxelWorld.scale
-                positions[i + 1] = y * entity.voxelWorld.scale
-                positions[i + 2] = z * entity.voxelWorld.scale
+            if (!chunkColliders) {
+                chunkColliders = new RapierChunkColliders({ physicsWorld, rigidBody: entity.rigidBody, scale: entity.voxelWorld.scale })
             }
 
-            const colliderDesc = ColliderDesc.trimesh(positions, indices)
-            colliderDesc.setTranslation(chunkWorldPosition.x, chunkWorldPosition.y, chunkWorldPosition.z)
-
-            const collider = physicsWorld.createCollider(colliderDesc, entity.rigidBody!)
-
-            colliders.current.set(chunk.id, collider)
+            chunkColliders.update(chunk, boxes)
         })
 
         return () => {
-            unsub()
-        }
-    }, [version])
-
-    useEffect(() => {
-        if (entity.voxelWorld.type !== 'dynamic') return
-
-        const add = (chunk: Chunk, position: THREE.Vector3Like) => {
-            if (colliders.current.has(`${chunk.id}:${position.x},${position.y},${position.z}`)) return
-
-            const scale = entity.voxelWorld.scale
-            const halfSize = 0.5 * scale
-            const colliderDesc = ColliderDesc.cuboid(halfSize, halfSize, halfSize)
-            colliderDesc.setTranslation(
-                position.x * scale + halfSize,
-                position.y * scale + halfSize,
-                position.z * scale + halfSize,
-            )
+            unsubUpdate()
+            unsubBuilt()
 
-            const collider = physicsWorld.createCollider(colliderDesc, entity.rigidBody!)
-
-            colliders.current.set(`${chunk.id}:${position.x},${position.y},${position.z}`, collider)
-        }
-
-        const remove = (chunk: Chunk, position: THREE.Vector3Like) => {
-            const collider = colliders.current.get(`${chunk.id}:${position.x},${position.y},${position.z}`)
-
-            if (!collider) return
-
-            physicsWorld.removeCollider(collider, false)
-
-            colliders.current.delete(`${chunk.id}:${position.x},${position.y},${position.z}`)
+            chunkColliders?.dispose()
         }
-
-        entity.voxels.onUpdate.add((changes) => {
-            for (const change of changes) {
-                const { chunk, position, value } = change
-
-                if (value.solid) {
-                    add(chunk, position)
-                } else {
-                    remove(chunk, position)
-                }
-            }
-        })
-    }, [version])
+    }, [])
 
     return (
         <group ref={groupRef}>
@@ -233,12 +172,15 @@ const updateVoxelWorlds = () => {
 
 const VoxelWorlds = () => {
     const [voxelsWorkerPool] = useState(() => new VoxelsWorkerPool())
+    const [chunkColliderBuilder] = useState(() => new ChunkColliderBuilder())
 
     useEffect(() => {
         voxelsWorkerPool.connect()
+        chunkColliderBuilder.connect()
 
         return () => {
             voxelsWorkerPool.disconnect()
+            chunkColliderBuilder.disconnect()
         }
     }, [])
 
@@ -257,7 +199,11 @@ const VoxelWorlds = () => {
         updateVoxelWorlds()
     })
 
-    return <Entities in={voxelWorldsQuery}>{(entity) => <VoxelWorld key={entity.voxels.world.id} entity={entity} />}</Entities>
+    return (
+        <chunkColliderBuilderContext.Provider value={chunkColliderBuilder}>
+            <Entities in={voxelWorldsQuery}>{(entity) => <VoxelWorld key={entity.voxels.world.id} entity={entity} />}</Entities>
+        </chunkColliderBuilderContext.Provider>
+    )
 }
 
 const Tools = {
@@ -423,51 +369,63 @@ const CreateWorldTool = () => {
     )
 }
 
-const _raycaster = new THREE.Raycaster()
 const _raycastInverseMatrix = new THREE.Matrix4()
+const _raycastLocalOrigin = new THREE.Vector3()
+const _raycastLocalDirection = new THREE.Vector3()
+const _raycastHitWorldPosition = new THREE.Vector3()
 const _raycastLocalPosition = new THREE.Vector3()
+const _raycastHitNormal = new THREE.Vector3()
 const _raycastHitNormalOffset = new THREE.Vector3()
 const _raycastNormalOffsetLocalPosition = new THREE.Vector3()
 const _raycastBlock = new THREE.Vector3()
 
+const _raycastOrigins = new Float32Array(3)
+const _raycastDirections = new Float32Array(3)
+const _raycastHits = new Uint8Array(1)
+const _raycastHitPositions = new Float32Array(3)
+const _raycastHitNormals = new Float32Array(3)
+
 /**
  * Multi-voxel world raycast
  */
 const raycastVoxelWorlds = (origin: THREE.Vector3, direction: THREE.Vector3) => {
-    _raycaster.set(origin, direction)
+    let closestEntity: (typeof voxelWorldsQuery.entities)[number] | undefined
+    let closestDistance = Infinity
 
-    const voxelChunkMeshes = voxelWorldsQuery.entities
-        .flatMap((entity) => Array.from(entity.voxels.chunkMeshes.values()))
-        .map((chunkMesh) => chunkMesh.mesh)
-
-    const hits = _raycaster.intersectObjects(voxelChunkMeshes, true)
+    for (const entity of voxelWorldsQuery.entities) {
+        const { voxelWorld, voxels } = entity
+
+        // raycast in the local space of the voxel world
+        const inverseMatrix = _raycastInverseMatrix.copy(voxelWorld.matrix).invert()
+        _raycastLocalOrigin.copy(origin).applyMatrix4(inverseMatrix).toArray(_raycastOrigins)
+        _raycastLocalDirection.copy(direction).transformDirection(inverseMatrix).toArray(_raycastDirections)
+
+        const hits = voxels.world.raycastBatch({
+            origins: _raycastOrigins,
+            directions: _raycastDirections,
+            outHits: _raycastHits,
+            outHitPositions: _raycastHitPositions,
+            outHitNormals: _raycastHitNormals,
+        })
 
-    const closest = hits.sort((a, b) => a.distance - b.distance)[0]
+        if (hits === 0) continue
 
-    if (!closest) return
+        const hitWorldPosition = _raycastHitWorldPosition.fromArray(_raycastHitPositions).applyMatrix4(voxelWorld.matrix)
+        const distance = hitWorldPosition.distanceTo(origin)
 
-    const closestMesh = closest.object as THREE.Mesh
+        if (distance >= closestDistance) continue
 
-    let voxelWorldGroup: THREE.Object3D | null = closestMesh
-    while (voxelWorldGroup && !voxelWorldGroup.userData.voxelWorld) {
-        voxelWorldGroup = voxelWorldGroup.parent
+        closestDistance = distance
+        closestEntity = entity
+        _raycastLocalPosition.fromArray(_raycastHitPositions)
+        _raycastHitNormal.fromArray(_raycastHitNormals)
     }
 
-    if (!voxelWorldGroup) return
-
-    const entity = voxelWorldGroup.userData.voxelWorld as With<EntityType, 'voxelWorld' | 'voxels'>
-    const { voxelWorld } = entity
-
-    const hitPosition = closest.point
-    const hitNormal = closest.face?.normal
-
-    if (!hitNormal) return
-
-    hitNormal.normalize()
+    if (!closestEntity) return
 
-    // get local position of voxel world via matrix
-    const inverseMatrix = _raycastInverseMatrix.copy(voxelWorld.matrix).invert()
-    const localPosition = _raycastLocalPosition.copy(hitPosition).applyMatrix4(inverseMatrix)
+    const entity = closestEntity
+    const localPosition = _raycastLocalPosition
+    const hitNormal = _raycastHitNormal
 
     // use face normal to get desired block position
     const hitNormalOffset = _raycastHitNormalOffset.copy(hitNormal).multiplyScalar(-0.5)
@@ -8,12 +8,18 @@ import { ReactElement, createRef, useEffect, useMemo, useRef, useState } from 'r
 import * as THREE from 'three'
 import { Vector3Tuple } from 'three'
 import { VoxelChunkMeshes, Voxels, useVoxels } from '../lib/react'
-import { SimpleLevel } from '../simple-level'
-import { createChunkTrimesh } from './chunk-collider'
-import { chunkPositionToWorldPosition } from '../lib/world'
+import { SimpleLevel, useSimpleLevel } from '../simple-level'
+import { ChunkColliderBuilder, RapierChunkColliders } from '../lib/chunk-colliders'
+import { ChunkStreamSource } from '../lib/chunk-loader-worker-types'
+import { saveVoxelsToIndexedDB } from '../lib/chunk-stream-loader'
+import { useChunkStreamLevel } from '../use-chunk-stream-level'
 
 const SKETCH = 'simple-voxels/rapier-physics'
 
+const LEVEL_STORAGE = { database: 'sketches', store: 'simple-voxels', key: 'rapier-physics-level' }
+
+const LEVEL_SOURCE: ChunkStreamSource = { type: 'indexeddb', ...LEVEL_STORAGE }
+
 type Box = {
     position: THREE.Vector3Tuple
     rotation: THREE.Vector3Tuple
@@ -53,56 +59,53 @@ const BoxCannonTool = ({ children }: { children: React.ReactNode }) => {
     )
 }
 
-const VOXEL_PHYSICS_WORLD_OFFSET = 0.5
-
-const worldPositionToPhysicsPosition = (position: THREE.Vector3, out = new THREE.Vector3()) => {
-    return out.copy(position).addScalar(VOXEL_PHYSICS_WORLD_OFFSET)
-}
-
 const ChunkColliders = () => {
     const { voxels } = useVoxels()
 
     const { world } = useRapier()
 
-    const chunkRigidBodies = useMemo(() => {
-        return new Map<string, Rapier.RigidBody>()
-    }, [])
-
     useEffect(() => {
-        const unsub = voxels.onUpdate.add((changes) => {
-            const chunksIds = new Set<string>(changes.map((change) => change.chunk.id))
+        const rigidBody = world.createRigidBody(Rapier.RigidBodyDesc.fixed())
 
-            for (const chunkId of chunksIds) {
-                const chunk = voxels.world.chunks.get(chunkId)
-                if (!chunk) continue
+        const chunkColliders = new RapierChunkColliders({ physicsWorld: world, rigidBody })
 
-                let chunkRigidBody = chunkRigidBodies.get(chunkId)
+        const chunkColliderBuilder = new ChunkColliderBuilder()
+        chunkColliderBuilder.connect()
 
-                if (!chunkRigidBody) {
-                    chunkRigidBody = world.createRigidBody(Rapier.RigidBodyDesc.fixed())
+        // only rebuild the colliders of chunks that changed
+        const unsubUpdate = voxels.onUpdate.add((changes) => {
+            const chunks = new Set(changes.map((change) => change.chunk))
 
-                    const offset = worldPositionToPhysicsPosition(chunkPositionToWorldPosition(chunk.position))
+            for (const chunk of chunks) {
+                chunkColliderBuilder.build(voxels.world, chunk)
+            }
+        })
 
-                    chunkRigidBody.setTranslation(offset, true)
+        // streamed chunks are added whole, without block changes
+        const unsubChunksAdded = voxels.onChunksAdded.add((chunks) => {
+            for (const chunk of chunks) {
+                chunkColliderBuilder.build(voxels.world, chunk)
+            }
+        })
 
-                    chunkRigidBodies.set(chunkId, chunkRigidBody)
-                }
+        const unsubBuilt = chunkColliderBuilder.onBuilt.add((_worldId, chunkId, boxes) => {
+            const chunk = voxels.world.chunks.get(chunkId)
+            if (!chunk) return
 
-                while (chunkRigidBody.numColliders() > 0) {
-                    world.removeCollider(chunkRigidBody.collider(0), false)
-                }
+            chunkColliders.update(chunk, boxes)
+        })
 
-                const trimesh = createChunkTrimesh(voxels.world, chunk)
+        return () => {
+            unsubUpdate()
+            unsubChunksAdded()
+            unsubBuilt()
 
-                const colliderDesc = Rapier.ColliderDesc.trimesh(trimesh.positions, trimesh.indices)
-                colliderDesc.setTranslation(-0.5, -0.5, -0.5)
+            chunkColliderBuilder.disconnect()
+            chunkColliders.dispose()
 
-                world.createCollider(colliderDesc, chunkRigidBody)
+            if (rigidBody.isValid()) {
+                world.removeRigidBody(rigidBody)
             }
-        })
-
-        return () => {
-            unsub()
         }
     }, [])
 
@@ -150,15 +153,59 @@ const Snow = () => {
     return bodies
 }
 
+/**
+ * Generates the simple level and stores it once its blocks have been applied, so the next load can stream it
+ */
+const GenerateAndSaveLevel = () => {
+    const { voxels } = useVoxels()
+
+    useSimpleLevel()
+
+    useEffect(() => {
+        const unsub = voxels.onUpdate.add(() => {
+            unsub()
+
+            saveVoxelsToIndexedDB(voxels, LEVEL_STORAGE.database, LEVEL_STORAGE.store, LEVEL_STORAGE.key).catch((error) => {
+                console.error(error)
+            })
+        })
+
+        return unsub
+    }, [])
+
+    return null
+}
+
+const StreamLevel = ({ onError }: { onError: () => void }) => {
+    useChunkStreamLevel(LEVEL_SOURCE, onError)
+
+    return null
+}
+
+/**
+ * Streams the level stored in IndexedDB, or generates and stores it if nothing is stored yet
+ */
+const StreamedLevel = () => {
+    const [stored, setStored] = useState(true)
+
+    if (!stored) return <GenerateAndSaveLevel />
+
+    return <StreamLevel onError={() => setStored(false)} />
+}
+
 export default () => {
-    const { physicsDebug } = useControls(SKETCH, {
+    const { physicsDebug, level } = useControls(SKETCH, {
         physicsDebug: false,
+        level: {
+            value: 'generated',
+            options: ['generated', 'streamed'],
+        },
     })
 
     return (
         <Canvas camera={{ position: [20, 50, 50] }}>
-            <Voxels>
-                <SimpleLevel />
+            <Voxels key={level}>
+                {level === 'streamed' ? <StreamedLevel /> : <SimpleLevel />}
 
                 <Physics debug={physicsDebug}>
                     <Bounds fit margin={1.5}>
@@ -14,7 +14,7 @@ const VoxelMap = () => {
 export default function Sketch() {
     return (
         <Canvas>
-            <Voxels>
+            <Voxels mesher="greedy">
                 <VoxelMap />
 
                 <group onPointerDown={console.log}>
@@ -0,0 +1,48 @@
+import { useFrame } from '@react-three/fiber'
+import { useEffect, useState } from 'react'
+import { ChunkStreamSource } from './lib/chunk-loader-worker-types'
+import { ChunkStreamLoader } from './lib/chunk-stream-loader'
+import { useVoxels } from './lib/react'
+
+/**
+ * Streams a level in the binary chunk format into the voxels world, nearest to the actor first.
+ * Errors, e.g. nothing stored for an 'indexeddb' source, are passed to `onError` or logged.
+ */
+export const useChunkStreamLevel = (source: ChunkStreamSource, onError?: (error: Error) => void) => {
+    const { voxels } = useVoxels()
+    const [ready, setReady] = useState(false)
+
+    const [loader] = useState(() => new ChunkStreamLoader(voxels))
+
+    useEffect(() => {
+        let discard = false
+
+        loader
+            .load(source)
+            .then(() => {
+                if (discard) return
+
+                setReady(true)
+            })
+            .catch((error) => {
+                if (discard) return
+
+                if (onError) {
+                    onError(error)
+                } else {
+                    console.error(error)
+                }
+            })
+
+        return () => {
+            discard = true
+            loader.dispose()
+        }
+    }, [])
+
+    useFrame(() => {
+        loader.update()
+    })
+
+    return ready
+}
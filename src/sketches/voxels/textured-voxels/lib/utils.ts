@@ -1,49 +1,22 @@
+import { SpatialHashMap, packSpatialHashKey } from '@/common/utils/spatial-hash'
 import * as THREE from 'three'
 
+/**
+ * Map from integer positions to values, backed by an open addressing table of packed position keys.
+ * Positions must be in the range [-512, 511] on each axis.
+ */
 export class Vector3Map<T> {
-    map = new Map<number, Map<number, Map<number, T>>>()
+    map = new SpatialHashMap<T>()
 
     get({ x, y, z }: THREE.Vector3Like) {
-        const xMap = this.map.get(x)
-
-        if (!xMap) {
-            return
-        }
-
-        const yMap = xMap.get(y)
-
-        if (!yMap) {
-            return
-        }
-
-        return yMap.get(z)
+        return this.map.get(packSpatialHashKey(x, y, z))
     }
 
     set({ x, y, z }: THREE.Vector3Like, value: T) {
-        let xMap = this.map.get(x)
-
-        if (!xMap) {
-            xMap = new Map()
-            this.map.set(x, xMap)
-        }
-
-        let yMap = xMap.get(y)
-
-        if (!yMap) {
-            yMap = new Map()
-            xMap.set(y, yMap)
-        }
-
-        yMap.set(z, value)
+        this.map.set(packSpatialHashKey(x, y, z), value)
     }
 
-    *[Symbol.iterator]() {
-        for (const xMap of this.map.values()) {
-            for (const yMap of xMap.values()) {
-                for (const value of yMap.values()) {
-                    yield value
-                }
-            }
-        }
+    [Symbol.iterator]() {
+        return this.map.values()[Symbol.iterator]()
     }
-}
\ No newline at end of file
+}